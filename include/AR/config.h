@@ -251,11 +251,12 @@ enum {
 
 // Input modules. This is edited by the configure script.
 #undef  AR_INPUT_V4L
-#undef  AR_INPUT_V4L2
+#define AR_INPUT_V4L2
 #undef  AR_INPUT_DV
 #undef  AR_INPUT_1394CAM
 #undef  AR_INPUT_GSTREAMER
 #define AR_INPUT_IMAGE
+#define AR_INPUT_RAW
 #define AR_INPUT_DUMMY
 
 // Default input module. This is edited by the configure script.
@@ -265,6 +266,7 @@ enum {
 #undef  AR_DEFAULT_INPUT_1394CAM
 #undef  AR_DEFAULT_INPUT_GSTREAMER
 #undef  AR_DEFAULT_INPUT_IMAGE
+#undef  AR_DEFAULT_INPUT_RAW
 #undef  AR_DEFAULT_INPUT_DUMMY
 
 // Other Linux-only configuration.
@@ -371,6 +373,7 @@ enum {
 // Input modules. This is edited by the configure script.
 #define AR_INPUT_DUMMY
 #define AR_INPUT_IMAGE
+#define AR_INPUT_RAW
 #define AR_INPUT_WINDOWS_DIRECTSHOW
 #if !defined(_WIN64) || _MSC_VER >= 1800 // DSVideoLib 64-bit only on release for Visual Studio 2013 and later.
 #define AR_INPUT_WINDOWS_DSVIDEOLIB
@@ -385,6 +388,7 @@ enum {
 // Default input module. This is edited by the configure script.
 #undef  AR_DEFAULT_INPUT_DUMMY
 #undef  AR_DEFAULT_INPUT_IMAGE
+#undef  AR_DEFAULT_INPUT_RAW
 #define AR_DEFAULT_INPUT_WINDOWS_DIRECTSHOW
 #if !defined(_WIN64) || _MSC_VER >= 1800 // DSVideoLib 64-bit only on release for Visual Studio 2013 and later.
 #undef  AR_DEFAULT_INPUT_WINDOWS_DSVIDEOLIB
@@ -433,6 +437,8 @@ enum {
 #define ARDOUBLE_IS_FLOAT
 #undef  AR_INPUT_DUMMY
 #define AR_INPUT_ANDROID
+#undef  AR_INPUT_V4L2
+#undef  AR_INPUT_RAW
 #define AR_INPUT_IMAGE
 #undef  AR_DEFAULT_INPUT_DUMMY
 #define AR_DEFAULT_INPUT_ANDROID
@@ -505,8 +511,10 @@ enum {
 #endif
 #define AR_INPUT_DUMMY
 #define AR_INPUT_IMAGE
+#define AR_INPUT_RAW
 #undef  AR_DEFAULT_INPUT_DUMMY
 #undef  AR_DEFAULT_INPUT_IMAGE
+#undef  AR_DEFAULT_INPUT_RAW
 #define HAVE_LIBJPEG 1
 
 #endif
@@ -548,6 +556,10 @@ enum {
 #define AR_INPUT_IMAGE_DEFAULT_PIXEL_FORMAT   AR_PIXEL_FORMAT_RGB
 #endif
 
+#ifdef AR_INPUT_RAW
+#define AR_INPUT_RAW_DEFAULT_PIXEL_FORMAT   AR_PIXEL_FORMAT_RGB
+#endif
+
 //
 // Setup AR_DEFAULT_PIXEL_FORMAT.
 //
@@ -582,6 +594,8 @@ enum {
 #  define AR_DEFAULT_PIXEL_FORMAT   AR_INPUT_ANDROID_PIXEL_FORMAT
 #elif defined(AR_DEFAULT_INPUT_IMAGE)
 #  define AR_DEFAULT_PIXEL_FORMAT   AR_INPUT_IMAGE_DEFAULT_PIXEL_FORMAT
+#elif defined(AR_DEFAULT_INPUT_RAW)
+#  define AR_DEFAULT_PIXEL_FORMAT   AR_INPUT_RAW_DEFAULT_PIXEL_FORMAT
 #elif defined(AR_DEFAULT_INPUT_WINDOWS_MEDIA_FOUNDATION)
 #  define AR_DEFAULT_PIXEL_FORMAT   AR_INPUT_WINDOWS_MEDIA_FOUNDATION_PIXEL_FORMAT
 #elif defined(AR_DEFAULT_INPUT_WINDOWS_MEDIA_CAPTURE)
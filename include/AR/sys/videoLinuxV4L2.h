@@ -64,27 +64,23 @@ extern "C" {
 #define   AR2VIDEO_V4L2_STATUS_RUN     1
 #define   AR2VIDEO_V4L2_STATUS_STOP    2
 
+// One driver buffer, memory-mapped. Frames are handed to the caller in 'out' without copying.
 typedef struct {
-    AR2VideoBufferT     in;
-    AR2VideoBufferT     wait;
-    AR2VideoBufferT     out;
-    pthread_mutex_t     mutex;
+    ARUint8               *start;
+    size_t                 length;
+    AR2VideoBufferT        out;
+    ARUint8               *outPlanes[2];
 } AR2VideoBufferV4L2T;
 
-struct buffer_ar_v4l2 {
-    ARUint8   *start;
-    size_t    length;
-};
-
 typedef struct {
     char                   dev[256];
     int                    width;
     int                    height;
     int                    channel;
-    int                    mode;
+    int                    fps;
     AR_PIXEL_FORMAT        format;
+    __u32                  palette;         // V4L2 fourcc negotiated with the driver.
     int                    debug;
-    int                    palette;
     int                    saturation;
     int                    exposure;
     int                    gain;
@@ -92,19 +88,26 @@ typedef struct {
     int                    contrast;
     int                    brightness;
     int                    hue;
-    double                 whiteness;
-    double                 color;
 
     int                    fd;
     int                    status;
-    int                    video_cont_num;
-    ARUint8                *videoBuffer;
+    int                    bytesPerLine;    // As reported by the driver for plane 0.
 
-    pthread_t              capture;
-    AR2VideoBufferV4L2T    buffer;
-    
-    struct buffer_ar_v4l2 *buffers;
+    AR2VideoBufferV4L2T   *buffers;
     int                    n_buffers;
+    int                    bufferInUse;     // Index of the buffer held by the caller, or -1.
+    ARUint8               *copyBuffer;      // Only used when the driver pads rows; frames are then repacked here.
+    AR2VideoBufferT        copyOut;
+    ARUint8               *copyOutPlanes[2];
+
+    AR_VIDEO_FRAME_READY_CALLBACK callback;
+    void                  *userdata;
+    pthread_t              asyncThread;
+    pthread_mutex_t        asyncMutex;
+    pthread_cond_t         asyncCond;
+    int                    asyncRunning;
+    int                    asyncQuit;
+    int                    asyncFramePending; // Callback has been made, and the frame not yet collected.
 } AR2VideoParamV4L2T;
 
 
@@ -116,6 +119,7 @@ int                  ar2VideoGetSizeV4L2        ( AR2VideoParamV4L2T *vid, int *
 AR_PIXEL_FORMAT      ar2VideoGetPixelFormatV4L2 ( AR2VideoParamV4L2T *vid );
 AR2VideoBufferT     *ar2VideoGetImageV4L2       ( AR2VideoParamV4L2T *vid );
 int                  ar2VideoCapStartV4L2       ( AR2VideoParamV4L2T *vid );
+int                  ar2VideoCapStartAsyncV4L2  ( AR2VideoParamV4L2T *vid, AR_VIDEO_FRAME_READY_CALLBACK callback, void *userdata );
 int                  ar2VideoCapStopV4L2        ( AR2VideoParamV4L2T *vid );
 
 int                  ar2VideoGetParamiV4L2      ( AR2VideoParamV4L2T *vid, int paramName, int *value );
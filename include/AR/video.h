@@ -76,7 +76,8 @@ extern "C" {
 #define  AR_VIDEO_DEVICE_WINDOWS_MEDIA_FOUNDATION 16
 #define  AR_VIDEO_DEVICE_WINDOWS_MEDIA_CAPTURE 17
 #define  AR_VIDEO_DEVICE_V4L2               18
-#define  AR_VIDEO_DEVICE_MAX                18
+#define  AR_VIDEO_DEVICE_RAW                19
+#define  AR_VIDEO_DEVICE_MAX                19
 
 
 #define  AR_VIDEO_1394_BRIGHTNESS                      65
@@ -257,6 +258,9 @@ typedef void (*AR_VIDEO_FRAME_READY_CALLBACK)(void *);
 #ifdef AR_INPUT_IMAGE
 #include <AR/sys/videoImage.h>
 #endif
+#ifdef AR_INPUT_RAW
+#include <AR/sys/videoRaw.h>
+#endif
 #ifdef AR_INPUT_ANDROID
 #include <AR/sys/videoAndroid.h>
 #endif
@@ -311,6 +315,9 @@ typedef union {
 #ifdef AR_INPUT_IMAGE
     AR2VideoParamImageT         *image;
 #endif
+#ifdef AR_INPUT_RAW
+    AR2VideoParamRawT           *raw;
+#endif
 #ifdef AR_INPUT_ANDROID
     AR2VideoParamAndroidT       *android;
 #endif
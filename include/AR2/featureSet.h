@@ -100,6 +100,10 @@ AR2FeatureCoordT *ar2SelectFeature2( AR2ImageT *image, AR2FeatureMapT *featureMa
 AR2FeatureSetT *ar2ReadFeatureSet( char *filename, char *ext );
 int             ar2SaveFeatureSet( char *filename, char *ext, AR2FeatureSetT *featureSet );
 int             ar2FreeFeatureSet( AR2FeatureSetT **featureSet );
+// Packed layout, loaded by ar2ReadFeatureSet with a single read (or memory-mapping, where available).
+int             ar2SaveFeatureSetPacked( char *filename, char *ext, AR2FeatureSetT *featureSet );
+// Rewrites an existing legacy feature set file in the packed layout. A file that is already packed is left as is.
+int             ar2ConvertFeatureSet   ( char *filename, char *ext );
 
 #ifdef __cplusplus
 }
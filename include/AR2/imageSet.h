@@ -60,17 +60,43 @@ typedef struct {
     float         dpi;
 } AR2ImageT;
 
+typedef struct {
+    int          *pinCount;         // Per scale, number of outstanding ar2ImageSetRequireScales() calls.
+    ARUint32     *lastUsed;         // Per scale, value of a process-wide use counter when last required.
+} AR2ImageSetLazyT;
+
 typedef struct {
     AR2ImageT   **scale;
     int32_t       num;
+    AR2ImageSetLazyT *lazy;         // NULL if all scales are resident, otherwise scales other than 0 may have NULL image data.
 } AR2ImageSetT;
 
+#define    AR2_IMAGESET_LAZY_SCALE_MAX       32  // Image sets with more scales than this are always loaded eagerly.
+
+#define    AR2_IMAGESET_COMPRESS_NONE        0   // Levels stored as raw 8-bit luminance.
+#define    AR2_IMAGESET_COMPRESS_DELTA_RLE   1   // Levels stored losslessly as run-length encoded horizontal differences.
+
 /*   image.c   */
 AR2ImageSetT   *ar2GenImageSet   ( ARUint8 *image, int xsize, int ysize, int nc, float dpi, float dpi_list[], int dpi_num );
 AR2ImageSetT   *ar2ReadImageSet  ( char *filename );
 int             ar2WriteImageSet ( char *filename, AR2ImageSetT *imageSet );
+// Writes every scale of the image set, so that ar2ReadImageSet need not regenerate them on load.
+int             ar2WriteImageSetFull( char *filename, AR2ImageSetT *imageSet, int compress );
+// Rewrites an existing .iset file of any supported format in the full format.
+int             ar2UpgradeImageSet  ( char *filename, int compress );
 int             ar2FreeImageSet  ( AR2ImageSetT **imageSet );
 
+// Lazy loading. When enabled, ar2ReadImageSet loads only scale 0, and other scales are generated
+// the first time they are required and may be evicted again to stay within the memory budget.
+int             ar2ImageSetSetLazyLoad     ( int lazy );
+int             ar2ImageSetGetLazyLoad     ( int *lazy );
+int             ar2ImageSetSetMemoryBudget ( size_t bytes );    // 0 means unlimited.
+int             ar2ImageSetGetMemoryBudget ( size_t *bytes );
+// Ensure the scales whose bits are set in scaleMask are resident, generating any that are missing
+// (in parallel if there are several), and pin them so they are not evicted until released.
+int             ar2ImageSetRequireScales   ( AR2ImageSetT *imageSet, ARUint32 scaleMask );
+int             ar2ImageSetReleaseScales   ( AR2ImageSetT *imageSet, ARUint32 scaleMask );
+
 #ifdef __cplusplus
 }
 #endif
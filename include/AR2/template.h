@@ -108,6 +108,11 @@ int ar2SetTemplateSub ( const ARParamLT *cparamLT, const float  trans[3][4], AR2
 int ar2GetBestMatching ( ARUint8 *img, ARUint8 *mfImage, int xsize, int ysize, AR_PIXEL_FORMAT pixFormat,
                          AR2TemplateT *mtemp, int rx, int ry,
                          int search[3][2], int *bx, int *by, float *val);
+int ar2GetBestMatchingBuffered( ARUint8 *img, ARUint8 *mfImage, int xsize, int ysize, AR_PIXEL_FORMAT pixFormat,
+                                AR2TemplateT *mtemp, int rx, int ry,
+                                int search[3][2], int *bx, int *by, float *val,
+                                ARUint32 *subImage1, ARUint32 *subImage2 );
+int ar2GetBestMatchingSubImageSize( int xsize, int ysize );
 
 #if AR2_CAPABLE_ADAPTIVE_TEMPLATE
 int ar2GetBestMatching2( ARUint8 *img, ARUint8 *mfImage, int xsize, int ysize, AR_PIXEL_FORMAT pixFormat,
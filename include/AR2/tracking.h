@@ -103,6 +103,9 @@ struct _AR2Tracking2DParamT {
     AR2TemplateCandidateT   *candidate;
     ARUint8                 *dataPtr;    // Input image.
     ARUint8                 *mfImage;    // (Internally allocated buffer same size as input image).
+    ARUint32                *subImage1;  // (Internally allocated matching work buffer, subImageSize elements).
+    ARUint32                *subImage2;  // (Internally allocated matching work buffer, subImageSize elements).
+    int                      subImageSize;
     AR2TemplateT            *templ;
 #if AR2_CAPABLE_ADAPTIVE_TEMPLATE
     AR2Template2T           *templ2;
@@ -52,6 +52,7 @@
 #include <ARWrapper/ARMarker.h>
 #include <ARWrapper/ARMarkerSquare.h>
 #include <ARWrapper/ARMarkerMulti.h>
+#include <thread_sub.h>
 #if HAVE_NFT
 #  include <AR2/tracking.h>
 #  include <KPM/kpm.h>
@@ -134,6 +135,29 @@ private:
     ARdouble m_transL2R[3][4];
     AR3DStereoHandle *m_ar3DStereoHandle;
     
+    // Pipelined square marker detection. See setPipelined().
+    bool m_pipelined;
+    THREAD_HANDLE_T *m_detectionThreadHandle;
+    ARUint8 *m_detectionImage0;         ///< Frame being detected by the worker. Only valid during update().
+    ARUint8 *m_detectionImage1;
+    bool m_detectionOK;                 ///< Result of the worker's last arDetectMarker() call(s).
+    std::vector<ARMarkerInfo> m_pipelineMarkerInfo0; ///< Detection results of the previous frame, awaiting pose estimation.
+    std::vector<ARMarkerInfo> m_pipelineMarkerInfo1;
+    int m_pipelineMarkerNum0;
+    int m_pipelineMarkerNum1;
+    bool m_pipelineMarkerInfoValid;
+    double m_pipelineFrameTime;         ///< Time at which the frame held in m_pipelineMarkerInfo0/1 entered update().
+    
+    // Stereo detection of the right view, run concurrently with the left view.
+    THREAD_HANDLE_T *m_rightDetectionThreadHandle;
+    ARUint8 *m_rightDetectionImage;
+    bool m_rightDetectionOK;
+    
+    // Frame timing accounting. See getFrameTiming().
+    unsigned long m_timingFrameCount;
+    double m_timingLatencySum;
+    double m_timingProcessingSum;
+    
 #if HAVE_NFT
     bool doNFTMarkerDetection;
     bool m_nftMultiMode;
@@ -144,6 +168,7 @@ private:
     AR2HandleT          *m_ar2Handle;
     KpmHandle           *m_kpmHandle;
     AR2SurfaceSetT      *surfaceSet[PAGES_MAX]; // Weak-reference. Strong reference is now in ARMarkerNFT class.
+    struct _TrackingPagesHandle *m_trackingPagesHandle; // Pool for tracking several pages at once. Created on first use.
 #endif
     
     int m_error;
@@ -175,6 +200,27 @@ private:
 	 */
 	bool removeMarker(ARMarker* marker);
 	
+    //
+    // Square marker detection.
+    //
+    
+    /**
+     * Runs arDetectMarker() on the given frame(s) with m_arHandle0 (and m_arHandle1 if stereo).
+     * In stereo, the right view is detected on a second thread while the left is detected
+     * on this one. Touches only the ARHandles, so may be run on the detection thread.
+     */
+    bool detectMarkers(ARUint8 *image0, ARUint8 *image1);
+    
+    /**
+     * Estimates poses of the square and multi-square markers from detection results.
+     */
+    bool updateSquareMarkers(ARMarkerInfo *markerInfo0, int markerNum0, ARMarkerInfo *markerInfo1, int markerNum1);
+    
+    static void *detectionWorker(THREAD_HANDLE_T *threadHandle);
+    static void *rightDetectionWorker(THREAD_HANDLE_T *threadHandle);
+    bool finishPipelinedDetection(void);
+    void stopDetectionThread(void);
+	
     //
     // Convenience initialisers.
     //
@@ -478,6 +524,47 @@ public:
     
     bool getNFTMultiMode() const;
 
+    /**
+     * Enables or disables pipelined marker detection.
+     * In pipelined mode, update() hands square marker detection of the new frame to a
+     * worker thread, and while it runs, completes pose estimation and marker updates
+     * for the frame detected during the previous call, followed by NFT tracking of the
+     * new frame. Square marker results therefore lag the video by one frame, in exchange
+     * for the detection overlapping the rest of the update. This favours throughput over
+     * latency; use getFrameTiming() to measure both in a given deployment.
+     * @param on			true to enable pipelined mode, false (the default) to process each frame in sequence.
+     * @see					getPipelined()
+     */
+    void setPipelined(bool on);
+    
+    /**
+     * Returns whether pipelined marker detection is enabled.
+     * @return				true if pipelined mode is enabled.
+     * @see					setPipelined()
+     */
+    bool getPipelined() const;
+    
+    /**
+     * Returns frame timing averaged over the frames processed since the last call to
+     * resetFrameTiming().
+     * @param latencyMs		If non-NULL, filled with the mean time in milliseconds from a frame
+     *						entering update() to the return of the update() call in which its
+     *						square marker results were published.
+     * @param processingMs	If non-NULL, filled with the mean time in milliseconds spent in
+     *						update() per frame on the calling thread. 1000/processingMs is the
+     *						attainable frame rate of the caller.
+     * @param frameCount	If non-NULL, filled with the number of frames the averages cover.
+     * @return				true if at least one frame has been processed.
+     * @see					resetFrameTiming()
+     */
+    bool getFrameTiming(float *latencyMs, float *processingMs, int *frameCount) const;
+    
+    /**
+     * Discards accumulated frame timing, e.g. after switching pipelined mode.
+     * @see					getFrameTiming()
+     */
+    void resetFrameTiming();
+
 	/**
 	 * Populates the provided color buffer with the current contents of the debug image.
      * @param videoSourceIndex Index into an array of video sources, specifying which source should be queried.
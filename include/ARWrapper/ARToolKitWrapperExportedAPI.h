@@ -372,6 +372,37 @@ extern "C" {
     
     EXPORT_API bool arwGetNFTMultiMode();
 
+    /**
+     * Enables or disables pipelined marker detection. In pipelined mode, square marker
+     * detection of each new frame overlaps pose estimation of the previous frame, so
+     * square marker results lag the video by one frame in exchange for higher throughput.
+     * @param on		true to enable pipelined mode, false to process each frame in sequence.
+     * @see				arwGetPipelined()
+     */
+    EXPORT_API void arwSetPipelined(bool on);
+    
+    /**
+     * Returns whether pipelined marker detection is enabled.
+     * @return			true if pipelined mode is enabled.
+     * @see				arwSetPipelined()
+     */
+    EXPORT_API bool arwGetPipelined();
+    
+    /**
+     * Returns frame timing averaged since the last call to arwResetFrameTiming().
+     * @param latencyMs		Mean time in milliseconds from a frame entering arwUpdateAR() to its results being available. May be NULL.
+     * @param processingMs	Mean time in milliseconds spent in arwUpdateAR() per frame. May be NULL.
+     * @param frameCount	Number of frames the averages cover. May be NULL.
+     * @return				true if at least one frame has been processed.
+     */
+    EXPORT_API bool arwGetFrameTiming(float *latencyMs, float *processingMs, int *frameCount);
+    
+    /**
+     * Discards accumulated frame timing.
+     * @see				arwGetFrameTiming()
+     */
+    EXPORT_API void arwResetFrameTiming();
+
     // ----------------------------------------------------------------------------------------------------
 #pragma mark  Marker management
     // ----------------------------------------------------------------------------------------------------
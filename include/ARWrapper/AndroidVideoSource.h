@@ -54,7 +54,7 @@ class AndroidVideoSource : public VideoSource {
 private:
 
 	bool newFrameArrived;
-    ARUint8 *localFrameBuffer;
+    ARUint8 *writeFrameBuffer;      ///< Buffer from frameRing the next frame is written into.
     size_t frameBufferSize;
 
     static void getVideoReadyAndroidCparamCallback(const ARParam *cparam_p, void *userdata);
@@ -80,6 +80,14 @@ public:
      */
     size_t getFrameSize();
     
+    /**
+     * Returns the buffer the next frame should be written into, for formats which
+     * need no conversion (NV21 and 420f). Once written, pass NULL to acceptImage().
+     * @return		Pointer to a buffer of getFrameSize() bytes, or NULL if every buffer
+     *				is still in use, in which case the frame should be dropped.
+     */
+    ARUint8* getWriteFrameBuffer();
+    
 	void acceptImage(ARUint8* ptr);
 
 	virtual bool captureFrame();
@@ -40,4 +40,33 @@
 
 void color_convert_common(unsigned char *pY, unsigned char *pUV, int width, int height, unsigned char *buffer);
 
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+#  define HAVE_X86_SIMD 1
+
+// Vectorised conversions to 32-bit RGBA (bytes R, G, B, 255), producing output
+// bit-identical to the scalar loops in VideoSource::updateTexture32(). Each takes
+// the instruction set level to use, normally the value of color_convert_x86_level().
+
+#define COLOR_CONVERSION_X86_NONE   0
+#define COLOR_CONVERSION_X86_SSE2   1
+#define COLOR_CONVERSION_X86_SSSE3  2
+#define COLOR_CONVERSION_X86_AVX2   3
+
+// Returns the highest of the levels above usable on this CPU and OS. Detected on first call.
+int color_convert_x86_level(void);
+
+// Packed 24 or 32-bit RGB in any component order, e.g. BGRA is pixelSize 4 with offsets 2, 1, 0.
+// Converts count pixels. Needs at least SSSE3 to do anything faster than the scalar loop.
+void color_convert_x86_rgb(int level, const unsigned char *src, int pixelSize, int rOffset, int gOffset, int bOffset,
+                           unsigned int *dst, int count);
+
+// Bi-planar 4:2:0 (NV21 if crFirst, else 420f). width and height must be even.
+void color_convert_x86_420bi(int level, const unsigned char *pY, const unsigned char *pC, int crFirst,
+                             int width, int height, unsigned int *dst);
+
+// Packed 4:2:2 (yuvs if yFirst, else 2vuy). Converts count pixels, which must be even.
+void color_convert_x86_422(int level, const unsigned char *src, int yFirst, unsigned int *dst, int count);
+
+#endif // x86
+
 #endif // !COLORCONVERSION_H
@@ -0,0 +1,75 @@
+/*
+ *  FrameBufferRing.h
+ *  ARToolKit5
+ *
+ *  This file is part of ARToolKit.
+ *
+ *  ARToolKit is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ARToolKit is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ARToolKit.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  As a special exception, the copyright holders of this library give you
+ *  permission to link this library with independent modules to produce an
+ *  executable, regardless of the license terms of these independent modules, and to
+ *  copy and distribute the resulting executable under terms of your choice,
+ *  provided that you also meet, for each linked independent module, the terms and
+ *  conditions of the license of that module. An independent module is a module
+ *  which is neither derived from nor based on this library. If you modify this
+ *  library, you may extend this exception to your version of the library, but you
+ *  are not obligated to do so. If you do not wish to do so, delete this exception
+ *  statement from your version.
+ *
+ *  Copyright 2015 Daqri, LLC.
+ *
+ */
+
+#ifndef FRAMEBUFFERRING_H
+#define FRAMEBUFFERRING_H
+
+#include <AR/ar.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A small ring of reference-counted frame buffers, shared between threads.
+ *
+ * A producer takes a free buffer with frameBufferRingAcquire(), fills it, and hands
+ * it to the ring with frameBufferRingPublish(), which makes it the latest frame.
+ * A consumer which needs a frame to outlive the next publish (e.g. a worker thread)
+ * takes a reference with frameBufferRingRetain() and drops it with frameBufferRingRelease().
+ * A buffer is only reused once every reference to it has been released, so no one
+ * ever waits on anyone else; with three buffers, one can be written while one is
+ * the latest frame and a third is held by a worker. If every buffer is in use,
+ * frameBufferRingAcquire() returns NULL and the producer should drop the frame.
+ */
+typedef struct _FrameBufferRing FrameBufferRing;
+
+#define FRAME_BUFFER_RING_DEFAULT_COUNT 3
+
+FrameBufferRing *frameBufferRingCreate(int bufferSize, int bufferCount); // Returns NULL in case of failure.
+int frameBufferRingDelete(FrameBufferRing **ring_p); // All references should have been released.
+int frameBufferRingGetBufferSize(FrameBufferRing *ring);
+
+ARUint8 *frameBufferRingAcquire(FrameBufferRing *ring); // Free buffer, with one reference held by the caller. NULL if none is free.
+int frameBufferRingPublish(FrameBufferRing *ring, ARUint8 *buff); // Make buff the latest frame. The caller's reference passes to the ring.
+ARUint8 *frameBufferRingGetLatest(FrameBufferRing *ring); // Latest published frame, or NULL.
+
+int frameBufferRingRetain(FrameBufferRing *ring, ARUint8 *buff); // Returns -1 if buff is not a buffer of this ring.
+int frameBufferRingRelease(FrameBufferRing *ring, ARUint8 *buff);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // !FRAMEBUFFERRING_H
@@ -44,6 +44,7 @@
 #include <AR/video.h>
 
 #include <ARWrapper/Image.h>
+#include <ARWrapper/FrameBufferRing.h>
 
 #ifndef _WINRT
 #  if TARGET_PLATFORM_ANDROID || TARGET_PLATFORM_IOS
@@ -96,6 +97,7 @@ protected:
     ARUint8 *frameBuffer;               ///< Pointer to latest frame. Set by concrete subclass to point to frame data.
     ARUint8 *frameBuffer2;              ///< For bi-planar formats, pointer to plane 2 of latest frame. Set by concrete subclass to point to frame data.
 	int frameStamp;						///< Latest framestamp. Incremented in the concrete subclass when a new frame arrives.
+    FrameBufferRing *frameRing;         ///< Buffers frames can be shared from. A subclass which owns its frame memory may capture into it, otherwise retainFrame() copies frames into it.
     
     int m_error;
     void setError(int error);
@@ -199,6 +201,27 @@ public:
 	 */
 	int getFrameStamp();
 
+	/**
+	 * Returns the current frame, holding a reference on it so that it stays valid
+	 * (e.g. for use on another thread) while newer frames arrive. If the frame was
+	 * captured into a shared buffer this does not copy; otherwise the frame (its
+	 * first plane, for bi-planar formats) is copied into a shared buffer.
+	 * @return		Pointer to the frame, or NULL if there is no frame or no free buffer.
+	 *				Must be passed to releaseFrame() when no longer needed.
+	 */
+	ARUint8* retainFrame();
+
+	/**
+	 * Drops a reference taken by retainFrame().
+	 */
+	void releaseFrame(ARUint8* frame);
+
+	/**
+	 * Returns the ring holding frames returned by retainFrame(), for code which
+	 * releases them without access to the video source.
+	 */
+	FrameBufferRing* getFrameRing();
+
 	/**
 	 * Populates the provided color buffer with the current video frame.
 	 * @param buffer	The color buffer to populate with frame data
@@ -221,8 +221,72 @@ int         kpmSetProcMode( KpmHandle *kpmHandle, KPM_PROC_MODE  procMode );
 int         kpmGetProcMode( KpmHandle *kpmHandle, KPM_PROC_MODE *procMode );
 int         kpmSetDetectedFeatureMax( KpmHandle *kpmHandle, int  detectedMaxFeature );
 int         kpmGetDetectedFeatureMax( KpmHandle *kpmHandle, int *detectedMaxFeature );
+
+/*!
+    @function
+    @abstract Set the number of threads used to detect features during kpmMatching.
+    @discussion
+        With the FREAK (binary feature) matcher, the bands of each DoG image are searched
+        concurrently and the detected features are then merged in a fixed order, so the
+        result is the same for any number of threads.
+    @param kpmHandle Handle to the current KPM tracker instance, as generated by kpmCreateHandle or kpmCreateHandleHomography.
+    @param surfThreadNum Number of threads. Values less than 1 select one thread per CPU core (the default).
+    @result 0 on success, or -1 on error.
+ */
 int         kpmSetSurfThreadNum( KpmHandle *kpmHandle, int surfThreadNum );
 
+/*!
+    @function
+    @abstract Set the number of threads used to match reference keyframes during kpmMatching.
+    @discussion
+        Keyframes of the reference data set are matched concurrently, and the best match is then
+        chosen in a fixed order, so the result is the same for any number of threads. Each page
+        contributes one keyframe per scale, so a data set has several times more keyframes than pages.
+        Has no effect unless the FREAK (binary feature) matcher is in use.
+    @param kpmHandle Handle to the current KPM tracker instance, as generated by kpmCreateHandle or kpmCreateHandleHomography.
+    @param matchingThreadNum Number of threads. Values less than 1 select one thread per CPU core (the default).
+    @result 0 on success, or -1 on error.
+    @seealso kpmGetMatchingThreadNum kpmGetMatchingThreadNum
+*/
+int         kpmSetMatchingThreadNum( KpmHandle *kpmHandle, int  matchingThreadNum );
+int         kpmGetMatchingThreadNum( KpmHandle *kpmHandle, int *matchingThreadNum );
+
+/*!
+    @function
+    @abstract Stop matching reference pages once a page is recognised well enough.
+    @discussion
+        By default kpmMatching tries every page of the reference data set and reports the best.
+        With early exit, the most recently recognised pages are tried first and matching stops
+        at the first page verified with at least inlierNum inliers. This makes recognition of a
+        page that was just lost much faster, at the cost of not always reporting the best page.
+        Has no effect unless the FREAK (binary feature) matcher is in use.
+    @param kpmHandle Handle to the current KPM tracker instance, as generated by kpmCreateHandle or kpmCreateHandleHomography.
+    @param inlierNum Number of inliers at which to stop, or 0 to try every page (the default).
+    @result 0 on success, or -1 on error.
+    @seealso kpmGetMatchingEarlyExit kpmGetMatchingEarlyExit
+ */
+int         kpmSetMatchingEarlyExit( KpmHandle *kpmHandle, int  inlierNum );
+int         kpmGetMatchingEarlyExit( KpmHandle *kpmHandle, int *inlierNum );
+
+/*!
+    @function
+    @abstract Shortlist the reference pages worth verifying before matching them.
+    @discussion
+        With the global index, the features of every page are searched once, each matching
+        feature votes for its page, and only the keyframes of the shortlistSize pages with the
+        most votes go on to be matched and verified. This keeps matching time nearly flat as
+        pages are added. With no more pages than shortlistSize, every page is matched as before.
+        Enabled by default, with a shortlist of 8 pages.
+        Has no effect unless the FREAK (binary feature) matcher is in use.
+    @param kpmHandle Handle to the current KPM tracker instance, as generated by kpmCreateHandle or kpmCreateHandleHomography.
+    @param on 1 to use the global index, or 0 to match every page.
+    @param shortlistSize Maximum number of pages verified per kpmMatching call. Must be at least 1.
+    @result 0 on success, or -1 on error.
+    @seealso kpmGetGlobalIndex kpmGetGlobalIndex
+ */
+int         kpmSetGlobalIndex( KpmHandle *kpmHandle, int  on, int  shortlistSize );
+int         kpmGetGlobalIndex( KpmHandle *kpmHandle, int *on, int *shortlistSize );
+
 /*!
     @function
     @abstract Load a reference data set into the key point matcher for tracking.
@@ -263,6 +327,43 @@ int         kpmSetRefDataSetFile( KpmHandle *kpmHandle, const char *filename, co
 
 int         kpmSetRefDataSetFileOld( KpmHandle *kpmHandle, const char *filename, const char *ext );
 
+/*!
+    @function
+    @abstract Add a single page to the reference data of a KPM handle.
+    @discussion
+        The reference points and images of one page are copied from refDataSet and added
+        to those already loaded by kpmSetRefDataSet or earlier calls to this function.
+        Pages already loaded, and the matcher's indexes of their images, are left as they are.
+        This may be called while another thread is calling kpmMatching on the same handle;
+        matching waits only while the new page's images are indexed.
+        With the SURF (non-binary) matcher, the single index over all pages is rebuilt.
+    @param kpmHandle Handle to the current KPM tracker instance, as generated by kpmCreateHandle or kpmCreateHandleHomography.
+    @param refDataSet Reference data set holding the page, e.g. as loaded by kpmLoadRefDataSet.
+        Use kpmChangePageNoOfRefDataSet first if its page number is already in use.
+        The dataset can be disposed of by calling kpmDeleteRefDataSet after this operation.
+    @param pageNo Page number, in refDataSet, of the page to add.
+    @result 0 if successful, or -1 if the page is not in refDataSet, is already loaded,
+        or would exceed the maximum number of reference images.
+    @seealso kpmRemoveRefDataSetPage kpmRemoveRefDataSetPage
+    @seealso kpmChangePageNoOfRefDataSet kpmChangePageNoOfRefDataSet
+ */
+int         kpmAddRefDataSetPage( KpmHandle *kpmHandle, KpmRefDataSet *refDataSet, int pageNo );
+
+/*!
+    @function
+    @abstract Remove a single page from the reference data of a KPM handle.
+    @discussion
+        The reference points and images of the page are removed. Other pages, and the
+        matcher's indexes of their images, are left as they are. This may be called while
+        another thread is calling kpmMatching on the same handle. Any KpmResult array
+        previously returned by kpmGetResult must be fetched again afterwards.
+    @param kpmHandle Handle to the current KPM tracker instance, as generated by kpmCreateHandle or kpmCreateHandleHomography.
+    @param pageNo Page number of the page to remove.
+    @result 0 if successful, or -1 if the page is not loaded.
+    @seealso kpmAddRefDataSetPage kpmAddRefDataSetPage
+ */
+int         kpmRemoveRefDataSetPage( KpmHandle *kpmHandle, int pageNo );
+
 /*!
     @function
     @abstract Perform key-point matching on an image.
@@ -277,6 +378,25 @@ int         kpmSetRefDataSetFileOld( KpmHandle *kpmHandle, const char *filename,
  */
 int         kpmMatching( KpmHandle *kpmHandle, ARUint8 *inImage );
 
+/*!
+    @function
+    @abstract Perform key-point matching on an image which is already greyscale.
+    @discussion
+        Use this in place of kpmMatching when the caller already holds the luma (Y) plane of
+        the frame, e.g. the first plane of a bi-planar YUV frame, to avoid a colour conversion.
+        Image buffers are held in the KPM handle and reused, so matching a sequence of frames
+        does not allocate memory once the buffers have grown to fit.
+    @param kpmHandle Handle to the current KPM tracker instance, as generated by kpmCreateHandle or kpmCreateHandleHomography.
+    @param monoImage Luma pixels, one byte per pixel, beginning with the leftmost pixel of the top row.
+        The dimensions of this image must match the values specified at the time of creation of the KPM handle.
+        The pixel format of the handle is ignored.
+    @param rowBytes Number of bytes from the start of one row of monoImage to the start of the next.
+        Pass 0 for an unpadded image.
+    @result 0 if successful, or value &lt;0 in case of error.
+    @seealso kpmMatching kpmMatching
+ */
+int         kpmMatchingMono( KpmHandle *kpmHandle, ARUint8 *monoImage, int rowBytes );
+
 int         kpmSetMatchingSkipPage( KpmHandle *kpmHandle, int *skipPages, int num );
 #if !BINARY_FEATURE
 int         kpmSetMatchingSkipRegion( KpmHandle *kpmHandle, SurfSubRect *skipRegion, int regionNum);
@@ -386,6 +506,36 @@ int         kpmChangePageNoOfRefDataSet ( KpmRefDataSet *refDataSet, int oldPage
  */
 ARUint8    *kpmUtilGenBWImage( ARUint8 *image, AR_PIXEL_FORMAT pixFormat, int xsize, int ysize, int procMode, int *newXsize, int *newYsize );
 
+/*!
+    @function
+    @abstract Get the size of the greyscale image used for a processing mode.
+    @param xsize Width of the source image.
+    @param ysize Height of the source image.
+    @param procMode Processing mode, one of the KPM_PROC_MODE values.
+    @param newXsize On return, the width of the greyscale image.
+    @param newYsize On return, the height of the greyscale image.
+    @result 0 if successful, or value &lt;0 in case of error.
+ */
+int         kpmUtilGetBWImageSize( int xsize, int ysize, int procMode, int *newXsize, int *newYsize );
+
+/*!
+    @function
+    @abstract Generate a greyscale image for a processing mode into a caller-supplied buffer.
+    @discussion
+        As kpmUtilGenBWImage, but without allocating memory, and the rows of the source
+        image may be padded.
+    @param image Source image, beginning with the leftmost pixel of the top row.
+    @param pixFormat Layout of pixel data in 'image'.
+    @param xsize Width of the source image.
+    @param ysize Height of the source image.
+    @param rowBytes Number of bytes from the start of one row of 'image' to the start of the next.
+    @param procMode Processing mode, one of the KPM_PROC_MODE values.
+    @param newImage Buffer to receive the greyscale image, unpadded. Its size is given by kpmUtilGetBWImageSize.
+    @result 0 if successful, or value &lt;0 in case of error.
+    @seealso kpmUtilGetBWImageSize kpmUtilGetBWImageSize
+ */
+int         kpmUtilGenBWImage2( ARUint8 *image, AR_PIXEL_FORMAT pixFormat, int xsize, int ysize, int rowBytes, int procMode, ARUint8 *newImage );
+
 #if !BINARY_FEATURE
 int         kpmUtilGetPose ( ARParamLT *cparamLT, KpmMatchResult *matchData, KpmRefDataSet *refDataSet, KpmInputDataSet *inputDataSet, float  camPose[3][4], float  *err );
     
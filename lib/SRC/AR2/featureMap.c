@@ -39,9 +39,29 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <thread_sub.h>
 #include <AR2/config.h>
 #include <AR2/featureSet.h>
 
+// Parameters shared by the threads computing rows of a feature map.
+typedef struct {
+    ARUint8        *imageBW;
+    float          *fimage;
+    float          *fimage2;
+    int             xsize, ysize;
+    int             ts1, ts2;
+    int             search_size1, search_size2;
+    float           max_sim_thresh, sd_thresh;
+    int             k;
+    int             first, step;    // Rows first, first + step, ... (in range [1, ysize - 1)) are computed.
+} AR2FeatureMapRowsArgT;
+
+static void  genFeatureMapRows      ( AR2FeatureMapRowsArgT *arg );
+static void *genFeatureMapRowsThread( THREAD_HANDLE_T *threadHandle );
+static void  updateRowMin           ( float *fimage2, int xsize, int j, float *rowMin, int *rowMinX );
+static int   findMinFeature         ( float *fimage2, int xsize, int ysize, float *rowMin, int *rowMinX,
+                                      float max_sim_thresh, int *cx, int *cy, float *min_sim );
+
 static int make_template( ARUint8 *imageBW, int xsize, int ysize,
                           int cx, int cy, int ts1, int ts2, float  sd_thresh,
                           float  *template, float  *vlen );
@@ -122,23 +142,21 @@ AR2FeatureMapT *ar2GenFeatureMap( AR2ImageT *image,
                                   float  max_sim_thresh, float  sd_thresh )
 {
     AR2FeatureMapT  *featureMap;
-    float           *fimage, *fp;
+    float           *fimage;
     float           *fimage2, *fp2;
-    float           *template;
     ARUint8         *p;
     float           dx, dy;
     int             xsize, ysize;
     int             hist[1000], sum;
     int             i, j, k;
-    float           vlen;
-    float           max, sim;
-    int             ii, jj;
+    AR2FeatureMapRowsArgT  arg[AR2_THREAD_MAX];
+    THREAD_HANDLE_T       *threadHandle[AR2_THREAD_MAX];
+    int                    threadNum;
 
     xsize = image->xsize;
     ysize = image->ysize;
     arMalloc(fimage,   float,  xsize*ysize);
     arMalloc(fimage2,  float,  xsize*ysize);
-    arMalloc(template, float , (ts1+ts2+1)*(ts1+ts2+1));
 
 
     fp2 = fimage2;
@@ -193,32 +211,103 @@ AR2FeatureMapT *ar2GenFeatureMap( AR2ImageT *image,
     ARLOGi(" Filtered features = %7d[pixel]\n", j);
 
 
-    fp = fimage;
-    fp2 = fimage2;
+    // Border rows and columns are never features.
     for( i = 0; i < xsize; i++ ) {
-        *(fp++) = 1.0f;
-        fp2++;
+        fimage[i] = 1.0f;
+        fimage[(ysize-1)*xsize + i] = 1.0f;
     }
     for( j = 1; j < ysize-1; j++ ) {
-        ARLOGi("\r%4d/%4d.", j+1, ysize); fflush(stdout);
-        *(fp++) = 1.0f;
-        fp2++;
+        fimage[j*xsize] = 1.0f;
+        fimage[j*xsize + xsize-1] = 1.0f;
+    }
+
+    // Each interior pixel depends only on the image and gradient map, so rows are
+    // interleaved across threads; the result is identical for any thread count.
+    threadNum = threadGetCPU();
+    if( threadNum > AR2_THREAD_MAX ) threadNum = AR2_THREAD_MAX;
+    if( threadNum > ysize - 2 ) threadNum = ysize - 2;
+    if( threadNum < 1 ) threadNum = 1;
+    for( i = 0; i < threadNum; i++ ) {
+#if AR2_CAPABLE_ADAPTIVE_TEMPLATE
+        arg[i].imageBW        = image->imgBWBlur[1];
+#else
+        arg[i].imageBW        = image->imgBW;
+#endif
+        arg[i].fimage         = fimage;
+        arg[i].fimage2        = fimage2;
+        arg[i].xsize          = xsize;
+        arg[i].ysize          = ysize;
+        arg[i].ts1            = ts1;
+        arg[i].ts2            = ts2;
+        arg[i].search_size1   = search_size1;
+        arg[i].search_size2   = search_size2;
+        arg[i].max_sim_thresh = max_sim_thresh;
+        arg[i].sd_thresh      = sd_thresh;
+        arg[i].k              = k;
+        arg[i].first          = 1 + i;
+        arg[i].step           = threadNum;
+        threadHandle[i] = NULL;
+        if( i > 0 ) {
+            threadHandle[i] = threadInit( i, &(arg[i]), genFeatureMapRowsThread );
+            if( threadHandle[i] ) threadStartSignal( threadHandle[i] );
+        }
+    }
+    genFeatureMapRows( &(arg[0]) );
+    for( i = 1; i < threadNum; i++ ) {
+        if( threadHandle[i] == NULL ) {
+            genFeatureMapRows( &(arg[i]) ); // Thread could not be started, so do its share here.
+            continue;
+        }
+        threadEndWait( threadHandle[i] );
+        threadWaitQuit( threadHandle[i] );
+        threadFree( &threadHandle[i] );
+    }
+    free(fimage2);
+
+    arMalloc( featureMap, AR2FeatureMapT, 1 );
+    featureMap->map = fimage;
+    featureMap->xsize = xsize;
+    featureMap->ysize = ysize;
+
+    return featureMap;
+}
+
+
+static void genFeatureMapRows( AR2FeatureMapRowsArgT *arg )
+{
+    float           *template;
+    float           *fp, *fp2;
+    float           vlen;
+    float           max, sim;
+    int             xsize, ysize;
+    int             search_size1, search_size2;
+    int             i, j;
+    int             ii, jj;
+
+    xsize = arg->xsize;
+    ysize = arg->ysize;
+    search_size1 = arg->search_size1;
+    search_size2 = arg->search_size2;
+    arMalloc(template, float , (arg->ts1+arg->ts2+1)*(arg->ts1+arg->ts2+1));
+
+    for( j = arg->first; j < ysize-1; j += arg->step ) {
+        if( arg->first == 1 ) {
+            ARLOGi("\r%4d/%4d.", j+1, ysize); fflush(stdout);
+        }
+        fp  = &(arg->fimage[j*xsize + 1]);
+        fp2 = &(arg->fimage2[j*xsize + 1]);
         for( i = 1; i < xsize-1; i++ ) {
             if( *fp2 <= *(fp2-1) || *fp2 <= *(fp2+1) || *fp2 <= *(fp2-xsize) || *fp2 <= *(fp2+xsize) ) {
                 *(fp++) = 1.0f;
                 fp2++;
                 continue;
             }
-            if( (int)(*fp2 * 1000) < k ) {
+            if( (int)(*fp2 * 1000) < arg->k ) {
                 *(fp++) = 1.0f;
                 fp2++;
                 continue;
             }
-#if AR2_CAPABLE_ADAPTIVE_TEMPLATE
-            if( make_template(image->imgBWBlur[1], xsize, ysize, i, j, ts1, ts2, sd_thresh, template, &vlen) < 0 ) {
-#else
-            if( make_template(image->imgBW, xsize, ysize, i, j, ts1, ts2, sd_thresh, template, &vlen) < 0 ) {
-#endif
+            if( make_template(arg->imageBW, xsize, ysize, i, j, arg->ts1, arg->ts2, arg->sd_thresh, template, &vlen) < 0 ) {
                 *(fp++) = 1.0f;
                 fp2++;
                 continue;
@@ -231,37 +320,75 @@ AR2FeatureMapT *ar2GenFeatureMap( AR2ImageT *image,
                     if( ii*ii + jj*jj <= search_size2*search_size2 ) continue;
                     //if( jj >= -search_size2 && jj <= search_size2 && ii >= -search_size2 && ii <= search_size2 ) continue;
 
-#if AR2_CAPABLE_ADAPTIVE_TEMPLATE
-                    if( get_similarity(image->imgBWBlur[1], xsize, ysize, template, vlen, ts1, ts2, i+ii, j+jj, &sim) < 0 ) continue;
-#else
-                    if( get_similarity(image->imgBW, xsize, ysize, template, vlen, ts1, ts2, i+ii, j+jj, &sim) < 0 ) continue;
-#endif
+                    if( get_similarity(arg->imageBW, xsize, ysize, template, vlen, arg->ts1, arg->ts2, i+ii, j+jj, &sim) < 0 ) continue;
 
                     if( sim > max ) {
                         max = sim;
-                        if( max > max_sim_thresh ) break;
+                        if( max > arg->max_sim_thresh ) break;
                     }
                 }
-                if( max > max_sim_thresh ) break;
+                if( max > arg->max_sim_thresh ) break;
             }
             *(fp++) = (float)max;
             fp2++;
         }
-        *(fp++) = 1.0f;
-        fp2++;
     }
-    ARLOGi("\n");
-    free(fimage2);
+    if( arg->first == 1 ) {
+        ARLOGi("\n");
+    }
+
     free(template);
+}
 
-    arMalloc( featureMap, AR2FeatureMapT, 1 );
-    featureMap->map = fimage;
-    featureMap->xsize = xsize;
-    featureMap->ysize = ysize;
+static void *genFeatureMapRowsThread( THREAD_HANDLE_T *threadHandle )
+{
+    AR2FeatureMapRowsArgT  *arg;
 
-    return featureMap;
+    arg = (AR2FeatureMapRowsArgT *)threadGetArg(threadHandle);
+    while( threadStartWait(threadHandle) == 0 ) {
+        genFeatureMapRows( arg );
+        threadEndSignal(threadHandle);
+    }
+
+    return NULL;
 }
 
+// Recomputes the minimum of row j of fimage2, and the x position of its first occurrence.
+static void updateRowMin( float *fimage2, int xsize, int j, float *rowMin, int *rowMinX )
+{
+    float      *fp;
+    int         i;
+
+    fp = &fimage2[j*xsize];
+    rowMin[j]  = fp[0];
+    rowMinX[j] = 0;
+    for( i = 1; i < xsize; i++ ) {
+        if( fp[i] < rowMin[j] ) {
+            rowMin[j]  = fp[i];
+            rowMinX[j] = i;
+        }
+    }
+}
+
+// Equivalent to a raster-order scan of fimage2 for the first value less than max_sim_thresh
+// and less than all before it, but visits only the cached minimum of each row.
+static int findMinFeature( float *fimage2, int xsize, int ysize, float *rowMin, int *rowMinX,
+                           float max_sim_thresh, int *cx, int *cy, float *min_sim )
+{
+    int         j;
+
+    *min_sim = max_sim_thresh;
+    *cx = *cy = -1;
+    for( j = 0; j < ysize; j++ ) {
+        if( rowMin[j] < *min_sim ) {
+            *min_sim = rowMin[j];
+            *cx = rowMinX[j];
+            *cy = j;
+        }
+    }
+
+    return (*cx == -1) ? -1 : 0;
+}
 
 AR2FeatureCoordT *ar2SelectFeature( AR2ImageT *image, AR2FeatureMapT *featureMap,
                                     int ts1, int ts2, int search_size2, int occ_size,
@@ -277,6 +404,8 @@ AR2FeatureCoordT *ar2SelectFeature( AR2ImageT *image, AR2FeatureMapT *featureMap
     int                max_feature_num;
     int                cx, cy;
     int                i, j;
+    float             *rowMin;
+    int               *rowMinX;
 
     if( image->xsize != featureMap->xsize || image->ysize != featureMap->ysize ) return NULL;
 
@@ -291,6 +420,12 @@ AR2FeatureCoordT *ar2SelectFeature( AR2ImageT *image, AR2FeatureMapT *featureMap
         *(fp2++) = *(fp1++);
     }
 
+    // Per-row minima of fimage2, kept current as entries are suppressed, so that each
+    // selection step scans ysize values rather than the whole map.
+    arMalloc(rowMin,  float, ysize);
+    arMalloc(rowMinX, int,   ysize);
+    for( j = 0; j < ysize; j++ ) updateRowMin( fimage2, xsize, j, rowMin, rowMinX );
+
     max_feature_num = (xsize/occ_size)*(ysize/occ_size);
     if( max_feature_num < 10 ) max_feature_num = 10;
     ARLOGi("Max feature = %d\n", max_feature_num);
@@ -299,20 +434,7 @@ AR2FeatureCoordT *ar2SelectFeature( AR2ImageT *image, AR2FeatureMapT *featureMap
 
     while( *num < max_feature_num ) {
 
-        min_sim = max_sim_thresh;
-        fp2 = fimage2;
-        cx = cy = -1;
-        for( j = 0; j < ysize; j++ ) {
-            for( i = 0; i < xsize; i++ ) {
-                if( *fp2 < min_sim ) {
-                    min_sim = *fp2;
-                    cx = i;
-                    cy = j;
-                }
-                fp2++;
-            }
-        }
-        if( cx == -1 ) break;
+        if( findMinFeature( fimage2, xsize, ysize, rowMin, rowMinX, max_sim_thresh, &cx, &cy, &min_sim ) < 0 ) break;
 
 #if AR2_CAPABLE_ADAPTIVE_TEMPLATE
         if( make_template( image->imgBWBlur[1], xsize, ysize, cx, cy, ts1, ts2, 0.0, template, &vlen ) < 0 ) {
@@ -320,10 +442,12 @@ AR2FeatureCoordT *ar2SelectFeature( AR2ImageT *image, AR2FeatureMapT *featureMap
         if( make_template( image->imgBW, xsize, ysize, cx, cy, ts1, ts2, 0.0, template, &vlen ) < 0 ) {
 #endif
             fimage2[cy*xsize+cx] = 1.0f;
+            updateRowMin( fimage2, xsize, cy, rowMin, rowMinX );
             continue;
         }
         if( vlen/(ts1+ts2+1) < sd_thresh ) {
             fimage2[cy*xsize+cx] = 1.0f;
+            updateRowMin( fimage2, xsize, cy, rowMin, rowMinX );
             continue;
         }
 
@@ -354,6 +478,7 @@ AR2FeatureCoordT *ar2SelectFeature( AR2ImageT *image, AR2FeatureMapT *featureMap
 
         if( (min < min_sim_thresh && min < min_sim) || max > 0.99f ) {
             fimage2[cy*xsize+cx] = 1.0f;
+            updateRowMin( fimage2, xsize, cy, rowMin, rowMinX );
             continue;
         }
 
@@ -366,16 +491,20 @@ AR2FeatureCoordT *ar2SelectFeature( AR2ImageT *image, AR2FeatureMapT *featureMap
 
         ARLOGi("%3d: (%3d,%3d) : %f min=%f max=%f, sd=%f\n", *num, cx, cy, min_sim, min, max, vlen/(ts1+ts2+1));
         for( j = -occ_size; j <= occ_size; j++ ) {
+            if( cy+j < 0 || cy+j >= ysize ) continue;
             for( i = -occ_size; i <= occ_size; i++ ) {
-                if( cy+j < 0 || cy+j >= ysize || cx+i < 0 || cx+i >= xsize ) continue;
+                if( cx+i < 0 || cx+i >= xsize ) continue;
 
                 fimage2[(cy+j)*xsize+(cx+i)] = 1.0f;
             }
+            updateRowMin( fimage2, xsize, cy+j, rowMin, rowMinX );
         }
     }
 
     free( template );
     free( fimage2 );
+    free( rowMin );
+    free( rowMinX );
 
     return coord;
 }
@@ -397,6 +526,8 @@ AR2FeatureCoordT *ar2SelectFeature2( AR2ImageT *image, AR2FeatureMapT *featureMa
     int                cx, cy;
     int                i, j;
     int                ii;
+    float             *rowMin;
+    int               *rowMinX;
 
     if( image->xsize != featureMap->xsize || image->ysize != featureMap->ysize ) return NULL;
 
@@ -413,6 +544,10 @@ AR2FeatureCoordT *ar2SelectFeature2( AR2ImageT *image, AR2FeatureMapT *featureMa
         *(fp2++) = *(fp1++);
     }
 
+    arMalloc(rowMin,  float, ysize);
+    arMalloc(rowMinX, int,   ysize);
+    for( j = 0; j < ysize; j++ ) updateRowMin( fimage2, xsize, j, rowMin, rowMinX );
+
     div_size = (ts1+ts2+1)*3;
     xdiv = xsize/div_size;
     ydiv = ysize/div_size;
@@ -424,20 +559,7 @@ AR2FeatureCoordT *ar2SelectFeature2( AR2ImageT *image, AR2FeatureMapT *featureMa
 
     while( *num < max_feature_num ) {
 
-        min_sim = max_sim_thresh;
-        fp2 = fimage2;
-        cx = cy = -1;
-        for( j = 0; j < ysize; j++ ) {
-            for( i = 0; i < xsize; i++ ) {
-                if( *fp2 < min_sim ) {
-                    min_sim = *fp2;
-                    cx = i;
-                    cy = j;
-                }
-                fp2++;
-            }
-        }
-        if( cx == -1 ) break;
+        if( findMinFeature( fimage2, xsize, ysize, rowMin, rowMinX, max_sim_thresh, &cx, &cy, &min_sim ) < 0 ) break;
 
 #if AR2_CAPABLE_ADAPTIVE_TEMPLATE
         if( make_template( image->imgBWBlur[1], xsize, ysize, cx, cy, ts1, ts2, 0.0, template, &vlen ) < 0 ) {
@@ -445,10 +567,12 @@ AR2FeatureCoordT *ar2SelectFeature2( AR2ImageT *image, AR2FeatureMapT *featureMa
         if( make_template( image->imgBW, xsize, ysize, cx, cy, ts1, ts2, 0.0, template, &vlen ) < 0 ) {
 #endif
             fimage2[cy*xsize+cx] = 1.0f;
+            updateRowMin( fimage2, xsize, cy, rowMin, rowMinX );
             continue;
         }
         if( vlen/(ts1+ts2+1) < sd_thresh ) {
             fimage2[cy*xsize+cx] = 1.0f;
+            updateRowMin( fimage2, xsize, cy, rowMin, rowMinX );
             continue;
         }
 
@@ -479,6 +603,7 @@ AR2FeatureCoordT *ar2SelectFeature2( AR2ImageT *image, AR2FeatureMapT *featureMa
 
         if( (min < min_sim_thresh && min < min_sim) || max > 0.99f ) {
             fimage2[cy*xsize+cx] = 1.0f;
+            updateRowMin( fimage2, xsize, cy, rowMin, rowMinX );
             continue;
         }
 
@@ -491,11 +616,13 @@ AR2FeatureCoordT *ar2SelectFeature2( AR2ImageT *image, AR2FeatureMapT *featureMa
 
         ARLOGi("%3d: (%3d,%3d) : %f min=%f max=%f, sd=%f\n", *num, cx, cy, min_sim, min, max, vlen/(ts1+ts2+1));
         for( j = -occ_size; j <= occ_size; j++ ) {
+            if( cy+j < 0 || cy+j >= ysize ) continue;
             for( i = -occ_size; i <= occ_size; i++ ) {
-                if( cy+j < 0 || cy+j >= ysize || cx+i < 0 || cx+i >= xsize ) continue;
+                if( cx+i < 0 || cx+i >= xsize ) continue;
 
                 fimage2[(cy+j)*xsize+(cx+i)] = 1.0f;
             }
+            updateRowMin( fimage2, xsize, cy+j, rowMin, rowMinX );
         }
     }
 
@@ -520,6 +647,8 @@ AR2FeatureCoordT *ar2SelectFeature2( AR2ImageT *image, AR2FeatureMapT *featureMa
 
     free( template );
     free( fimage2 );
+    free( rowMin );
+    free( rowMinX );
 
     return coord;
 }
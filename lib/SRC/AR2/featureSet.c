@@ -38,8 +38,46 @@
 #include <AR/ar.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#ifndef _WIN32
+#  include <fcntl.h>
+#  include <unistd.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#endif
 #include <AR2/featureSet.h>
 
+//
+// Packed feature set layout. All fields are 32 bits, in native byte order.
+//   int32   AR2_FEATURE_SET_PACKED_TAG (in place of the level count of the legacy layout)
+//   int32   AR2_FEATURE_SET_PACKED_VERSION
+//   int32   level count
+//   int32   total coordinate count
+//   level count times: int32 scale, float maxdpi, float mindpi, int32 coordinate count
+//   total coordinate count times: AR2FeatureCoordT (int32 x, int32 y, float mx, float my, float maxSim)
+// Coordinates of all levels are contiguous, in level order, so the whole file can be used in place.
+//
+#define AR2_FEATURE_SET_PACKED_TAG      -1
+#define AR2_FEATURE_SET_PACKED_VERSION   1
+
+// Feature sets whose coordinates live in a single block (read or mapped from a packed file)
+// are recorded here, so that ar2FreeFeatureSet knows to release the block rather than each level.
+typedef struct {
+    AR2FeatureSetT  *featureSet;
+    void            *block;
+    size_t           size;
+    int              mapped;
+} AR2FeatureSetBlockT;
+
+static pthread_mutex_t       blockMutex = PTHREAD_MUTEX_INITIALIZER;
+static AR2FeatureSetBlockT  *blocks = NULL;
+static int                   blockNum = 0;
+static int                   blockMax = 0;
+
+static AR2FeatureSetT *ar2ReadFeatureSetPacked( const char *path );
+static int             ar2FreeFeatureSetBlock ( AR2FeatureSetT *featureSet );
+
 AR2FeatureSetT *ar2ReadFeatureSet( char *filename, char *ext )
 {
     AR2FeatureSetT *featureSet = NULL;
@@ -60,6 +98,11 @@ AR2FeatureSetT *ar2ReadFeatureSet( char *filename, char *ext )
         ARLOGe("Read error!!\n");
         goto bail0;
     }
+    if( featureSet->num == AR2_FEATURE_SET_PACKED_TAG ) {
+        free( featureSet );
+        fclose(fp);
+        return ar2ReadFeatureSetPacked( buf );
+    }
 
     arMalloc( featureSet->list, AR2FeaturePointsT, featureSet->num );
     for( i = 0; i < featureSet->num; i++ ) {
@@ -159,12 +202,101 @@ bailBadWrite:
     return (-1);
 }
 
+int ar2SaveFeatureSetPacked( char *filename, char *ext, AR2FeatureSetT *featureSet )
+{
+    FILE    *fp;
+    int32_t  header[4];
+    int32_t  level[4];
+    int      i;
+
+    // Written to a temporary file and renamed into place, as featureSet may be mapped from the file being replaced.
+    char buf[512];
+    char tmp[516];
+    sprintf(buf, "%s.%s", filename, ext);
+    sprintf(tmp, "%s.tmp", buf);
+    if( (fp=fopen(tmp, "wb")) == NULL ) {
+        ARLOGe("File open error. %s\n", tmp);
+        return -1;
+    }
+
+    header[0] = AR2_FEATURE_SET_PACKED_TAG;
+    header[1] = AR2_FEATURE_SET_PACKED_VERSION;
+    header[2] = featureSet->num;
+    header[3] = 0;
+    for( i = 0; i < featureSet->num; i++ ) header[3] += featureSet->list[i].num;
+    if( fwrite(header, sizeof(header), 1, fp) != 1 ) goto bailBadWrite;
+
+    for( i = 0; i < featureSet->num; i++ ) {
+        level[0] = featureSet->list[i].scale;
+        memcpy( &level[1], &(featureSet->list[i].maxdpi), sizeof(float) );
+        memcpy( &level[2], &(featureSet->list[i].mindpi), sizeof(float) );
+        level[3] = featureSet->list[i].num;
+        if( fwrite(level, sizeof(level), 1, fp) != 1 ) goto bailBadWrite;
+    }
+    for( i = 0; i < featureSet->num; i++ ) {
+        if( featureSet->list[i].num == 0 ) continue;
+        if( fwrite(featureSet->list[i].coord, sizeof(AR2FeatureCoordT), featureSet->list[i].num, fp) != (size_t)featureSet->list[i].num ) goto bailBadWrite;
+    }
+
+    if( fclose(fp) != 0 ) {
+        ARLOGe("Error saving feature set: error writing data.\n");
+        remove(tmp);
+        return (-1);
+    }
+#ifdef _WIN32
+    remove(buf); // rename() does not replace an existing file on Windows.
+#endif
+    if( rename(tmp, buf) != 0 ) {
+        ARLOGe("Error saving feature set: unable to rename %s to %s.\n", tmp, buf);
+        remove(tmp);
+        return (-1);
+    }
+    return 0;
+
+bailBadWrite:
+    ARLOGe("Error saving feature set: error writing data.\n");
+    fclose(fp);
+    remove(tmp);
+    return (-1);
+}
+
+int ar2ConvertFeatureSet( char *filename, char *ext )
+{
+    AR2FeatureSetT *featureSet;
+    FILE           *fp;
+    int32_t         tag;
+    int             ret;
+
+    char buf[512];
+    sprintf(buf, "%s.%s", filename, ext);
+    if( (fp=fopen(buf, "rb")) == NULL ) {
+        ARLOGe("File open error. %s\n", filename);
+        return -1;
+    }
+    ret = (int)fread(&tag, sizeof(tag), 1, fp);
+    fclose(fp);
+    if( ret == 1 && tag == AR2_FEATURE_SET_PACKED_TAG ) return 0; // Already packed.
+
+    if( (featureSet = ar2ReadFeatureSet(filename, ext)) == NULL ) return -1;
+    ret = ar2SaveFeatureSetPacked( filename, ext, featureSet );
+    ar2FreeFeatureSet( &featureSet );
+
+    return ret;
+}
+
 int ar2FreeFeatureSet( AR2FeatureSetT **featureSet )
 {
     int     i;
 
     if( *featureSet == NULL ) return -1;
 
+    if( ar2FreeFeatureSetBlock(*featureSet) == 0 ) {
+        free( (*featureSet)->list );
+        free( *featureSet );
+        *featureSet = NULL;
+        return 0;
+    }
+
     for( i = 0; i < (*featureSet)->num; i++ ) {
         free( (*featureSet)->list[i].coord );
     }
@@ -174,3 +306,151 @@ int ar2FreeFeatureSet( AR2FeatureSetT **featureSet )
 
     return 0;
 }
+
+static AR2FeatureSetT *ar2ReadFeatureSetPacked( const char *path )
+{
+    AR2FeatureSetT      *featureSet;
+    AR2FeatureSetBlockT *newBlocks;
+    ARUint8             *block = NULL;
+    size_t               size;
+    int                  mapped = 0;
+    int32_t              header[4];
+    int32_t             *level;
+    AR2FeatureCoordT    *coord;
+    size_t               total;
+    int                  i;
+
+#ifndef _WIN32
+    int                  fd;
+    struct stat          st;
+
+    if( (fd = open(path, O_RDONLY)) < 0 ) {
+        ARLOGe("File open error. %s\n", path);
+        return NULL;
+    }
+    if( fstat(fd, &st) < 0 ) {
+        ARLOGe("Read error!!\n");
+        close(fd);
+        return NULL;
+    }
+    size = (size_t)st.st_size;
+    if( size >= sizeof(header) ) {
+        // Private mapping, so pages are shared with the page cache until (if ever) written.
+        block = (ARUint8 *)mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0 );
+        if( block == (ARUint8 *)MAP_FAILED ) block = NULL;
+        else                                 mapped = 1;
+    }
+    close(fd);
+#endif
+    if( block == NULL ) {
+        FILE *fp;
+        long  len;
+        if( (fp = fopen(path, "rb")) == NULL ) {
+            ARLOGe("File open error. %s\n", path);
+            return NULL;
+        }
+        fseek(fp, 0, SEEK_END);
+        len = ftell(fp);
+        rewind(fp);
+        if( len < (long)sizeof(header) ) {
+            ARLOGe("Read error!!\n");
+            fclose(fp);
+            return NULL;
+        }
+        size = (size_t)len;
+        arMalloc( block, ARUint8, size );
+        if( fread(block, 1, size, fp) != size ) {
+            ARLOGe("Read error!!\n");
+            free(block);
+            fclose(fp);
+            return NULL;
+        }
+        fclose(fp);
+    }
+
+    memcpy( header, block, sizeof(header) );
+    if( header[1] != AR2_FEATURE_SET_PACKED_VERSION ) {
+        ARLOGe("Unsupported packed feature set version %d.\n", header[1]);
+        goto bail;
+    }
+    if( header[2] < 0 || header[3] < 0
+     || size != sizeof(header) + (size_t)header[2]*4*sizeof(int32_t) + (size_t)header[3]*sizeof(AR2FeatureCoordT) ) {
+        ARLOGe("Read error!!\n");
+        goto bail;
+    }
+
+    arMalloc( featureSet, AR2FeatureSetT, 1 );
+    featureSet->num = header[2];
+    arMalloc( featureSet->list, AR2FeaturePointsT, (featureSet->num > 0 ? featureSet->num : 1) );
+    level = (int32_t *)(block + sizeof(header));
+    coord = (AR2FeatureCoordT *)(level + 4*featureSet->num);
+    total = 0;
+    for( i = 0; i < featureSet->num; i++ ) {
+        featureSet->list[i].scale  = level[4*i + 0];
+        memcpy( &(featureSet->list[i].maxdpi), &level[4*i + 1], sizeof(float) );
+        memcpy( &(featureSet->list[i].mindpi), &level[4*i + 2], sizeof(float) );
+        featureSet->list[i].num    = level[4*i + 3];
+        featureSet->list[i].coord  = coord + total;
+        total += (size_t)featureSet->list[i].num;
+    }
+    if( total != (size_t)header[3] ) {
+        ARLOGe("Read error!!\n");
+        free( featureSet->list );
+        free( featureSet );
+        goto bail;
+    }
+
+    pthread_mutex_lock(&blockMutex);
+    if( blockNum == blockMax ) {
+        newBlocks = (AR2FeatureSetBlockT *)realloc( blocks, sizeof(AR2FeatureSetBlockT)*(blockMax + 16) );
+        if( newBlocks == NULL ) {
+            ARLOGe("Out of memory!!\n");
+            exit(1);
+        }
+        blocks = newBlocks;
+        blockMax += 16;
+    }
+    blocks[blockNum].featureSet = featureSet;
+    blocks[blockNum].block      = block;
+    blocks[blockNum].size       = size;
+    blocks[blockNum].mapped     = mapped;
+    blockNum++;
+    pthread_mutex_unlock(&blockMutex);
+
+    return featureSet;
+
+bail:
+#ifndef _WIN32
+    if( mapped ) munmap( block, size );
+    else
+#endif
+    free( block );
+    return NULL;
+}
+
+// Returns 0 if featureSet was loaded from a packed file and its block has been released, -1 otherwise.
+static int ar2FreeFeatureSetBlock( AR2FeatureSetT *featureSet )
+{
+    AR2FeatureSetBlockT  entry;
+    int                  i;
+
+    pthread_mutex_lock(&blockMutex);
+    for( i = 0; i < blockNum; i++ ) {
+        if( blocks[i].featureSet == featureSet ) break;
+    }
+    if( i == blockNum ) {
+        pthread_mutex_unlock(&blockMutex);
+        return -1;
+    }
+    entry = blocks[i];
+    blocks[i] = blocks[--blockNum];
+    pthread_mutex_unlock(&blockMutex);
+
+#ifndef _WIN32
+    if( entry.mapped ) munmap( entry.block, entry.size );
+    else
+#endif
+    free( entry.block );
+
+    return 0;
+}
@@ -76,6 +76,7 @@ AR2HandleT *ar2CreateHandleHomography( int xsize, int ysize, AR_PIXEL_FORMAT pix
 static AR2HandleT *ar2CreateHandleSub( int pixFormat, int xsize, int ysize, int threadNum )
 {
     AR2HandleT   *ar2Handle;
+    int           subImageSize;
     int           i;
 
     arMalloc(ar2Handle, AR2HandleT, 1);
@@ -109,8 +110,14 @@ static AR2HandleT *ar2CreateHandleSub( int pixFormat, int xsize, int ysize, int
     }
     ar2Handle->threadNum = threadNum;
     ARLOGi("Tracking thread = %d\n", threadNum);
+    // Matching work buffers are sized for the default template size, and grown only if a larger template is later requested.
+    subImageSize = ar2GetBestMatchingSubImageSize( ar2Handle->templateSize1 + ar2Handle->templateSize2 + 1,
+                                                   ar2Handle->templateSize1 + ar2Handle->templateSize2 + 1 );
     for( i = 0; i < ar2Handle->threadNum; i++ ) {
         arMalloc( ar2Handle->arg[i].mfImage, ARUint8, xsize*ysize );
+        arMalloc( ar2Handle->arg[i].subImage1, ARUint32, subImageSize );
+        arMalloc( ar2Handle->arg[i].subImage2, ARUint32, subImageSize );
+        ar2Handle->arg[i].subImageSize = subImageSize;
         ar2Handle->arg[i].templ = NULL;
 #if AR2_CAPABLE_ADAPTIVE_TEMPLATE
         ar2Handle->arg[i].templ2 = NULL;
@@ -131,6 +138,8 @@ int ar2DeleteHandle( AR2HandleT **ar2Handle )
         threadWaitQuit( (*ar2Handle)->threadHandle[i] );
         threadFree( &((*ar2Handle)->threadHandle[i]) );
         if( (*ar2Handle)->arg[i].mfImage   != NULL )  free( (*ar2Handle)->arg[i].mfImage );
+        if( (*ar2Handle)->arg[i].subImage1 != NULL )  free( (*ar2Handle)->arg[i].subImage1 );
+        if( (*ar2Handle)->arg[i].subImage2 != NULL )  free( (*ar2Handle)->arg[i].subImage2 );
         if( (*ar2Handle)->arg[i].templ  != NULL ) ar2FreeTemplate( (*ar2Handle)->arg[i].templ );
 #if AR2_CAPABLE_ADAPTIVE_TEMPLATE
         if( (*ar2Handle)->arg[i].templ2 != NULL ) ar2FreeTemplate ( (*ar2Handle)->arg[i].templ2 );
@@ -43,15 +43,43 @@
 #ifdef _WIN32
 #  define lroundf(x) ((x)>=0.0f?(long)((x)+0.5f):(long)((x)-0.5f))
 #endif
+#include <pthread.h>
+#include <thread_sub.h>
 #include <AR2/imageFormat.h>
 #include <AR2/imageSet.h>
 
 static AR2ImageT *ar2GenImageLayer1 ( ARUint8 *image, int xsize, int ysize, int nc, float srcdpi, float dstdpi );
 static AR2ImageT *ar2GenImageLayer2 ( AR2ImageT *src, float dstdpi );
+static void       ar2GenImageLayer2Sub( AR2ImageT *src, AR2ImageT *dst );
 #if AR2_CAPABLE_ADAPTIVE_TEMPLATE
 static void       defocus_image     ( ARUint8 *img, int xsize, int ysize, int n );
 #endif
 static AR2ImageSetT *ar2ReadImageSetOld( FILE *fp );
+static AR2ImageSetT *ar2ReadImageSetFull( FILE *fp, int lazy );
+static int           ar2WriteImagePlane ( FILE *fp, ARUint8 *image, int xsize, int ysize, int compress );
+static ARUint8      *ar2ReadImagePlane  ( FILE *fp, int xsize, int ysize, int compress );
+static int           ar2SkipImagePlane  ( FILE *fp );
+#if !AR2_CAPABLE_ADAPTIVE_TEMPLATE
+static int           ar2ImageSetLazyInit( AR2ImageSetT *imageSet );
+static void          ar2ImageSetLazyFinal( AR2ImageSetT *imageSet );
+static void          ar2ImageSetLazyEvict( void );
+static void          ar2GenImageLayersParallel( AR2ImageT *src, AR2ImageT **dst, int num );
+#endif
+
+// Lazy loading state, shared by all image sets in the process and protected by lazyMutex.
+static pthread_mutex_t  lazyMutex = PTHREAD_MUTEX_INITIALIZER;
+static int              lazyLoad = 0;
+static size_t           lazyMemoryBudget = 0;
+static size_t           lazyMemoryUsed = 0;
+static ARUint32         lazyUseCounter = 0;
+static AR2ImageSetT   **lazySets = NULL;
+static int              lazySetNum = 0;
+static int              lazySetMax = 0;
+
+// A full (all scales stored) image set begins with this value in place of the scale count,
+// so that readers which predate the format reject it rather than misinterpreting it.
+#define AR2_IMAGESET_FULL_TAG       -1
+#define AR2_IMAGESET_FULL_VERSION    1
 
 AR2ImageSetT *ar2GenImageSet( ARUint8 *image, int xsize, int ysize, int nc, float dpi, float dpi_list[], int dpi_num )
 {
@@ -67,6 +95,7 @@ AR2ImageSetT *ar2GenImageSet( ARUint8 *image, int xsize, int ysize, int nc, floa
 
     arMalloc( imageSet, AR2ImageSetT, 1 );
     imageSet->num = dpi_num;
+    imageSet->lazy = NULL;
     arMalloc( imageSet->scale,  AR2ImageT*,  imageSet->num );
 
     imageSet->scale[0] = ar2GenImageLayer1( image, xsize, ysize, nc, dpi, dpi_list[0] );
@@ -91,6 +120,9 @@ AR2ImageSetT *ar2ReadImageSet( char *filename )
     size_t         len;
     const char     ext[] = ".iset";
     char          *buf;
+    int            lazy;
+
+    ar2ImageSetGetLazyLoad(&lazy);
     
     len = strlen(filename) + strlen(ext) + 1; // +1 for nul terminator.
     arMalloc(buf, char, len);
@@ -103,11 +135,21 @@ AR2ImageSetT *ar2ReadImageSet( char *filename )
     }
 
     arMalloc( imageSet, AR2ImageSetT, 1 );
+    imageSet->lazy = NULL;
 
-    if( fread(&(imageSet->num), sizeof(imageSet->num), 1, fp) != 1 || imageSet->num <= 0) {
+    if( fread(&(imageSet->num), sizeof(imageSet->num), 1, fp) != 1 ) {
         ARLOGe("Error reading imageSet.\n");
         goto bail;
     }
+    if( imageSet->num == AR2_IMAGESET_FULL_TAG ) {
+        free(imageSet);
+        return ar2ReadImageSetFull(fp, lazy);
+    }
+    if( imageSet->num <= 0 ) {
+        ARLOGe("Error reading imageSet.\n");
+        goto bail;
+    }
+    if( imageSet->num > AR2_IMAGESET_LAZY_SCALE_MAX ) lazy = 0;
     ARLOGi("Imageset contains %d images.\n", imageSet->num);
     arMalloc( imageSet->scale, AR2ImageT*, imageSet->num );
 
@@ -162,6 +204,17 @@ AR2ImageSetT *ar2ReadImageSet( char *filename )
             goto bail1;
         }
         
+#if !AR2_CAPABLE_ADAPTIVE_TEMPLATE
+        if( lazy ) {
+            // Record the size of the scale only; its image is generated when first required.
+            arMalloc( imageSet->scale[i], AR2ImageT, 1 );
+            imageSet->scale[i]->xsize = (int)lroundf(imageSet->scale[0]->xsize * dpi / imageSet->scale[0]->dpi);
+            imageSet->scale[i]->ysize = (int)lroundf(imageSet->scale[0]->ysize * dpi / imageSet->scale[0]->dpi);
+            imageSet->scale[i]->dpi   = dpi;
+            imageSet->scale[i]->imgBW = NULL;
+            continue;
+        }
+#endif
         imageSet->scale[i] = ar2GenImageLayer2( imageSet->scale[0], dpi );
         if( imageSet->scale[i] == NULL ) {
             for( k1 = 0; k1 < i; k1++ ) {
@@ -178,6 +231,9 @@ AR2ImageSetT *ar2ReadImageSet( char *filename )
 
     fclose(fp);
 
+#if !AR2_CAPABLE_ADAPTIVE_TEMPLATE
+    if( lazy ) ar2ImageSetLazyInit(imageSet);
+#endif
     return imageSet;
     
     
@@ -235,6 +291,84 @@ bailBadWrite:
     return (-1);
 }
 
+int ar2WriteImageSetFull( char *filename, AR2ImageSetT *imageSet, int compress )
+{
+    FILE          *fp;
+    int32_t        header[4];
+    int            i;
+#if AR2_CAPABLE_ADAPTIVE_TEMPLATE
+    int            j;
+#endif
+    size_t         len;
+    const char     ext[] = ".iset";
+    char          *buf;
+    ARUint32       scaleMask;
+
+    if( compress != AR2_IMAGESET_COMPRESS_NONE && compress != AR2_IMAGESET_COMPRESS_DELTA_RLE ) {
+        ARLOGe("Error saving image set: unknown compression %d.\n", compress);
+        return (-1);
+    }
+
+    len = strlen(filename) + strlen(ext) + 1; // +1 for nul terminator.
+    arMalloc(buf, char, len);
+    sprintf(buf, "%s%s", filename, ext);
+    if( (fp=fopen(buf, "wb")) == NULL ) {
+        ARLOGe("Error: unable to open file '%s' for writing.\n", buf);
+        free(buf);
+        return (-1);
+    }
+    free(buf);
+
+    header[0] = AR2_IMAGESET_FULL_TAG;
+    header[1] = AR2_IMAGESET_FULL_VERSION;
+    header[2] = imageSet->num;
+    header[3] = compress;
+    if( fwrite(header, sizeof(header), 1, fp) != 1 ) goto bailBadWrite;
+
+    // A lazily loaded set may not have all scales resident, so pin them all for the duration of the write.
+    scaleMask = (imageSet->num >= AR2_IMAGESET_LAZY_SCALE_MAX ? 0xFFFFFFFFu : (1u << imageSet->num) - 1u);
+    ar2ImageSetRequireScales(imageSet, scaleMask);
+
+    for( i = 0; i < imageSet->num; i++ ) {
+        if( fwrite(&(imageSet->scale[i]->xsize), sizeof(imageSet->scale[i]->xsize), 1, fp) != 1 ) goto bailBadWrite;
+        if( fwrite(&(imageSet->scale[i]->ysize), sizeof(imageSet->scale[i]->ysize), 1, fp) != 1 ) goto bailBadWrite;
+        if( fwrite(&(imageSet->scale[i]->dpi),   sizeof(imageSet->scale[i]->dpi),   1, fp) != 1 ) goto bailBadWrite;
+#if AR2_CAPABLE_ADAPTIVE_TEMPLATE
+        for( j = 0; j < AR2_BLUR_IMAGE_MAX; j++ ) {
+            if( ar2WriteImagePlane(fp, imageSet->scale[i]->imgBWBlur[j], imageSet->scale[i]->xsize, imageSet->scale[i]->ysize, compress) < 0 ) goto bailBadWriteScales;
+        }
+#else
+        if( ar2WriteImagePlane(fp, imageSet->scale[i]->imgBW, imageSet->scale[i]->xsize, imageSet->scale[i]->ysize, compress) < 0 ) goto bailBadWriteScales;
+#endif
+    }
+
+    ar2ImageSetReleaseScales(imageSet, scaleMask);
+    fclose(fp);
+    return 0;
+
+bailBadWriteScales:
+    ar2ImageSetReleaseScales(imageSet, scaleMask);
+bailBadWrite:
+    ARLOGe("Error saving image set: error writing data.\n");
+    fclose(fp);
+    return (-1);
+}
+
+int ar2UpgradeImageSet( char *filename, int compress )
+{
+    AR2ImageSetT  *imageSet;
+    int            ret;
+
+    if( (imageSet = ar2ReadImageSet(filename)) == NULL ) {
+        ARLOGe("Error: unable to read image set '%s.iset' for upgrade.\n", filename);
+        return (-1);
+    }
+    ret = ar2WriteImageSetFull(filename, imageSet, compress);
+    ar2FreeImageSet(&imageSet);
+
+    return ret;
+}
+
 int ar2FreeImageSet( AR2ImageSetT **imageSet )
 {
     int    i;
@@ -242,6 +376,10 @@ int ar2FreeImageSet( AR2ImageSetT **imageSet )
     if(  imageSet == NULL ) return -1;
     if( *imageSet == NULL ) return -1;
 
+#if !AR2_CAPABLE_ADAPTIVE_TEMPLATE
+    if( (*imageSet)->lazy ) ar2ImageSetLazyFinal(*imageSet);
+#endif
+
     for( i = 0; i < (*imageSet)->num; i++ ) {
 #if AR2_CAPABLE_ADAPTIVE_TEMPLATE
         for( int j = 0; j < AR2_BLUR_IMAGE_MAX; j++ ) {
@@ -259,6 +397,104 @@ int ar2FreeImageSet( AR2ImageSetT **imageSet )
     return 0;
 }
 
+int ar2ImageSetSetLazyLoad( int lazy )
+{
+#if AR2_CAPABLE_ADAPTIVE_TEMPLATE
+    if( lazy ) return -1;
+#endif
+    pthread_mutex_lock(&lazyMutex);
+    lazyLoad = lazy;
+    pthread_mutex_unlock(&lazyMutex);
+    return 0;
+}
+
+int ar2ImageSetGetLazyLoad( int *lazy )
+{
+    if( lazy == NULL ) return -1;
+    pthread_mutex_lock(&lazyMutex);
+    *lazy = lazyLoad;
+    pthread_mutex_unlock(&lazyMutex);
+    return 0;
+}
+
+int ar2ImageSetSetMemoryBudget( size_t bytes )
+{
+    pthread_mutex_lock(&lazyMutex);
+    lazyMemoryBudget = bytes;
+#if !AR2_CAPABLE_ADAPTIVE_TEMPLATE
+    ar2ImageSetLazyEvict();
+#endif
+    pthread_mutex_unlock(&lazyMutex);
+    return 0;
+}
+
+int ar2ImageSetGetMemoryBudget( size_t *bytes )
+{
+    if( bytes == NULL ) return -1;
+    pthread_mutex_lock(&lazyMutex);
+    *bytes = lazyMemoryBudget;
+    pthread_mutex_unlock(&lazyMutex);
+    return 0;
+}
+
+int ar2ImageSetRequireScales( AR2ImageSetT *imageSet, ARUint32 scaleMask )
+{
+#if !AR2_CAPABLE_ADAPTIVE_TEMPLATE
+    AR2ImageT     *missing[AR2_IMAGESET_LAZY_SCALE_MAX];
+    int            missingNum;
+    int            i;
+#endif
+
+    if( imageSet == NULL ) return -1;
+    if( imageSet->lazy == NULL ) return 0;
+
+#if !AR2_CAPABLE_ADAPTIVE_TEMPLATE
+    // Generation happens with the lock held so that a scale is never generated twice, nor
+    // evicted while being generated. This is rare enough that the serialisation does not matter.
+    pthread_mutex_lock(&lazyMutex);
+    lazyUseCounter++;
+    missingNum = 0;
+    for( i = 1; i < imageSet->num; i++ ) {
+        if( !(scaleMask & (1u << i)) ) continue;
+        imageSet->lazy->pinCount[i]++;
+        imageSet->lazy->lastUsed[i] = lazyUseCounter;
+        if( imageSet->scale[i]->imgBW == NULL ) {
+            missing[missingNum++] = imageSet->scale[i];
+            lazyMemoryUsed += (size_t)imageSet->scale[i]->xsize * imageSet->scale[i]->ysize;
+        }
+    }
+    if( missingNum > 0 ) {
+        ar2GenImageLayersParallel( imageSet->scale[0], missing, missingNum );
+        ar2ImageSetLazyEvict();
+    }
+    pthread_mutex_unlock(&lazyMutex);
+#endif
+
+    return 0;
+}
+
+int ar2ImageSetReleaseScales( AR2ImageSetT *imageSet, ARUint32 scaleMask )
+{
+#if !AR2_CAPABLE_ADAPTIVE_TEMPLATE
+    int            i;
+#endif
+
+    if( imageSet == NULL ) return -1;
+    if( imageSet->lazy == NULL ) return 0;
+
+#if !AR2_CAPABLE_ADAPTIVE_TEMPLATE
+    pthread_mutex_lock(&lazyMutex);
+    for( i = 1; i < imageSet->num; i++ ) {
+        if( !(scaleMask & (1u << i)) ) continue;
+        if( imageSet->lazy->pinCount[i] > 0 ) imageSet->lazy->pinCount[i]--;
+    }
+    ar2ImageSetLazyEvict();
+    pthread_mutex_unlock(&lazyMutex);
+#endif
+
+    return 0;
+}
+
 static AR2ImageT *ar2GenImageLayer1( ARUint8 *image, int xsize, int ysize, int nc, float srcdpi, float dstdpi )
 {
     AR2ImageT   *dst;
@@ -337,19 +573,29 @@ static AR2ImageT *ar2GenImageLayer1( ARUint8 *image, int xsize, int ysize, int n
 static AR2ImageT *ar2GenImageLayer2( AR2ImageT *src, float dpi )
 {
     AR2ImageT   *dst;
+
+    arMalloc( dst, AR2ImageT, 1 );
+    dst->xsize = (int)lroundf(src->xsize * dpi / src->dpi);
+    dst->ysize = (int)lroundf(src->ysize * dpi / src->dpi);
+    dst->dpi   = dpi;
+    ar2GenImageLayer2Sub( src, dst );
+
+    return dst;
+}
+
+// Allocates and fills the image data of dst, whose size and dpi must already be set, by minifying src.
+static void ar2GenImageLayer2Sub( AR2ImageT *src, AR2ImageT *dst )
+{
     ARUint8     *p1, *p2;
+    float        dpi;
     int          wx, wy;
     int          sx, sy, ex, ey;
     int          ii, jj, iii, jjj;
     int          co, value;
 
-    wx = (int)lroundf(src->xsize * dpi / src->dpi);
-    wy = (int)lroundf(src->ysize * dpi / src->dpi);
-
-    arMalloc( dst, AR2ImageT, 1 );
-    dst->xsize = wx;
-    dst->ysize = wy;
-    dst->dpi   = dpi;
+    wx  = dst->xsize;
+    wy  = dst->ysize;
+    dpi = dst->dpi;
 #if AR2_CAPABLE_ADAPTIVE_TEMPLATE
     for( int i = 0; i < AR2_BLUR_IMAGE_MAX; i++ ) {
         arMalloc( dst->imgBWBlur[i], ARUint8, wx*wy );
@@ -397,7 +643,7 @@ static AR2ImageT *ar2GenImageLayer2( AR2ImageT *src, float dpi )
     //defocus_image( dst->imgBW, wx, wy, 3 );
 #endif
 
-    return dst;
+    return;
 }
 
 #if AR2_CAPABLE_ADAPTIVE_TEMPLATE
@@ -457,6 +703,7 @@ static AR2ImageSetT *ar2ReadImageSetOld( FILE *fp )
 #endif
 
     arMalloc( imageSet, AR2ImageSetT, 1 );
+    imageSet->lazy = NULL;
     
     if( fread(&(imageSet->num), sizeof(imageSet->num), 1, fp) != 1 || imageSet->num <= 0) {
         ARLOGe("Error reading imageSet.\n");
@@ -545,3 +792,369 @@ bail:
     return NULL;
 }
 
+static AR2ImageSetT *ar2ReadImageSetFull( FILE *fp, int lazy )
+{
+    AR2ImageSetT  *imageSet;
+    int32_t        header[3];
+    int            compress;
+    int            i, k;
+#if AR2_CAPABLE_ADAPTIVE_TEMPLATE
+    int            j, l;
+#endif
+
+    // header[0] is the version, header[1] the scale count, header[2] the compression method.
+    if( fread(header, sizeof(header), 1, fp) != 1 ) {
+        ARLOGe("Error reading imageSet.\n");
+        fclose(fp);
+        return NULL;
+    }
+    if( header[0] != AR2_IMAGESET_FULL_VERSION ) {
+        ARLOGe("Error reading imageSet: unsupported version %d.\n", header[0]);
+        fclose(fp);
+        return NULL;
+    }
+    if( header[1] <= 0 || (header[2] != AR2_IMAGESET_COMPRESS_NONE && header[2] != AR2_IMAGESET_COMPRESS_DELTA_RLE) ) {
+        ARLOGe("Error reading imageSet.\n");
+        fclose(fp);
+        return NULL;
+    }
+    compress = header[2];
+    if( header[1] > AR2_IMAGESET_LAZY_SCALE_MAX ) lazy = 0;
+
+    arMalloc( imageSet, AR2ImageSetT, 1 );
+    imageSet->num = header[1];
+    imageSet->lazy = NULL;
+    ARLOGi("Imageset contains %d images.\n", imageSet->num);
+    arMalloc( imageSet->scale, AR2ImageT*, imageSet->num );
+
+    for( i = 0; i < imageSet->num; i++ ) {
+        arMalloc( imageSet->scale[i], AR2ImageT, 1 );
+        if( fread(&(imageSet->scale[i]->xsize), sizeof(imageSet->scale[i]->xsize), 1, fp) != 1
+         || fread(&(imageSet->scale[i]->ysize), sizeof(imageSet->scale[i]->ysize), 1, fp) != 1
+         || fread(&(imageSet->scale[i]->dpi),   sizeof(imageSet->scale[i]->dpi),   1, fp) != 1
+         || imageSet->scale[i]->xsize <= 0 || imageSet->scale[i]->ysize <= 0 ) {
+            free(imageSet->scale[i]);
+            goto bail;
+        }
+#if AR2_CAPABLE_ADAPTIVE_TEMPLATE
+        for( j = 0; j < AR2_BLUR_IMAGE_MAX; j++ ) {
+            imageSet->scale[i]->imgBWBlur[j] = ar2ReadImagePlane(fp, imageSet->scale[i]->xsize, imageSet->scale[i]->ysize, compress);
+            if( imageSet->scale[i]->imgBWBlur[j] == NULL ) {
+                for( l = 0; l < j; l++ ) free(imageSet->scale[i]->imgBWBlur[l]);
+                free(imageSet->scale[i]);
+                goto bail;
+            }
+        }
+#else
+        if( lazy && i > 0 ) {
+            imageSet->scale[i]->imgBW = NULL;
+            if( ar2SkipImagePlane(fp) < 0 ) {
+                free(imageSet->scale[i]);
+                goto bail;
+            }
+            continue;
+        }
+        imageSet->scale[i]->imgBW = ar2ReadImagePlane(fp, imageSet->scale[i]->xsize, imageSet->scale[i]->ysize, compress);
+        if( imageSet->scale[i]->imgBW == NULL ) {
+            free(imageSet->scale[i]);
+            goto bail;
+        }
+#endif
+    }
+
+    fclose(fp);
+#if !AR2_CAPABLE_ADAPTIVE_TEMPLATE
+    if( lazy ) ar2ImageSetLazyInit(imageSet);
+#endif
+    return imageSet;
+
+bail:
+    ARLOGe("Error reading imageSet.\n");
+    for( k = 0; k < i; k++ ) {
+#if AR2_CAPABLE_ADAPTIVE_TEMPLATE
+        for( l = 0; l < AR2_BLUR_IMAGE_MAX; l++ ) free(imageSet->scale[k]->imgBWBlur[l]);
+#else
+        free(imageSet->scale[k]->imgBW);
+#endif
+        free(imageSet->scale[k]);
+    }
+    free(imageSet->scale);
+    free(imageSet);
+    fclose(fp);
+    return NULL;
+}
+
+//
+// Each plane is stored as a byte count followed by that many bytes of data.
+// With AR2_IMAGESET_COMPRESS_DELTA_RLE, each row is replaced by the differences
+// between horizontally adjacent pixels (modulo 256) and the result PackBits-encoded;
+// control byte n in [0, 127] precedes n + 1 literal bytes, n in [-127, -1] precedes
+// a single byte to be repeated 1 - n times.
+//
+static int ar2WriteImagePlane( FILE *fp, ARUint8 *image, int xsize, int ysize, int compress )
+{
+    ARUint8    *delta, *out, *p;
+    int32_t     outLen;
+    int         size;
+    int         i, j, run;
+
+    size = xsize*ysize;
+    if( compress == AR2_IMAGESET_COMPRESS_NONE ) {
+        outLen = size;
+        if( fwrite(&outLen, sizeof(outLen), 1, fp) != 1 ) return -1;
+        if( fwrite(image, sizeof(ARUint8), size, fp) != (size_t)size ) return -1;
+        return 0;
+    }
+
+    arMalloc( delta, ARUint8, size );
+    for( j = 0; j < ysize; j++ ) {
+        p = &image[j*xsize];
+        delta[j*xsize] = p[0];
+        for( i = 1; i < xsize; i++ ) delta[j*xsize + i] = (ARUint8)(p[i] - p[i - 1]);
+    }
+
+    arMalloc( out, ARUint8, size + (size + 127)/128 );
+    outLen = 0;
+    i = 0;
+    while( i < size ) {
+        for( run = 1; i + run < size && run < 128 && delta[i + run] == delta[i]; run++ );
+        if( run >= 2 ) {
+            out[outLen++] = (ARUint8)(signed char)(1 - run);
+            out[outLen++] = delta[i];
+            i += run;
+        }
+        else {
+            // Extend the literal run until a repeat of at least 3 bytes begins.
+            for( run = 1; i + run < size && run < 128; run++ ) {
+                if( i + run + 2 < size && delta[i + run] == delta[i + run + 1] && delta[i + run] == delta[i + run + 2] ) break;
+            }
+            out[outLen++] = (ARUint8)(run - 1);
+            memcpy( &out[outLen], &delta[i], run );
+            outLen += run;
+            i += run;
+        }
+    }
+    free(delta);
+
+    if( fwrite(&outLen, sizeof(outLen), 1, fp) != 1 || fwrite(out, sizeof(ARUint8), outLen, fp) != (size_t)outLen ) {
+        free(out);
+        return -1;
+    }
+    free(out);
+
+    return 0;
+}
+
+static ARUint8 *ar2ReadImagePlane( FILE *fp, int xsize, int ysize, int compress )
+{
+    ARUint8    *image, *in, *p;
+    int32_t     inLen;
+    int         size;
+    int         i, j, n;
+
+    size = xsize*ysize;
+    if( fread(&inLen, sizeof(inLen), 1, fp) != 1 || inLen < 0 ) return NULL;
+
+    arMalloc( image, ARUint8, size );
+    if( compress == AR2_IMAGESET_COMPRESS_NONE ) {
+        if( inLen != size || fread(image, sizeof(ARUint8), size, fp) != (size_t)size ) {
+            free(image);
+            return NULL;
+        }
+        return image;
+    }
+
+    arMalloc( in, ARUint8, (inLen > 0 ? inLen : 1) );
+    if( fread(in, sizeof(ARUint8), inLen, fp) != (size_t)inLen ) goto bail;
+    i = j = 0;
+    while( i < inLen && j < size ) {
+        n = (signed char)in[i++];
+        if( n >= 0 ) {
+            n += 1;
+            if( i + n > inLen || j + n > size ) goto bail;
+            memcpy( &image[j], &in[i], n );
+            i += n;
+            j += n;
+        }
+        else if( n != -128 ) {
+            n = 1 - n;
+            if( i >= inLen || j + n > size ) goto bail;
+            memset( &image[j], in[i++], n );
+            j += n;
+        }
+    }
+    if( j != size ) goto bail;
+    free(in);
+
+    // Undo the horizontal differencing.
+    for( j = 0; j < ysize; j++ ) {
+        p = &image[j*xsize];
+        for( i = 1; i < xsize; i++ ) p[i] = (ARUint8)(p[i] + p[i - 1]);
+    }
+
+    return image;
+
+bail:
+    free(in);
+    free(image);
+    return NULL;
+}
+
+static int ar2SkipImagePlane( FILE *fp )
+{
+    int32_t     inLen;
+
+    if( fread(&inLen, sizeof(inLen), 1, fp) != 1 || inLen < 0 ) return -1;
+    if( fseek(fp, (long)inLen, SEEK_CUR) != 0 ) return -1;
+
+    return 0;
+}
+
+#if !AR2_CAPABLE_ADAPTIVE_TEMPLATE
+static int ar2ImageSetLazyInit( AR2ImageSetT *imageSet )
+{
+    AR2ImageSetT  **sets;
+    int             i;
+
+    arMalloc( imageSet->lazy, AR2ImageSetLazyT, 1 );
+    arMalloc( imageSet->lazy->pinCount, int, imageSet->num );
+    arMalloc( imageSet->lazy->lastUsed, ARUint32, imageSet->num );
+    for( i = 0; i < imageSet->num; i++ ) {
+        imageSet->lazy->pinCount[i] = 0;
+        imageSet->lazy->lastUsed[i] = 0;
+    }
+
+    pthread_mutex_lock(&lazyMutex);
+    if( lazySetNum == lazySetMax ) {
+        sets = (AR2ImageSetT **)realloc( lazySets, sizeof(AR2ImageSetT *)*(lazySetMax + 16) );
+        if( sets == NULL ) {
+            ARLOGe("Out of memory!!\n");
+            exit(1);
+        }
+        lazySets = sets;
+        lazySetMax += 16;
+    }
+    lazySets[lazySetNum++] = imageSet;
+    for( i = 1; i < imageSet->num; i++ ) {
+        if( imageSet->scale[i]->imgBW ) lazyMemoryUsed += (size_t)imageSet->scale[i]->xsize * imageSet->scale[i]->ysize;
+    }
+    ar2ImageSetLazyEvict();
+    pthread_mutex_unlock(&lazyMutex);
+
+    return 0;
+}
+
+static void ar2ImageSetLazyFinal( AR2ImageSetT *imageSet )
+{
+    int             i;
+
+    pthread_mutex_lock(&lazyMutex);
+    for( i = 0; i < lazySetNum; i++ ) {
+        if( lazySets[i] == imageSet ) {
+            lazySets[i] = lazySets[--lazySetNum];
+            break;
+        }
+    }
+    for( i = 1; i < imageSet->num; i++ ) {
+        if( imageSet->scale[i]->imgBW ) lazyMemoryUsed -= (size_t)imageSet->scale[i]->xsize * imageSet->scale[i]->ysize;
+    }
+    pthread_mutex_unlock(&lazyMutex);
+
+    free( imageSet->lazy->pinCount );
+    free( imageSet->lazy->lastUsed );
+    free( imageSet->lazy );
+    imageSet->lazy = NULL;
+}
+
+// Frees least-recently required, unpinned scales until within budget. Caller must hold lazyMutex.
+static void ar2ImageSetLazyEvict( void )
+{
+    AR2ImageSetT   *set;
+    int             bestSet, bestScale;
+    ARUint32        bestAge, age;
+    int             i, j;
+
+    if( lazyMemoryBudget == 0 ) return;
+
+    while( lazyMemoryUsed > lazyMemoryBudget ) {
+        bestSet = -1;
+        bestScale = -1;
+        bestAge = 0;
+        for( i = 0; i < lazySetNum; i++ ) {
+            set = lazySets[i];
+            for( j = 1; j < set->num; j++ ) {
+                if( set->scale[j]->imgBW == NULL || set->lazy->pinCount[j] > 0 ) continue;
+                age = lazyUseCounter - set->lazy->lastUsed[j];
+                if( bestSet < 0 || age > bestAge ) {
+                    bestSet = i;
+                    bestScale = j;
+                    bestAge = age;
+                }
+            }
+        }
+        if( bestSet < 0 ) break; // Everything resident is pinned.
+
+        set = lazySets[bestSet];
+        free( set->scale[bestScale]->imgBW );
+        set->scale[bestScale]->imgBW = NULL;
+        lazyMemoryUsed -= (size_t)set->scale[bestScale]->xsize * set->scale[bestScale]->ysize;
+    }
+}
+
+typedef struct {
+    AR2ImageT      *src;
+    AR2ImageT     **dst;
+    int             num;
+    int             first;
+    int             step;
+} AR2GenImageLayerArgT;
+
+static void *ar2GenImageLayerWorker( THREAD_HANDLE_T *threadHandle )
+{
+    AR2GenImageLayerArgT  *arg;
+    int                    i;
+
+    arg = (AR2GenImageLayerArgT *)threadGetArg(threadHandle);
+    while( threadStartWait(threadHandle) == 0 ) {
+        for( i = arg->first; i < arg->num; i += arg->step ) ar2GenImageLayer2Sub( arg->src, arg->dst[i] );
+        threadEndSignal(threadHandle);
+    }
+
+    return NULL;
+}
+
+// Generates the image data for each of dst[0..num-1] from src, spreading the scales across threads.
+static void ar2GenImageLayersParallel( AR2ImageT *src, AR2ImageT **dst, int num )
+{
+    AR2GenImageLayerArgT   arg[AR2_THREAD_MAX];
+    THREAD_HANDLE_T       *threadHandle[AR2_THREAD_MAX];
+    int                    threadNum;
+    int                    i, j;
+
+    threadNum = threadGetCPU();
+    if( threadNum > num ) threadNum = num;
+    if( threadNum > AR2_THREAD_MAX ) threadNum = AR2_THREAD_MAX;
+    if( threadNum < 1 ) threadNum = 1;
+
+    // Share 0 is generated on the calling thread, as is the share of any worker which fails to start.
+    for( i = 1; i < threadNum; i++ ) {
+        arg[i].src   = src;
+        arg[i].dst   = dst;
+        arg[i].num   = num;
+        arg[i].first = i;
+        arg[i].step  = threadNum;
+        threadHandle[i] = threadInit( i, &(arg[i]), ar2GenImageLayerWorker );
+        if( threadHandle[i] ) threadStartSignal( threadHandle[i] );
+    }
+    for( i = 0; i < num; i += threadNum ) ar2GenImageLayer2Sub( src, dst[i] );
+    for( i = 1; i < threadNum; i++ ) {
+        if( threadHandle[i] == NULL ) {
+            for( j = i; j < num; j += threadNum ) ar2GenImageLayer2Sub( src, dst[j] );
+            continue;
+        }
+        threadEndWait( threadHandle[i] );
+        threadWaitQuit( threadHandle[i] );
+        threadFree( &threadHandle[i] );
+    }
+}
+#endif
@@ -60,6 +60,18 @@ static int ar2GetBestMatchingSubFineOpt( ARUint8 *img, int xsize, int ysize, int
                                          ARUint32 *subImage1, ARUint32 *subImage2, int sx2, int sy2, int *val);
 #endif
 
+/*!
+    @function
+    @abstract Get the number of elements required in each of the subImage work buffers used by ar2GetBestMatchingBuffered.
+    @param xsize Horizontal size of the template (i.e. xts1 + xts2 + 1).
+    @param ysize Vertical size of the template (i.e. yts1 + yts2 + 1).
+    @result Number of ARUint32 elements required in each buffer.
+ */
+int ar2GetBestMatchingSubImageSize( int xsize, int ysize )
+{
+    return ( (xsize + 1)*AR2_TEMP_SCALE + (SKIP_INTERVAL*2) ) * ( (ysize + 1)*AR2_TEMP_SCALE + (SKIP_INTERVAL*2) );
+}
+
 /*!
     @function
     @abstract Get best match for a candidate feature template.
@@ -82,6 +94,37 @@ static int ar2GetBestMatchingSubFineOpt( ARUint8 *img, int xsize, int ysize, int
 int ar2GetBestMatching( ARUint8 *img, ARUint8 *mfImage, int xsize, int ysize, AR_PIXEL_FORMAT pixFormat,
                         AR2TemplateT *mtemp, int rx, int ry,
                          int search[3][2], int *bx, int *by, float *val)
+{
+    ARUint32   *subImage1;
+    ARUint32   *subImage2;
+    int         size;
+    int         ret;
+
+    size = ar2GetBestMatchingSubImageSize( mtemp->xsize, mtemp->ysize );
+    arMalloc( subImage1, ARUint32, size );
+    arMalloc( subImage2, ARUint32, size );
+    ret = ar2GetBestMatchingBuffered( img, mfImage, xsize, ysize, pixFormat, mtemp, rx, ry, search, bx, by, val,
+                                      subImage1, subImage2 );
+    free(subImage1);
+    free(subImage2);
+
+    return ret;
+}
+
+/*!
+    @function
+    @abstract Get best match for a candidate feature template, using caller-supplied work buffers.
+    @discussion
+        Identical to ar2GetBestMatching, except that no memory is allocated. This is the variant
+        used by the tracking threads, which each own a pair of buffers for the lifetime of the AR2HandleT.
+    @param subImage1 Work buffer of at least ar2GetBestMatchingSubImageSize(mtemp->xsize, mtemp->ysize) elements.
+    @param subImage2 Work buffer of at least ar2GetBestMatchingSubImageSize(mtemp->xsize, mtemp->ysize) elements.
+    @result -1 in case of error or no match, or 0 otherwise.
+ */
+int ar2GetBestMatchingBuffered( ARUint8 *img, ARUint8 *mfImage, int xsize, int ysize, AR_PIXEL_FORMAT pixFormat,
+                                AR2TemplateT *mtemp, int rx, int ry,
+                                int search[3][2], int *bx, int *by, float *val,
+                                ARUint32 *subImage1, ARUint32 *subImage2 )
 {
     int              search_flag[] = {USE_SEARCH1, USE_SEARCH2, USE_SEARCH3};
     int              px, py, sx, sy, ex, ey;
@@ -96,8 +139,8 @@ int ar2GetBestMatching( ARUint8 *img, ARUint8 *mfImage, int xsize, int ysize, AR
     ARUint8         *pmf;
 #if 0
 #else
-    ARUint32   *subImage1, *p11, *p12, w1;
-    ARUint32   *subImage2, *p21, *p22, w2;
+    ARUint32   *p11, *p12, w1;
+    ARUint32   *p21, *p22, w2;
     ARUint32    subImage11[AR2_TEMP_SCALE];
     ARUint32    subImage21[AR2_TEMP_SCALE];
     ARUint8    *p3, *p4;
@@ -188,9 +231,6 @@ int ar2GetBestMatching( ARUint8 *img, ARUint8 *mfImage, int xsize, int ysize, AR
         }
     }
 #else
-    arMalloc( subImage1, ARUint32, ( (mtemp->xsize + 1)*AR2_TEMP_SCALE + (SKIP_INTERVAL*2)) * ((mtemp->ysize + 1)*AR2_TEMP_SCALE + (SKIP_INTERVAL*2) ) );
-    arMalloc( subImage2, ARUint32, ( (mtemp->xsize + 1)*AR2_TEMP_SCALE + (SKIP_INTERVAL*2)) * ((mtemp->ysize + 1)*AR2_TEMP_SCALE + (SKIP_INTERVAL*2) ) );
-
     for(l = 0; l < keep_num; l++) {
         if( mtemp->validNum != mtemp->xsize*mtemp->ysize
          || (pixFormat != AR_PIXEL_FORMAT_MONO && pixFormat != AR_PIXEL_FORMAT_420v && pixFormat != AR_PIXEL_FORMAT_420f && pixFormat != AR_PIXEL_FORMAT_NV21)
@@ -266,8 +306,6 @@ int ar2GetBestMatching( ARUint8 *img, ARUint8 *mfImage, int xsize, int ysize, AR
             }
         }
     }
-    free(subImage1);
-    free(subImage2);
 #endif
 
     return ret;
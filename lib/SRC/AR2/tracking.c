@@ -62,12 +62,15 @@ static int    extractVisibleFeaturesHomography( int xsize, int ysize, float  tra
                                           AR2TemplateCandidateT candidate[],
                                           AR2TemplateCandidateT candidate2[] );
 static int    getDeltaS( float  H[8], float  dU[], float  J_U_H[][8], int n );
+static void   getRequiredScales         ( AR2SurfaceSetT *surfaceSet, AR2TemplateCandidateT candidate[],
+                                          ARUint32 scaleMask[AR2_TRACKING_SURFACE_MAX] );
 
 
 int ar2Tracking( AR2HandleT *ar2Handle, AR2SurfaceSetT *surfaceSet, ARUint8 *dataPtr, float  trans[3][4], float  *err )
 {
     AR2TemplateCandidateT  *candidatePtr;
     AR2TemplateCandidateT  *cp[AR2_THREAD_MAX];
+    ARUint32                scaleMask[AR2_TRACKING_SURFACE_MAX];
 #if AR2_CAPABLE_ADAPTIVE_TEMPLATE
     float                   aveBlur;
 #endif
@@ -96,6 +99,14 @@ int ar2Tracking( AR2HandleT *ar2Handle, AR2SurfaceSetT *surfaceSet, ARUint8 *dat
         extractVisibleFeaturesHomography(ar2Handle->xsize, ar2Handle->ysize, ar2Handle->wtrans1, surfaceSet, ar2Handle->candidate, ar2Handle->candidate2);
     }
 
+    // Make sure the image set scales any candidate may refer to are resident for the duration of matching.
+    for( i = 0; i < surfaceSet->num; i++ ) scaleMask[i] = 0;
+    getRequiredScales( surfaceSet, ar2Handle->candidate, scaleMask );
+    getRequiredScales( surfaceSet, ar2Handle->candidate2, scaleMask );
+    for( i = 0; i < surfaceSet->num; i++ ) {
+        if( scaleMask[i] ) ar2ImageSetRequireScales( surfaceSet->surface[i].imageSet, scaleMask[i] );
+    }
+
     candidatePtr = ar2Handle->candidate;
 #if AR2_CAPABLE_ADAPTIVE_TEMPLATE
     aveBlur = 0.0F;
@@ -171,6 +182,9 @@ int ar2Tracking( AR2HandleT *ar2Handle, AR2SurfaceSetT *surfaceSet, ARUint8 *dat
             }
         }
     }
+    for( i = 0; i < surfaceSet->num; i++ ) {
+        if( scaleMask[i] ) ar2ImageSetReleaseScales( surfaceSet->surface[i].imageSet, scaleMask[i] );
+    }
     for( i = 0; i < num; i++ ) {
         surfaceSet->prevFeature[i] = ar2Handle->usedFeature[i];
     }
@@ -267,6 +281,18 @@ int ar2Tracking( AR2HandleT *ar2Handle, AR2SurfaceSetT *surfaceSet, ARUint8 *dat
     return 0;
 }
 
+static void getRequiredScales( AR2SurfaceSetT *surfaceSet, AR2TemplateCandidateT candidate[],
+                               ARUint32 scaleMask[AR2_TRACKING_SURFACE_MAX] )
+{
+    int         scale;
+    int         i;
+
+    for( i = 0; candidate[i].flag != -1; i++ ) {
+        scale = surfaceSet->surface[candidate[i].snum].featureSet->list[candidate[i].level].scale;
+        if( scale < AR2_IMAGESET_LAZY_SCALE_MAX ) scaleMask[candidate[i].snum] |= (1u << scale);
+    }
+}
+
 static int extractVisibleFeatures(const ARParamLT *cparamLT, const float  trans1[][3][4], AR2SurfaceSetT *surfaceSet,
                                   AR2TemplateCandidateT candidate[],  // candidates inside DPI range of [mindpi, maxdpi].
                                   AR2TemplateCandidateT candidate2[]) // candidates inside DPI range of [mindpi/2, maxdpi*2].
@@ -47,11 +47,13 @@
 
 #if AR2_CAPABLE_ADAPTIVE_TEMPLATE
 static int ar2Tracking2dSub ( AR2HandleT *handle, AR2SurfaceSetT *surfaceSet, AR2TemplateCandidateT *candidate,
-                              ARUint8 *dataPtr, ARUint8 *mfImage, AR2TemplateT **templ,
+                              ARUint8 *dataPtr, ARUint8 *mfImage, ARUint32 **subImage1, ARUint32 **subImage2,
+                              int *subImageSize, AR2TemplateT **templ,
                               AR2Template2T **templ2, AR2Tracking2DResultT *result );
 #else
 static int ar2Tracking2dSub ( AR2HandleT *handle, AR2SurfaceSetT *surfaceSet, AR2TemplateCandidateT *candidate,
-                              ARUint8 *dataPtr, ARUint8 *mfImage, AR2TemplateT **templ,
+                              ARUint8 *dataPtr, ARUint8 *mfImage, ARUint32 **subImage1, ARUint32 **subImage2,
+                              int *subImageSize, AR2TemplateT **templ,
                               AR2Tracking2DResultT *result );
 #endif
 
@@ -69,10 +71,12 @@ void *ar2Tracking2d( THREAD_HANDLE_T *threadHandle )
 
 #if AR2_CAPABLE_ADAPTIVE_TEMPLATE
         arg->ret = ar2Tracking2dSub( arg->ar2Handle, arg->surfaceSet, arg->candidate,
-                                     arg->dataPtr, arg->mfImage, &(arg->templ), &(arg->templ2), &(arg->result) );
+                                     arg->dataPtr, arg->mfImage, &(arg->subImage1), &(arg->subImage2),
+                                     &(arg->subImageSize), &(arg->templ), &(arg->templ2), &(arg->result) );
 #else
         arg->ret = ar2Tracking2dSub( arg->ar2Handle, arg->surfaceSet, arg->candidate,
-                                     arg->dataPtr, arg->mfImage, &(arg->templ), &(arg->result) );
+                                     arg->dataPtr, arg->mfImage, &(arg->subImage1), &(arg->subImage2),
+                                     &(arg->subImageSize), &(arg->templ), &(arg->result) );
 #endif
         threadEndSignal(threadHandle);
     }
@@ -84,11 +88,13 @@ void *ar2Tracking2d( THREAD_HANDLE_T *threadHandle )
 
 #if AR2_CAPABLE_ADAPTIVE_TEMPLATE
 static int ar2Tracking2dSub ( AR2HandleT *handle, AR2SurfaceSetT *surfaceSet, AR2TemplateCandidateT *candidate,
-                              ARUint8 *dataPtr, ARUint8 *mfImage, AR2TemplateT **templ,
+                              ARUint8 *dataPtr, ARUint8 *mfImage, ARUint32 **subImage1, ARUint32 **subImage2,
+                              int *subImageSize, AR2TemplateT **templ,
                               AR2Template2T **templ2, AR2Tracking2DResultT *result )
 #else
 static int ar2Tracking2dSub ( AR2HandleT *handle, AR2SurfaceSetT *surfaceSet, AR2TemplateCandidateT *candidate,
-                              ARUint8 *dataPtr, ARUint8 *mfImage, AR2TemplateT **templ,
+                              ARUint8 *dataPtr, ARUint8 *mfImage, ARUint32 **subImage1, ARUint32 **subImage2,
+                              int *subImageSize, AR2TemplateT **templ,
                               AR2Tracking2DResultT *result )
 #endif
 {
@@ -98,12 +104,24 @@ static int ar2Tracking2dSub ( AR2HandleT *handle, AR2SurfaceSetT *surfaceSet, AR
     int                   snum, level, fnum;
     int                   search[3][2];
     int                   bx, by;
+    int                   size;
 
     snum  = candidate->snum;
     level = candidate->level;
     fnum  = candidate->num;
 
-    if( *templ == NULL )  *templ = ar2GenTemplate( handle->templateSize1, handle->templateSize2 );
+    if( *templ == NULL ) {
+        *templ = ar2GenTemplate( handle->templateSize1, handle->templateSize2 );
+        // Grow the per-thread matching work buffers if the template is larger than they were sized for.
+        size = ar2GetBestMatchingSubImageSize( (*templ)->xsize, (*templ)->ysize );
+        if( size > *subImageSize ) {
+            free( *subImage1 );
+            free( *subImage2 );
+            arMalloc( *subImage1, ARUint32, size );
+            arMalloc( *subImage2, ARUint32, size );
+            *subImageSize = size;
+        }
+    }
 #if AR2_CAPABLE_ADAPTIVE_TEMPLATE
     if( *templ2 == NULL ) *templ2 = ar2GenTemplate2( handle->templateSize1, handle->templateSize2 );
 #endif
@@ -179,17 +197,19 @@ static int ar2Tracking2dSub ( AR2HandleT *handle, AR2SurfaceSetT *surfaceSet, AR
 
 #if AR2_CAPABLE_ADAPTIVE_TEMPLATE
     if( handle->blurMethod == AR2_CONSTANT_BLUR ) {
-        if( ar2GetBestMatching( dataPtr,
-                                mfImage,
-                                handle->xsize,
-                                handle->ysize,
-                                handle->pixFormat,
-                               *templ,
-                                handle->searchSize,
-                                handle->searchSize,
-                                search,
-                                &bx, &by,
-                              &(result->sim)) < 0 ) {
+        if( ar2GetBestMatchingBuffered( dataPtr,
+                                    mfImage,
+                                    handle->xsize,
+                                    handle->ysize,
+                                    handle->pixFormat,
+                                   *templ,
+                                    handle->searchSize,
+                                    handle->searchSize,
+                                    search,
+                                    &bx, &by,
+                                  &(result->sim),
+                                   *subImage1,
+                                   *subImage2) < 0 ) {
             return -1;
         }
         result->blurLevel = handle->blurLevel;
@@ -211,17 +231,19 @@ static int ar2Tracking2dSub ( AR2HandleT *handle, AR2SurfaceSetT *surfaceSet, AR
         }
     }
 #else
-    if( ar2GetBestMatching( dataPtr,
-                            mfImage,
-                            handle->xsize,
-                            handle->ysize,
-                            handle->pixFormat,
-                           *templ,
-                            handle->searchSize,
-                            handle->searchSize,
-                            search,
-                            &bx, &by,
-                          &(result->sim)) < 0 ) {
+    if( ar2GetBestMatchingBuffered( dataPtr,
+                                    mfImage,
+                                    handle->xsize,
+                                    handle->ysize,
+                                    handle->pixFormat,
+                                   *templ,
+                                    handle->searchSize,
+                                    handle->searchSize,
+                                    search,
+                                    &bx, &by,
+                                  &(result->sim),
+                                   *subImage1,
+                                   *subImage2) < 0 ) {
         return -1;
     }
 #endif
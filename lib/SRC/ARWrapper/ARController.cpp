@@ -56,8 +56,14 @@
 #endif
 #if HAVE_NFT
 #  include "trackingSub.h"
+#  include "trackingPages.h"
 #endif
 #include <stdarg.h>
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <sys/time.h>
+#endif
 
 #include <algorithm>
 #include <string>
@@ -69,6 +75,21 @@
 static const char LOG_TAG[] = "ARController (native)";
 PFN_LOGCALLBACK ARController::logCallback = NULL;
 
+// Wall-clock time in seconds, for frame timing.
+static double getTimeSeconds(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER count, freq;
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&freq);
+    return ((double)count.QuadPart / (double)freq.QuadPart);
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return ((double)tv.tv_sec + (double)tv.tv_usec * 1.0e-6);
+#endif
+}
+
 ARController::ARController() :
     state(NOTHING_INITIALISED),
     versionString(NULL),
@@ -95,6 +116,23 @@ ARController::ARController() :
     m_arPattHandle(NULL),
     m_ar3DHandle(NULL),
     m_ar3DStereoHandle(NULL),
+    m_pipelined(false),
+    m_detectionThreadHandle(NULL),
+    m_detectionImage0(NULL),
+    m_detectionImage1(NULL),
+    m_detectionOK(false),
+    m_pipelineMarkerInfo0(AR_SQUARE_MAX),
+    m_pipelineMarkerInfo1(AR_SQUARE_MAX),
+    m_pipelineMarkerNum0(0),
+    m_pipelineMarkerNum1(0),
+    m_pipelineMarkerInfoValid(false),
+    m_pipelineFrameTime(0.0),
+    m_rightDetectionThreadHandle(NULL),
+    m_rightDetectionImage(NULL),
+    m_rightDetectionOK(false),
+    m_timingFrameCount(0),
+    m_timingLatencySum(0.0),
+    m_timingProcessingSum(0.0),
 #if HAVE_NFT
     doNFTMarkerDetection(false),
     m_nftMultiMode(false),
@@ -103,6 +141,7 @@ ARController::ARController() :
     trackingThreadHandle(NULL),
     m_ar2Handle(NULL),
     m_kpmHandle(NULL),
+    m_trackingPagesHandle(NULL),
 #endif
     m_error(ARW_ERROR_NONE)
 {
@@ -360,8 +399,11 @@ bool ARController::videoAcceptImage(JNIEnv* env, jobject obj, const int videoSou
         }
         
         if (avs->getPixelFormat() == AR_PIXEL_FORMAT_NV21) {
-            env->GetByteArrayRegion(pinArray, 0, avs->getFrameSize(), (jbyte *)avs->getFrame());
-            avs->acceptImage(NULL);
+            ARUint8 *buff = avs->getWriteFrameBuffer();
+            if (buff) { // Otherwise every buffer is still in use, so drop this frame.
+                env->GetByteArrayRegion(pinArray, 0, avs->getFrameSize(), (jbyte *)buff);
+                avs->acceptImage(NULL);
+            }
         } else {
             if (jbyte* buff = env->GetByteArrayElements(pinArray, NULL)) {
                 avs->acceptImage((unsigned char *)buff);
@@ -521,6 +563,9 @@ bool ARController::update()
     m_videoSourceFrameStamp0 = frameStamp0;
     //logv("ARController::update() gotFrame");
     
+    double frameTime = getTimeSeconds();
+    bool detectionPending = false;
+    
     //
     // Detect markers.
     //
@@ -528,11 +573,6 @@ bool ARController::update()
     if (doMarkerDetection) {
         logv(AR_LOG_LEVEL_DEBUG, "ARWrapper::ARController::update(): if (doMarkerDetection) true");
         
-        ARMarkerInfo *markerInfo0 = NULL;
-        ARMarkerInfo *markerInfo1 = NULL;
-        int markerNum0 = 0;
-        int markerNum1 = 0;
-        
         if (!m_arHandle0 || (m_videoSourceIsStereo && !m_arHandle1)) {
             if (!initAR()) {
                 logv(AR_LOG_LEVEL_ERROR, "ARController::update(): Error initialising AR, exiting returning false");
@@ -540,41 +580,32 @@ bool ARController::update()
             }
         }
         
-        if (m_arHandle0) {
-            if (arDetectMarker(m_arHandle0, image0) < 0) {
-                logv(AR_LOG_LEVEL_ERROR, "ARController::update(): Error: arDetectMarker(), exiting returning false");
-                return false;
-            }
-            markerInfo0 = arGetMarker(m_arHandle0);
-            markerNum0 = arGetMarkerNum(m_arHandle0);
-        }
-        if (m_videoSourceIsStereo && m_arHandle1) {
-            if (arDetectMarker(m_arHandle1, image1) < 0) {
-                logv(AR_LOG_LEVEL_ERROR, "ARController::update(): Error: arDetectMarker(), exiting returning false");
-                return false;
-            }
-            markerInfo1 = arGetMarker(m_arHandle1);
-            markerNum1 = arGetMarkerNum(m_arHandle1);
-        }
-        
-        // Update square markers.
-        bool success = true;
-        if (!m_videoSourceIsStereo) {
-            for (std::vector<ARMarker *>::iterator it = markers.begin(); it != markers.end(); ++it) {
-                if ((*it)->type == ARMarker::SINGLE) {
-                    success &= ((ARMarkerSquare *)(*it))->updateWithDetectedMarkers(markerInfo0, markerNum0, m_ar3DHandle);
-                } else if ((*it)->type == ARMarker::MULTI) {
-                    success &= ((ARMarkerMulti *)(*it))->updateWithDetectedMarkers(markerInfo0, markerNum0, m_ar3DHandle);
+        if (m_pipelined) {
+            if (!m_detectionThreadHandle) {
+                m_detectionThreadHandle = threadInit(0, this, detectionWorker);
+                if (!m_detectionThreadHandle) {
+                    logv(AR_LOG_LEVEL_ERROR, "ARController::update(): Error starting detection thread, exiting returning false");
+                    return false;
                 }
             }
+            
+            // Detect markers in this frame on the worker, and meanwhile update
+            // square markers from the detection results of the previous frame.
+            m_detectionImage0 = image0;
+            m_detectionImage1 = image1;
+            threadStartSignal(m_detectionThreadHandle);
+            detectionPending = true;
+            
+            if (m_pipelineMarkerInfoValid) {
+                updateSquareMarkers(&m_pipelineMarkerInfo0[0], m_pipelineMarkerNum0, &m_pipelineMarkerInfo1[0], m_pipelineMarkerNum1);
+            }
         } else {
-            for (std::vector<ARMarker *>::iterator it = markers.begin(); it != markers.end(); ++it) {
-                if ((*it)->type == ARMarker::SINGLE) {
-                    success &= ((ARMarkerSquare *)(*it))->updateWithDetectedMarkersStereo(markerInfo0, markerNum0, markerInfo1, markerNum1, m_ar3DStereoHandle, m_transL2R);
-                } else if ((*it)->type == ARMarker::MULTI) {
-                    success &= ((ARMarkerMulti *)(*it))->updateWithDetectedMarkersStereo(markerInfo0, markerNum0, markerInfo1, markerNum1, m_ar3DStereoHandle, m_transL2R);
-                }
+            if (!detectMarkers(image0, image1)) {
+                logv(AR_LOG_LEVEL_ERROR, "ARController::update(): Error: arDetectMarker(), exiting returning false");
+                return false;
             }
+            updateSquareMarkers(arGetMarker(m_arHandle0), arGetMarkerNum(m_arHandle0),
+                                (m_videoSourceIsStereo ? arGetMarker(m_arHandle1) : NULL), (m_videoSourceIsStereo ? arGetMarkerNum(m_arHandle1) : 0));
         }
     } // doMarkerDetection
     
@@ -585,6 +616,7 @@ bool ARController::update()
         if (!m_kpmHandle || !m_ar2Handle) {
             if (!initNFT()) {
                 logv(AR_LOG_LEVEL_ERROR, "ARController::update(): Error initialising NFT, exiting returning false");
+                if (detectionPending) finishPipelinedDetection();
                 return false;
             }
         }
@@ -595,13 +627,20 @@ bool ARController::update()
         if (trackingThreadHandle) {
             
             // Do KPM tracking.
-            float err;
             float trackingTrans[3][4];
             
             if (m_kpmRequired) {
                 if (!m_kpmBusy) {
-                    trackingInitStart(trackingThreadHandle, image0);
-                    m_kpmBusy = true;
+                    // Hand the worker a reference to the frame rather than a copy, so this
+                    // thread can move on to the next frame straight away.
+                    ARUint8 *kpmImage = m_videoSource0->retainFrame();
+                    if (kpmImage) {
+                        if (trackingInitStartShared(trackingThreadHandle, kpmImage, m_videoSource0->getFrameRing()) == 0) {
+                            m_kpmBusy = true;
+                        } else {
+                            m_videoSource0->releaseFrame(kpmImage);
+                        }
+                    }
                 } else {
                     int ret;
                     int pageNo;
@@ -624,24 +663,60 @@ bool ARController::update()
                 }
             }
             
-            // Do AR2 tracking and update NFT markers.
+            // Do AR2 tracking of all pages currently being tracked.
+            AR2SurfaceSetT *trackedSurfaceSet[PAGES_MAX];
+            float trackedTrans[PAGES_MAX][3][4];
+            float trackedErr[PAGES_MAX];
+            int trackedRet[PAGES_MAX];
+            int trackedPage[PAGES_MAX];
+            int trackedNum = 0;
             int page = 0;
+            int i;
+            
+            for (std::vector<ARMarker *>::iterator it = markers.begin(); it != markers.end(); ++it) {
+                if ((*it)->type == ARMarker::NFT) {
+                    if (surfaceSet[page]->contNum > 0) {
+                        trackedSurfaceSet[trackedNum] = surfaceSet[page];
+                        trackedPage[trackedNum] = page;
+                        trackedNum++;
+                    }
+                    page++;
+                }
+            }
+            // With several pages in view, track them in parallel rather than one after another.
+            // The workers and the calling thread each get an equal share of the CPUs for template matching.
+            if (trackedNum > 1 && !m_trackingPagesHandle && threadGetCPU() > 1) {
+                int workerNum = std::min(threadGetCPU() - 1, page - 1);
+                m_trackingPagesHandle = trackingPagesInit(m_ar2Handle, workerNum, std::max(1, threadGetCPU() / (workerNum + 1)));
+            }
+            if (trackedNum > 1 && m_trackingPagesHandle) {
+                trackingPagesRun(m_trackingPagesHandle, m_ar2Handle, trackedSurfaceSet, trackedNum, image0, trackedTrans, trackedErr, trackedRet);
+            } else {
+                for (i = 0; i < trackedNum; i++) {
+                    trackedRet[i] = ar2Tracking(m_ar2Handle, trackedSurfaceSet[i], image0, trackedTrans[i], &trackedErr[i]);
+                }
+            }
+            
+            // Update NFT markers.
             int pagesTracked = 0;
             bool success = true;
             ARdouble *transL2R = (m_videoSourceIsStereo ? (ARdouble *)m_transL2R : NULL);
-
+            
+            page = 0;
+            i = 0;
             for (std::vector<ARMarker *>::iterator it = markers.begin(); it != markers.end(); ++it) {
                 if ((*it)->type == ARMarker::NFT) {
                     
-                    if (surfaceSet[page]->contNum > 0) {
-                        if (ar2Tracking(m_ar2Handle, surfaceSet[page], image0, trackingTrans, &err) < 0) {
+                    if (i < trackedNum && trackedPage[i] == page) {
+                        if (trackedRet[i] < 0) {
                             //logv("Tracking lost on page %d.", page);
                             success &= ((ARMarkerNFT *)(*it))->updateWithNFTResults(-1, NULL, NULL);
                         } else {
-                            //logv("Tracked page %d (pos = {% 4f, % 4f, % 4f}).\n", page, trackingTrans[0][3], trackingTrans[1][3], trackingTrans[2][3]);
-                            success &= ((ARMarkerNFT *)(*it))->updateWithNFTResults(page, trackingTrans, (ARdouble (*)[4])transL2R);
+                            //logv("Tracked page %d (pos = {% 4f, % 4f, % 4f}).\n", page, trackedTrans[i][0][3], trackedTrans[i][1][3], trackedTrans[i][2][3]);
+                            success &= ((ARMarkerNFT *)(*it))->updateWithNFTResults(page, trackedTrans[i], (ARdouble (*)[4])transL2R);
                             pagesTracked++;
                         }
+                        i++;
                     }
                     
                     page++;
@@ -653,11 +728,143 @@ bool ARController::update()
         } // trackingThreadHandle
     } // doNFTMarkerDetection
 #endif // HAVE_NFT
+    
+    double now;
+    if (detectionPending) {
+        if (!finishPipelinedDetection()) {
+            logv(AR_LOG_LEVEL_ERROR, "ARController::update(): Error: arDetectMarker(), exiting returning false");
+            return false;
+        }
+        now = getTimeSeconds();
+        if (m_pipelineMarkerInfoValid) {
+            m_timingLatencySum += now - m_pipelineFrameTime;
+            m_timingProcessingSum += now - frameTime;
+            m_timingFrameCount++;
+        }
+        m_pipelineMarkerInfoValid = true;
+        m_pipelineFrameTime = frameTime;
+    } else {
+        now = getTimeSeconds();
+        m_timingLatencySum += now - frameTime;
+        m_timingProcessingSum += now - frameTime;
+        m_timingFrameCount++;
+    }
+    
     logv(AR_LOG_LEVEL_DEBUG, "ARWrapper::ARController::update(): exiting, returning true");
     
 	return true;
 }
 
+bool ARController::detectMarkers(ARUint8 *image0, ARUint8 *image1)
+{
+    bool ok = true;
+    bool rightPending = false;
+    
+    // The two views share only the (read-only) pattern handle, so detect the right
+    // view on its own thread while this one does the left. Both must be complete
+    // before any stereo pose estimation.
+    if (m_videoSourceIsStereo && m_arHandle1) {
+        if (!m_rightDetectionThreadHandle) {
+            m_rightDetectionThreadHandle = threadInit(1, this, rightDetectionWorker);
+        }
+        if (m_rightDetectionThreadHandle) {
+            m_rightDetectionImage = image1;
+            threadStartSignal(m_rightDetectionThreadHandle);
+            rightPending = true;
+        } else {
+            if (arDetectMarker(m_arHandle1, image1) < 0) ok = false;
+        }
+    }
+    if (m_arHandle0) {
+        if (arDetectMarker(m_arHandle0, image0) < 0) ok = false;
+    }
+    if (rightPending) {
+        threadEndWait(m_rightDetectionThreadHandle);
+        m_rightDetectionImage = NULL;
+        if (!m_rightDetectionOK) ok = false;
+    }
+    return ok;
+}
+
+void *ARController::rightDetectionWorker(THREAD_HANDLE_T *threadHandle)
+{
+    ARController *controller = (ARController *)threadGetArg(threadHandle);
+    
+    while (threadStartWait(threadHandle) == 0) {
+        controller->m_rightDetectionOK = (arDetectMarker(controller->m_arHandle1, controller->m_rightDetectionImage) >= 0);
+        threadEndSignal(threadHandle);
+    }
+    return NULL;
+}
+
+bool ARController::updateSquareMarkers(ARMarkerInfo *markerInfo0, int markerNum0, ARMarkerInfo *markerInfo1, int markerNum1)
+{
+    bool success = true;
+    if (!m_videoSourceIsStereo) {
+        for (std::vector<ARMarker *>::iterator it = markers.begin(); it != markers.end(); ++it) {
+            if ((*it)->type == ARMarker::SINGLE) {
+                success &= ((ARMarkerSquare *)(*it))->updateWithDetectedMarkers(markerInfo0, markerNum0, m_ar3DHandle);
+            } else if ((*it)->type == ARMarker::MULTI) {
+                success &= ((ARMarkerMulti *)(*it))->updateWithDetectedMarkers(markerInfo0, markerNum0, m_ar3DHandle);
+            }
+        }
+    } else {
+        for (std::vector<ARMarker *>::iterator it = markers.begin(); it != markers.end(); ++it) {
+            if ((*it)->type == ARMarker::SINGLE) {
+                success &= ((ARMarkerSquare *)(*it))->updateWithDetectedMarkersStereo(markerInfo0, markerNum0, markerInfo1, markerNum1, m_ar3DStereoHandle, m_transL2R);
+            } else if ((*it)->type == ARMarker::MULTI) {
+                success &= ((ARMarkerMulti *)(*it))->updateWithDetectedMarkersStereo(markerInfo0, markerNum0, markerInfo1, markerNum1, m_ar3DStereoHandle, m_transL2R);
+            }
+        }
+    }
+    return success;
+}
+
+// Detection thread. Between a threadStartSignal() in update() and the matching
+// threadEndWait() in finishPipelinedDetection(), this thread has sole use of the
+// ARHandles; the caller's thread uses only the AR3DHandles, markers and NFT state.
+void *ARController::detectionWorker(THREAD_HANDLE_T *threadHandle)
+{
+    ARController *controller = (ARController *)threadGetArg(threadHandle);
+    
+    while (threadStartWait(threadHandle) == 0) {
+        controller->m_detectionOK = controller->detectMarkers(controller->m_detectionImage0, controller->m_detectionImage1);
+        threadEndSignal(threadHandle);
+    }
+    return NULL;
+}
+
+bool ARController::finishPipelinedDetection(void)
+{
+    threadEndWait(m_detectionThreadHandle);
+    m_detectionImage0 = m_detectionImage1 = NULL;
+    if (!m_detectionOK) {
+        m_pipelineMarkerInfoValid = false;
+        return false;
+    }
+    
+    // Keep the results for pose estimation during the next update, as the
+    // ARHandles will be overwritten by detection of the next frame.
+    m_pipelineMarkerNum0 = arGetMarkerNum(m_arHandle0);
+    if (m_pipelineMarkerNum0 > 0) memcpy(&m_pipelineMarkerInfo0[0], arGetMarker(m_arHandle0), m_pipelineMarkerNum0 * sizeof(ARMarkerInfo));
+    if (m_videoSourceIsStereo && m_arHandle1) {
+        m_pipelineMarkerNum1 = arGetMarkerNum(m_arHandle1);
+        if (m_pipelineMarkerNum1 > 0) memcpy(&m_pipelineMarkerInfo1[0], arGetMarker(m_arHandle1), m_pipelineMarkerNum1 * sizeof(ARMarkerInfo));
+    } else {
+        m_pipelineMarkerNum1 = 0;
+    }
+    return true;
+}
+
+void ARController::stopDetectionThread(void)
+{
+    if (m_detectionThreadHandle) {
+        threadWaitQuit(m_detectionThreadHandle);
+        threadFree(&m_detectionThreadHandle);
+    }
+    m_pipelineMarkerInfoValid = false;
+}
+
 bool ARController::initAR(void)
 {
     logv(AR_LOG_LEVEL_INFO, "ARController::initAR() called");
@@ -794,6 +1001,7 @@ bool ARController::unloadNFTData(void)
         trackingInitQuit(&trackingThreadHandle);
         m_kpmBusy = false;
     }
+    trackingPagesQuit(&m_trackingPagesHandle);
     for (i = 0; i < PAGES_MAX; i++) surfaceSet[i] = NULL; // Discard weak-references.
     m_kpmRequired = true;
     
@@ -907,6 +1115,12 @@ bool ARController::stopRunning()
     logv(AR_LOG_LEVEL_DEBUG, "ARWrapper::ARController::stopRunning(): called unlockVideoSource()");
 	m_projectionMatrixSet = false;
     
+    stopDetectionThread();
+    if (m_rightDetectionThreadHandle) {
+        threadWaitQuit(m_rightDetectionThreadHandle);
+        threadFree(&m_rightDetectionThreadHandle);
+    }
+    
 #if HAVE_NFT
     // NFT cleanup.
     //logv("Cleaning up ARToolKit NFT handles.");
@@ -1221,6 +1435,34 @@ bool ARController::getNFTMultiMode() const
 #endif
 }
 
+void ARController::setPipelined(bool on)
+{
+    if (on == m_pipelined) return;
+    m_pipelined = on;
+    // Results held for the previous frame are dropped when leaving pipelined mode.
+    if (!on) stopDetectionThread();
+}
+
+bool ARController::getPipelined() const
+{
+    return m_pipelined;
+}
+
+bool ARController::getFrameTiming(float *latencyMs, float *processingMs, int *frameCount) const
+{
+    if (latencyMs) *latencyMs = (m_timingFrameCount ? (float)(m_timingLatencySum * 1000.0 / m_timingFrameCount) : 0.0f);
+    if (processingMs) *processingMs = (m_timingFrameCount ? (float)(m_timingProcessingSum * 1000.0 / m_timingFrameCount) : 0.0f);
+    if (frameCount) *frameCount = (int)m_timingFrameCount;
+    return (m_timingFrameCount > 0);
+}
+
+void ARController::resetFrameTiming()
+{
+    m_timingFrameCount = 0;
+    m_timingLatencySum = 0.0;
+    m_timingProcessingSum = 0.0;
+}
+
 // ----------------------------------------------------------------------------------------------------
 #pragma mark Debug texture
 // ----------------------------------------------------------------------------------------------------
@@ -536,6 +536,30 @@ EXPORT_API bool arwGetNFTMultiMode()
     return gARTK->getNFTMultiMode();
 }
 
+EXPORT_API void arwSetPipelined(bool on)
+{
+    if (!gARTK) return;
+    gARTK->setPipelined(on);
+}
+
+EXPORT_API bool arwGetPipelined()
+{
+    if (!gARTK) return false;
+    return gARTK->getPipelined();
+}
+
+EXPORT_API bool arwGetFrameTiming(float *latencyMs, float *processingMs, int *frameCount)
+{
+    if (!gARTK) return false;
+    return gARTK->getFrameTiming(latencyMs, processingMs, frameCount);
+}
+
+EXPORT_API void arwResetFrameTiming()
+{
+    if (!gARTK) return;
+    gARTK->resetFrameTiming();
+}
+
 
 // ----------------------------------------------------------------------------------------------------
 #pragma mark  Marker management
@@ -924,6 +948,10 @@ extern "C" {
     JNIEXPORT jint JNICALL JNIFUNCTION(arwGetImageProcMode(JNIEnv *env, jobject obj));
     JNIEXPORT void JNICALL JNIFUNCTION(arwSetNFTMultiMode(JNIEnv *env, jobject obj, jboolean on));
     JNIEXPORT jboolean JNICALL JNIFUNCTION(arwGetNFTMultiMode(JNIEnv *env, jobject obj));
+    JNIEXPORT void JNICALL JNIFUNCTION(arwSetPipelined(JNIEnv *env, jobject obj, jboolean on));
+    JNIEXPORT jboolean JNICALL JNIFUNCTION(arwGetPipelined(JNIEnv *env, jobject obj));
+    JNIEXPORT jfloatArray JNICALL JNIFUNCTION(arwGetFrameTiming(JNIEnv *env, jobject obj));
+    JNIEXPORT void JNICALL JNIFUNCTION(arwResetFrameTiming(JNIEnv *env, jobject obj));
 
     JNIEXPORT void JNICALL JNIFUNCTION(arwSetMarkerOptionBool(JNIEnv *env, jobject obj, jint markerUID, jint option, jboolean value));
     JNIEXPORT void JNICALL JNIFUNCTION(arwSetMarkerOptionInt(JNIEnv *env, jobject obj, jint markerUID, jint option, jint value));
@@ -1245,6 +1273,34 @@ JNIEXPORT jboolean JNICALL JNIFUNCTION(arwGetNFTMultiMode(JNIEnv *env, jobject o
     return arwGetNFTMultiMode();
 }
 
+JNIEXPORT void JNICALL JNIFUNCTION(arwSetPipelined(JNIEnv *env, jobject obj, jboolean on))
+{
+    arwSetPipelined(on);
+}
+
+JNIEXPORT jboolean JNICALL JNIFUNCTION(arwGetPipelined(JNIEnv *env, jobject obj))
+{
+    return arwGetPipelined();
+}
+
+// Returns { latencyMs, processingMs, frameCount }, or NULL if no frames have been processed.
+JNIEXPORT jfloatArray JNICALL JNIFUNCTION(arwGetFrameTiming(JNIEnv *env, jobject obj))
+{
+    float timing[3];
+    int frameCount;
+    
+    if (!arwGetFrameTiming(&timing[0], &timing[1], &frameCount)) return NULL;
+    timing[2] = (float)frameCount;
+    jfloatArray result = env->NewFloatArray(3);
+    if (result) env->SetFloatArrayRegion(result, 0, 3, timing);
+    return result;
+}
+
+JNIEXPORT void JNICALL JNIFUNCTION(arwResetFrameTiming(JNIEnv *env, jobject obj))
+{
+    arwResetFrameTiming();
+}
+
 JNIEXPORT void JNICALL JNIFUNCTION(arwSetMarkerOptionInt(JNIEnv *env, jobject obj, jint markerUID, jint option, jint value))
 {
     return arwSetMarkerOptionInt(markerUID, option, value);
@@ -47,7 +47,7 @@
 
 AndroidVideoSource::AndroidVideoSource() : VideoSource(),
     newFrameArrived(false),
-    localFrameBuffer(NULL),
+    writeFrameBuffer(NULL),
     frameBufferSize(0),
     gCameraIndex(0),
     gCameraIsFrontFacing(false) {
@@ -182,20 +182,24 @@ bool AndroidVideoSource::getVideoReadyAndroid2(const ARParam *cparam_p) {
         goto bail;
 	}
 
-	// Allocate local buffer for video frame after copy or conversion.
+	// Allocate local buffers for video frames after copy or conversion. Frames are
+    // captured straight into these, so they can be shared with the tracking thread.
     if (pixelFormat == AR_PIXEL_FORMAT_NV21 || pixelFormat == AR_PIXEL_FORMAT_420f) {
         frameBufferSize = videoWidth * videoHeight + 2 * videoWidth/2 * videoHeight/2;
     } else {
         frameBufferSize = videoWidth * videoHeight * arUtilGetPixelSize(pixelFormat);
     }
-    localFrameBuffer = (ARUint8*)calloc(frameBufferSize, sizeof(ARUint8));
-	if (!localFrameBuffer) {
+    if (frameRing) frameBufferRingDelete(&frameRing);
+    frameRing = frameBufferRingCreate((int)frameBufferSize, FRAME_BUFFER_RING_DEFAULT_COUNT);
+	if (!frameRing) {
         ARController::logv("Error: Unable to allocate memory for local video frame buffer");
         goto bail;
 	}
-    frameBuffer = localFrameBuffer;
+    frameBuffer = frameBufferRingAcquire(frameRing);
+    memset(frameBuffer, 0, frameBufferSize);
+    frameBufferRingPublish(frameRing, frameBuffer);
     if (pixelFormat == AR_PIXEL_FORMAT_NV21 || pixelFormat == AR_PIXEL_FORMAT_420f) {
-        frameBuffer2 = localFrameBuffer + videoWidth*videoHeight;
+        frameBuffer2 = frameBuffer + videoWidth*videoHeight;
     } else {
         frameBuffer2 = NULL;
     }
@@ -229,18 +233,30 @@ bool AndroidVideoSource::captureFrame() {
     return false;
 }
 
+ARUint8* AndroidVideoSource::getWriteFrameBuffer() {
+    if (deviceState != DEVICE_RUNNING) return NULL;
+    if (!writeFrameBuffer) writeFrameBuffer = frameBufferRingAcquire(frameRing);
+    return writeFrameBuffer;
+}
+
 void AndroidVideoSource::acceptImage(ARUint8* ptr) {
 	
     //ARController::logv("AndroidVideoSource::acceptImage()");
 	if (deviceState == DEVICE_RUNNING) {
         if (pixelFormat == AR_PIXEL_FORMAT_NV21 || pixelFormat == AR_PIXEL_FORMAT_420f) {
-            // Nothing more to do.
+            // Already written into writeFrameBuffer by the caller.
+            if (!writeFrameBuffer) return;
         } else if (ptr && pixelFormat == AR_PIXEL_FORMAT_RGBA) {
-            color_convert_common((unsigned char*)ptr, (unsigned char*)(ptr + videoWidth * videoHeight), videoWidth, videoHeight, localFrameBuffer);
+            if (!getWriteFrameBuffer()) return; // Every buffer is in use, so drop this frame.
+            color_convert_common((unsigned char*)ptr, (unsigned char*)(ptr + videoWidth * videoHeight), videoWidth, videoHeight, writeFrameBuffer);
             
         } else {
             return;
         }
+        frameBufferRingPublish(frameRing, writeFrameBuffer);
+        frameBuffer = writeFrameBuffer;
+        if (frameBuffer2) frameBuffer2 = frameBuffer + videoWidth*videoHeight;
+        writeFrameBuffer = NULL;
 		frameStamp++;
 		newFrameArrived = true;
     }
@@ -252,9 +268,10 @@ bool AndroidVideoSource::close() {
     
     if (cparamLT) arParamLTFree(&cparamLT);
 
-	if (localFrameBuffer) {
-		free(localFrameBuffer);
-		localFrameBuffer = NULL;
+	if (frameRing) {
+        if (writeFrameBuffer) frameBufferRingRelease(frameRing, writeFrameBuffer);
+        writeFrameBuffer = NULL;
+		frameBufferRingDelete(&frameRing);
         frameBuffer = NULL;
         frameBuffer2 = NULL;
         frameBufferSize = 0;
@@ -100,3 +100,320 @@ void color_convert_common(unsigned char *pY, unsigned char *pUV, int width, int
 	    
 	}
 }
+
+#ifdef HAVE_X86_SIMD
+
+// ----------------------------------------------------------------------------------------------------
+// x86 SIMD color conversion
+// ----------------------------------------------------------------------------------------------------
+
+#if defined(_MSC_VER)
+#  include <intrin.h>
+#  define X86_TARGET(X)
+#else
+#  include <cpuid.h>
+#  include <immintrin.h>
+#  define X86_TARGET(X) __attribute__((target(X)))
+#endif
+
+#define CLAMP255(X) ((unsigned char)MIN(MAX((X), 0), 255))
+
+static int color_convert_x86_detect(void)
+{
+    unsigned int regs[4];
+    unsigned int maxLeaf;
+    int level = COLOR_CONVERSION_X86_NONE;
+    
+#if defined(_MSC_VER)
+    int r[4];
+    __cpuidex(r, 0, 0); maxLeaf = (unsigned int)r[0];
+    if (maxLeaf < 1) return level;
+    __cpuidex(r, 1, 0); regs[2] = (unsigned int)r[2]; regs[3] = (unsigned int)r[3];
+#else
+    __cpuid_count(0, 0, regs[0], regs[1], regs[2], regs[3]); maxLeaf = regs[0];
+    if (maxLeaf < 1) return level;
+    __cpuid_count(1, 0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+    if (!(regs[3] & (1u << 26))) return level;
+    level = COLOR_CONVERSION_X86_SSE2;
+    if (!(regs[2] & (1u << 9))) return level;
+    level = COLOR_CONVERSION_X86_SSSE3;
+    
+    // AVX2 also needs the OS to save the YMM registers.
+    if (!(regs[2] & (1u << 27)) || !(regs[2] & (1u << 28)) || maxLeaf < 7) return level;
+#if defined(_MSC_VER)
+    if ((_xgetbv(0) & 0x6) != 0x6) return level;
+    __cpuidex(r, 7, 0); regs[1] = (unsigned int)r[1];
+#else
+    unsigned int eax, edx;
+    __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    if ((eax & 0x6) != 0x6) return level;
+    __cpuid_count(7, 0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+    if (regs[1] & (1u << 5)) level = COLOR_CONVERSION_X86_AVX2;
+    return level;
+}
+
+int color_convert_x86_level(void)
+{
+    static int level = -1;
+    if (level == -1) level = color_convert_x86_detect();
+    return level;
+}
+
+//
+// Packed RGB.
+//
+
+static void color_convert_rgb_scalar(const unsigned char *src, int pixelSize, int rOffset, int gOffset, int bOffset,
+                                     unsigned int *dst, int count)
+{
+    for (; count > 0; count--) {
+        *dst = 0xff000000 | (src[bOffset] << 16) | (src[gOffset] << 8) | src[rOffset];
+        src += pixelSize;
+        dst++;
+    }
+}
+
+// Shuffle mask taking four pixels of pixelSize bytes to RGB0.
+static void color_convert_rgb_mask(int pixelSize, int rOffset, int gOffset, int bOffset, char mask[16])
+{
+    for (int i = 0; i < 4; i++) {
+        mask[i*4 + 0] = (char)(i*pixelSize + rOffset);
+        mask[i*4 + 1] = (char)(i*pixelSize + gOffset);
+        mask[i*4 + 2] = (char)(i*pixelSize + bOffset);
+        mask[i*4 + 3] = (char)0x80; // Zero, replaced by alpha.
+    }
+}
+
+X86_TARGET("ssse3")
+static int color_convert_rgb_ssse3(const unsigned char *src, int pixelSize, const char m[16], unsigned int *dst, int count)
+{
+    const __m128i mask = _mm_loadu_si128((const __m128i *)m);
+    const __m128i alpha = _mm_set1_epi32((int)0xff000000);
+    int x = 0;
+    
+    // Each load reads 16 bytes, which for 24-bit pixels runs past the 4 pixels used.
+    for (; (x + 4)*pixelSize + (16 - 4*pixelSize) <= count*pixelSize; x += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + x*pixelSize));
+        _mm_storeu_si128((__m128i *)(dst + x), _mm_or_si128(_mm_shuffle_epi8(v, mask), alpha));
+    }
+    return x;
+}
+
+X86_TARGET("avx2")
+static int color_convert_rgb32_avx2(const unsigned char *src, const char m[16], unsigned int *dst, int count)
+{
+    const __m128i mask128 = _mm_loadu_si128((const __m128i *)m);
+    const __m256i mask = _mm256_inserti128_si256(_mm256_castsi128_si256(mask128), mask128, 1);
+    const __m256i alpha = _mm256_set1_epi32((int)0xff000000);
+    int x = 0;
+    
+    for (; x + 8 <= count; x += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(src + x*4));
+        _mm256_storeu_si256((__m256i *)(dst + x), _mm256_or_si256(_mm256_shuffle_epi8(v, mask), alpha));
+    }
+    return x;
+}
+
+void color_convert_x86_rgb(int level, const unsigned char *src, int pixelSize, int rOffset, int gOffset, int bOffset,
+                           unsigned int *dst, int count)
+{
+    char mask[16];
+    int done = 0;
+    
+    if (level >= COLOR_CONVERSION_X86_SSSE3 && (pixelSize == 3 || pixelSize == 4)) {
+        color_convert_rgb_mask(pixelSize, rOffset, gOffset, bOffset, mask);
+        if (level >= COLOR_CONVERSION_X86_AVX2 && pixelSize == 4) done = color_convert_rgb32_avx2(src, mask, dst, count);
+        done += color_convert_rgb_ssse3(src + done*pixelSize, pixelSize, mask, dst + done, count - done);
+    }
+    color_convert_rgb_scalar(src + done*pixelSize, pixelSize, rOffset, gOffset, bOffset, dst + done, count - done);
+}
+
+//
+// YCbCr. Fixed-point BT.601 full-range, as in VideoSource::updateTexture32():
+//   R = Y + (179*Cr >> 7), G = Y + ((-44*Cb - 91*Cr) >> 7), B = Y + (227*Cb >> 7).
+// All intermediates fit in 16 bits, so mullo/srai reproduce the scalar arithmetic exactly,
+// and packus reproduces the clamp.
+//
+
+static inline void color_convert_ycc_scalar(int Y0, int Y1, int Cb, int Cr, unsigned char *out)
+{
+    int R = (        179*Cr) >> 7;
+    int G = (-44*Cb - 91*Cr) >> 7;
+    int B = (227*Cb        ) >> 7;
+    out[0] = CLAMP255(Y0 + R); out[1] = CLAMP255(Y0 + G); out[2] = CLAMP255(Y0 + B); out[3] = 255;
+    out[4] = CLAMP255(Y1 + R); out[5] = CLAMP255(Y1 + G); out[6] = CLAMP255(Y1 + B); out[7] = 255;
+}
+
+// Interleaves 16 R, G and B bytes with alpha and stores 16 RGBA pixels.
+X86_TARGET("sse2")
+static inline void color_convert_store_rgba_sse2(__m128i r, __m128i g, __m128i b, unsigned char *out)
+{
+    const __m128i a = _mm_set1_epi8((char)0xff);
+    __m128i rgLo = _mm_unpacklo_epi8(r, g), rgHi = _mm_unpackhi_epi8(r, g);
+    __m128i baLo = _mm_unpacklo_epi8(b, a), baHi = _mm_unpackhi_epi8(b, a);
+    _mm_storeu_si128((__m128i *)(out +  0), _mm_unpacklo_epi16(rgLo, baLo));
+    _mm_storeu_si128((__m128i *)(out + 16), _mm_unpackhi_epi16(rgLo, baLo));
+    _mm_storeu_si128((__m128i *)(out + 32), _mm_unpacklo_epi16(rgHi, baHi));
+    _mm_storeu_si128((__m128i *)(out + 48), _mm_unpackhi_epi16(rgHi, baHi));
+}
+
+// Chroma offsets (8 words each of Cb and Cr minus 128) to R, G and B offsets.
+X86_TARGET("sse2")
+static inline void color_convert_chroma_sse2(__m128i cb, __m128i cr, __m128i *r, __m128i *g, __m128i *b)
+{
+    *r = _mm_srai_epi16(_mm_mullo_epi16(cr, _mm_set1_epi16(179)), 7);
+    *g = _mm_srai_epi16(_mm_add_epi16(_mm_mullo_epi16(cb, _mm_set1_epi16(-44)), _mm_mullo_epi16(cr, _mm_set1_epi16(-91))), 7);
+    *b = _mm_srai_epi16(_mm_mullo_epi16(cb, _mm_set1_epi16(227)), 7);
+}
+
+// 16 pixels of one row, whose 8 chroma offsets are in r, g, b.
+X86_TARGET("sse2")
+static inline void color_convert_420_row_sse2(const unsigned char *pY, __m128i r, __m128i g, __m128i b, unsigned char *out)
+{
+    const __m128i lowBytes = _mm_set1_epi16(0x00ff);
+    __m128i y = _mm_loadu_si128((const __m128i *)pY);
+    __m128i yE = _mm_and_si128(y, lowBytes);
+    __m128i yO = _mm_srli_epi16(y, 8);
+    __m128i r8 = _mm_unpacklo_epi8(_mm_packus_epi16(_mm_add_epi16(yE, r), _mm_add_epi16(yE, r)), _mm_packus_epi16(_mm_add_epi16(yO, r), _mm_add_epi16(yO, r)));
+    __m128i g8 = _mm_unpacklo_epi8(_mm_packus_epi16(_mm_add_epi16(yE, g), _mm_add_epi16(yE, g)), _mm_packus_epi16(_mm_add_epi16(yO, g), _mm_add_epi16(yO, g)));
+    __m128i b8 = _mm_unpacklo_epi8(_mm_packus_epi16(_mm_add_epi16(yE, b), _mm_add_epi16(yE, b)), _mm_packus_epi16(_mm_add_epi16(yO, b), _mm_add_epi16(yO, b)));
+    color_convert_store_rgba_sse2(r8, g8, b8, out);
+}
+
+X86_TARGET("sse2")
+static int color_convert_420bi_rows_sse2(const unsigned char *pY0, const unsigned char *pY1, const unsigned char *pC, int crFirst,
+                                         int width, unsigned char *out0, unsigned char *out1)
+{
+    const __m128i lowBytes = _mm_set1_epi16(0x00ff);
+    const __m128i bias = _mm_set1_epi16(128);
+    int x = 0;
+    
+    for (; x + 16 <= width; x += 16) {
+        __m128i c = _mm_loadu_si128((const __m128i *)(pC + x));
+        __m128i c0 = _mm_sub_epi16(_mm_and_si128(c, lowBytes), bias);
+        __m128i c1 = _mm_sub_epi16(_mm_srli_epi16(c, 8), bias);
+        __m128i r, g, b;
+        color_convert_chroma_sse2(crFirst ? c1 : c0, crFirst ? c0 : c1, &r, &g, &b);
+        color_convert_420_row_sse2(pY0 + x, r, g, b, out0 + x*4);
+        color_convert_420_row_sse2(pY1 + x, r, g, b, out1 + x*4);
+    }
+    return x;
+}
+
+X86_TARGET("avx2")
+static inline void color_convert_420_row_avx2(const unsigned char *pY, __m256i r, __m256i g, __m256i b, unsigned char *out)
+{
+    const __m256i lowBytes = _mm256_set1_epi16(0x00ff);
+    const __m256i a = _mm256_set1_epi8((char)0xff);
+    __m256i y = _mm256_loadu_si256((const __m256i *)pY);
+    __m256i yE = _mm256_and_si256(y, lowBytes);
+    __m256i yO = _mm256_srli_epi16(y, 8);
+    // Per 128-bit lane, as the AVX2 pack and unpack instructions work within lanes;
+    // lane 0 holds pixels 0-15 and lane 1 pixels 16-31 throughout.
+    __m256i r8 = _mm256_unpacklo_epi8(_mm256_packus_epi16(_mm256_add_epi16(yE, r), _mm256_add_epi16(yE, r)), _mm256_packus_epi16(_mm256_add_epi16(yO, r), _mm256_add_epi16(yO, r)));
+    __m256i g8 = _mm256_unpacklo_epi8(_mm256_packus_epi16(_mm256_add_epi16(yE, g), _mm256_add_epi16(yE, g)), _mm256_packus_epi16(_mm256_add_epi16(yO, g), _mm256_add_epi16(yO, g)));
+    __m256i b8 = _mm256_unpacklo_epi8(_mm256_packus_epi16(_mm256_add_epi16(yE, b), _mm256_add_epi16(yE, b)), _mm256_packus_epi16(_mm256_add_epi16(yO, b), _mm256_add_epi16(yO, b)));
+    __m256i rgLo = _mm256_unpacklo_epi8(r8, g8), rgHi = _mm256_unpackhi_epi8(r8, g8);
+    __m256i baLo = _mm256_unpacklo_epi8(b8, a), baHi = _mm256_unpackhi_epi8(b8, a);
+    __m256i p0 = _mm256_unpacklo_epi16(rgLo, baLo); // Pixels 0-3, 16-19.
+    __m256i p1 = _mm256_unpackhi_epi16(rgLo, baLo); // Pixels 4-7, 20-23.
+    __m256i p2 = _mm256_unpacklo_epi16(rgHi, baHi); // Pixels 8-11, 24-27.
+    __m256i p3 = _mm256_unpackhi_epi16(rgHi, baHi); // Pixels 12-15, 28-31.
+    _mm256_storeu_si256((__m256i *)(out +  0), _mm256_permute2x128_si256(p0, p1, 0x20));
+    _mm256_storeu_si256((__m256i *)(out + 32), _mm256_permute2x128_si256(p2, p3, 0x20));
+    _mm256_storeu_si256((__m256i *)(out + 64), _mm256_permute2x128_si256(p0, p1, 0x31));
+    _mm256_storeu_si256((__m256i *)(out + 96), _mm256_permute2x128_si256(p2, p3, 0x31));
+}
+
+X86_TARGET("avx2")
+static int color_convert_420bi_rows_avx2(const unsigned char *pY0, const unsigned char *pY1, const unsigned char *pC, int crFirst,
+                                         int width, unsigned char *out0, unsigned char *out1)
+{
+    const __m256i lowBytes = _mm256_set1_epi16(0x00ff);
+    const __m256i bias = _mm256_set1_epi16(128);
+    int x = 0;
+    
+    for (; x + 32 <= width; x += 32) {
+        __m256i c = _mm256_loadu_si256((const __m256i *)(pC + x));
+        __m256i c0 = _mm256_sub_epi16(_mm256_and_si256(c, lowBytes), bias);
+        __m256i c1 = _mm256_sub_epi16(_mm256_srli_epi16(c, 8), bias);
+        __m256i cb = (crFirst ? c1 : c0), cr = (crFirst ? c0 : c1);
+        __m256i r = _mm256_srai_epi16(_mm256_mullo_epi16(cr, _mm256_set1_epi16(179)), 7);
+        __m256i g = _mm256_srai_epi16(_mm256_add_epi16(_mm256_mullo_epi16(cb, _mm256_set1_epi16(-44)), _mm256_mullo_epi16(cr, _mm256_set1_epi16(-91))), 7);
+        __m256i b = _mm256_srai_epi16(_mm256_mullo_epi16(cb, _mm256_set1_epi16(227)), 7);
+        color_convert_420_row_avx2(pY0 + x, r, g, b, out0 + x*4);
+        color_convert_420_row_avx2(pY1 + x, r, g, b, out1 + x*4);
+    }
+    return x;
+}
+
+void color_convert_x86_420bi(int level, const unsigned char *pY, const unsigned char *pC, int crFirst,
+                             int width, int height, unsigned int *dst)
+{
+    for (int y = 0; y < height; y += 2) {
+        const unsigned char *pY0 = pY + y*width, *pY1 = pY0 + width;
+        const unsigned char *pCRow = pC + (y >> 1)*width;
+        unsigned char *out0 = (unsigned char *)(dst + y*width), *out1 = out0 + width*4;
+        int x = 0;
+        
+        if (level >= COLOR_CONVERSION_X86_AVX2) x = color_convert_420bi_rows_avx2(pY0, pY1, pCRow, crFirst, width, out0, out1);
+        if (level >= COLOR_CONVERSION_X86_SSE2) x += color_convert_420bi_rows_sse2(pY0 + x, pY1 + x, pCRow + x, crFirst, width - x, out0 + x*4, out1 + x*4);
+        for (; x < width; x += 2) {
+            int Cb = pCRow[x + (crFirst ? 1 : 0)] - 128;
+            int Cr = pCRow[x + (crFirst ? 0 : 1)] - 128;
+            color_convert_ycc_scalar(pY0[x], pY0[x + 1], Cb, Cr, out0 + x*4);
+            color_convert_ycc_scalar(pY1[x], pY1[x + 1], Cb, Cr, out1 + x*4);
+        }
+    }
+}
+
+//
+// Packed 4:2:2.
+//
+
+// 8 pixels (16 bytes) to 8 words each of R, G and B.
+X86_TARGET("sse2")
+static inline void color_convert_422_8_sse2(const unsigned char *src, int yFirst, __m128i *r, __m128i *g, __m128i *b)
+{
+    const __m128i lowBytes = _mm_set1_epi16(0x00ff);
+    __m128i v = _mm_loadu_si128((const __m128i *)src);
+    __m128i y = (yFirst ? _mm_and_si128(v, lowBytes) : _mm_srli_epi16(v, 8));
+    __m128i c = _mm_sub_epi16((yFirst ? _mm_srli_epi16(v, 8) : _mm_and_si128(v, lowBytes)), _mm_set1_epi16(128)); // Cb0 Cr0 Cb1 Cr1 ...
+    __m128i cb = _mm_shufflehi_epi16(_mm_shufflelo_epi16(c, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 2, 0, 0));
+    __m128i cr = _mm_shufflehi_epi16(_mm_shufflelo_epi16(c, _MM_SHUFFLE(3, 3, 1, 1)), _MM_SHUFFLE(3, 3, 1, 1));
+    color_convert_chroma_sse2(cb, cr, r, g, b);
+    *r = _mm_add_epi16(y, *r);
+    *g = _mm_add_epi16(y, *g);
+    *b = _mm_add_epi16(y, *b);
+}
+
+X86_TARGET("sse2")
+static int color_convert_422_sse2(const unsigned char *src, int yFirst, unsigned char *out, int count)
+{
+    int x = 0;
+    
+    for (; x + 16 <= count; x += 16) {
+        __m128i r0, g0, b0, r1, g1, b1;
+        color_convert_422_8_sse2(src + x*2, yFirst, &r0, &g0, &b0);
+        color_convert_422_8_sse2(src + x*2 + 16, yFirst, &r1, &g1, &b1);
+        color_convert_store_rgba_sse2(_mm_packus_epi16(r0, r1), _mm_packus_epi16(g0, g1), _mm_packus_epi16(b0, b1), out + x*4);
+    }
+    return x;
+}
+
+void color_convert_x86_422(int level, const unsigned char *src, int yFirst, unsigned int *dst, int count)
+{
+    unsigned char *out = (unsigned char *)dst;
+    int x = 0;
+    
+    if (level >= COLOR_CONVERSION_X86_SSE2) x = color_convert_422_sse2(src, yFirst, out, count);
+    for (; x < count; x += 2) {
+        const unsigned char *p = src + x*2;
+        if (yFirst) color_convert_ycc_scalar(p[0], p[2], p[1] - 128, p[3] - 128, out + x*4);
+        else        color_convert_ycc_scalar(p[1], p[3], p[0] - 128, p[2] - 128, out + x*4);
+    }
+}
+
+#endif // HAVE_X86_SIMD
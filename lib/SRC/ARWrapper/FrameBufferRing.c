@@ -0,0 +1,208 @@
+/*
+ *  FrameBufferRing.c
+ *  ARToolKit5
+ *
+ *  This file is part of ARToolKit.
+ *
+ *  ARToolKit is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ARToolKit is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ARToolKit.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  As a special exception, the copyright holders of this library give you
+ *  permission to link this library with independent modules to produce an
+ *  executable, regardless of the license terms of these independent modules, and to
+ *  copy and distribute the resulting executable under terms of your choice,
+ *  provided that you also meet, for each linked independent module, the terms and
+ *  conditions of the license of that module. An independent module is a module
+ *  which is neither derived from nor based on this library. If you modify this
+ *  library, you may extend this exception to your version of the library, but you
+ *  are not obligated to do so. If you do not wish to do so, delete this exception
+ *  statement from your version.
+ *
+ *  Copyright 2015 Daqri, LLC.
+ *
+ */
+
+#include <ARWrapper/FrameBufferRing.h>
+#include <stdlib.h>
+
+#if !defined(_WINRT)
+#  include <pthread.h>
+#else
+#  define pthread_mutex_t               CRITICAL_SECTION
+#  define pthread_mutex_init(pm, a)     InitializeCriticalSectionEx(pm, 4000, CRITICAL_SECTION_NO_DEBUG_INFO)
+#  define pthread_mutex_lock(pm)        EnterCriticalSection(pm)
+#  define pthread_mutex_unlock(pm)      LeaveCriticalSection(pm)
+#  define pthread_mutex_destroy(pm)     DeleteCriticalSection(pm)
+#endif
+
+struct _FrameBufferRing {
+    ARUint8        **buff;
+    int             *refCount;      // References held on each buffer. 0 = free.
+    int              bufferCount;
+    int              bufferSize;
+    int              latest;        // Index of the latest published buffer, or -1.
+    pthread_mutex_t  lock;
+};
+
+static int frameBufferRingFind(FrameBufferRing *ring, ARUint8 *buff)
+{
+    int i;
+    
+    for (i = 0; i < ring->bufferCount; i++) {
+        if (ring->buff[i] == buff) return i;
+    }
+    return -1;
+}
+
+FrameBufferRing *frameBufferRingCreate(int bufferSize, int bufferCount)
+{
+    FrameBufferRing *ring;
+    int              i;
+    
+    if (bufferSize <= 0 || bufferCount < 1) {
+        ARLOGe("frameBufferRingCreate(): Error: bad bufferSize %d or bufferCount %d.\n", bufferSize, bufferCount);
+        return (NULL);
+    }
+    
+    arMallocClear(ring, FrameBufferRing, 1);
+    arMallocClear(ring->buff, ARUint8 *, bufferCount);
+    arMallocClear(ring->refCount, int, bufferCount);
+    for (i = 0; i < bufferCount; i++) {
+        ring->buff[i] = (ARUint8 *)malloc(bufferSize);
+        if (!ring->buff[i]) {
+            ARLOGe("Out of memory!!\n");
+            ring->bufferCount = i;
+            frameBufferRingDelete(&ring);
+            return (NULL);
+        }
+    }
+    ring->bufferCount = bufferCount;
+    ring->bufferSize = bufferSize;
+    ring->latest = -1;
+    pthread_mutex_init(&(ring->lock), NULL);
+    
+    return (ring);
+}
+
+int frameBufferRingDelete(FrameBufferRing **ring_p)
+{
+    int i;
+    
+    if (!ring_p || !*ring_p) return (-1);
+    
+    for (i = 0; i < (*ring_p)->bufferCount; i++) {
+        if ((*ring_p)->refCount[i] > 0 && i != (*ring_p)->latest) {
+            ARLOGw("frameBufferRingDelete(): Warning: buffer %d still in use.\n", i);
+        }
+        free((*ring_p)->buff[i]);
+    }
+    if ((*ring_p)->bufferSize) pthread_mutex_destroy(&((*ring_p)->lock));
+    free((*ring_p)->buff);
+    free((*ring_p)->refCount);
+    free(*ring_p);
+    *ring_p = NULL;
+    
+    return (0);
+}
+
+int frameBufferRingGetBufferSize(FrameBufferRing *ring)
+{
+    if (!ring) return (0);
+    return (ring->bufferSize);
+}
+
+ARUint8 *frameBufferRingAcquire(FrameBufferRing *ring)
+{
+    ARUint8 *buff = NULL;
+    int      i;
+    
+    if (!ring) return (NULL);
+    
+    pthread_mutex_lock(&(ring->lock));
+    for (i = 0; i < ring->bufferCount; i++) {
+        if (ring->refCount[i] == 0) {
+            ring->refCount[i] = 1;
+            buff = ring->buff[i];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&(ring->lock));
+    
+    return (buff);
+}
+
+int frameBufferRingPublish(FrameBufferRing *ring, ARUint8 *buff)
+{
+    int i;
+    
+    if (!ring || !buff) return (-1);
+    
+    pthread_mutex_lock(&(ring->lock));
+    i = frameBufferRingFind(ring, buff);
+    if (i < 0 || ring->refCount[i] == 0) {
+        pthread_mutex_unlock(&(ring->lock));
+        ARLOGe("frameBufferRingPublish(): Error: buffer was not acquired from this ring.\n");
+        return (-1);
+    }
+    // The ring's own reference moves from the old latest frame to the new one.
+    if (ring->latest >= 0) ring->refCount[ring->latest]--;
+    ring->latest = i;
+    pthread_mutex_unlock(&(ring->lock));
+    
+    return (0);
+}
+
+ARUint8 *frameBufferRingGetLatest(FrameBufferRing *ring)
+{
+    ARUint8 *buff;
+    
+    if (!ring) return (NULL);
+    
+    pthread_mutex_lock(&(ring->lock));
+    buff = (ring->latest >= 0 ? ring->buff[ring->latest] : NULL);
+    pthread_mutex_unlock(&(ring->lock));
+    
+    return (buff);
+}
+
+int frameBufferRingRetain(FrameBufferRing *ring, ARUint8 *buff)
+{
+    int i;
+    
+    if (!ring || !buff) return (-1);
+    
+    pthread_mutex_lock(&(ring->lock));
+    i = frameBufferRingFind(ring, buff);
+    if (i >= 0) ring->refCount[i]++;
+    pthread_mutex_unlock(&(ring->lock));
+    
+    return (i < 0 ? -1 : 0);
+}
+
+int frameBufferRingRelease(FrameBufferRing *ring, ARUint8 *buff)
+{
+    int i;
+    
+    if (!ring || !buff) return (-1);
+    
+    pthread_mutex_lock(&(ring->lock));
+    i = frameBufferRingFind(ring, buff);
+    if (i >= 0 && ring->refCount[i] > 0) ring->refCount[i]--;
+    pthread_mutex_unlock(&(ring->lock));
+    
+    if (i < 0) {
+        ARLOGe("frameBufferRingRelease(): Error: buffer is not from this ring.\n");
+        return (-1);
+    }
+    return (0);
+}
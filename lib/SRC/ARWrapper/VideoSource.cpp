@@ -87,6 +87,7 @@ VideoSource::VideoSource() :
     frameBuffer(NULL),
     frameBuffer2(NULL),
     frameStamp(0),
+    frameRing(NULL),
     m_error(ARW_ERROR_NONE)
 {
         
@@ -109,6 +110,7 @@ VideoSource::~VideoSource() {
 		cameraParamBuffer = NULL;
 	}
 
+    if (frameRing) frameBufferRingDelete(&frameRing);
 }
 
 void VideoSource::setError(int error)
@@ -185,6 +187,40 @@ int VideoSource::getFrameStamp() {
 	return frameStamp;
 }
 
+ARUint8* VideoSource::retainFrame() {
+    
+    if (!frameBuffer) return NULL;
+    
+    // Frames captured into the ring are shared as they are.
+    if (frameRing && frameBufferRingRetain(frameRing, frameBuffer) == 0) return frameBuffer;
+    
+    // Otherwise the frame belongs to the video library and may be reused on the next
+    // capture, so keep a copy.
+    int frameSize = videoWidth * videoHeight * arUtilGetPixelSize(pixelFormat);
+    if (!frameRing) {
+        frameRing = frameBufferRingCreate(frameSize, FRAME_BUFFER_RING_DEFAULT_COUNT);
+        if (!frameRing) return NULL;
+    } else if (frameBufferRingGetBufferSize(frameRing) < frameSize) {
+        ARController::logv(AR_LOG_LEVEL_ERROR, "VideoSource::retainFrame(): Error: frame size changed.");
+        return NULL;
+    }
+    ARUint8 *frame = frameBufferRingAcquire(frameRing);
+    if (!frame) {
+        ARController::logv(AR_LOG_LEVEL_WARN, "VideoSource::retainFrame(): Warning: no free frame buffer.");
+        return NULL;
+    }
+    memcpy(frame, frameBuffer, frameSize);
+    return frame;
+}
+
+void VideoSource::releaseFrame(ARUint8* frame) {
+    if (frameRing && frame) frameBufferRingRelease(frameRing, frame);
+}
+
+FrameBufferRing* VideoSource::getFrameRing() {
+    return frameRing;
+}
+
 bool VideoSource::updateTexture(Color* buffer) {
 	
 	static int lastFrameStamp = 0;
@@ -728,6 +764,23 @@ bool VideoSource::updateTexture32(uint32_t *buffer) {
     if (lastFrameStamp == frameStamp) return false;
     
     int pixelSize = arUtilGetPixelSize(pixelFormat);
+#ifdef HAVE_X86_SIMD
+    int simdLevel = color_convert_x86_level();
+    // Packed RGB in any order, as component offsets of R, G and B.
+    int rgbOffsets[3] = {-1, -1, -1};
+    switch (pixelFormat) {
+        case AR_PIXEL_FORMAT_BGRA: case AR_PIXEL_FORMAT_BGR: rgbOffsets[0] = 2; rgbOffsets[1] = 1; rgbOffsets[2] = 0; break;
+        case AR_PIXEL_FORMAT_RGBA: case AR_PIXEL_FORMAT_RGB: rgbOffsets[0] = 0; rgbOffsets[1] = 1; rgbOffsets[2] = 2; break;
+        case AR_PIXEL_FORMAT_ARGB: rgbOffsets[0] = 1; rgbOffsets[1] = 2; rgbOffsets[2] = 3; break;
+        case AR_PIXEL_FORMAT_ABGR: rgbOffsets[0] = 3; rgbOffsets[1] = 2; rgbOffsets[2] = 1; break;
+        default: break;
+    }
+    if (rgbOffsets[0] != -1 && simdLevel >= COLOR_CONVERSION_X86_SSSE3) {
+        color_convert_x86_rgb(simdLevel, frameBuffer, pixelSize, rgbOffsets[0], rgbOffsets[1], rgbOffsets[2], buffer, videoWidth*videoHeight);
+        lastFrameStamp = frameStamp;
+        return true;
+    }
+#endif
     switch (pixelFormat) {
         case AR_PIXEL_FORMAT_BGRA:
         case AR_PIXEL_FORMAT_BGR:
@@ -806,8 +859,51 @@ bool VideoSource::updateTexture32(uint32_t *buffer) {
                 }
             }
             break;
+        case AR_PIXEL_FORMAT_2vuy:
+        case AR_PIXEL_FORMAT_yuvs:
+        {
+            bool yFirst = (pixelFormat == AR_PIXEL_FORMAT_yuvs);
+#ifdef HAVE_X86_SIMD
+            if (simdLevel >= COLOR_CONVERSION_X86_SSE2 && videoWidth % 2 == 0) {
+                color_convert_x86_422(simdLevel, frameBuffer, yFirst, buffer, videoWidth*videoHeight);
+                break;
+            }
+#endif
+            int wd2 = videoWidth >> 1;
+            for (int y = 0; y < videoHeight; y++) {
+                ARUint8 *inp = &frameBuffer[videoWidth*y*2];
+                uint8_t *outp = (uint8_t *)&buffer[videoWidth*y];
+                for (int x = 0; x < wd2; x++) { // Groups of two pixels.
+                    int16_t Cb, Cr;
+                    int16_t Y0, Y1, R, G, B;
+                    if (yFirst) {
+                        Y0 = *(inp++); Cb = ((int16_t)(*(inp++))) - 128; Y1 = *(inp++); Cr = ((int16_t)(*(inp++))) - 128;
+                    } else {
+                        Cb = ((int16_t)(*(inp++))) - 128; Y0 = *(inp++); Cr = ((int16_t)(*(inp++))) - 128; Y1 = *(inp++);
+                    }
+                    R = (        179*Cr) >> 7;
+                    G = (-44*Cb - 91*Cr) >> 7;
+                    B = (227*Cb        ) >> 7;
+                    *(outp++) = (uint8_t)CLAMP(Y0 + R, 0, 255);
+                    *(outp++) = (uint8_t)CLAMP(Y0 + G, 0, 255);
+                    *(outp++) = (uint8_t)CLAMP(Y0 + B, 0, 255);
+                    *(outp++) = 255;
+                    *(outp++) = (uint8_t)CLAMP(Y1 + R, 0, 255);
+                    *(outp++) = (uint8_t)CLAMP(Y1 + G, 0, 255);
+                    *(outp++) = (uint8_t)CLAMP(Y1 + B, 0, 255);
+                    *(outp++) = 255;
+                }
+            }
+        }
+            break;
         case AR_PIXEL_FORMAT_420f:
         {
+#ifdef HAVE_X86_SIMD
+            if (simdLevel >= COLOR_CONVERSION_X86_SSE2 && videoWidth % 2 == 0 && videoHeight % 2 == 0) {
+                color_convert_x86_420bi(simdLevel, frameBuffer, frameBuffer2, 0, videoWidth, videoHeight, buffer);
+                break;
+            }
+#endif
 #if defined(HAVE_ARM_NEON) || defined(HAVE_ARM64_NEON)
             if (fastPath()) {
                 YCbCr422BiPlanarToRGBA_ARM_neon_asm((uint8_t *)buffer, frameBuffer, frameBuffer2, videoWidth, videoHeight);
@@ -841,10 +937,10 @@ bool VideoSource::updateTexture32(uint32_t *buffer) {
                         *(outp0++) = G0;
                         *(outp0++) = B0;
                         *(outp0++) = 255;
-                        *(outp1++) = R1;
-                        *(outp1++) = G1;
-                        *(outp1++) = B1;
-                        *(outp1++) = 255;
+                        *(outp0++) = R1;
+                        *(outp0++) = G1;
+                        *(outp0++) = B1;
+                        *(outp0++) = 255;
                         Y0 = *(pY1++);
                         Y1 = *(pY1++);
                         R0 = (uint8_t)CLAMP(Y0 + R, 0, 255);
@@ -853,10 +949,10 @@ bool VideoSource::updateTexture32(uint32_t *buffer) {
                         G1 = (uint8_t)CLAMP(Y1 + G, 0, 255);
                         B0 = (uint8_t)CLAMP(Y0 + B, 0, 255);
                         B1 = (uint8_t)CLAMP(Y1 + B, 0, 255);
-                        *(outp0++) = R0;
-                        *(outp0++) = G0;
-                        *(outp0++) = B0;
-                        *(outp0++) = 255;
+                        *(outp1++) = R0;
+                        *(outp1++) = G0;
+                        *(outp1++) = B0;
+                        *(outp1++) = 255;
                         *(outp1++) = R1;
                         *(outp1++) = G1;
                         *(outp1++) = B1;
@@ -874,6 +970,12 @@ bool VideoSource::updateTexture32(uint32_t *buffer) {
             break;
         case AR_PIXEL_FORMAT_NV21:
         {
+#ifdef HAVE_X86_SIMD
+            if (simdLevel >= COLOR_CONVERSION_X86_SSE2 && videoWidth % 2 == 0 && videoHeight % 2 == 0) {
+                color_convert_x86_420bi(simdLevel, frameBuffer, frameBuffer2, 1, videoWidth, videoHeight, buffer);
+                break;
+            }
+#endif
 #if defined(HAVE_ARM_NEON) || defined(HAVE_ARM64_NEON)
             if (fastPath()) {
                 YCrCb422BiPlanarToRGBA_ARM_neon_asm((uint8_t *)buffer, frameBuffer, frameBuffer2, videoWidth, videoHeight);
@@ -908,10 +1010,10 @@ bool VideoSource::updateTexture32(uint32_t *buffer) {
                         *(outp0++) = G0;
                         *(outp0++) = B0;
                         *(outp0++) = 255;
-                        *(outp1++) = R1;
-                        *(outp1++) = G1;
-                        *(outp1++) = B1;
-                        *(outp1++) = 255;
+                        *(outp0++) = R1;
+                        *(outp0++) = G1;
+                        *(outp0++) = B1;
+                        *(outp0++) = 255;
                         Y0 = *(pY1++);
                         Y1 = *(pY1++);
                         R0 = (uint8_t)CLAMP(Y0 + R, 0, 255);
@@ -920,10 +1022,10 @@ bool VideoSource::updateTexture32(uint32_t *buffer) {
                         G1 = (uint8_t)CLAMP(Y1 + G, 0, 255);
                         B0 = (uint8_t)CLAMP(Y0 + B, 0, 255);
                         B1 = (uint8_t)CLAMP(Y1 + B, 0, 255);
-                        *(outp0++) = R0;
-                        *(outp0++) = G0;
-                        *(outp0++) = B0;
-                        *(outp0++) = 255;
+                        *(outp1++) = R0;
+                        *(outp1++) = G0;
+                        *(outp1++) = B0;
+                        *(outp1++) = 255;
                         *(outp1++) = R1;
                         *(outp1++) = G1;
                         *(outp1++) = B1;
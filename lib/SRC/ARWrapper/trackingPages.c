@@ -0,0 +1,238 @@
+/*
+ *  trackingPages.c
+ *  ARToolKit5
+ *
+ *  This file is part of ARToolKit.
+ *
+ *  ARToolKit is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ARToolKit is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ARToolKit.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  As a special exception, the copyright holders of this library give you
+ *  permission to link this library with independent modules to produce an
+ *  executable, regardless of the license terms of these independent modules, and to
+ *  copy and distribute the resulting executable under terms of your choice,
+ *  provided that you also meet, for each linked independent module, the terms and
+ *  conditions of the license of that module. An independent module is a module
+ *  which is neither derived from nor based on this library. If you modify this
+ *  library, you may extend this exception to your version of the library, but you
+ *  are not obligated to do so. If you do not wish to do so, delete this exception
+ *  statement from your version.
+ *
+ *  Copyright 2015 Daqri, LLC.
+ *
+ */
+
+#include "trackingPages.h"
+
+#if HAVE_NFT
+
+#include <stdio.h>
+#include <stdlib.h>
+#if !defined(_WINRT)
+#  include <pthread.h>
+#else
+#  define pthread_mutex_t               CRITICAL_SECTION
+#  define pthread_mutex_init(pm, a)     InitializeCriticalSectionEx(pm, 4000, CRITICAL_SECTION_NO_DEBUG_INFO)
+#  define pthread_mutex_lock(pm)        EnterCriticalSection(pm)
+#  define pthread_mutex_unlock(pm)      LeaveCriticalSection(pm)
+#  define pthread_mutex_destroy(pm)     DeleteCriticalSection(pm)
+#endif
+
+typedef struct {
+    TrackingPagesHandle    *parent;
+    AR2HandleT             *ar2Handle;      // This worker's tracking handle.
+    THREAD_HANDLE_T        *threadHandle;
+} TrackingPagesWorker;
+
+struct _TrackingPagesHandle {
+    TrackingPagesWorker    *worker;
+    int                     workerNum;
+    AR2HandleT             *ar2Handle;      // The calling thread's tracking handle.
+    // The current batch. Valid between the start and end of trackingPagesRun().
+    AR2SurfaceSetT        **surfaceSet;
+    int                     num;
+    ARUint8                *image;
+    float                 (*trans)[3][4];
+    float                  *err;
+    int                    *ret;
+    int                     next;           // Index of the next page to be claimed by a worker.
+    pthread_mutex_t         lock;
+};
+
+static void *trackingPagesMain( THREAD_HANDLE_T *threadHandle );
+
+static AR2HandleT *trackingPagesCreateAR2Handle( AR2HandleT *ar2Handle, int threadNum )
+{
+    AR2HandleT *h;
+    
+    if (ar2Handle->cparamLT) h = ar2CreateHandle(ar2Handle->cparamLT, ar2Handle->pixFormat, threadNum);
+    else                     h = ar2CreateHandleHomography(ar2Handle->xsize, ar2Handle->ysize, ar2Handle->pixFormat, threadNum);
+    if (!h) {
+        ARLOGe("trackingPagesInit(): Error: ar2CreateHandle.\n");
+        return (NULL);
+    }
+    ar2SetTrackingMode(h, ar2Handle->trackingMode);
+    return (h);
+}
+
+static void trackingPagesCopySettings( AR2HandleT *to, AR2HandleT *from )
+{
+    to->searchSize       = from->searchSize;
+    to->templateSize1    = from->templateSize1;
+    to->templateSize2    = from->templateSize2;
+    to->searchFeatureNum = from->searchFeatureNum;
+    to->simThresh        = from->simThresh;
+    to->trackingThresh   = from->trackingThresh;
+#if AR2_CAPABLE_ADAPTIVE_TEMPLATE
+    to->blurMethod       = from->blurMethod;
+#endif
+}
+
+// Claims and tracks pages from the current batch until none are left.
+static void trackingPagesWork( TrackingPagesHandle *handle, AR2HandleT *ar2Handle )
+{
+    int i;
+    
+    for (;;) {
+        pthread_mutex_lock(&handle->lock);
+        i = handle->next++;
+        pthread_mutex_unlock(&handle->lock);
+        if (i >= handle->num) break;
+        handle->ret[i] = ar2Tracking(ar2Handle, handle->surfaceSet[i], handle->image, handle->trans[i], &handle->err[i]);
+    }
+}
+
+TrackingPagesHandle *trackingPagesInit( AR2HandleT *ar2Handle, int workerNum, int threadNum )
+{
+    TrackingPagesHandle *handle;
+    int                  i;
+    
+    if (!ar2Handle || workerNum < 1) {
+        ARLOGe("trackingPagesInit(): Error: NULL ar2Handle or bad workerNum %d.\n", workerNum);
+        return (NULL);
+    }
+    
+    arMallocClear(handle, TrackingPagesHandle, 1);
+    arMallocClear(handle->worker, TrackingPagesWorker, workerNum);
+    pthread_mutex_init(&handle->lock, NULL);
+    
+    if (!(handle->ar2Handle = trackingPagesCreateAR2Handle(ar2Handle, threadNum))) {
+        trackingPagesQuit(&handle);
+        return (NULL);
+    }
+    for (i = 0; i < workerNum; i++) {
+        handle->worker[i].parent = handle;
+        if (!(handle->worker[i].ar2Handle = trackingPagesCreateAR2Handle(ar2Handle, threadNum))) break;
+        handle->worker[i].threadHandle = threadInit(i, &(handle->worker[i]), trackingPagesMain);
+        if (!handle->worker[i].threadHandle) {
+            ARLOGe("trackingPagesInit(): Error: threadInit.\n");
+            ar2DeleteHandle(&(handle->worker[i].ar2Handle));
+            break;
+        }
+        handle->workerNum++;
+    }
+    if (handle->workerNum < workerNum) {
+        trackingPagesQuit(&handle);
+        return (NULL);
+    }
+    
+    return (handle);
+}
+
+int trackingPagesRun( TrackingPagesHandle *handle, AR2HandleT *ar2Handle, AR2SurfaceSetT *surfaceSet[], int num,
+                      ARUint8 *image, float trans[][3][4], float err[], int ret[] )
+{
+    int         started;
+    int         i;
+    
+    if (!handle || !ar2Handle || !surfaceSet || !image || !trans || !err || !ret) {
+        ARLOGe("trackingPagesRun(): Error: NULL parameter.\n");
+        return (-1);
+    }
+    if (num <= 0) return (0);
+    
+    handle->surfaceSet = surfaceSet;
+    handle->num = num;
+    handle->image = image;
+    handle->trans = trans;
+    handle->err = err;
+    handle->ret = ret;
+    handle->next = 0;
+    
+    // No more workers than there are pages beyond the one this thread will take.
+    started = (num - 1 < handle->workerNum ? num - 1 : handle->workerNum);
+    for (i = 0; i < started; i++) {
+        trackingPagesCopySettings(handle->worker[i].ar2Handle, ar2Handle);
+        threadStartSignal(handle->worker[i].threadHandle);
+    }
+    
+    // The calling thread tracks with the pool's own handle, whose template matching threads
+    // are its share of the CPUs, rather than with ar2Handle, which may use all of them.
+    trackingPagesCopySettings(handle->ar2Handle, ar2Handle);
+    trackingPagesWork(handle, handle->ar2Handle);
+    
+    for (i = 0; i < started; i++) {
+        threadEndWait(handle->worker[i].threadHandle);
+    }
+    
+    handle->surfaceSet = NULL;
+    handle->image = NULL;
+    handle->trans = NULL;
+    handle->err = NULL;
+    handle->ret = NULL;
+    handle->num = 0;
+    
+    return (0);
+}
+
+int trackingPagesQuit( TrackingPagesHandle **handle_p )
+{
+    TrackingPagesHandle *handle;
+    int                  i;
+    
+    if (!handle_p) {
+        ARLOGe("trackingPagesQuit(): Error: NULL handle_p.\n");
+        return (-1);
+    }
+    if (!*handle_p) return (0);
+    handle = *handle_p;
+    
+    for (i = 0; i < handle->workerNum; i++) {
+        threadWaitQuit(handle->worker[i].threadHandle);
+        threadFree(&(handle->worker[i].threadHandle));
+        ar2DeleteHandle(&(handle->worker[i].ar2Handle));
+    }
+    if (handle->ar2Handle) ar2DeleteHandle(&(handle->ar2Handle));
+    pthread_mutex_destroy(&handle->lock);
+    free(handle->worker);
+    free(handle);
+    *handle_p = NULL;
+    
+    return (0);
+}
+
+static void *trackingPagesMain( THREAD_HANDLE_T *threadHandle )
+{
+    TrackingPagesWorker *worker;
+    
+    worker = (TrackingPagesWorker *)threadGetArg(threadHandle);
+    
+    while (threadStartWait(threadHandle) == 0) {
+        trackingPagesWork(worker->parent, worker->ar2Handle);
+        threadEndSignal(threadHandle);
+    }
+    
+    return (NULL);
+}
+
+#endif // HAVE_NFT
@@ -0,0 +1,74 @@
+/*
+ *  trackingPages.h
+ *  ARToolKit5
+ *
+ *  This file is part of ARToolKit.
+ *
+ *  ARToolKit is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ARToolKit is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ARToolKit.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  As a special exception, the copyright holders of this library give you
+ *  permission to link this library with independent modules to produce an
+ *  executable, regardless of the license terms of these independent modules, and to
+ *  copy and distribute the resulting executable under terms of your choice,
+ *  provided that you also meet, for each linked independent module, the terms and
+ *  conditions of the license of that module. An independent module is a module
+ *  which is neither derived from nor based on this library. If you modify this
+ *  library, you may extend this exception to your version of the library, but you
+ *  are not obligated to do so. If you do not wish to do so, delete this exception
+ *  statement from your version.
+ *
+ *  Copyright 2015 Daqri, LLC.
+ *
+ */
+
+#ifndef TRACKING_PAGES_H
+#define TRACKING_PAGES_H
+
+#include <ARWrapper/Platform.h>
+
+#if HAVE_NFT
+
+#include <thread_sub.h>
+#include <AR2/tracking.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Tracks several NFT pages in one batch. Each page is tracked in full (by ar2Tracking) by
+// one of a pool of workers, each with its own AR2HandleT, so that the cost of a frame is
+// bounded by the slowest page rather than the sum of all pages. The calling thread takes
+// part too, with a handle of its own from the pool.
+typedef struct _TrackingPagesHandle TrackingPagesHandle;
+
+// Creates workerNum workers, plus a handle for the calling thread, with tracking handles matching
+// ar2Handle's camera parameters, pixel format and tracking mode, each using threadNum threads for
+// template matching.
+TrackingPagesHandle *trackingPagesInit( AR2HandleT *ar2Handle, int workerNum, int threadNum );
+
+// Runs ar2Tracking() on each of the num surface sets in image, filling trans[i], err[i] and
+// ret[i] as ar2Tracking() would for surfaceSet[i]. The pool's handles take their tracking
+// settings from ar2Handle, which is not itself used for tracking. Returns once all pages are done.
+int trackingPagesRun( TrackingPagesHandle *handle, AR2HandleT *ar2Handle, AR2SurfaceSetT *surfaceSet[], int num,
+                      ARUint8 *image, float trans[][3][4], float err[], int ret[] );
+
+int trackingPagesQuit( TrackingPagesHandle **handle_p );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HAVE_NFT
+
+#endif // !TRACKING_PAGES_H
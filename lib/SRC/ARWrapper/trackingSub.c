@@ -47,6 +47,8 @@
 typedef struct {
     KpmHandle              *kpmHandle;      // KPM-related data.
     ARUint8                *imagePtr;       // Pointer to image being tracked.
+    FrameBufferRing        *imageRing;      // Ring holding imagePtr, released once matched, or NULL if imagePtr is imageBuff.
+    ARUint8                *imageBuff;      // Copy of the image made by trackingInitStart.
     int                     imageSize;      // Bytes per image.
     float                   trans[3][4];    // Transform containing pose of tracked image.
     int                     page;           // Assigned page number of tracked image.
@@ -69,7 +71,9 @@ int trackingInitQuit( THREAD_HANDLE_T **threadHandle_p )
     threadWaitQuit( *threadHandle_p );
     trackingInitHandle = (TrackingInitHandle *)threadGetArg(*threadHandle_p);
     if (trackingInitHandle) {
-        free( trackingInitHandle->imagePtr );
+        // A frame handed over just before quitting may not have been matched.
+        if (trackingInitHandle->imageRing) frameBufferRingRelease( trackingInitHandle->imageRing, trackingInitHandle->imagePtr );
+        free( trackingInitHandle->imageBuff );
         free( trackingInitHandle );
     }
     threadFree( threadHandle_p );
@@ -90,7 +94,9 @@ THREAD_HANDLE_T *trackingInitInit( KpmHandle *kpmHandle )
     if( trackingInitHandle == NULL ) return NULL;
     trackingInitHandle->kpmHandle = kpmHandle;
     trackingInitHandle->imageSize = kpmHandleGetXSize(kpmHandle) * kpmHandleGetYSize(kpmHandle) * arUtilGetPixelSize(kpmHandleGetPixelFormat(kpmHandle));
-    trackingInitHandle->imagePtr  = (ARUint8 *)malloc(trackingInitHandle->imageSize);
+    trackingInitHandle->imagePtr  = NULL;
+    trackingInitHandle->imageRing = NULL;
+    trackingInitHandle->imageBuff = NULL; // Allocated on first use by trackingInitStart.
     trackingInitHandle->flag      = 0;
 
     threadHandle = threadInit(0, trackingInitHandle, trackingInitMain);
@@ -111,7 +117,38 @@ int trackingInitStart( THREAD_HANDLE_T *threadHandle, ARUint8 *imagePtr )
         ARLOGe("trackingInitStart(): Error: NULL trackingInitHandle.\n");
         return (-1);
     }
-    memcpy( trackingInitHandle->imagePtr, imagePtr, trackingInitHandle->imageSize );
+    if (!trackingInitHandle->imageBuff) {
+        trackingInitHandle->imageBuff = (ARUint8 *)malloc(trackingInitHandle->imageSize);
+        if (!trackingInitHandle->imageBuff) {
+            ARLOGe("Out of memory!!\n");
+            return (-1);
+        }
+    }
+    memcpy( trackingInitHandle->imageBuff, imagePtr, trackingInitHandle->imageSize );
+    trackingInitHandle->imagePtr  = trackingInitHandle->imageBuff;
+    trackingInitHandle->imageRing = NULL;
+    threadStartSignal( threadHandle );
+
+    return 0;
+}
+
+int trackingInitStartShared( THREAD_HANDLE_T *threadHandle, ARUint8 *imagePtr, FrameBufferRing *imageRing )
+{
+    TrackingInitHandle     *trackingInitHandle;
+
+    if (!threadHandle || !imagePtr || !imageRing) {
+        ARLOGe("trackingInitStartShared(): Error: NULL threadHandle or imagePtr or imageRing.\n");
+        return (-1);
+    }
+    
+    trackingInitHandle = (TrackingInitHandle *)threadGetArg(threadHandle);
+    if (!trackingInitHandle) {
+        ARLOGe("trackingInitStartShared(): Error: NULL trackingInitHandle.\n");
+        return (-1);
+    }
+    // The worker is idle until signalled, so it is safe to hand over the frame here.
+    trackingInitHandle->imagePtr  = imagePtr;
+    trackingInitHandle->imageRing = imageRing;
     threadStartSignal( threadHandle );
 
     return 0;
@@ -160,19 +197,24 @@ static void *trackingInitMain( THREAD_HANDLE_T *threadHandle )
         return (NULL);
     }
     kpmHandle          = trackingInitHandle->kpmHandle;
-    imagePtr           = trackingInitHandle->imagePtr;
-    if (!kpmHandle || !imagePtr) {
-        ARLOGe("Error starting tracking thread: empty kpmHandle/imagePtr.\n");
+    if (!kpmHandle) {
+        ARLOGe("Error starting tracking thread: empty kpmHandle.\n");
         return (NULL);
     }
     ARLOGi("Start tracking thread.\n");
     
-    kpmGetResult( kpmHandle, &kpmResult, &kpmResultNum );
-
     for(;;) {
         if( threadStartWait(threadHandle) < 0 ) break;
 
+        imagePtr = trackingInitHandle->imagePtr;
         kpmMatching(kpmHandle, imagePtr);
+        if (trackingInitHandle->imageRing) {
+            frameBufferRingRelease( trackingInitHandle->imageRing, imagePtr );
+            trackingInitHandle->imageRing = NULL;
+        }
+        
+        // Fetched each time, as pages may have been added to or removed from the handle.
+        kpmGetResult( kpmHandle, &kpmResult, &kpmResultNum );
         trackingInitHandle->flag = 0;
         for( i = 0; i < kpmResultNum; i++ ) {
             if( kpmResult[i].camPoseF != 0 ) continue;
@@ -44,6 +44,7 @@
 
 #include <thread_sub.h> 
 #include <KPM/kpm.h>
+#include <ARWrapper/FrameBufferRing.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -51,6 +52,9 @@ extern "C" {
 
 THREAD_HANDLE_T *trackingInitInit( KpmHandle *kpmHandle );
 int trackingInitStart( THREAD_HANDLE_T *threadHandle, ARUint8 *imagePtr );
+// As trackingInitStart, but matches imagePtr in place rather than copying it. The caller passes
+// a reference on imagePtr, taken from imageRing, which is released once matching is done.
+int trackingInitStartShared( THREAD_HANDLE_T *threadHandle, ARUint8 *imagePtr, FrameBufferRing *imageRing );
 int trackingInitGetResult( THREAD_HANDLE_T *threadHandle, float trans[3][4], int *page );
 int trackingInitQuit( THREAD_HANDLE_T **threadHandle_p );
 
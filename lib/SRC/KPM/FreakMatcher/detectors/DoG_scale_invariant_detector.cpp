@@ -41,9 +41,16 @@
 #include <algorithm>
 #include <functional>
 #include "interpolate.h"
+#include "pyramid_kernels.h"
 
 using namespace vision;
 
+// Number of DoG image rows searched for extrema by one task
+static const size_t kRowsPerExtractTask = 32;
+
+// Number of feature points refined or oriented by one task
+static const size_t kPointsPerTask = 64;
+
 DoGPyramid::DoGPyramid()
 : mNumOctaves(0)
 , mNumScalesPerOctave(0)
@@ -94,14 +101,11 @@ void DoGPyramid::difference_image_binomial(Image& d, const Image& im1, const Ima
     ASSERT(im1.width() == im2.width(), "Images must have the same width");
     ASSERT(im1.height() == im2.height(), "Images must have the same height");
     
+    const detail::PyramidKernels& kernels = GetPyramidKernels();
+    
     // Compute diff
     for(size_t i = 0; i < im1.height(); i++) {
-        float* p0 = d.get<float>(i);
-        const float* p1 = im1.get<float>(i);
-        const float* p2 = im2.get<float>(i);
-        for(size_t j = 0; j < im1.width(); j++) {
-            p0[j] = p1[j]-p2[j];
-        }
+        kernels.subtractRow(d.get<float>(i), im1.get<float>(i), im2.get<float>(i), im1.width());
     }
 }
 
@@ -178,269 +182,304 @@ void DoGScaleInvariantDetector::extractFeatures(const GaussianScaleSpacePyramid*
     // Clear old features
     mFeaturePoints.clear();
     
+    // Split each DoG image into bands of rows. The bands are searched concurrently
+    // and their extrema appended in order, so the features are the same for any
+    // number of threads.
+    size_t num_tasks = 0;
+    for(size_t i = 1; i < laplacian->size()-1; i++) {
+        size_t height = laplacian->get(i).height();
+        for(size_t row = 0; row < height; row += kRowsPerExtractTask) {
+            if(num_tasks == mExtractTasks.size()) {
+                mExtractTasks.push_back(ExtractTask());
+            }
+            ExtractTask& task = mExtractTasks[num_tasks++];
+            task.level = i;
+            task.rowBegin = row;
+            task.rowEnd = std::min(row+kRowsPerExtractTask, height);
+        }
+    }
+    
+    mThreadPool.parallelFor((int)num_tasks, [&](int i, int) {
+        ExtractTask& task = mExtractTasks[i];
+        task.points.clear();
+        extractFeatures(task.points, pyramid, laplacian, task.level, task.rowBegin, task.rowEnd);
+    });
+    
+    for(size_t i = 0; i < num_tasks; i++) {
+        mFeaturePoints.insert(mFeaturePoints.end(),
+                              mExtractTasks[i].points.begin(),
+                              mExtractTasks[i].points.end());
+    }
+}
+
+void DoGScaleInvariantDetector::extractFeatures(std::vector<FeaturePoint>& points,
+                                                const GaussianScaleSpacePyramid* pyramid,
+                                                const DoGPyramid* laplacian,
+                                                size_t level,
+                                                size_t row_begin,
+                                                size_t row_end) const {
+    
     float laplacianSqrThreshold = sqr(mLaplacianThreshold);
     
-    for(size_t i = 1; i < mLaplacianPyramid.size()-1; i++) {
-        const Image& im0 = laplacian->get(i-1);
-        const Image& im1 = laplacian->get(i);
-        const Image& im2 = laplacian->get(i+1);
+    const Image& im0 = laplacian->get(level-1);
+    const Image& im1 = laplacian->get(level);
+    const Image& im2 = laplacian->get(level+1);
+    
+    int octave = laplacian->octaveFromIndex((int)level);
+    int scale = laplacian->scaleFromIndex((int)level);
+    
+    if(im0.width() == im1.width() && im0.width() == im2.width()) { // All images are the same size
+        ASSERT(im0.height() == im1.height(), "Height is inconsistent");
+        ASSERT(im0.height() == im2.height(), "Height is inconsistent");
         
-        int octave = laplacian->octaveFromIndex((int)i);
-        int scale = laplacian->scaleFromIndex((int)i);
+        size_t width_minus_1 = im1.width() - 1;
+        size_t heigh_minus_1 = im1.height() - 1;
         
-        if(im0.width() == im1.width() && im0.width() == im2.width()) { // All images are the same size
-            ASSERT(im0.height() == im1.height(), "Height is inconsistent");
-            ASSERT(im0.height() == im2.height(), "Height is inconsistent");
+        for(size_t row = std::max<size_t>(1, row_begin); row < std::min(heigh_minus_1, row_end); row++) {
+            const float* im0_ym1 = im0.get<float>(row-1);
+            const float* im0_y   = im0.get<float>(row);
+            const float* im0_yp1 = im0.get<float>(row+1);
             
-            size_t width_minus_1 = im1.width() - 1;
-            size_t heigh_minus_1 = im1.height() - 1;
+            const float* im1_ym1 = im1.get<float>(row-1);
+            const float* im1_y   = im1.get<float>(row);
+            const float* im1_yp1 = im1.get<float>(row+1);
             
-            for(size_t row = 1; row < heigh_minus_1; row++) {
-                const float* im0_ym1 = im0.get<float>(row-1);
-                const float* im0_y   = im0.get<float>(row);
-                const float* im0_yp1 = im0.get<float>(row+1);
-                
-                const float* im1_ym1 = im1.get<float>(row-1);
-                const float* im1_y   = im1.get<float>(row);
-                const float* im1_yp1 = im1.get<float>(row+1);
+            const float* im2_ym1 = im2.get<float>(row-1);
+            const float* im2_y   = im2.get<float>(row);
+            const float* im2_yp1 = im2.get<float>(row+1);
+            
+            for(size_t col = 1; col < width_minus_1; col++) {
+                const float& value = im1_y[col];
+                FeaturePoint fp;
                 
-                const float* im2_ym1 = im2.get<float>(row-1);
-                const float* im2_y   = im2.get<float>(row);
-                const float* im2_yp1 = im2.get<float>(row+1);
+                // Check laplacian score
+                if(sqr(value) < laplacianSqrThreshold) {
+                    continue;
+                }
                 
-                for(size_t col = 1; col < width_minus_1; col++) {
-                    const float& value = im1_y[col];
-                    FeaturePoint fp;
-                    
-                    // Check laplacian score
-                    if(sqr(value) < laplacianSqrThreshold) {
-                        continue;
-                    }
-                    
 #define NONMAX_CHECK(OPERATOR, VALUE)                  \
-                    /* im0 - 9 evaluations */          \
-                    VALUE OPERATOR im0_ym1[col-1]   && \
-                    VALUE OPERATOR im0_ym1[col]     && \
-                    VALUE OPERATOR im0_ym1[col+1]   && \
-                    VALUE OPERATOR im0_y[col-1]     && \
-                    VALUE OPERATOR im0_y[col]       && \
-                    VALUE OPERATOR im0_y[col+1]     && \
-                    VALUE OPERATOR im0_yp1[col-1]   && \
-                    VALUE OPERATOR im0_yp1[col]     && \
-                    VALUE OPERATOR im0_yp1[col+1]   && \
-                    /* im1 - 8 evaluations */          \
-                    VALUE OPERATOR im1_ym1[col-1]   && \
-                    VALUE OPERATOR im1_ym1[col]     && \
-                    VALUE OPERATOR im1_ym1[col+1]   && \
-                    VALUE OPERATOR im1_y[col-1]     && \
-                    VALUE OPERATOR im1_y[col+1]     && \
-                    VALUE OPERATOR im1_yp1[col-1]   && \
-                    VALUE OPERATOR im1_yp1[col]     && \
-                    VALUE OPERATOR im1_yp1[col+1]   && \
-                    /* im2 - 9 evaluations */          \
-                    VALUE OPERATOR im2_ym1[col-1]   && \
-                    VALUE OPERATOR im2_ym1[col]     && \
-                    VALUE OPERATOR im2_ym1[col+1]   && \
-                    VALUE OPERATOR im2_y[col-1]     && \
-                    VALUE OPERATOR im2_y[col]       && \
-                    VALUE OPERATOR im2_y[col+1]     && \
-                    VALUE OPERATOR im2_yp1[col-1]   && \
-                    VALUE OPERATOR im2_yp1[col]     && \
-                    VALUE OPERATOR im2_yp1[col+1]
-                    
-                    bool extrema = false;
-                    if(NONMAX_CHECK(>, value)) { // strictly greater than
-                        extrema = true;
-                    } else if(NONMAX_CHECK(<, value)) { // strictly less than
-                        extrema = true;
-                    }
+                /* im0 - 9 evaluations */          \
+                VALUE OPERATOR im0_ym1[col-1]   && \
+                VALUE OPERATOR im0_ym1[col]     && \
+                VALUE OPERATOR im0_ym1[col+1]   && \
+                VALUE OPERATOR im0_y[col-1]     && \
+                VALUE OPERATOR im0_y[col]       && \
+                VALUE OPERATOR im0_y[col+1]     && \
+                VALUE OPERATOR im0_yp1[col-1]   && \
+                VALUE OPERATOR im0_yp1[col]     && \
+                VALUE OPERATOR im0_yp1[col+1]   && \
+                /* im1 - 8 evaluations */          \
+                VALUE OPERATOR im1_ym1[col-1]   && \
+                VALUE OPERATOR im1_ym1[col]     && \
+                VALUE OPERATOR im1_ym1[col+1]   && \
+                VALUE OPERATOR im1_y[col-1]     && \
+                VALUE OPERATOR im1_y[col+1]     && \
+                VALUE OPERATOR im1_yp1[col-1]   && \
+                VALUE OPERATOR im1_yp1[col]     && \
+                VALUE OPERATOR im1_yp1[col+1]   && \
+                /* im2 - 9 evaluations */          \
+                VALUE OPERATOR im2_ym1[col-1]   && \
+                VALUE OPERATOR im2_ym1[col]     && \
+                VALUE OPERATOR im2_ym1[col+1]   && \
+                VALUE OPERATOR im2_y[col-1]     && \
+                VALUE OPERATOR im2_y[col]       && \
+                VALUE OPERATOR im2_y[col+1]     && \
+                VALUE OPERATOR im2_yp1[col-1]   && \
+                VALUE OPERATOR im2_yp1[col]     && \
+                VALUE OPERATOR im2_yp1[col+1]
+                
+                bool extrema = false;
+                if(NONMAX_CHECK(>, value)) { // strictly greater than
+                    extrema = true;
+                } else if(NONMAX_CHECK(<, value)) { // strictly less than
+                    extrema = true;
+                }
+                
+                if(extrema) {
+                    fp.octave = octave;
+                    fp.scale  = scale;
+                    fp.score  = value;
+                    fp.sigma  = pyramid->effectiveSigma(octave, scale);
                     
-                    if(extrema) {
-                        fp.octave = octave;
-                        fp.scale  = scale;
-                        fp.score  = value;
-                        fp.sigma  = pyramid->effectiveSigma(octave, scale);
-                        
-                        bilinear_upsample_point(fp.x,
-                                                fp.y,
-                                                col,
-                                                row,
-                                                octave);
-                        
-                        mFeaturePoints.push_back(fp);
-                    }
+                    bilinear_upsample_point(fp.x,
+                                            fp.y,
+                                            col,
+                                            row,
+                                            octave);
                     
-#undef NONMAX_CHECK
+                    points.push_back(fp);
                 }
+                
+#undef NONMAX_CHECK
             }
-        } else if(im0.width() == im1.width() && (im1.width()>>1) == im2.width()) { // 0,1 are the same size, 2 is half size
-            ASSERT(im0.height() == im1.height(), "Height is inconsistent");
-            ASSERT((im1.height()>>1) == im2.height(), "Height is inconsistent");
-    
-            size_t end_x = std::floor(((im2.width()-1)-0.5f)*2.f+0.5f);
-            size_t end_y = std::floor(((im2.height()-1)-0.5f)*2.f+0.5f);
+        }
+    } else if(im0.width() == im1.width() && (im1.width()>>1) == im2.width()) { // 0,1 are the same size, 2 is half size
+        ASSERT(im0.height() == im1.height(), "Height is inconsistent");
+        ASSERT((im1.height()>>1) == im2.height(), "Height is inconsistent");
 
-            for(size_t row = 2; row < end_y; row++) {
-                const float* im0_ym1 = im0.get<float>(row-1);
-                const float* im0_y   = im0.get<float>(row);
-                const float* im0_yp1 = im0.get<float>(row+1);
-                
-                const float* im1_ym1 = im1.get<float>(row-1);
-                const float* im1_y   = im1.get<float>(row);
-                const float* im1_yp1 = im1.get<float>(row+1);
+        size_t end_x = std::floor(((im2.width()-1)-0.5f)*2.f+0.5f);
+        size_t end_y = std::floor(((im2.height()-1)-0.5f)*2.f+0.5f);
 
-                for(size_t col = 2; col < end_x; col++) {
-                    const float& value = im1_y[col];
-                    FeaturePoint fp;
-                    
-                    // Check laplacian score
-                    if(sqr(value) < laplacianSqrThreshold) {
-                        continue;
-                    }
-                    
-                    // Compute downsampled point location
-                    float ds_x = col*0.5f-0.25f;
-                    float ds_y = row*0.5f-0.25f;
-                                        
+        for(size_t row = std::max<size_t>(2, row_begin); row < std::min(end_y, row_end); row++) {
+            const float* im0_ym1 = im0.get<float>(row-1);
+            const float* im0_y   = im0.get<float>(row);
+            const float* im0_yp1 = im0.get<float>(row+1);
+            
+            const float* im1_ym1 = im1.get<float>(row-1);
+            const float* im1_y   = im1.get<float>(row);
+            const float* im1_yp1 = im1.get<float>(row+1);
+
+            for(size_t col = 2; col < end_x; col++) {
+                const float& value = im1_y[col];
+                FeaturePoint fp;
+                
+                // Check laplacian score
+                if(sqr(value) < laplacianSqrThreshold) {
+                    continue;
+                }
+                
+                // Compute downsampled point location
+                float ds_x = col*0.5f-0.25f;
+                float ds_y = row*0.5f-0.25f;
+                                    
 #define NONMAX_CHECK(OPERATOR, VALUE)                  \
-                    /* im0 - 9 evaluations */          \
-                    VALUE OPERATOR im0_ym1[col-1]   && \
-                    VALUE OPERATOR im0_ym1[col]     && \
-                    VALUE OPERATOR im0_ym1[col+1]   && \
-                    VALUE OPERATOR im0_y[col-1]     && \
-                    VALUE OPERATOR im0_y[col]       && \
-                    VALUE OPERATOR im0_y[col+1]     && \
-                    VALUE OPERATOR im0_yp1[col-1]   && \
-                    VALUE OPERATOR im0_yp1[col]     && \
-                    VALUE OPERATOR im0_yp1[col+1]   && \
-                    /* im1 - 8 evaluations */          \
-                    VALUE OPERATOR im1_ym1[col-1]   && \
-                    VALUE OPERATOR im1_ym1[col]     && \
-                    VALUE OPERATOR im1_ym1[col+1]   && \
-                    VALUE OPERATOR im1_y[col-1]     && \
-                    VALUE OPERATOR im1_y[col+1]     && \
-                    VALUE OPERATOR im1_yp1[col-1]   && \
-                    VALUE OPERATOR im1_yp1[col]     && \
-                    VALUE OPERATOR im1_yp1[col+1]   && \
-                    /* im2 - 9 evaluations */          \
-                    VALUE OPERATOR bilinear_interpolation<float>(im2, ds_x-0.5f, ds_y-0.5f)   && \
-                    VALUE OPERATOR bilinear_interpolation<float>(im2, ds_x,      ds_y-0.5f)   && \
-                    VALUE OPERATOR bilinear_interpolation<float>(im2, ds_x+0.5f, ds_y-0.5f)   && \
-                    VALUE OPERATOR bilinear_interpolation<float>(im2, ds_x-0.5f, ds_y)        && \
-                    VALUE OPERATOR bilinear_interpolation<float>(im2, ds_x,      ds_y)        && \
-                    VALUE OPERATOR bilinear_interpolation<float>(im2, ds_x+0.5f, ds_y)        && \
-                    VALUE OPERATOR bilinear_interpolation<float>(im2, ds_x-0.5f, ds_y+0.5f)   && \
-                    VALUE OPERATOR bilinear_interpolation<float>(im2, ds_x,      ds_y+0.5f)   && \
-                    VALUE OPERATOR bilinear_interpolation<float>(im2, ds_x+0.5f, ds_y+0.5f)
+                /* im0 - 9 evaluations */          \
+                VALUE OPERATOR im0_ym1[col-1]   && \
+                VALUE OPERATOR im0_ym1[col]     && \
+                VALUE OPERATOR im0_ym1[col+1]   && \
+                VALUE OPERATOR im0_y[col-1]     && \
+                VALUE OPERATOR im0_y[col]       && \
+                VALUE OPERATOR im0_y[col+1]     && \
+                VALUE OPERATOR im0_yp1[col-1]   && \
+                VALUE OPERATOR im0_yp1[col]     && \
+                VALUE OPERATOR im0_yp1[col+1]   && \
+                /* im1 - 8 evaluations */          \
+                VALUE OPERATOR im1_ym1[col-1]   && \
+                VALUE OPERATOR im1_ym1[col]     && \
+                VALUE OPERATOR im1_ym1[col+1]   && \
+                VALUE OPERATOR im1_y[col-1]     && \
+                VALUE OPERATOR im1_y[col+1]     && \
+                VALUE OPERATOR im1_yp1[col-1]   && \
+                VALUE OPERATOR im1_yp1[col]     && \
+                VALUE OPERATOR im1_yp1[col+1]   && \
+                /* im2 - 9 evaluations */          \
+                VALUE OPERATOR bilinear_interpolation<float>(im2, ds_x-0.5f, ds_y-0.5f)   && \
+                VALUE OPERATOR bilinear_interpolation<float>(im2, ds_x,      ds_y-0.5f)   && \
+                VALUE OPERATOR bilinear_interpolation<float>(im2, ds_x+0.5f, ds_y-0.5f)   && \
+                VALUE OPERATOR bilinear_interpolation<float>(im2, ds_x-0.5f, ds_y)        && \
+                VALUE OPERATOR bilinear_interpolation<float>(im2, ds_x,      ds_y)        && \
+                VALUE OPERATOR bilinear_interpolation<float>(im2, ds_x+0.5f, ds_y)        && \
+                VALUE OPERATOR bilinear_interpolation<float>(im2, ds_x-0.5f, ds_y+0.5f)   && \
+                VALUE OPERATOR bilinear_interpolation<float>(im2, ds_x,      ds_y+0.5f)   && \
+                VALUE OPERATOR bilinear_interpolation<float>(im2, ds_x+0.5f, ds_y+0.5f)
 
-                    bool extrema = false;
-                    if(NONMAX_CHECK(>, value)) { // strictly greater than
-                        extrema = true;
-                    } else if(NONMAX_CHECK(<, value)) { // strictly less than
-                        extrema = true;
-                    }
+                bool extrema = false;
+                if(NONMAX_CHECK(>, value)) { // strictly greater than
+                    extrema = true;
+                } else if(NONMAX_CHECK(<, value)) { // strictly less than
+                    extrema = true;
+                }
+                
+                if(extrema) {
+                    fp.octave = octave;
+                    fp.scale  = scale;
+                    fp.score  = value;
+                    fp.sigma  = pyramid->effectiveSigma(octave, scale);
                     
-                    if(extrema) {
-                        fp.octave = octave;
-                        fp.scale  = scale;
-                        fp.score  = value;
-                        fp.sigma  = pyramid->effectiveSigma(octave, scale);
-                        
-                        bilinear_upsample_point(fp.x,
-                                                fp.y,
-                                                col,
-                                                row,
-                                                octave);
-                        
-                        mFeaturePoints.push_back(fp);
-                    }
+                    bilinear_upsample_point(fp.x,
+                                            fp.y,
+                                            col,
+                                            row,
+                                            octave);
                     
-#undef NONMAX_CHECK
+                    points.push_back(fp);
                 }
+                
+#undef NONMAX_CHECK
             }
-        } else if((im0.width()>>1) == im1.width() && (im0.width()>>1) == im2.width()) { // 0 is twice the size of 1 and 2
-            ASSERT((im0.height()>>1) == im1.height(), "Height is inconsistent");
-            ASSERT((im0.height()>>1) == im2.height(), "Height is inconsistent");
+        }
+    } else if((im0.width()>>1) == im1.width() && (im0.width()>>1) == im2.width()) { // 0 is twice the size of 1 and 2
+        ASSERT((im0.height()>>1) == im1.height(), "Height is inconsistent");
+        ASSERT((im0.height()>>1) == im2.height(), "Height is inconsistent");
+        
+        size_t width_minus_1 = im1.width() - 1;
+        size_t height_minus_1 = im1.height() - 1;
+        
+        for(size_t row = std::max<size_t>(1, row_begin); row < std::min(height_minus_1, row_end); row++) {
+            const float* im1_ym1 = im1.get<float>(row-1);
+            const float* im1_y   = im1.get<float>(row);
+            const float* im1_yp1 = im1.get<float>(row+1);
             
-            size_t width_minus_1 = im1.width() - 1;
-            size_t height_minus_1 = im1.height() - 1;
+            const float* im2_ym1 = im2.get<float>(row-1);
+            const float* im2_y   = im2.get<float>(row);
+            const float* im2_yp1 = im2.get<float>(row+1);
             
-            for(size_t row = 1; row < height_minus_1; row++) {
-                const float* im1_ym1 = im1.get<float>(row-1);
-                const float* im1_y   = im1.get<float>(row);
-                const float* im1_yp1 = im1.get<float>(row+1);
+            for(size_t col = 1; col < width_minus_1; col++) {
+                const float& value = im1_y[col];
+                FeaturePoint fp;
                 
-                const float* im2_ym1 = im2.get<float>(row-1);
-                const float* im2_y   = im2.get<float>(row);
-                const float* im2_yp1 = im2.get<float>(row+1);
+                // Check laplacian score
+                if(sqr(value) < laplacianSqrThreshold) {
+                    continue;
+                }
+                
+                float us_x = (col<<1)+0.5f;
+                float us_y = (row<<1)+0.5f;
                 
-                for(size_t col = 1; col < width_minus_1; col++) {
-                    const float& value = im1_y[col];
-                    FeaturePoint fp;
-                    
-                    // Check laplacian score
-                    if(sqr(value) < laplacianSqrThreshold) {
-                        continue;
-                    }
-                    
-                    float us_x = (col<<1)+0.5f;
-                    float us_y = (row<<1)+0.5f;
-                    
 #define NONMAX_CHECK(OPERATOR, VALUE)                  \
-                    /* im1 - 8 evaluations */          \
-                    VALUE OPERATOR im1_ym1[col-1]   && \
-                    VALUE OPERATOR im1_ym1[col]     && \
-                    VALUE OPERATOR im1_ym1[col+1]   && \
-                    VALUE OPERATOR im1_y[col-1]     && \
-                    VALUE OPERATOR im1_y[col+1]     && \
-                    VALUE OPERATOR im1_yp1[col-1]   && \
-                    VALUE OPERATOR im1_yp1[col]     && \
-                    VALUE OPERATOR im1_yp1[col+1]   && \
-                    /* im2 - 9 evaluations */          \
-                    VALUE OPERATOR im2_ym1[col-1]   && \
-                    VALUE OPERATOR im2_ym1[col]     && \
-                    VALUE OPERATOR im2_ym1[col+1]   && \
-                    VALUE OPERATOR im2_y[col-1]     && \
-                    VALUE OPERATOR im2_y[col]       && \
-                    VALUE OPERATOR im2_y[col+1]     && \
-                    VALUE OPERATOR im2_yp1[col-1]   && \
-                    VALUE OPERATOR im2_yp1[col]     && \
-                    VALUE OPERATOR im2_yp1[col+1]   && \
-                    /* im2 - 9 evaluations */          \
-                    VALUE OPERATOR bilinear_interpolation<float>(im0, us_x-2.f, us_y-2.f)   && \
-                    VALUE OPERATOR bilinear_interpolation<float>(im0, us_x,     us_y-2.f)   && \
-                    VALUE OPERATOR bilinear_interpolation<float>(im0, us_x+2.f, us_y-2.f)   && \
-                    VALUE OPERATOR bilinear_interpolation<float>(im0, us_x-2.f, us_y)       && \
-                    VALUE OPERATOR bilinear_interpolation<float>(im0, us_x,     us_y)       && \
-                    VALUE OPERATOR bilinear_interpolation<float>(im0, us_x+2.f, us_y)       && \
-                    VALUE OPERATOR bilinear_interpolation<float>(im0, us_x-2.f, us_y+2.f)   && \
-                    VALUE OPERATOR bilinear_interpolation<float>(im0, us_x,     us_y+2.f)   && \
-                    VALUE OPERATOR bilinear_interpolation<float>(im0, us_x+2.f, us_y+2.f)
-                    
-                    bool extrema = false;
-                    if(NONMAX_CHECK(>, value)) { // strictly greater than
-                        extrema = true;
-                    } else if(NONMAX_CHECK(<, value)) { // strictly less than
-                        extrema = true;
-                    }
+                /* im1 - 8 evaluations */          \
+                VALUE OPERATOR im1_ym1[col-1]   && \
+                VALUE OPERATOR im1_ym1[col]     && \
+                VALUE OPERATOR im1_ym1[col+1]   && \
+                VALUE OPERATOR im1_y[col-1]     && \
+                VALUE OPERATOR im1_y[col+1]     && \
+                VALUE OPERATOR im1_yp1[col-1]   && \
+                VALUE OPERATOR im1_yp1[col]     && \
+                VALUE OPERATOR im1_yp1[col+1]   && \
+                /* im2 - 9 evaluations */          \
+                VALUE OPERATOR im2_ym1[col-1]   && \
+                VALUE OPERATOR im2_ym1[col]     && \
+                VALUE OPERATOR im2_ym1[col+1]   && \
+                VALUE OPERATOR im2_y[col-1]     && \
+                VALUE OPERATOR im2_y[col]       && \
+                VALUE OPERATOR im2_y[col+1]     && \
+                VALUE OPERATOR im2_yp1[col-1]   && \
+                VALUE OPERATOR im2_yp1[col]     && \
+                VALUE OPERATOR im2_yp1[col+1]   && \
+                /* im2 - 9 evaluations */          \
+                VALUE OPERATOR bilinear_interpolation<float>(im0, us_x-2.f, us_y-2.f)   && \
+                VALUE OPERATOR bilinear_interpolation<float>(im0, us_x,     us_y-2.f)   && \
+                VALUE OPERATOR bilinear_interpolation<float>(im0, us_x+2.f, us_y-2.f)   && \
+                VALUE OPERATOR bilinear_interpolation<float>(im0, us_x-2.f, us_y)       && \
+                VALUE OPERATOR bilinear_interpolation<float>(im0, us_x,     us_y)       && \
+                VALUE OPERATOR bilinear_interpolation<float>(im0, us_x+2.f, us_y)       && \
+                VALUE OPERATOR bilinear_interpolation<float>(im0, us_x-2.f, us_y+2.f)   && \
+                VALUE OPERATOR bilinear_interpolation<float>(im0, us_x,     us_y+2.f)   && \
+                VALUE OPERATOR bilinear_interpolation<float>(im0, us_x+2.f, us_y+2.f)
+                
+                bool extrema = false;
+                if(NONMAX_CHECK(>, value)) { // strictly greater than
+                    extrema = true;
+                } else if(NONMAX_CHECK(<, value)) { // strictly less than
+                    extrema = true;
+                }
+                
+                if(extrema) {
+                    fp.octave = octave;
+                    fp.scale  = scale;
+                    fp.score  = value;
+                    fp.sigma  = pyramid->effectiveSigma(octave, scale);
                     
-                    if(extrema) {
-                        fp.octave = octave;
-                        fp.scale  = scale;
-                        fp.score  = value;
-                        fp.sigma  = pyramid->effectiveSigma(octave, scale);
-                        
-                        bilinear_upsample_point(fp.x,
-                                                fp.y,
-                                                col,
-                                                row,
-                                                octave);
-                        
-                        mFeaturePoints.push_back(fp);
-                    }
+                    bilinear_upsample_point(fp.x,
+                                            fp.y,
+                                            col,
+                                            row,
+                                            octave);
                     
-#undef NONMAX_CHECK
+                    points.push_back(fp);
                 }
+                
+#undef NONMAX_CHECK
             }
         }
     }
@@ -470,83 +509,100 @@ void DoGScaleInvariantDetector::pruneFeatures() {
 }
 
 void DoGScaleInvariantDetector::findSubpixelLocations(const GaussianScaleSpacePyramid* pyramid) {
+    size_t num_points = mFeaturePoints.size();
+    mSubpixelValid.resize(num_points);
+    
+    // Refine the points concurrently, then keep the valid ones in order
+    int num_tasks = (int)((num_points+kPointsPerTask-1)/kPointsPerTask);
+    mThreadPool.parallelFor(num_tasks, [&](int task, int) {
+        size_t end = std::min((task+1)*kPointsPerTask, num_points);
+        for(size_t i = task*kPointsPerTask; i < end; i++) {
+            mSubpixelValid[i] = findSubpixelLocation(mFeaturePoints[i], pyramid);
+        }
+    });
+    
+    size_t num_valid = 0;
+    for(size_t i = 0; i < num_points; i++) {
+        if(mSubpixelValid[i]) {
+            mFeaturePoints[num_valid++] = mFeaturePoints[i];
+        }
+    }
+    
+    mFeaturePoints.resize(num_valid);
+}
+
+bool DoGScaleInvariantDetector::findSubpixelLocation(FeaturePoint& kp, const GaussianScaleSpacePyramid* pyramid) const {
     float A[9];
     float b[3];
     float u[3];
     int x, y;
     float xp, yp;
-    int num_points;
     float laplacianSqrThreshold;
     float hessianThreshold;
     
-    num_points = 0;
     laplacianSqrThreshold = sqr(mLaplacianThreshold);
     hessianThreshold = (sqr(mEdgeThreshold+1)/mEdgeThreshold);
     
-    for(size_t i = 0; i < mFeaturePoints.size(); i++) {
-        FeaturePoint& kp = mFeaturePoints[i];
-        
-        ASSERT(kp.scale < mLaplacianPyramid.numScalePerOctave(), "Feature point scale is out of bounds");
-        int lap_index = kp.octave*mLaplacianPyramid.numScalePerOctave()+kp.scale;
-        
-        // Downsample the feature point to the detection octave
-        bilinear_downsample_point(xp, yp, kp.x, kp.y, kp.octave);
-        
-        // Compute the discrete pixel location
-        x = (int)(xp+0.5f);
-        y = (int)(yp+0.5f);
-        
-        // Get Laplacian images
-        const Image& lap0 = mLaplacianPyramid.images()[lap_index-1];
-        const Image& lap1 = mLaplacianPyramid.images()[lap_index];
-        const Image& lap2 = mLaplacianPyramid.images()[lap_index+1];
-        
-        // Compute the Hessian
-        if(!ComputeSubpixelHessian(A, b, lap0, lap1, lap2, x, y)) {
-            continue;
-        }
-        
-        // A*u=b
-        if(!SolveSymmetricLinearSystem3x3(u, A, b)) {
-            continue;
-        }
-        
-        // If points move too much in the sub-pixel update, then the point probably
-        // unstable.
-        if(sqr(u[0])+sqr(u[1]) > mMaxSubpixelDistanceSqr) {
-            continue;
-        }
-        
-        // Compute the edge score
-        if(!ComputeEdgeScore(kp.edge_score, A)) {
-            continue;
-        }
-        
-        // Compute a linear estimate of the intensity
-        ASSERT(kp.score == lap1.get<float>(y)[x], "Score is not consistent with the DoG image");
-        kp.score = lap1.get<float>(y)[x] - (b[0]*u[0] + b[1]*u[1] + b[2]*u[2]);
-        
-        // Update the location:
-        // Apply the update on the downsampled location and then upsample the result.
-        bilinear_upsample_point(kp.x, kp.y, xp+u[0], yp+u[1], kp.octave);
-        
-        // Update the scale
-        kp.sp_scale = kp.scale + u[2];
-        kp.sp_scale = ClipScalar<float>(kp.sp_scale, 0, mLaplacianPyramid.numScalePerOctave());
-        
-        if(std::abs(kp.edge_score)  < hessianThreshold &&
-           sqr(kp.score)            >= laplacianSqrThreshold &&
-           kp.x                     >= 0 &&
-           kp.x                     < mLaplacianPyramid.images()[0].width() &&
-           kp.y                     >= 0 &&
-           kp.y                     < mLaplacianPyramid.images()[0].height()) {
-            // Update the sigma
-            kp.sigma = pyramid->effectiveSigma(kp.octave, kp.sp_scale);
-            mFeaturePoints[num_points++] = kp;
-        }
+    ASSERT(kp.scale < mLaplacianPyramid.numScalePerOctave(), "Feature point scale is out of bounds");
+    int lap_index = kp.octave*mLaplacianPyramid.numScalePerOctave()+kp.scale;
+    
+    // Downsample the feature point to the detection octave
+    bilinear_downsample_point(xp, yp, kp.x, kp.y, kp.octave);
+    
+    // Compute the discrete pixel location
+    x = (int)(xp+0.5f);
+    y = (int)(yp+0.5f);
+    
+    // Get Laplacian images
+    const Image& lap0 = mLaplacianPyramid.images()[lap_index-1];
+    const Image& lap1 = mLaplacianPyramid.images()[lap_index];
+    const Image& lap2 = mLaplacianPyramid.images()[lap_index+1];
+    
+    // Compute the Hessian
+    if(!ComputeSubpixelHessian(A, b, lap0, lap1, lap2, x, y)) {
+        return false;
+    }
+    
+    // A*u=b
+    if(!SolveSymmetricLinearSystem3x3(u, A, b)) {
+        return false;
+    }
+    
+    // If points move too much in the sub-pixel update, then the point probably
+    // unstable.
+    if(sqr(u[0])+sqr(u[1]) > mMaxSubpixelDistanceSqr) {
+        return false;
+    }
+    
+    // Compute the edge score
+    if(!ComputeEdgeScore(kp.edge_score, A)) {
+        return false;
     }
     
-    mFeaturePoints.resize(num_points);
+    // Compute a linear estimate of the intensity
+    ASSERT(kp.score == lap1.get<float>(y)[x], "Score is not consistent with the DoG image");
+    kp.score = lap1.get<float>(y)[x] - (b[0]*u[0] + b[1]*u[1] + b[2]*u[2]);
+    
+    // Update the location:
+    // Apply the update on the downsampled location and then upsample the result.
+    bilinear_upsample_point(kp.x, kp.y, xp+u[0], yp+u[1], kp.octave);
+    
+    // Update the scale
+    kp.sp_scale = kp.scale + u[2];
+    kp.sp_scale = ClipScalar<float>(kp.sp_scale, 0, mLaplacianPyramid.numScalePerOctave());
+    
+    if(std::abs(kp.edge_score)  < hessianThreshold &&
+       sqr(kp.score)            >= laplacianSqrThreshold &&
+       kp.x                     >= 0 &&
+       kp.x                     < mLaplacianPyramid.images()[0].width() &&
+       kp.y                     >= 0 &&
+       kp.y                     < mLaplacianPyramid.images()[0].height()) {
+        // Update the sigma
+        kp.sigma = pyramid->effectiveSigma(kp.octave, kp.sp_scale);
+        return true;
+    }
+    
+    return false;
 }
 
 void DoGScaleInvariantDetector::findFeatureOrientations(const GaussianScaleSpacePyramid* pyramid) {
@@ -556,47 +612,63 @@ void DoGScaleInvariantDetector::findFeatureOrientations(const GaussianScaleSpace
         }
         return;
     }
-
-    int num_angles;
-    mTmpOrientatedFeaturePoints.clear();
-    mTmpOrientatedFeaturePoints.reserve(mFeaturePoints.size()*kMaxNumOrientations);
+    
+    size_t num_points = mFeaturePoints.size();
+    mOrientations.resize(num_points*kMaxNumOrientations);
+    mNumOrientations.resize(num_points);
+    
+    mHistograms.resize(mThreadPool.numThreads());
+    for(size_t i = 0; i < mHistograms.size(); i++) {
+        mHistograms[i].resize(mOrientationAssignment.numBins());
+    }
     
     // Compute the gradient pyramid
-    mOrientationAssignment.computeGradients(pyramid);
+    mThreadPool.parallelFor((int)pyramid->images().size(), [&](int i, int) {
+        mOrientationAssignment.computeGradient(pyramid, i);
+    });
     
-    // Compute an orientation for each feature point
-    for(size_t i = 0; i < mFeaturePoints.size(); i++) {
-        float x, y, s;
-        
-        // Down sample the point to the detected octave
-        bilinear_downsample_point(x,
-                                  y,
-                                  s, 
-                                  mFeaturePoints[i].x,
-                                  mFeaturePoints[i].y,
-                                  mFeaturePoints[i].sigma,
-                                  mFeaturePoints[i].octave);
-        
-        // Downsampling the point can cause (x,y) to leave the image bounds by
-        // a tiny amount. Here we just clip it to be within the image bounds.
-        x = ClipScalar<float>(x, 0, pyramid->get(mFeaturePoints[i].octave, 0).width()-1);
-        y = ClipScalar<float>(y, 0, pyramid->get(mFeaturePoints[i].octave, 0).height()-1);
-        
-        // Compute dominant orientations
-        mOrientationAssignment.compute(&mOrientations[0],
-                                       num_angles,
-                                       mFeaturePoints[i].octave,
-                                       mFeaturePoints[i].scale,
-                                       x,
-                                       y,
-                                       s);
-        
-        // Create a feature point for each angle
-        for(int j = 0; j < num_angles; j++) {
+    // Compute the orientations of each feature point concurrently
+    int num_tasks = (int)((num_points+kPointsPerTask-1)/kPointsPerTask);
+    mThreadPool.parallelFor(num_tasks, [&](int task, int thread) {
+        size_t end = std::min((task+1)*kPointsPerTask, num_points);
+        for(size_t i = task*kPointsPerTask; i < end; i++) {
+            float x, y, s;
+            
+            // Down sample the point to the detected octave
+            bilinear_downsample_point(x,
+                                      y,
+                                      s,
+                                      mFeaturePoints[i].x,
+                                      mFeaturePoints[i].y,
+                                      mFeaturePoints[i].sigma,
+                                      mFeaturePoints[i].octave);
+            
+            // Downsampling the point can cause (x,y) to leave the image bounds by
+            // a tiny amount. Here we just clip it to be within the image bounds.
+            x = ClipScalar<float>(x, 0, pyramid->get(mFeaturePoints[i].octave, 0).width()-1);
+            y = ClipScalar<float>(y, 0, pyramid->get(mFeaturePoints[i].octave, 0).height()-1);
+            
+            // Compute dominant orientations
+            mOrientationAssignment.compute(&mOrientations[i*kMaxNumOrientations],
+                                           mNumOrientations[i],
+                                           &mHistograms[thread][0],
+                                           mFeaturePoints[i].octave,
+                                           mFeaturePoints[i].scale,
+                                           x,
+                                           y,
+                                           s);
+        }
+    });
+    
+    // Create a feature point for each angle, in order
+    mTmpOrientatedFeaturePoints.clear();
+    mTmpOrientatedFeaturePoints.reserve(num_points*kMaxNumOrientations);
+    for(size_t i = 0; i < num_points; i++) {
+        for(int j = 0; j < mNumOrientations[i]; j++) {
             // Copy the feature point
             FeaturePoint fp = mFeaturePoints[i];
             // Update the orientation
-            fp.angle = mOrientations[j];
+            fp.angle = mOrientations[i*kMaxNumOrientations+j];
             // Store oriented feature point
             mTmpOrientatedFeaturePoints.push_back(fp);
         }
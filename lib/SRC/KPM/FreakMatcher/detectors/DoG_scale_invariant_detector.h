@@ -40,6 +40,7 @@
 #include "interpolate.h"
 #include "utils/point.h"
 #include <framework/error.h>
+#include <framework/thread_pool.h>
 #include <math/math_utils.h>
 
 namespace vision {
@@ -194,6 +195,18 @@ namespace vision {
             return mFindOrientation;
         }
         
+        /**
+         * Set/Get the number of threads used for detection. The detected
+         * features are the same for any number of threads. Values less than 1
+         * select one thread per hardware core.
+         */
+        void setNumThreads(int n) {
+            mThreadPool.setNumThreads(n);
+        }
+        int numThreads() const {
+            return mThreadPool.numThreads();
+        }
+        
         /**
          * @return Feature points
          */
@@ -244,9 +257,28 @@ namespace vision {
         // Orientation assignment
         OrientationAssignment mOrientationAssignment;
         
-        // Vector of orientations. Pre-allocated to the maximum
+        // Orientations of each feature point. Pre-allocated to the maximum
         // number of orientations per feature point.
         std::vector<float> mOrientations;
+        std::vector<int> mNumOrientations;
+        
+        // Orientation histogram of each thread
+        std::vector<std::vector<float> > mHistograms;
+        
+        // Threads used for detection
+        ThreadPool mThreadPool;
+        
+        // A band of rows of one DoG image, and the extrema found in it
+        struct ExtractTask {
+            size_t level;
+            size_t rowBegin;
+            size_t rowEnd;
+            std::vector<FeaturePoint> points;
+        };
+        std::vector<ExtractTask> mExtractTasks;
+        
+        // True if a feature point survives the sub-pixel refinement
+        std::vector<unsigned char> mSubpixelValid;
         
         /**
          * Extract the minima/maxima.
@@ -254,6 +286,24 @@ namespace vision {
         void extractFeatures(const GaussianScaleSpacePyramid* pyramid,
                              const DoGPyramid* laplacian);
         
+        /**
+         * Extract the minima/maxima from rows [ROW_BEGIN, ROW_END) of the DoG
+         * image at LEVEL.
+         */
+        void extractFeatures(std::vector<FeaturePoint>& points,
+                             const GaussianScaleSpacePyramid* pyramid,
+                             const DoGPyramid* laplacian,
+                             size_t level,
+                             size_t row_begin,
+                             size_t row_end) const;
+        
+        /**
+         * Sub-pixel refinement of one feature point.
+         *
+         * @return True if the point is kept
+         */
+        bool findSubpixelLocation(FeaturePoint& kp, const GaussianScaleSpacePyramid* pyramid) const;
+        
         /**
          * Sub-pixel refinement.
          */
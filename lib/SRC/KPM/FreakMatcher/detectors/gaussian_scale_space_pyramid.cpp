@@ -34,6 +34,7 @@
 //
 
 #include "gaussian_scale_space_pyramid.h"
+#include "pyramid_kernels.h"
 #include <framework/error.h>
 //#include <framework/logger.h>
 
@@ -46,111 +47,44 @@ namespace vision {
                             const unsigned char* src,
                             size_t width,
                             size_t height) {
+        const detail::PyramidKernels& kernels = GetPyramidKernels();
+        
         unsigned short* tmp_ptr;
-        float* dst_ptr;
         
         size_t width_minus_1, width_minus_2;
-        size_t height_minus_2;
         
         ASSERT(width >= 5, "Image is too small");
         ASSERT(height >= 5, "Image is too small");
         
         width_minus_1 = width-1;
         width_minus_2 = width-2;
-        height_minus_2 = height-2;
-        
-        tmp_ptr = tmp;
         
         // Apply horizontal filter
         for(size_t row = 0; row < height; row++) {
             const unsigned char* src_ptr = &src[row*width];
+            tmp_ptr = &tmp[row*width];
             
             // Left border is computed by extending the border pixel beyond the image
-            *(tmp_ptr++) = ((src_ptr[0]<<1)+(src_ptr[0]<<2)) + ((src_ptr[0]+src_ptr[1])<<2) + (src_ptr[0]+src_ptr[2]);
-            *(tmp_ptr++) = ((src_ptr[1]<<1)+(src_ptr[1]<<2)) + ((src_ptr[0]+src_ptr[2])<<2) + (src_ptr[0]+src_ptr[3]);
+            tmp_ptr[0] = ((src_ptr[0]<<1)+(src_ptr[0]<<2)) + ((src_ptr[0]+src_ptr[1])<<2) + (src_ptr[0]+src_ptr[2]);
+            tmp_ptr[1] = ((src_ptr[1]<<1)+(src_ptr[1]<<2)) + ((src_ptr[0]+src_ptr[2])<<2) + (src_ptr[0]+src_ptr[3]);
             
             // Compute non-border pixels
-            for(size_t col = 2; col < width_minus_2; col++, tmp_ptr++) {
-                *tmp_ptr = ((src_ptr[col]<<1)+(src_ptr[col]<<2)) + ((src_ptr[col-1]+src_ptr[col+1])<<2) + (src_ptr[col-2]+src_ptr[col+2]);
-            }
+            kernels.binomialRowU8(tmp_ptr, src_ptr, width);
             
             // Right border. Computed similarily as the left border.
-            *(tmp_ptr++) = ((src_ptr[width_minus_2]<<1)+(src_ptr[width_minus_2]<<2)) + ((src_ptr[width_minus_2-1]+src_ptr[width_minus_2+1])<<2) + (src_ptr[width_minus_2-2]+src_ptr[width_minus_2+1]);
-            *(tmp_ptr++) = ((src_ptr[width_minus_1]<<1)+(src_ptr[width_minus_1]<<2)) + ((src_ptr[width_minus_1-1]+src_ptr[width_minus_1])<<2)   + (src_ptr[width_minus_1-2]+src_ptr[width_minus_1]);
-        }
-        
-        const unsigned short* pm2;
-        const unsigned short* pm1;
-        const unsigned short* p;
-        const unsigned short* pp1;
-        const unsigned short* pp2;
-        
-        // Apply vertical filter along top border. This is applied twice as there are two
-        // border pixels.
-        pm2     = tmp;
-        pm1     = tmp;
-        p       = tmp;
-        pp1     = p+width;
-        pp2     = pp1+width;
-        dst_ptr = dst;
-        
-        for(size_t col = 0; col < width; col++, dst_ptr++, pm2++, pm1++, p++, pp1++, pp2++) {
-            *dst_ptr = (((*p<<1)+(*p<<2)) + ((*pm1+*pp1)<<2) + (*pm2+*pp2))*(1.f/256.f);
+            tmp_ptr[width_minus_2] = ((src_ptr[width_minus_2]<<1)+(src_ptr[width_minus_2]<<2)) + ((src_ptr[width_minus_2-1]+src_ptr[width_minus_2+1])<<2) + (src_ptr[width_minus_2-2]+src_ptr[width_minus_2+1]);
+            tmp_ptr[width_minus_1] = ((src_ptr[width_minus_1]<<1)+(src_ptr[width_minus_1]<<2)) + ((src_ptr[width_minus_1-1]+src_ptr[width_minus_1])<<2)   + (src_ptr[width_minus_1-2]+src_ptr[width_minus_1]);
         }
         
-        pm2     = tmp;
-        pm1     = tmp;
-        p       = tmp+width;
-        pp1     = p+width;
-        pp2     = pp1+width;
-        dst_ptr = dst+width;
-        
-        for(size_t col = 0; col < width; col++, dst_ptr++, pm2++, pm1++, p++, pp1++, pp2++) {
-            *dst_ptr = (((*p<<1)+(*p<<2)) + ((*pm1+*pp1)<<2) + (*pm2+*pp2))*(1.f/256.f);
-        }
-        
-        // Apply vertical filter for non-border pixels.
-        pm2 = tmp;
-        pm1 = pm2+width;
-        p   = pm1+width;
-        pp1 = p+width;
-        pp2 = pp1+width;
-        
-        for(size_t row = 2; row < height_minus_2; row++) {
-            pm2 = &tmp[(row-2)*width];
-            pm1 = pm2+width;
-            p   = pm1+width;
-            pp1 = p+width;
-            pp2 = pp1+width;
-            
-            dst_ptr = &dst[row*width];
-            
-            for(size_t col = 0; col < width; col++, dst_ptr++, pm2++, pm1++, p++, pp1++, pp2++) {
-                *dst_ptr = (((*p<<1)+(*p<<2)) + ((*pm1+*pp1)<<2) + (*pm2+*pp2))*(1.f/256.f);
-            }
-        }
-        
-        // Apply vertical filter for bottom border. Similar to top border.
-        pm2     = tmp+(height-4)*width;
-        pm1     = pm2+width;
-        p       = pm1+width;
-        pp1     = p+width;
-        pp2     = pp1;
-        dst_ptr = dst+(height-2)*width;
-        
-        for(size_t col = 0; col < width; col++, dst_ptr++, pm2++, pm1++, p++, pp1++, pp2++) {
-            *dst_ptr = (((*p<<1)+(*p<<2)) + ((*pm1+*pp1)<<2) + (*pm2+*pp2))*(1.f/256.f);
-        }
-        
-        pm2     = tmp+(height-3)*width;
-        pm1     = pm2+width;
-        p       = pm1+width;
-        pp1     = p;
-        pp2     = p;
-        dst_ptr = dst+(height-1)*width;
-        
-        for(size_t col = 0; col < width; col++, dst_ptr++, pm2++, pm1++, p++, pp1++, pp2++) {
-            *dst_ptr = (((*p<<1)+(*p<<2)) + ((*pm1+*pp1)<<2) + (*pm2+*pp2))*(1.f/256.f);
+        // Apply vertical filter. The two border rows at the top and bottom are
+        // computed by extending the border row beyond the image.
+        for(size_t row = 0; row < height; row++) {
+            const unsigned short* pm2 = &tmp[(row < 2 ? 0 : row-2)*width];
+            const unsigned short* pm1 = &tmp[(row < 1 ? 0 : row-1)*width];
+            const unsigned short* p   = &tmp[row*width];
+            const unsigned short* pp1 = &tmp[(row+1 < height ? row+1 : height-1)*width];
+            const unsigned short* pp2 = &tmp[(row+2 < height ? row+2 : height-1)*width];
+            kernels.binomialColumnU16(&dst[row*width], pm2, pm1, p, pp1, pp2, width);
         }
     }
     
@@ -159,109 +93,50 @@ namespace vision {
                             const float* src,
                             size_t width,
                             size_t height) {
+        const detail::PyramidKernels& kernels = GetPyramidKernels();
+        
         float* tmp_ptr;
-        float* dst_ptr;
         
         size_t width_minus_1, width_minus_2;
-        size_t height_minus_2;
         
         ASSERT(width >= 5, "Image is too small");
         ASSERT(height >= 5, "Image is too small");
         
         width_minus_1 = width-1;
         width_minus_2 = width-2;
-        height_minus_2 = height-2;
-        
-        tmp_ptr = tmp;
         
         // Apply horizontal filter
         for(size_t row = 0; row < height; row++) {
             const float* src_ptr = &src[row*width];
+            tmp_ptr = &tmp[row*width];
             
             // Left border is computed by extending the border pixel beyond the image
-            *(tmp_ptr++) = 6.f*src_ptr[0] + 4.f*(src_ptr[0]+src_ptr[1]) + src_ptr[0] + src_ptr[2];
-            *(tmp_ptr++) = 6.f*src_ptr[1] + 4.f*(src_ptr[0]+src_ptr[2]) + src_ptr[0] + src_ptr[3];
+            tmp_ptr[0] = 6.f*src_ptr[0] + 4.f*(src_ptr[0]+src_ptr[1]) + src_ptr[0] + src_ptr[2];
+            tmp_ptr[1] = 6.f*src_ptr[1] + 4.f*(src_ptr[0]+src_ptr[2]) + src_ptr[0] + src_ptr[3];
             
             // Compute non-border pixels
-            for(size_t col = 2; col < width_minus_2; col++, tmp_ptr++) {
-                *tmp_ptr = (6.f*src_ptr[col] + 4.f*(src_ptr[col-1]+src_ptr[col+1]) + src_ptr[col-2] + src_ptr[col+2]);
-            }
+            kernels.binomialRowF32(tmp_ptr, src_ptr, width);
             
             // Right border. Computed similarily as the left border.
-            *(tmp_ptr++) = 6.f*src_ptr[width_minus_2] + 4.f*(src_ptr[width_minus_2-1]+src_ptr[width_minus_2+1]) + src_ptr[width_minus_2-2] + src_ptr[width_minus_2+1];
-            *(tmp_ptr++) = 6.f*src_ptr[width_minus_1] + 4.f*(src_ptr[width_minus_1-1]+src_ptr[width_minus_1])   + src_ptr[width_minus_1-2] + src_ptr[width_minus_1];
-        }
-        
-        const float* pm2;
-        const float* pm1;
-        const float* p;
-        const float* pp1;
-        const float* pp2;
-        
-        // Apply vertical filter along top border. This is applied twice as there are two
-        // border pixels.
-        pm2     = tmp;
-        pm1     = tmp;
-        p       = tmp;
-        pp1     = p+width;
-        pp2     = pp1+width;
-        dst_ptr = dst;
-        
-        for(size_t col = 0; col < width; col++, dst_ptr++, pm2++, pm1++, p++, pp1++, pp2++) {
-            *dst_ptr = (6.f*(*p) + 4.f*(*pm1+*pp1) + (*pm2) + (*pp2))*(1.f/256.f);;
+            tmp_ptr[width_minus_2] = 6.f*src_ptr[width_minus_2] + 4.f*(src_ptr[width_minus_2-1]+src_ptr[width_minus_2+1]) + src_ptr[width_minus_2-2] + src_ptr[width_minus_2+1];
+            tmp_ptr[width_minus_1] = 6.f*src_ptr[width_minus_1] + 4.f*(src_ptr[width_minus_1-1]+src_ptr[width_minus_1])   + src_ptr[width_minus_1-2] + src_ptr[width_minus_1];
         }
         
-        pm2     = tmp;
-        pm1     = tmp;
-        p       = tmp+width;
-        pp1     = p+width;
-        pp2     = pp1+width;
-        dst_ptr = dst+width;
-        
-        for(size_t col = 0; col < width; col++, dst_ptr++, pm2++, pm1++, p++, pp1++, pp2++) {
-            *dst_ptr = (6.f*(*p) + 4.f*(*pm1+*pp1) + (*pm2) + (*pp2))*(1.f/256.f);;
-        }
-        
-        // Apply vertical filter for non-border pixels.
-        for(size_t row = 2; row < height_minus_2; row++) {
-            pm2 = &tmp[(row-2)*width];
-            pm1 = pm2+width;
-            p   = pm1+width;
-            pp1 = p+width;
-            pp2 = pp1+width;
-            
-            dst_ptr = &dst[row*width];
-            
-            for(size_t col = 0; col < width; col++, dst_ptr++, pm2++, pm1++, p++, pp1++, pp2++) {
-                *dst_ptr = (6.f*(*p) + 4.f*(*pm1+*pp1) + (*pm2) + (*pp2))*(1.f/256.f);;
-            }
-        }
-        
-        // Apply vertical filter for bottom border. Similar to top border.
-        pm2     = tmp+(height-4)*width;
-        pm1     = pm2+width;
-        p       = pm1+width;
-        pp1     = p+width;
-        pp2     = pp1;
-        dst_ptr = dst+(height-2)*width;
-        
-        for(size_t col = 0; col < width; col++, dst_ptr++, pm2++, pm1++, p++, pp1++, pp2++) {
-            *dst_ptr = (6.f*(*p) + 4.f*(*pm1+*pp1) + (*pm2) + (*pp2))*(1.f/256.f);;
-        }
-        
-        pm2     = tmp+(height-3)*width;
-        pm1     = pm2+width;
-        p       = pm1+width;
-        pp1     = p;
-        pp2     = p;
-        dst_ptr = dst+(height-1)*width;
-        
-        for(size_t col = 0; col < width; col++, dst_ptr++, pm2++, pm1++, p++, pp1++, pp2++) {
-            *dst_ptr = (6.f*(*p) + 4.f*(*pm1+*pp1) + (*pm2) + (*pp2))*(1.f/256.f);;
+        // Apply vertical filter. The two border rows at the top and bottom are
+        // computed by extending the border row beyond the image.
+        for(size_t row = 0; row < height; row++) {
+            const float* pm2 = &tmp[(row < 2 ? 0 : row-2)*width];
+            const float* pm1 = &tmp[(row < 1 ? 0 : row-1)*width];
+            const float* p   = &tmp[row*width];
+            const float* pp1 = &tmp[(row+1 < height ? row+1 : height-1)*width];
+            const float* pp2 = &tmp[(row+2 < height ? row+2 : height-1)*width];
+            kernels.binomialColumnF32(&dst[row*width], pm2, pm1, p, pp1, pp2, width);
         }
     }
     
     void downsample_bilinear(float* dst, const float* src, size_t src_width, size_t src_height) {
+        const detail::PyramidKernels& kernels = GetPyramidKernels();
+        
         size_t dst_width;
         size_t dst_height;
         const float* src_ptr1;
@@ -273,9 +148,7 @@ namespace vision {
         for(size_t row = 0; row < dst_height; row++) {
             src_ptr1 = &src[(row<<1)*src_width];
             src_ptr2 = src_ptr1 + src_width;
-            for(size_t col = 0; col < dst_width; col++, src_ptr1+=2, src_ptr2+=2) {
-                *(dst++) = (src_ptr1[0]+src_ptr1[1]+src_ptr2[0]+src_ptr2[1])*0.25f;
-            }
+            kernels.downsampleRow(&dst[row*dst_width], src_ptr1, src_ptr2, dst_width);
         }
     }
     
@@ -70,6 +70,11 @@ namespace vision {
          */
         void computeGradients(const GaussianScaleSpacePyramid* pyramid);
         
+        /**
+         * Compute the gradients of the pyramid image at INDEX.
+         */
+        void computeGradient(const GaussianScaleSpacePyramid* pyramid, size_t index);
+        
         /**
          * Compute orientations for a keypont.
          */
@@ -81,6 +86,24 @@ namespace vision {
                      float y,
                      float sigma);
         
+        /**
+         * Compute orientations for a keypont, using HISTOGRAM of numBins() values
+         * as working memory. Calls with different histograms may run concurrently.
+         */
+        void compute(float* angles,
+                     int& num_angles,
+                     float* histogram,
+                     int octave,
+                     int scale,
+                     float x,
+                     float y,
+                     float sigma) const;
+        
+        /**
+         * @return Number of bins in the orientation histogram
+         */
+        inline int numBins() const { return mNumBins; }
+        
         /**
          * @return Vector of images.
          */
@@ -0,0 +1,439 @@
+//
+//  pyramid_kernels.h
+//  ARToolKit5
+//
+//  This file is part of ARToolKit.
+//
+//  ARToolKit is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  ARToolKit is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with ARToolKit.  If not, see <http://www.gnu.org/licenses/>.
+//
+//  As a special exception, the copyright holders of this library give you
+//  permission to link this library with independent modules to produce an
+//  executable, regardless of the license terms of these independent modules, and to
+//  copy and distribute the resulting executable under terms of your choice,
+//  provided that you also meet, for each linked independent module, the terms and
+//  conditions of the license of that module. An independent module is a module
+//  which is neither derived from nor based on this library. If you modify this
+//  library, you may extend this exception to your version of the library, but you
+//  are not obligated to do so. If you do not wish to do so, delete this exception
+//  statement from your version.
+//
+//  Copyright 2013-2015 Daqri, LLC.
+//
+//  Author(s): Chris Broaddus
+//
+
+
+#pragma once
+
+#include <cstddef>
+#include <framework/cpu_features.h>
+
+#if VISION_X86_DISPATCH
+#  include <immintrin.h>
+#endif
+
+namespace vision {
+    
+    /**
+     * Row kernels used by the binomial pyramid and the DoG pyramid. Every kernel
+     * has a scalar, an SSE2 and an AVX2 version. The vector versions evaluate the
+     * same operations in the same order as the scalar one (and never contract to
+     * FMA), so the output is bit-identical whichever version is selected.
+     */
+    namespace detail {
+        
+        //
+        // Horizontal 4th order binomial filter on 8-bit pixels, for the non-border
+        // columns [2, width-2). Sums fit in 16 bits, so the results are exact.
+        //
+        
+        inline void BinomialRowU8Scalar(unsigned short* dst, const unsigned char* src, size_t width) {
+            for(size_t col = 2; col < width-2; col++) {
+                dst[col] = ((src[col]<<1)+(src[col]<<2)) + ((src[col-1]+src[col+1])<<2) + (src[col-2]+src[col+2]);
+            }
+        }
+        
+        //
+        // Vertical 4th order binomial filter on the 16-bit output of the horizontal
+        // pass. The largest sum is 16*16*255 which still fits in 16 bits.
+        //
+        
+        inline void BinomialColumnU16Scalar(float* dst,
+                                            const unsigned short* pm2,
+                                            const unsigned short* pm1,
+                                            const unsigned short* p,
+                                            const unsigned short* pp1,
+                                            const unsigned short* pp2,
+                                            size_t width) {
+            for(size_t col = 0; col < width; col++) {
+                dst[col] = (((p[col]<<1)+(p[col]<<2)) + ((pm1[col]+pp1[col])<<2) + (pm2[col]+pp2[col]))*(1.f/256.f);
+            }
+        }
+        
+        //
+        // Horizontal 4th order binomial filter on float pixels, for the non-border
+        // columns [2, width-2).
+        //
+        
+        inline void BinomialRowF32Scalar(float* dst, const float* src, size_t width) {
+            for(size_t col = 2; col < width-2; col++) {
+                dst[col] = (6.f*src[col] + 4.f*(src[col-1]+src[col+1]) + src[col-2] + src[col+2]);
+            }
+        }
+        
+        //
+        // Vertical 4th order binomial filter on float pixels.
+        //
+        
+        inline void BinomialColumnF32Scalar(float* dst,
+                                            const float* pm2,
+                                            const float* pm1,
+                                            const float* p,
+                                            const float* pp1,
+                                            const float* pp2,
+                                            size_t width) {
+            for(size_t col = 0; col < width; col++) {
+                dst[col] = (6.f*p[col] + 4.f*(pm1[col]+pp1[col]) + pm2[col] + pp2[col])*(1.f/256.f);
+            }
+        }
+        
+        //
+        // Mean of each 2x2 pixel quad of two source rows, for DST_WIDTH quads.
+        //
+        
+        inline void DownsampleRowScalar(float* dst, const float* src1, const float* src2, size_t dst_width) {
+            for(size_t col = 0; col < dst_width; col++, src1+=2, src2+=2) {
+                dst[col] = (src1[0]+src1[1]+src2[0]+src2[1])*0.25f;
+            }
+        }
+        
+        //
+        // DST = SRC1 - SRC2
+        //
+        
+        inline void SubtractRowScalar(float* dst, const float* src1, const float* src2, size_t width) {
+            for(size_t col = 0; col < width; col++) {
+                dst[col] = src1[col]-src2[col];
+            }
+        }
+        
+#if VISION_X86_DISPATCH
+        
+        VISION_TARGET("sse2")
+        inline void BinomialRowU8SSE2(unsigned short* dst, const unsigned char* src, size_t width) {
+            const __m128i zero = _mm_setzero_si128();
+            size_t col = 2;
+            // Loads reach src[col+9], which must not pass src[width-1]
+            for(; col+10 <= width; col += 8) {
+                __m128i m2 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(src+col-2)), zero);
+                __m128i m1 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(src+col-1)), zero);
+                __m128i c  = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(src+col)), zero);
+                __m128i p1 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(src+col+1)), zero);
+                __m128i p2 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(src+col+2)), zero);
+                __m128i s = _mm_add_epi16(_mm_slli_epi16(c, 1), _mm_slli_epi16(c, 2));
+                s = _mm_add_epi16(s, _mm_slli_epi16(_mm_add_epi16(m1, p1), 2));
+                s = _mm_add_epi16(s, _mm_add_epi16(m2, p2));
+                _mm_storeu_si128((__m128i*)(dst+col), s);
+            }
+            for(; col < width-2; col++) {
+                dst[col] = ((src[col]<<1)+(src[col]<<2)) + ((src[col-1]+src[col+1])<<2) + (src[col-2]+src[col+2]);
+            }
+        }
+        
+        VISION_TARGET("avx2")
+        inline void BinomialRowU8AVX2(unsigned short* dst, const unsigned char* src, size_t width) {
+            size_t col = 2;
+            // Loads reach src[col+17], which must not pass src[width-1]
+            for(; col+18 <= width; col += 16) {
+                __m256i m2 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(src+col-2)));
+                __m256i m1 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(src+col-1)));
+                __m256i c  = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(src+col)));
+                __m256i p1 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(src+col+1)));
+                __m256i p2 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(src+col+2)));
+                __m256i s = _mm256_add_epi16(_mm256_slli_epi16(c, 1), _mm256_slli_epi16(c, 2));
+                s = _mm256_add_epi16(s, _mm256_slli_epi16(_mm256_add_epi16(m1, p1), 2));
+                s = _mm256_add_epi16(s, _mm256_add_epi16(m2, p2));
+                _mm256_storeu_si256((__m256i*)(dst+col), s);
+            }
+            for(; col < width-2; col++) {
+                dst[col] = ((src[col]<<1)+(src[col]<<2)) + ((src[col-1]+src[col+1])<<2) + (src[col-2]+src[col+2]);
+            }
+        }
+        
+        VISION_TARGET("sse2")
+        inline void BinomialColumnU16SSE2(float* dst,
+                                          const unsigned short* pm2,
+                                          const unsigned short* pm1,
+                                          const unsigned short* p,
+                                          const unsigned short* pp1,
+                                          const unsigned short* pp2,
+                                          size_t width) {
+            const __m128i zero = _mm_setzero_si128();
+            const __m128 scale = _mm_set1_ps(1.f/256.f);
+            size_t col = 0;
+            for(; col+8 <= width; col += 8) {
+                __m128i c = _mm_loadu_si128((const __m128i*)(p+col));
+                __m128i s = _mm_add_epi16(_mm_slli_epi16(c, 1), _mm_slli_epi16(c, 2));
+                s = _mm_add_epi16(s, _mm_slli_epi16(_mm_add_epi16(_mm_loadu_si128((const __m128i*)(pm1+col)),
+                                                                  _mm_loadu_si128((const __m128i*)(pp1+col))), 2));
+                s = _mm_add_epi16(s, _mm_add_epi16(_mm_loadu_si128((const __m128i*)(pm2+col)),
+                                                   _mm_loadu_si128((const __m128i*)(pp2+col))));
+                _mm_storeu_ps(dst+col,   _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(s, zero)), scale));
+                _mm_storeu_ps(dst+col+4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(s, zero)), scale));
+            }
+            for(; col < width; col++) {
+                dst[col] = (((p[col]<<1)+(p[col]<<2)) + ((pm1[col]+pp1[col])<<2) + (pm2[col]+pp2[col]))*(1.f/256.f);
+            }
+        }
+        
+        VISION_TARGET("avx2")
+        inline void BinomialColumnU16AVX2(float* dst,
+                                          const unsigned short* pm2,
+                                          const unsigned short* pm1,
+                                          const unsigned short* p,
+                                          const unsigned short* pp1,
+                                          const unsigned short* pp2,
+                                          size_t width) {
+            const __m256 scale = _mm256_set1_ps(1.f/256.f);
+            size_t col = 0;
+            for(; col+16 <= width; col += 16) {
+                __m256i c = _mm256_loadu_si256((const __m256i*)(p+col));
+                __m256i s = _mm256_add_epi16(_mm256_slli_epi16(c, 1), _mm256_slli_epi16(c, 2));
+                s = _mm256_add_epi16(s, _mm256_slli_epi16(_mm256_add_epi16(_mm256_loadu_si256((const __m256i*)(pm1+col)),
+                                                                           _mm256_loadu_si256((const __m256i*)(pp1+col))), 2));
+                s = _mm256_add_epi16(s, _mm256_add_epi16(_mm256_loadu_si256((const __m256i*)(pm2+col)),
+                                                         _mm256_loadu_si256((const __m256i*)(pp2+col))));
+                __m256i lo = _mm256_cvtepu16_epi32(_mm256_castsi256_si128(s));
+                __m256i hi = _mm256_cvtepu16_epi32(_mm256_extracti128_si256(s, 1));
+                _mm256_storeu_ps(dst+col,   _mm256_mul_ps(_mm256_cvtepi32_ps(lo), scale));
+                _mm256_storeu_ps(dst+col+8, _mm256_mul_ps(_mm256_cvtepi32_ps(hi), scale));
+            }
+            for(; col < width; col++) {
+                dst[col] = (((p[col]<<1)+(p[col]<<2)) + ((pm1[col]+pp1[col])<<2) + (pm2[col]+pp2[col]))*(1.f/256.f);
+            }
+        }
+        
+        VISION_TARGET("sse2")
+        inline void BinomialRowF32SSE2(float* dst, const float* src, size_t width) {
+            const __m128 six = _mm_set1_ps(6.f);
+            const __m128 four = _mm_set1_ps(4.f);
+            size_t col = 2;
+            for(; col+6 <= width; col += 4) {
+                __m128 s = _mm_mul_ps(six, _mm_loadu_ps(src+col));
+                s = _mm_add_ps(s, _mm_mul_ps(four, _mm_add_ps(_mm_loadu_ps(src+col-1), _mm_loadu_ps(src+col+1))));
+                s = _mm_add_ps(s, _mm_loadu_ps(src+col-2));
+                s = _mm_add_ps(s, _mm_loadu_ps(src+col+2));
+                _mm_storeu_ps(dst+col, s);
+            }
+            for(; col < width-2; col++) {
+                dst[col] = (6.f*src[col] + 4.f*(src[col-1]+src[col+1]) + src[col-2] + src[col+2]);
+            }
+        }
+        
+        VISION_TARGET("avx2")
+        inline void BinomialRowF32AVX2(float* dst, const float* src, size_t width) {
+            const __m256 six = _mm256_set1_ps(6.f);
+            const __m256 four = _mm256_set1_ps(4.f);
+            size_t col = 2;
+            for(; col+10 <= width; col += 8) {
+                __m256 s = _mm256_mul_ps(six, _mm256_loadu_ps(src+col));
+                s = _mm256_add_ps(s, _mm256_mul_ps(four, _mm256_add_ps(_mm256_loadu_ps(src+col-1), _mm256_loadu_ps(src+col+1))));
+                s = _mm256_add_ps(s, _mm256_loadu_ps(src+col-2));
+                s = _mm256_add_ps(s, _mm256_loadu_ps(src+col+2));
+                _mm256_storeu_ps(dst+col, s);
+            }
+            for(; col < width-2; col++) {
+                dst[col] = (6.f*src[col] + 4.f*(src[col-1]+src[col+1]) + src[col-2] + src[col+2]);
+            }
+        }
+        
+        VISION_TARGET("sse2")
+        inline void BinomialColumnF32SSE2(float* dst,
+                                          const float* pm2,
+                                          const float* pm1,
+                                          const float* p,
+                                          const float* pp1,
+                                          const float* pp2,
+                                          size_t width) {
+            const __m128 six = _mm_set1_ps(6.f);
+            const __m128 four = _mm_set1_ps(4.f);
+            const __m128 scale = _mm_set1_ps(1.f/256.f);
+            size_t col = 0;
+            for(; col+4 <= width; col += 4) {
+                __m128 s = _mm_mul_ps(six, _mm_loadu_ps(p+col));
+                s = _mm_add_ps(s, _mm_mul_ps(four, _mm_add_ps(_mm_loadu_ps(pm1+col), _mm_loadu_ps(pp1+col))));
+                s = _mm_add_ps(s, _mm_loadu_ps(pm2+col));
+                s = _mm_add_ps(s, _mm_loadu_ps(pp2+col));
+                _mm_storeu_ps(dst+col, _mm_mul_ps(s, scale));
+            }
+            for(; col < width; col++) {
+                dst[col] = (6.f*p[col] + 4.f*(pm1[col]+pp1[col]) + pm2[col] + pp2[col])*(1.f/256.f);
+            }
+        }
+        
+        VISION_TARGET("avx2")
+        inline void BinomialColumnF32AVX2(float* dst,
+                                          const float* pm2,
+                                          const float* pm1,
+                                          const float* p,
+                                          const float* pp1,
+                                          const float* pp2,
+                                          size_t width) {
+            const __m256 six = _mm256_set1_ps(6.f);
+            const __m256 four = _mm256_set1_ps(4.f);
+            const __m256 scale = _mm256_set1_ps(1.f/256.f);
+            size_t col = 0;
+            for(; col+8 <= width; col += 8) {
+                __m256 s = _mm256_mul_ps(six, _mm256_loadu_ps(p+col));
+                s = _mm256_add_ps(s, _mm256_mul_ps(four, _mm256_add_ps(_mm256_loadu_ps(pm1+col), _mm256_loadu_ps(pp1+col))));
+                s = _mm256_add_ps(s, _mm256_loadu_ps(pm2+col));
+                s = _mm256_add_ps(s, _mm256_loadu_ps(pp2+col));
+                _mm256_storeu_ps(dst+col, _mm256_mul_ps(s, scale));
+            }
+            for(; col < width; col++) {
+                dst[col] = (6.f*p[col] + 4.f*(pm1[col]+pp1[col]) + pm2[col] + pp2[col])*(1.f/256.f);
+            }
+        }
+        
+        VISION_TARGET("sse2")
+        inline void DownsampleRowSSE2(float* dst, const float* src1, const float* src2, size_t dst_width) {
+            const __m128 quarter = _mm_set1_ps(0.25f);
+            size_t col = 0;
+            for(; col+4 <= dst_width; col += 4, src1+=8, src2+=8) {
+                __m128 a0 = _mm_loadu_ps(src1);
+                __m128 a1 = _mm_loadu_ps(src1+4);
+                __m128 b0 = _mm_loadu_ps(src2);
+                __m128 b1 = _mm_loadu_ps(src2+4);
+                __m128 s = _mm_add_ps(_mm_shuffle_ps(a0, a1, _MM_SHUFFLE(2, 0, 2, 0)),
+                                      _mm_shuffle_ps(a0, a1, _MM_SHUFFLE(3, 1, 3, 1)));
+                s = _mm_add_ps(s, _mm_shuffle_ps(b0, b1, _MM_SHUFFLE(2, 0, 2, 0)));
+                s = _mm_add_ps(s, _mm_shuffle_ps(b0, b1, _MM_SHUFFLE(3, 1, 3, 1)));
+                _mm_storeu_ps(dst+col, _mm_mul_ps(s, quarter));
+            }
+            for(; col < dst_width; col++, src1+=2, src2+=2) {
+                dst[col] = (src1[0]+src1[1]+src2[0]+src2[1])*0.25f;
+            }
+        }
+        
+        VISION_TARGET("avx2")
+        inline void DownsampleRowAVX2(float* dst, const float* src1, const float* src2, size_t dst_width) {
+            const __m256 quarter = _mm256_set1_ps(0.25f);
+            size_t col = 0;
+            for(; col+8 <= dst_width; col += 8, src1+=16, src2+=16) {
+                __m256 a0 = _mm256_loadu_ps(src1);
+                __m256 a1 = _mm256_loadu_ps(src1+8);
+                __m256 b0 = _mm256_loadu_ps(src2);
+                __m256 b1 = _mm256_loadu_ps(src2+8);
+                // Shuffles work within 128-bit lanes, so the quads come out in the
+                // order 0 1 4 5 2 3 6 7 and are put back in order before the store.
+                __m256 s = _mm256_add_ps(_mm256_shuffle_ps(a0, a1, _MM_SHUFFLE(2, 0, 2, 0)),
+                                         _mm256_shuffle_ps(a0, a1, _MM_SHUFFLE(3, 1, 3, 1)));
+                s = _mm256_add_ps(s, _mm256_shuffle_ps(b0, b1, _MM_SHUFFLE(2, 0, 2, 0)));
+                s = _mm256_add_ps(s, _mm256_shuffle_ps(b0, b1, _MM_SHUFFLE(3, 1, 3, 1)));
+                s = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(s), _MM_SHUFFLE(3, 1, 2, 0)));
+                _mm256_storeu_ps(dst+col, _mm256_mul_ps(s, quarter));
+            }
+            for(; col < dst_width; col++, src1+=2, src2+=2) {
+                dst[col] = (src1[0]+src1[1]+src2[0]+src2[1])*0.25f;
+            }
+        }
+        
+        VISION_TARGET("sse2")
+        inline void SubtractRowSSE2(float* dst, const float* src1, const float* src2, size_t width) {
+            size_t col = 0;
+            for(; col+4 <= width; col += 4) {
+                _mm_storeu_ps(dst+col, _mm_sub_ps(_mm_loadu_ps(src1+col), _mm_loadu_ps(src2+col)));
+            }
+            for(; col < width; col++) {
+                dst[col] = src1[col]-src2[col];
+            }
+        }
+        
+        VISION_TARGET("avx2")
+        inline void SubtractRowAVX2(float* dst, const float* src1, const float* src2, size_t width) {
+            size_t col = 0;
+            for(; col+8 <= width; col += 8) {
+                _mm256_storeu_ps(dst+col, _mm256_sub_ps(_mm256_loadu_ps(src1+col), _mm256_loadu_ps(src2+col)));
+            }
+            for(; col < width; col++) {
+                dst[col] = src1[col]-src2[col];
+            }
+        }
+        
+#endif // VISION_X86_DISPATCH
+        
+        /**
+         * Set of row kernels for one instruction set.
+         */
+        struct PyramidKernels {
+            void (*binomialRowU8)(unsigned short*, const unsigned char*, size_t);
+            void (*binomialColumnU16)(float*, const unsigned short*, const unsigned short*, const unsigned short*,
+                                      const unsigned short*, const unsigned short*, size_t);
+            void (*binomialRowF32)(float*, const float*, size_t);
+            void (*binomialColumnF32)(float*, const float*, const float*, const float*,
+                                      const float*, const float*, size_t);
+            void (*downsampleRow)(float*, const float*, const float*, size_t);
+            void (*subtractRow)(float*, const float*, const float*, size_t);
+        };
+        
+        /**
+         * Select the fastest kernels for this CPU.
+         */
+        inline PyramidKernels SelectPyramidKernels() {
+#if VISION_X86_DISPATCH
+            if(GetCpuFeatures().avx2) {
+                PyramidKernels k = {
+                    &BinomialRowU8AVX2,
+                    &BinomialColumnU16AVX2,
+                    &BinomialRowF32AVX2,
+                    &BinomialColumnF32AVX2,
+                    &DownsampleRowAVX2,
+                    &SubtractRowAVX2
+                };
+                return k;
+            }
+            if(GetCpuFeatures().sse2) {
+                PyramidKernels k = {
+                    &BinomialRowU8SSE2,
+                    &BinomialColumnU16SSE2,
+                    &BinomialRowF32SSE2,
+                    &BinomialColumnF32SSE2,
+                    &DownsampleRowSSE2,
+                    &SubtractRowSSE2
+                };
+                return k;
+            }
+#endif
+            PyramidKernels k = {
+                &BinomialRowU8Scalar,
+                &BinomialColumnU16Scalar,
+                &BinomialRowF32Scalar,
+                &BinomialColumnF32Scalar,
+                &DownsampleRowScalar,
+                &SubtractRowScalar
+            };
+            return k;
+        }
+        
+    } // detail
+    
+    /**
+     * @return Row kernels of the pyramid filters, selected on first use.
+     */
+    inline const detail::PyramidKernels& GetPyramidKernels() {
+        static const detail::PyramidKernels kernels = detail::SelectPyramidKernels();
+        return kernels;
+    }
+    
+} // vision
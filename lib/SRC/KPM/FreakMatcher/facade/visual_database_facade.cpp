@@ -151,6 +151,50 @@ namespace vision {
         return mVisualDbImpl->mVdb->inliers();
     }
     
+    void VisualDatabaseFacade::setNumQueryThreads(int n){
+        mVisualDbImpl->mVdb->setNumQueryThreads(n);
+    }
+    
+    int VisualDatabaseFacade::numQueryThreads() const{
+        return mVisualDbImpl->mVdb->numQueryThreads();
+    }
+    
+    void VisualDatabaseFacade::setNumDetectorThreads(int n){
+        mVisualDbImpl->mVdb->detector().setNumThreads(n);
+    }
+    
+    int VisualDatabaseFacade::numDetectorThreads() const{
+        return mVisualDbImpl->mVdb->detector().numThreads();
+    }
+    
+    void VisualDatabaseFacade::setEarlyExitInliers(int n){
+        mVisualDbImpl->mVdb->setEarlyExitInliers(n > 0 ? (size_t)n : 0);
+    }
+    
+    int VisualDatabaseFacade::earlyExitInliers() const{
+        return (int)mVisualDbImpl->mVdb->earlyExitInliers();
+    }
+    
+    void VisualDatabaseFacade::setImageGroup(int image_id, int group_id){
+        mVisualDbImpl->mVdb->setKeyframeGroup(image_id, group_id);
+    }
+    
+    void VisualDatabaseFacade::setUseGlobalIndex(bool b){
+        mVisualDbImpl->mVdb->setUseGlobalIndex(b);
+    }
+    
+    bool VisualDatabaseFacade::useGlobalIndex() const{
+        return mVisualDbImpl->mVdb->useGlobalIndex();
+    }
+    
+    void VisualDatabaseFacade::setShortlistSize(int n){
+        mVisualDbImpl->mVdb->setShortlistSize(n > 0 ? (size_t)n : 1);
+    }
+    
+    int VisualDatabaseFacade::shortlistSize() const{
+        return (int)mVisualDbImpl->mVdb->shortlistSize();
+    }
+    
     int VisualDatabaseFacade::getWidth(int image_id) const{
         return mVisualDbImpl->mVdb->keyframe(image_id)->width();
     }
@@ -92,6 +92,28 @@ namespace vision {
         
         const matches_t& inliers() const;
         
+        void setNumQueryThreads(int n);
+        
+        int numQueryThreads() const;
+        
+        void setNumDetectorThreads(int n);
+        
+        int numDetectorThreads() const;
+        
+        void setEarlyExitInliers(int n);
+        
+        int earlyExitInliers() const;
+        
+        void setImageGroup(int image_id, int group_id);
+        
+        void setUseGlobalIndex(bool b);
+        
+        bool useGlobalIndex() const;
+        
+        void setShortlistSize(int n);
+        
+        int shortlistSize() const;
+        
     private:
         std::unique_ptr<VisualDatabaseImpl> mVisualDbImpl;
     }; // VisualDatabaseFacade
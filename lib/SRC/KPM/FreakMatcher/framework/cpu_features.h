@@ -0,0 +1,141 @@
+//
+//  cpu_features.h
+//  ARToolKit5
+//
+//  This file is part of ARToolKit.
+//
+//  ARToolKit is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  ARToolKit is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with ARToolKit.  If not, see <http://www.gnu.org/licenses/>.
+//
+//  As a special exception, the copyright holders of this library give you
+//  permission to link this library with independent modules to produce an
+//  executable, regardless of the license terms of these independent modules, and to
+//  copy and distribute the resulting executable under terms of your choice,
+//  provided that you also meet, for each linked independent module, the terms and
+//  conditions of the license of that module. An independent module is a module
+//  which is neither derived from nor based on this library. If you modify this
+//  library, you may extend this exception to your version of the library, but you
+//  are not obligated to do so. If you do not wish to do so, delete this exception
+//  statement from your version.
+//
+//  Copyright 2013-2015 Daqri, LLC.
+//
+//  Author(s): Chris Broaddus
+//
+
+#pragma once
+
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+#  define VISION_X86 1
+#  if defined(_MSC_VER)
+#    include <intrin.h>
+#  else
+#    include <cpuid.h>
+#  endif
+#else
+#  define VISION_X86 0
+#endif
+
+// Compilers that can build functions for instruction sets not enabled on the
+// command line, so they can be selected at runtime.
+#if VISION_X86 && (defined(_MSC_VER) || defined(__GNUC__) || defined(__clang__))
+#  define VISION_X86_DISPATCH 1
+#  if defined(_MSC_VER) && !defined(__clang__)
+#    define VISION_TARGET(X)
+#  else
+#    define VISION_TARGET(X) __attribute__((target(X)))
+#  endif
+#else
+#  define VISION_X86_DISPATCH 0
+#endif
+
+namespace vision {
+    
+    /**
+     * Instruction set extensions usable on this CPU and OS.
+     */
+    struct CpuFeatures {
+        bool sse2;
+        bool ssse3;
+        bool sse41;
+        bool popcnt;
+        bool avx;
+        bool avx2;
+    };
+    
+    namespace detail {
+        
+#if VISION_X86
+        inline void cpuid(unsigned int leaf, unsigned int subleaf, unsigned int regs[4]) {
+#if defined(_MSC_VER)
+            int r[4];
+            __cpuidex(r, (int)leaf, (int)subleaf);
+            for(int i = 0; i < 4; i++) {
+                regs[i] = (unsigned int)r[i];
+            }
+#else
+            __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+        }
+        
+        inline unsigned long long xgetbv0() {
+#if defined(_MSC_VER)
+            return _xgetbv(0);
+#else
+            unsigned int eax, edx;
+            __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+            return ((unsigned long long)edx << 32) | eax;
+#endif
+        }
+#endif
+        
+        inline CpuFeatures DetectCpuFeatures() {
+            CpuFeatures f = {false, false, false, false, false, false};
+#if VISION_X86
+            unsigned int regs[4];
+            cpuid(0, 0, regs);
+            unsigned int max_leaf = regs[0];
+            if(max_leaf < 1) {
+                return f;
+            }
+            
+            cpuid(1, 0, regs);
+            f.sse2   = (regs[3] & (1u << 26)) != 0;
+            f.ssse3  = (regs[2] & (1u << 9)) != 0;
+            f.sse41  = (regs[2] & (1u << 19)) != 0;
+            f.popcnt = (regs[2] & (1u << 23)) != 0;
+            
+            // AVX also needs the OS to save the YMM registers
+            bool osxsave = (regs[2] & (1u << 27)) != 0;
+            bool avx = (regs[2] & (1u << 28)) != 0;
+            f.avx = avx && osxsave && (xgetbv0() & 0x6) == 0x6;
+            
+            if(f.avx && max_leaf >= 7) {
+                cpuid(7, 0, regs);
+                f.avx2 = (regs[1] & (1u << 5)) != 0;
+            }
+#endif
+            return f;
+        }
+        
+    } // detail
+    
+    /**
+     * @return Instruction set extensions of the CPU, detected on first use.
+     */
+    inline const CpuFeatures& GetCpuFeatures() {
+        static const CpuFeatures features = detail::DetectCpuFeatures();
+        return features;
+    }
+    
+} // vision
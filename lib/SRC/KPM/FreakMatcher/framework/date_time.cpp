@@ -42,13 +42,18 @@ namespace vision {
     std::string get_pretty_time() {
         const char* const format = "%m-%d-%Y-%H-%M-%S";
 		time_t t;
-		struct std::tm* timeinfo;
+		struct std::tm timeinfo;
 		
 		time(&t);
-		timeinfo = localtime(&t);
+		// Reentrant forms, as this may be called from several threads at once.
+#ifdef _WIN32
+		localtime_s(&timeinfo, &t);
+#else
+		localtime_r(&t, &timeinfo);
+#endif
 		
 		char str[256];
-        std::strftime(str, sizeof(str), format, timeinfo);
+        std::strftime(str, sizeof(str), format, &timeinfo);
         
         return std::string(str);
     }
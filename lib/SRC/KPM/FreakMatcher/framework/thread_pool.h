@@ -0,0 +1,227 @@
+//
+//  thread_pool.h
+//  ARToolKit5
+//
+//  This file is part of ARToolKit.
+//
+//  ARToolKit is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  ARToolKit is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with ARToolKit.  If not, see <http://www.gnu.org/licenses/>.
+//
+//  As a special exception, the copyright holders of this library give you
+//  permission to link this library with independent modules to produce an
+//  executable, regardless of the license terms of these independent modules, and to
+//  copy and distribute the resulting executable under terms of your choice,
+//  provided that you also meet, for each linked independent module, the terms and
+//  conditions of the license of that module. An independent module is a module
+//  which is neither derived from nor based on this library. If you modify this
+//  library, you may extend this exception to your version of the library, but you
+//  are not obligated to do so. If you do not wish to do so, delete this exception
+//  statement from your version.
+//
+//  Copyright 2013-2015 Daqri, LLC.
+//
+//  Author(s): Chris Broaddus
+//
+
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <exception>
+#include <cstddef>
+
+namespace vision {
+
+    /**
+     * Implements a small pool of persistent worker threads that run the
+     * iterations of a loop concurrently. The calling thread takes part in
+     * every loop, so a pool of one thread runs the loop inline.
+     */
+    class ThreadPool {
+    public:
+        
+        /**
+         * @param numThreads Total number of threads, including the caller.
+         *        Values less than 1 select one thread per hardware core.
+         */
+        ThreadPool(int numThreads = 0)
+        : mNumThreads(0)
+        , mQuit(false)
+        , mGeneration(0)
+        , mFn(NULL)
+        , mNumIterations(0)
+        , mNextIteration(0)
+        , mNumBusy(0) {
+            setNumThreads(numThreads);
+        }
+        
+        ~ThreadPool() {
+            stopWorkers();
+        }
+        
+        /**
+         * Set the total number of threads, including the caller.
+         * Values less than 1 select one thread per hardware core.
+         */
+        void setNumThreads(int numThreads) {
+            if(numThreads < 1) {
+                numThreads = DefaultNumThreads();
+            }
+            if(numThreads == mNumThreads) {
+                return;
+            }
+            stopWorkers();
+            mNumThreads = numThreads;
+            mQuit = false;
+            // New workers start from the current generation, so they wait for the next loop
+            // rather than treating one that has already completed as new.
+            for(int i = 1; i < mNumThreads; i++) {
+                mWorkers.push_back(std::thread(&ThreadPool::workerMain, this, i, mGeneration));
+            }
+        }
+        
+        /**
+         * @return Total number of threads, including the caller
+         */
+        inline int numThreads() const { return mNumThreads; }
+        
+        /**
+         * Call FN(i, thread) once for every i in [0, N), where THREAD in
+         * [0, numThreads()) identifies the thread making the call. Returns once
+         * all calls have completed. An exception thrown by FN is rethrown here.
+         * Not reentrant: FN must not itself call parallelFor on this pool.
+         */
+        void parallelFor(int n, const std::function<void(int, int)>& fn) {
+            if(n <= 0) {
+                return;
+            }
+            if(mWorkers.empty() || n == 1) {
+                for(int i = 0; i < n; i++) {
+                    fn(i, 0);
+                }
+                return;
+            }
+            
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mFn = &fn;
+                mNumIterations = n;
+                mNextIteration = 0;
+                mException = std::exception_ptr();
+                mNumBusy = (int)mWorkers.size();
+                mGeneration++;
+            }
+            mStartCondition.notify_all();
+            
+            runIterations(0);
+            
+            std::unique_lock<std::mutex> lock(mMutex);
+            mDoneCondition.wait(lock, [this] { return mNumBusy == 0; });
+            mFn = NULL;
+            if(mException) {
+                std::exception_ptr e = mException;
+                mException = std::exception_ptr();
+                std::rethrow_exception(e);
+            }
+        }
+        
+        /**
+         * @return Number of hardware threads, or 1 if unknown
+         */
+        static int DefaultNumThreads() {
+            unsigned int n = std::thread::hardware_concurrency();
+            return n > 0 ? (int)n : 1;
+        }
+        
+    private:
+        
+        // Disable copy
+        ThreadPool(const ThreadPool&);
+        ThreadPool& operator=(const ThreadPool&);
+        
+        void runIterations(int thread) {
+            for(;;) {
+                int i = mNextIteration++;
+                if(i >= mNumIterations) {
+                    break;
+                }
+                try {
+                    (*mFn)(i, thread);
+                } catch(...) {
+                    std::lock_guard<std::mutex> lock(mMutex);
+                    if(!mException) {
+                        mException = std::current_exception();
+                    }
+                }
+            }
+        }
+        
+        void workerMain(int thread, unsigned int generation) {
+            for(;;) {
+                {
+                    std::unique_lock<std::mutex> lock(mMutex);
+                    mStartCondition.wait(lock, [this, generation] { return mQuit || mGeneration != generation; });
+                    if(mQuit) {
+                        return;
+                    }
+                    generation = mGeneration;
+                }
+                
+                runIterations(thread);
+                
+                {
+                    std::lock_guard<std::mutex> lock(mMutex);
+                    mNumBusy--;
+                }
+                mDoneCondition.notify_one();
+            }
+        }
+        
+        void stopWorkers() {
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mQuit = true;
+            }
+            mStartCondition.notify_all();
+            for(size_t i = 0; i < mWorkers.size(); i++) {
+                mWorkers[i].join();
+            }
+            mWorkers.clear();
+        }
+        
+        // Total number of threads, including the caller
+        int mNumThreads;
+        
+        // Worker threads (all but the caller)
+        std::vector<std::thread> mWorkers;
+        
+        std::mutex mMutex;
+        std::condition_variable mStartCondition;
+        std::condition_variable mDoneCondition;
+        bool mQuit;
+        unsigned int mGeneration;
+        
+        // Current loop
+        const std::function<void(int, int)>* mFn;
+        int mNumIterations;
+        std::atomic<int> mNextIteration;
+        int mNumBusy;
+        std::exception_ptr mException;
+        
+    }; // ThreadPool
+    
+} // vision
@@ -41,6 +41,7 @@
 #include <math/cholesky_linear_solvers.h>
 #include <math/robustifiers.h>
 #include <utils/partial_sort.h>
+#include <framework/thread_pool.h>
 
 #include <Eigen/Core>
 #include <Eigen/LU>
@@ -54,6 +55,10 @@ namespace vision {
 #define HOMOGRAPHY_DEFAULT_MAX_TRIALS           1064
 #define HOMOGRAPHY_DEFAULT_CHUNK_SIZE           50
     
+// Number of trials solved, or hypotheses scored, by one task
+#define HOMOGRAPHY_TRIALS_PER_TASK              16
+#define HOMOGRAPHY_HYPOTHESES_PER_TASK          32
+    
     /**
      * Compute the Cauchy reprojection cost for H*p-q.
      */
@@ -90,8 +95,49 @@ namespace vision {
         return total_cost;
     }
     
+    /**
+     * Add the Cauchy reprojection cost of H*p_k-q_k, for the points k selected by
+     * INDICES, to COST. The terms are added in order so the result is the same
+     * as adding them one at a time.
+     */
+    template<typename T>
+    inline void AccumulateCauchyProjectiveReprojectionCost(T& cost,
+                                                           const T H[9],
+                                                           const T* p,
+                                                           const T* q,
+                                                           const int* indices,
+                                                           int num_points,
+                                                           T one_over_scale2) {
+        const int block_size = 64;
+        T t[block_size];
+        
+        for(int i = 0; i < num_points; i += block_size) {
+            int n = min2(block_size, num_points-i);
+            
+            // The projections have no dependencies between points and can be
+            // vectorised, unlike the logs below.
+            for(int k = 0; k < n; k++) {
+                const T* pk = &p[indices[i+k]<<1];
+                const T* qk = &q[indices[i+k]<<1];
+                T x, y;
+                MultiplyPointHomographyInhomogenous(x, y, H, pk[0], pk[1]);
+                x -= qk[0];
+                y -= qk[1];
+                t[k] = 1+(x*x+y*y)*one_over_scale2;
+            }
+            
+            for(int k = 0; k < n; k++) {
+                cost += std::log(t[k]);
+            }
+        }
+    }
+    
     /**
      * Robustly solve for the homography given a set of correspondences. 
+     *
+     * If POOL is given, the hypotheses are solved and scored on its threads.
+     * The random samples are drawn and the hypotheses ranked in the same order
+     * as without it, so the result does not depend on the number of threads.
      */
     template<typename T>
     bool PreemptiveRobustHomography(T H[9],
@@ -106,12 +152,13 @@ namespace vision {
                                     T scale = HOMOGRAPHY_DEFAULT_CAUCHY_SCALE,
                                     int max_num_hypotheses = HOMOGRAPHY_DEFAULT_NUM_HYPOTHESES,
                                     int max_trials = HOMOGRAPHY_DEFAULT_MAX_TRIALS,
-                                    int chunk_size = HOMOGRAPHY_DEFAULT_CHUNK_SIZE) {
+                                    int chunk_size = HOMOGRAPHY_DEFAULT_CHUNK_SIZE,
+                                    ThreadPool* pool = NULL) {
         int* hyp_perm;
         T one_over_scale2;
         T min_cost;
         int num_hypotheses, num_hypotheses_remaining, min_index;
-        int cur_chunk_size, this_chunk_end;
+        int cur_chunk_size;
         int trial;
         int seed;
         int sample_size = 4;
@@ -138,47 +185,81 @@ namespace vision {
         // Shuffle the indices
         ArrayShuffle(hyp_perm, num_points, num_points, seed);
 
-        // Compute a set of hypotheses
+        // Compute a set of hypotheses. The samples of a block of trials are drawn
+        // in order, and then the trials are solved concurrently. A block is never
+        // larger than the number of hypotheses still needed, so no more samples
+        // are drawn than when solving one trial at a time.
+        const int max_block_size = 256;
+        int samples[4*max_block_size];
+        bool valid[max_block_size];
+        
         for(trial = 0, num_hypotheses = 0;
-            trial < max_trials && num_hypotheses < max_num_hypotheses;
-            trial++) {
+            trial < max_trials && num_hypotheses < max_num_hypotheses;) {
             
-            // Shuffle the first SAMPLE_SIZE indices
-            ArrayShuffle(hyp_perm, num_points, sample_size, seed);
+            int block_size = min2(max_block_size, min2(max_trials-trial, max_num_hypotheses-num_hypotheses));
             
-            // Check if the four points are geometrically valid
-            if(!Homography4PointsGeometricallyConsistent(&p[hyp_perm[0]<<1],
-                                                         &p[hyp_perm[1]<<1],
-                                                         &p[hyp_perm[2]<<1],
-                                                         &p[hyp_perm[3]<<1],
-                                                         &q[hyp_perm[0]<<1],
-                                                         &q[hyp_perm[1]<<1],
-                                                         &q[hyp_perm[2]<<1],
-                                                         &q[hyp_perm[3]<<1])) {
-                continue;
+            for(int i = 0; i < block_size; i++) {
+                // Shuffle the first SAMPLE_SIZE indices
+                ArrayShuffle(hyp_perm, num_points, sample_size, seed);
+                CopyVector(&samples[i*4], hyp_perm, 4);
             }
             
-            // Compute the homography
-            if(!SolveHomography4Points(&hyp[num_hypotheses*9],
-                                       &p[hyp_perm[0]<<1],
-                                       &p[hyp_perm[1]<<1],
-                                       &p[hyp_perm[2]<<1],
-                                       &p[hyp_perm[3]<<1],
-                                       &q[hyp_perm[0]<<1],
-                                       &q[hyp_perm[1]<<1],
-                                       &q[hyp_perm[2]<<1],
-                                       &q[hyp_perm[3]<<1])) {
-                continue;
+            // Solve the trials in place of the next hypotheses
+            T* block_hyp = &hyp[num_hypotheses*9];
+            const int* block_samples = samples;
+            bool* block_valid = valid;
+            auto solve = [&](int task, int) {
+                int end = min2(block_size, (task+1)*HOMOGRAPHY_TRIALS_PER_TASK);
+                for(int i = task*HOMOGRAPHY_TRIALS_PER_TASK; i < end; i++) {
+                    const int* s = &block_samples[i*4];
+                    
+                    // Check if the four points are geometrically valid
+                    block_valid[i] = Homography4PointsGeometricallyConsistent(&p[s[0]<<1],
+                                                                              &p[s[1]<<1],
+                                                                              &p[s[2]<<1],
+                                                                              &p[s[3]<<1],
+                                                                              &q[s[0]<<1],
+                                                                              &q[s[1]<<1],
+                                                                              &q[s[2]<<1],
+                                                                              &q[s[3]<<1]);
+                    
+                    // Compute the homography
+                    block_valid[i] = block_valid[i] && SolveHomography4Points(&block_hyp[i*9],
+                                                                              &p[s[0]<<1],
+                                                                              &p[s[1]<<1],
+                                                                              &p[s[2]<<1],
+                                                                              &p[s[3]<<1],
+                                                                              &q[s[0]<<1],
+                                                                              &q[s[1]<<1],
+                                                                              &q[s[2]<<1],
+                                                                              &q[s[3]<<1]);
+                    
+                    // Check the test points
+                    if(block_valid[i] && num_test_points > 0) {
+                        block_valid[i] = HomographyPointsGeometricallyConsistent(&block_hyp[i*9], test_points, num_test_points);
+                    }
+                }
+            };
+            int num_tasks = (block_size+HOMOGRAPHY_TRIALS_PER_TASK-1)/HOMOGRAPHY_TRIALS_PER_TASK;
+            if(pool) {
+                pool->parallelFor(num_tasks, solve);
+            } else {
+                for(int i = 0; i < num_tasks; i++) {
+                    solve(i, 0);
+                }
             }
             
-            // Check the test points
-            if(num_test_points > 0) {
-                if(!HomographyPointsGeometricallyConsistent(&hyp[num_hypotheses*9], test_points, num_test_points)) {
-                    continue;
+            // Keep the valid hypotheses in trial order
+            for(int i = 0; i < block_size; i++) {
+                if(valid[i]) {
+                    if(&hyp[num_hypotheses*9] != &block_hyp[i*9]) {
+                        CopyVector9(&hyp[num_hypotheses*9], &block_hyp[i*9]);
+                    }
+                    num_hypotheses++;
                 }
             }
             
-            num_hypotheses++;
+            trial += block_size;
         }
         
         // We fail if no hypotheses could be computed
@@ -202,17 +283,25 @@ namespace vision {
             // Size of the current chunk
             cur_chunk_size = min2(chunk_size, num_points-i);
             
-            // End of the current chunk
-            this_chunk_end = i+cur_chunk_size;
-            
             // Score each of the remaining hypotheses
-            for(int j = 0; j < num_hypotheses_remaining; j++) {
-                const T* H_cur = &hyp[hyp_costs[j].second*9];
-                for(int k = i; k < this_chunk_end; k++) {
-                    hyp_costs[j].first += CauchyProjectiveReprojectionCost(H_cur,
-                                                                           &p[hyp_perm[k]<<1],
-                                                                           &q[hyp_perm[k]<<1],
-                                                                           one_over_scale2);
+            auto score = [&](int task, int) {
+                int end = min2(num_hypotheses_remaining, (task+1)*HOMOGRAPHY_HYPOTHESES_PER_TASK);
+                for(int j = task*HOMOGRAPHY_HYPOTHESES_PER_TASK; j < end; j++) {
+                    AccumulateCauchyProjectiveReprojectionCost(hyp_costs[j].first,
+                                                               &hyp[hyp_costs[j].second*9],
+                                                               p,
+                                                               q,
+                                                               &hyp_perm[i],
+                                                               cur_chunk_size,
+                                                               one_over_scale2);
+                }
+            };
+            int num_tasks = (num_hypotheses_remaining+HOMOGRAPHY_HYPOTHESES_PER_TASK-1)/HOMOGRAPHY_HYPOTHESES_PER_TASK;
+            if(pool) {
+                pool->parallelFor(num_tasks, score);
+            } else {
+                for(int j = 0; j < num_tasks; j++) {
+                    score(j, 0);
                 }
             }
             
@@ -593,6 +682,13 @@ namespace vision {
         bool find(float H[9], const T* p, const T* q, int num_points);
         bool find(float H[9], const T* p, const T* q, int num_points, const T* test_points, int num_test_points);
         
+        /**
+         * Set the pool used to solve and score the hypotheses, or NULL to do it
+         * on the calling thread. The result is the same either way.
+         */
+        void setThreadPool(ThreadPool* pool) { mThreadPool = pool; }
+        ThreadPool* threadPool() const { return mThreadPool; }
+        
     private:
         
         // Temporary memory for RANSAC
@@ -606,13 +702,17 @@ namespace vision {
         int mMaxTrials;
         int mChunkSize;
         
+        // Not owned
+        ThreadPool* mThreadPool;
+        
     }; // RobustHomography
     
     template<typename T>
     RobustHomography<T>::RobustHomography(T cauchyScale,
                                           int maxNumHypotheses,
                                           int maxTrials,
-                                          int chunkSize) {
+                                          int chunkSize)
+    : mThreadPool(NULL) {
         init(cauchyScale, maxNumHypotheses, maxTrials, chunkSize);
     }
     
@@ -645,7 +745,8 @@ namespace vision {
                                           mCauchyScale,
                                           mMaxNumHypotheses,
                                           mMaxTrials,
-                                          mChunkSize)) {
+                                          mChunkSize,
+                                          mThreadPool)) {
             return false;
         }
         
@@ -667,7 +768,8 @@ namespace vision {
                                              mCauchyScale,
                                              mMaxNumHypotheses,
                                              mMaxTrials,
-                                             mChunkSize);
+                                             mChunkSize,
+                                             mThreadPool);
     }
     
 } // vision
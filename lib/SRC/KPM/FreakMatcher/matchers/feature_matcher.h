@@ -102,12 +102,23 @@ namespace vision {
         
     private:
         
+        /**
+         * Compute the distances from F1 to the features of FEATURES2 listed in
+         * mCandidates, into mDistances.
+         */
+        void computeCandidateDistances(const unsigned char* f1,
+                                       const BinaryFeatureStore* features2);
+        
         // Vector of indices that represent matches
         matches_t mMatches;
         
         // Threshold on the 1st and 2nd best matches
         float mThreshold;
         
+        // Candidate features in store 2 for the current feature, and their distances
+        std::vector<int> mCandidates;
+        std::vector<unsigned int> mDistances;
+        
     }; // BinaryFeatureMatcher
     
     /**
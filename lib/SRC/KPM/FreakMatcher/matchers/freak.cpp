@@ -57,6 +57,22 @@ FREAKExtractor::FREAKExtractor() {
     
     mExpansionFactor = 7;
     
+    // Receptors in the order they are sampled
+    const float* rings[] = {mPointRing5, mPointRing4, mPointRing3, mPointRing2, mPointRing1, mPointRing0};
+    for(int i = 0; i < 6; i++) {
+        CopyVector(mReceptors+12*i, rings[i], 12);
+    }
+    mReceptors[72] = 0;
+    mReceptors[73] = 0;
+    
+    mReceptorSigmas[0] = mSigmaRing5;
+    mReceptorSigmas[1] = mSigmaRing4;
+    mReceptorSigmas[2] = mSigmaRing3;
+    mReceptorSigmas[3] = mSigmaRing2;
+    mReceptorSigmas[4] = mSigmaRing1;
+    mReceptorSigmas[5] = mSigmaRing0;
+    mReceptorSigmas[6] = mSigmaCenter;
+    
     ASSERT(sizeof(freak84_points_ring0) == 48, "Size should be 48 bytes");
     ASSERT(sizeof(freak84_points_ring1) == 48, "Size should be 48 bytes");
     ASSERT(sizeof(freak84_points_ring2) == 48, "Size should be 48 bytes");
@@ -153,6 +169,15 @@ void FREAKExtractor::extract(BinaryFeatureStore& store,
     
     store.setNumBytesPerFeature(96);
     store.resize(points.size());
+#ifndef FREAK_DEBUG
+    ExtractFREAK84Batch(store,
+                        pyramid,
+                        points,
+                        mReceptors,
+                        mReceptorSigmas,
+                        mExpansionFactor,
+                        mOrder);
+#else
     ExtractFREAK84(store,
                    pyramid,
                    points,
@@ -169,9 +194,7 @@ void FREAKExtractor::extract(BinaryFeatureStore& store,
                    mSigmaRing3,
                    mSigmaRing4,
                    mSigmaRing5,
-                   mExpansionFactor
-#ifdef FREAK_DEBUG
-                   ,
+                   mExpansionFactor,
                    mMappedPoints0,
                    mMappedPoints1,
                    mMappedPoints2,
@@ -186,6 +209,6 @@ void FREAKExtractor::extract(BinaryFeatureStore& store,
                    mMappedS4,
                    mMappedS5,
                    mMappedSC
-#endif
                    );
+#endif
 }
\ No newline at end of file
@@ -41,7 +41,14 @@
 #include <math/math_io.h>
 #include <utils/point.h>
 #include <detectors/interpolate.h>
+#include <framework/cpu_features.h>
 #include "feature_store.h"
+#include <algorithm>
+#include <utility>
+
+#if VISION_X86_DISPATCH
+#  include <immintrin.h>
+#endif
 
 namespace vision {
     
@@ -118,6 +125,14 @@ namespace vision {
         // Scale expansion factor
         float mExpansionFactor;
         
+        // Receptor locations and sigma values in sample order: rings 5 to 0,
+        // and then the center
+        float mReceptors[2*37];
+        float mReceptorSigmas[7];
+        
+        // Order in which the feature points are extracted
+        std::vector<std::pair<float, int> > mOrder;
+        
     }; // FREAKExtractor
 
     /**
@@ -395,19 +410,177 @@ namespace vision {
         return true;
     }
     
+    namespace detail {
+        
+        /**
+         * Appends the N low bits of BITS to a little endian bitstring that is
+         * written out 64 bits at a time.
+         */
+        class BitstringWriter {
+        public:
+            
+            BitstringWriter(unsigned char* out)
+            : mOut(out)
+            , mBits(0)
+            , mNumBits(0) {}
+            
+            inline void append(unsigned int bits, int n) {
+                mBits |= (unsigned long long)bits << mNumBits;
+                mNumBits += n;
+                if(mNumBits >= 64) {
+                    write(8);
+                    mNumBits -= 64;
+                    mBits = mNumBits > 0 ? (unsigned long long)bits >> (n-mNumBits) : 0;
+                }
+            }
+            
+            /**
+             * Write the remaining bits, padding the last byte with zeros.
+             */
+            inline void flush() {
+                write((mNumBits+7)/8);
+                mNumBits = 0;
+                mBits = 0;
+            }
+            
+        private:
+            
+            inline void write(int num_bytes) {
+                for(int i = 0; i < num_bytes; i++) {
+                    *(mOut++) = (unsigned char)(mBits >> (i*8));
+                }
+            }
+            
+            unsigned char* mOut;
+            unsigned long long mBits;
+            int mNumBits;
+        };
+        
+        inline void CompareFREAK84Scalar(unsigned char desc[84], const float samples[37]) {
+            BitstringWriter writer(desc);
+            for(int i = 0; i < 37; i++) {
+                for(int j = i+1; j < 37; j++) {
+                    writer.append(samples[i] < samples[j], 1);
+                }
+            }
+            writer.flush();
+        }
+        
+#if VISION_X86_DISPATCH
+        
+        VISION_TARGET("sse2")
+        inline void CompareFREAK84SSE2(unsigned char desc[84], const float samples[37]) {
+            // Pad the samples so every group of 4 can be loaded
+            float s[40];
+            CopyVector(s, samples, 37);
+            s[37] = s[38] = s[39] = 0;
+            
+            BitstringWriter writer(desc);
+            for(int i = 0; i < 37; i++) {
+                __m128 si = _mm_set1_ps(s[i]);
+                for(int j = i+1; j < 37; j += 4) {
+                    int n = min2<int>(4, 37-j);
+                    int mask = _mm_movemask_ps(_mm_cmplt_ps(si, _mm_loadu_ps(s+j)));
+                    writer.append(mask & ((1<<n)-1), n);
+                }
+            }
+            writer.flush();
+        }
+        
+#endif // VISION_X86_DISPATCH
+        
+        typedef void (*CompareFREAK84Fn)(unsigned char*, const float*);
+        
+        inline CompareFREAK84Fn SelectCompareFREAK84() {
+#if VISION_X86_DISPATCH
+            if(GetCpuFeatures().sse2) {
+                return &CompareFREAK84SSE2;
+            }
+#endif
+            return &CompareFREAK84Scalar;
+        }
+        
+    } // detail
+    
     /**
      * Compute the descriptor given the 37 samples from each receptor.
+     *
+     * Bit k of the descriptor is the k'th test (samples[i] < samples[j]) for
+     * i < j in row major order. The 6 bits past the 666 tests are zero.
      */
     inline void CompareFREAK84(unsigned char desc[84], const float samples[37]) {
-        int pos = 0;
-        ZeroVector(desc, 84);
+        static const detail::CompareFREAK84Fn fn = detail::SelectCompareFREAK84();
+        fn(desc, samples);
+    }
+    
+    /**
+     * Map receptor locations in the canonical frame to the image with the
+     * similarity S.
+     */
+    inline void MapReceptorsFREAK84(float mapped[2*37],
+                                    const float S[9],
+                                    const float receptors[2*37]) {
         for(int i = 0; i < 37; i++) {
-            for(int j = i+1; j < 37; j++) {
-                bitstring_set_bit(desc, pos, samples[i] < samples[j]);
-                pos++;
-            }
+            mapped[2*i]   = S[0]*receptors[2*i] + S[1]*receptors[2*i+1] + S[2];
+            mapped[2*i+1] = S[3]*receptors[2*i] + S[4]*receptors[2*i+1] + S[5];
         }
-        ASSERT(pos == 666, "Position is not within range");
+    }
+    
+    /**
+     * Sample NUM receptors at the image locations MAPPED that share the same
+     * SIGMA. The pyramid level is located once for all of them.
+     */
+    inline void SampleReceptorsFREAK84(float* samples,
+                                       const GaussianScaleSpacePyramid* pyramid,
+                                       const float* mapped,
+                                       int num,
+                                       float sigma) {
+        int octave, scale;
+        pyramid->locate(octave, scale, sigma);
+        const Image& image = pyramid->get(octave, scale);
+        
+        // Same as bilinear_downsample_point() for this octave
+        float a = 1.f/(1<<octave);
+        float b = 0.5f*a-0.5f;
+        
+        for(int i = 0; i < num; i++) {
+            samples[i] = SampleReceptor(image, mapped[2*i]*a+b, mapped[2*i+1]*a+b);
+        }
+    }
+    
+    /**
+     * Sample all the receptors from the pyramid given a single point.
+     *
+     * @param[in] receptors Receptor locations in sample order (rings 5 to 0,
+     *            then the center)
+     * @param[in] sigmas Sigma values of rings 5 to 0, then the center
+     */
+    inline void SamplePyramidFREAK84(float samples[37],
+                                     const GaussianScaleSpacePyramid* pyramid,
+                                     const FeaturePoint& point,
+                                     const float receptors[2*37],
+                                     const float sigmas[7],
+                                     float expansion_factor) {
+        float S[9];
+        float mapped[2*37];
+        
+        // Ensure the scale of the similarity transform is at least "1".
+        float transform_scale = point.scale*expansion_factor;
+        if(transform_scale < 1) {
+            transform_scale = 1;
+        }
+        
+        // Transformation from canonical test locations to image
+        Similarity(S, point.x, point.y, point.angle, transform_scale);
+        MapReceptorsFREAK84(mapped, S, receptors);
+        
+        // Locate and sample each ring
+        for(int i = 0; i < 6; i++) {
+            SampleReceptorsFREAK84(samples+6*i, pyramid, mapped+12*i, 6, sigmas[i]*transform_scale);
+        }
+        
+        // Locate and sample center
+        SampleReceptorsFREAK84(samples+36, pyramid, mapped+72, 1, sigmas[6]*transform_scale);
     }
     
     /**
@@ -620,4 +793,41 @@ namespace vision {
         store.resize(num_points);
     }
     
+    /**
+     * Extract the descriptors for all the feature points.
+     *
+     * The points are visited in order of their scale, so that points that
+     * sample the same pyramid images are processed together. The descriptors
+     * are stored in the order of POINTS.
+     *
+     * @param[in] receptors Receptor locations in sample order (rings 5 to 0,
+     *            then the center)
+     * @param[in] sigmas Sigma values of rings 5 to 0, then the center
+     * @param order Temporary memory for the visiting order
+     */
+    inline void ExtractFREAK84Batch(BinaryFeatureStore& store,
+                                    const GaussianScaleSpacePyramid* pyramid,
+                                    const std::vector<FeaturePoint>& points,
+                                    const float receptors[2*37],
+                                    const float sigmas[7],
+                                    float expansion_factor,
+                                    std::vector<std::pair<float, int> >& order) {
+        ASSERT(pyramid, "Pyramid is NULL");
+        ASSERT(store.size() == points.size(), "Feature store has not been allocated");
+        
+        order.resize(points.size());
+        for(size_t i = 0; i < points.size(); i++) {
+            order[i] = std::make_pair(points[i].scale, (int)i);
+        }
+        std::sort(order.begin(), order.end());
+        
+        for(size_t i = 0; i < order.size(); i++) {
+            int index = order[i].second;
+            float samples[37];
+            SamplePyramidFREAK84(samples, pyramid, points[index], receptors, sigmas, expansion_factor);
+            CompareFREAK84(store.feature(index), samples);
+            store.point(index) = points[index];
+        }
+    }
+    
 } // vision
\ No newline at end of file
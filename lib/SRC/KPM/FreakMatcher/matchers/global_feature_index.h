@@ -0,0 +1,275 @@
+//
+//  global_feature_index.h
+//  ARToolKit5
+//
+//  This file is part of ARToolKit.
+//
+//  ARToolKit is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  ARToolKit is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with ARToolKit.  If not, see <http://www.gnu.org/licenses/>.
+//
+//  As a special exception, the copyright holders of this library give you
+//  permission to link this library with independent modules to produce an
+//  executable, regardless of the license terms of these independent modules, and to
+//  copy and distribute the resulting executable under terms of your choice,
+//  provided that you also meet, for each linked independent module, the terms and
+//  conditions of the license of that module. An independent module is a module
+//  which is neither derived from nor based on this library. If you modify this
+//  library, you may extend this exception to your version of the library, but you
+//  are not obligated to do so. If you do not wish to do so, delete this exception
+//  statement from your version.
+//
+//  Copyright 2013-2015 Daqri, LLC.
+//
+//  Author(s): Chris Broaddus
+//
+
+#pragma once
+
+#include "keyframe.h"
+#include "binary_hierarchical_clustering.h"
+#include <math/hamming.h>
+#include <framework/error.h>
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+namespace vision {
+    
+    /**
+     * Implements a single index over the features of many keyframes. Keyframes
+     * belong to groups, typically the several scales of one page. A query votes
+     * for the groups owning the nearest neighbors of its features, which gives a
+     * shortlist of groups whose keyframes are worth verifying geometrically.
+     */
+    template<int NUM_BYTES_PER_FEATURE>
+    class GlobalFeatureIndex {
+    public:
+        
+        typedef Keyframe<NUM_BYTES_PER_FEATURE> keyframe_t;
+        typedef BinaryHierarchicalClustering<NUM_BYTES_PER_FEATURE> index_t;
+        
+        GlobalFeatureIndex() : mNumKeyframes(0), mNumGroups(0), mThreshold(0.8f) {}
+        ~GlobalFeatureIndex() {}
+        
+        /**
+         * Build the index over the features of KEYFRAMES, where GROUPS holds the
+         * group of each keyframe. A keyframe is referred to by its position in
+         * KEYFRAMES, and a group by its position in order of first appearance.
+         */
+        void build(const std::vector<const keyframe_t*>& keyframes, const std::vector<int>& groups);
+        
+        /**
+         * Remove all features. The index is rebuilt by the next BUILD.
+         */
+        void clear();
+        
+        /**
+         * @return Number of keyframes in the index
+         */
+        inline size_t numKeyframes() const { return mNumKeyframes; }
+        
+        /**
+         * @return Number of groups in the index
+         */
+        inline size_t numGroups() const { return mNumGroups; }
+        
+        /**
+         * @return Group position of the keyframe at position KEYFRAME
+         */
+        inline int keyframeGroup(size_t keyframe) const { return mKeyframeGroups[keyframe]; }
+        
+        /**
+         * Set/Get the ratio threshold between the best match and the best match
+         * in any other group.
+         */
+        inline void setThreshold(float tr) { mThreshold = tr; }
+        inline float threshold() const { return mThreshold; }
+        
+        /**
+         * Each feature of QUERY votes for the group of its nearest neighbor, if
+         * that neighbor is distinctive enough relative to the other groups. Keyframes
+         * of the same group are not compared against each other, so a page is not
+         * penalised for resembling itself at another scale. Keyframe positions set
+         * in ERASED (if not NULL) are ignored. On return VOTES holds numGroups()
+         * vote counts.
+         */
+        void vote(std::vector<int>& votes, const BinaryFeatureStore& query, const std::vector<unsigned char>* erased = NULL);
+        
+        /**
+         * Select the groups with the most votes, at most MAX_GROUPS of them, and
+         * each with at least MIN_VOTES votes. Ties go to the earlier group.
+         * On return SHORTLIST holds group positions in increasing order.
+         */
+        static void Shortlist(std::vector<int>& shortlist,
+                              const std::vector<int>& votes,
+                              size_t max_groups,
+                              int min_votes);
+        
+    private:
+        
+        // Number of keyframes and groups, and the group position of each keyframe
+        size_t mNumKeyframes;
+        size_t mNumGroups;
+        std::vector<int> mKeyframeGroups;
+        
+        // Features of all the keyframes
+        std::vector<unsigned char> mFeatures;
+        
+        // Minima/maxima flag and owning keyframe of each feature
+        std::vector<unsigned char> mMaxima;
+        std::vector<int> mOwner;
+        
+        // Index over all the features
+        index_t mIndex;
+        
+        // Ratio threshold against other groups
+        float mThreshold;
+        
+        // Candidates for the current query feature, and their distances
+        std::vector<int> mCandidates;
+        std::vector<unsigned int> mDistances;
+        
+    }; // GlobalFeatureIndex
+    
+    template<int NUM_BYTES_PER_FEATURE>
+    void GlobalFeatureIndex<NUM_BYTES_PER_FEATURE>::build(const std::vector<const keyframe_t*>& keyframes, const std::vector<int>& groups) {
+        ASSERT(groups.size() == keyframes.size(), "One group per keyframe");
+        clear();
+        
+        // Number the groups densely, in order of first appearance
+        mKeyframeGroups.resize(keyframes.size());
+        for(size_t i = 0; i < keyframes.size(); i++) {
+            size_t j = 0;
+            while(j < i && groups[j] != groups[i]) {
+                j++;
+            }
+            mKeyframeGroups[i] = (j < i ? mKeyframeGroups[j] : (int)mNumGroups++);
+        }
+        
+        size_t num_features = 0;
+        for(size_t i = 0; i < keyframes.size(); i++) {
+            num_features += keyframes[i]->store().size();
+        }
+        
+        mNumKeyframes = keyframes.size();
+        mFeatures.reserve(num_features*NUM_BYTES_PER_FEATURE);
+        mMaxima.reserve(num_features);
+        mOwner.reserve(num_features);
+        for(size_t i = 0; i < keyframes.size(); i++) {
+            const BinaryFeatureStore& store = keyframes[i]->store();
+            ASSERT(store.size() == 0 || store.numBytesPerFeature() == NUM_BYTES_PER_FEATURE, "Feature size mismatch");
+            mFeatures.insert(mFeatures.end(), store.features().begin(), store.features().begin() + store.size()*NUM_BYTES_PER_FEATURE);
+            for(size_t j = 0; j < store.size(); j++) {
+                mMaxima.push_back(store.point(j).maxima ? 1 : 0);
+                mOwner.push_back((int)i);
+            }
+        }
+        
+        if(num_features == 0) {
+            return;
+        }
+        
+        // Same parameters as the per-keyframe index
+        mIndex.setNumHypotheses(128);
+        mIndex.setNumCenters(8);
+        mIndex.setMaxNodesToPop(8);
+        mIndex.setMinFeaturesPerNode(16);
+        mIndex.build(&mFeatures[0], (int)num_features);
+    }
+    
+    template<int NUM_BYTES_PER_FEATURE>
+    void GlobalFeatureIndex<NUM_BYTES_PER_FEATURE>::clear() {
+        mNumKeyframes = 0;
+        mNumGroups = 0;
+        mKeyframeGroups.clear();
+        mFeatures.clear();
+        mMaxima.clear();
+        mOwner.clear();
+    }
+    
+    template<int NUM_BYTES_PER_FEATURE>
+    void GlobalFeatureIndex<NUM_BYTES_PER_FEATURE>::vote(std::vector<int>& votes, const BinaryFeatureStore& query, const std::vector<unsigned char>* erased) {
+        votes.assign(mNumGroups, 0);
+        if(mOwner.empty()) {
+            return;
+        }
+        
+        ASSERT(NUM_BYTES_PER_FEATURE == 96, "Only 96 bytes supported now");
+        for(size_t i = 0; i < query.size(); i++) {
+            const unsigned char* f = query.feature(i);
+            unsigned char maxima = query.point(i).maxima ? 1 : 0;
+            
+            // Both points should be a MINIMA or MAXIMA
+            mIndex.query(f);
+            const std::vector<int>& v = mIndex.reverseIndex();
+            mCandidates.clear();
+            for(size_t j = 0; j < v.size(); j++) {
+                if(mMaxima[v[j]] == maxima && (!erased || !(*erased)[mOwner[v[j]]])) {
+                    mCandidates.push_back(v[j]);
+                }
+            }
+            if(mCandidates.empty()) {
+                continue;
+            }
+            
+            mDistances.resize(mCandidates.size());
+            HammingDistance768Batch(&mDistances[0], f, &mFeatures[0], &mCandidates[0], (int)mCandidates.size());
+            
+            // Best match, then the best match owned by any other group
+            unsigned int first_best = std::numeric_limits<unsigned int>::max();
+            int best_group = -1;
+            for(size_t j = 0; j < mCandidates.size(); j++) {
+                if(mDistances[j] < first_best) {
+                    first_best = mDistances[j];
+                    best_group = mKeyframeGroups[mOwner[mCandidates[j]]];
+                }
+            }
+            unsigned int second_best = std::numeric_limits<unsigned int>::max();
+            for(size_t j = 0; j < mCandidates.size(); j++) {
+                if(mDistances[j] < second_best && mKeyframeGroups[mOwner[mCandidates[j]]] != best_group) {
+                    second_best = mDistances[j];
+                }
+            }
+            
+            // If no other group is close, always vote. Otherwise, do a ratio test.
+            if(second_best == std::numeric_limits<unsigned int>::max() ||
+               (float)first_best / (float)second_best < mThreshold) {
+                votes[best_group]++;
+            }
+        }
+    }
+    
+    template<int NUM_BYTES_PER_FEATURE>
+    void GlobalFeatureIndex<NUM_BYTES_PER_FEATURE>::Shortlist(std::vector<int>& shortlist,
+                                                              const std::vector<int>& votes,
+                                                              size_t max_groups,
+                                                              int min_votes) {
+        shortlist.clear();
+        for(size_t i = 0; i < votes.size(); i++) {
+            if(votes[i] >= min_votes) {
+                shortlist.push_back((int)i);
+            }
+        }
+        
+        if(shortlist.size() > max_groups) {
+            // Most votes first, earlier group first on ties
+            std::stable_sort(shortlist.begin(), shortlist.end(), [&votes](int a, int b) {
+                return votes[a] > votes[b];
+            });
+            shortlist.resize(max_groups);
+            std::sort(shortlist.begin(), shortlist.end());
+        }
+    }
+    
+} // vision
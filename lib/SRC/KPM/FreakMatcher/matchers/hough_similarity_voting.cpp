@@ -38,6 +38,9 @@
 
 using namespace vision;
 
+// Largest number of bins for which votes are accumulated in a dense array.
+static const int kMaxDenseVoteBins = 1<<20;
+
 HoughSimilarityVoting::HoughSimilarityVoting()
 : mRefImageWidth(0)
 , mRefImageHeight(0)
@@ -61,7 +64,8 @@ HoughSimilarityVoting::HoughSimilarityVoting()
 , mfBinAngle(0)
 , mfBinScale(0)
 , mA(0)
-, mB(0) {
+, mB(0)
+, mUseDenseVotes(false) {
 }
 
 HoughSimilarityVoting::~HoughSimilarityVoting() {}
@@ -98,14 +102,15 @@ void HoughSimilarityVoting::init(float minX,
     else
         mAutoAdjustXYNumBins = false;
     
-    mVotes.clear();
+    clearVotes();
+    allocVotes();
 }
 
 void HoughSimilarityVoting::vote(const float* ins, const float* ref, int size) {
     float x, y, angle, scale;
     int num_features_that_cast_vote;
     
-    mVotes.clear();
+    clearVotes();
     if(size == 0) {
         return;
     }
@@ -114,6 +119,7 @@ void HoughSimilarityVoting::vote(const float* ins, const float* ref, int size) {
     mSubBinLocationIndices.resize(size);
     if(mAutoAdjustXYNumBins) {
         autoAdjustXYNumBins(ins, ref, size);
+        allocVotes();
     }
     
     num_features_that_cast_vote = 0;
@@ -154,8 +160,19 @@ void HoughSimilarityVoting::vote(const float* ins, const float* ref, int size) {
 
 void HoughSimilarityVoting::getVotes(vote_vector_t& votes, int threshold) const {
     votes.clear();
-    votes.reserve(mVotes.size());
     
+    if(mUseDenseVotes) {
+        votes.reserve(mTouchedBins.size());
+        for(size_t i = 0; i < mTouchedBins.size(); i++) {
+            unsigned int v = mDenseVotes[mTouchedBins[i]];
+            if(v >= threshold) {
+                votes.push_back(std::make_pair(v, mTouchedBins[i]));
+            }
+        }
+        return;
+    }
+    
+    votes.reserve(mVotes.size());
     for(hash_t::const_iterator it = mVotes.begin(); it != mVotes.end(); it++) {
         if(it->second >= threshold) {
             votes.push_back(std::make_pair(it->second, it->first));
@@ -167,6 +184,19 @@ void HoughSimilarityVoting::getMaximumNumberOfVotes(float& maxVotes, int& maxInd
     maxVotes = 0;
     maxIndex = -1;
     
+    // Of several bins with the most votes, the dense array reports the first
+    // one voted for
+    if(mUseDenseVotes) {
+        for(size_t i = 0; i < mTouchedBins.size(); i++) {
+            unsigned int v = mDenseVotes[mTouchedBins[i]];
+            if(v > maxVotes) {
+                maxIndex = mTouchedBins[i];
+                maxVotes = v;
+            }
+        }
+        return;
+    }
+    
     for(hash_t::const_iterator it = mVotes.begin(); it != mVotes.end(); it++) {
         if(it->second > maxVotes) {
             maxIndex = it->first;
@@ -233,4 +263,23 @@ void HoughSimilarityVoting::autoAdjustXYNumBins(const float* ins, const float* r
     
     mA = mNumXBins*mNumYBins;
     mB = mNumXBins*mNumYBins*mNumAngleBins;
-}
\ No newline at end of file
+}
+
+void HoughSimilarityVoting::clearVotes() {
+    for(size_t i = 0; i < mTouchedBins.size(); i++) {
+        mDenseVotes[mTouchedBins[i]] = 0;
+    }
+    mTouchedBins.clear();
+    mVotes.clear();
+}
+
+void HoughSimilarityVoting::allocVotes() {
+    ASSERT(mTouchedBins.empty() && mVotes.empty(), "Votes must be cleared first");
+    
+    long long num_bins = (long long)mB*mNumScaleBins;
+    mUseDenseVotes = num_bins <= kMaxDenseVoteBins;
+    if(mUseDenseVotes && mDenseVotes.size() < (size_t)num_bins) {
+        // The array only grows, and unvoted bins are always zero
+        mDenseVotes.resize((size_t)num_bins, 0);
+    }
+}
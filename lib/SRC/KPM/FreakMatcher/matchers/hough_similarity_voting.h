@@ -95,7 +95,7 @@ namespace vision {
             mMaxX = maxX;
             mMinY = minY;
             mMaxY = maxY;
-            mVotes.clear();
+            clearVotes();
         }
         
         /**
@@ -278,7 +278,14 @@ namespace vision {
         int mA; // mNumXBins*mNumYBins
         int mB; // mNumXBins*mNumYBins*mNumAngleBins
         
-        mutable hash_t mVotes;
+        // Votes are accumulated in a dense array when the number of bins is small
+        // enough, otherwise in a hash map. Bins of the dense array are listed in
+        // the order they first received a vote, so that only those are visited
+        // and reset.
+        bool mUseDenseVotes;
+        std::vector<unsigned int> mDenseVotes;
+        std::vector<int> mTouchedBins;
+        hash_t mVotes;
         
         std::vector<float> mSubBinLocations;
         std::vector<int> mSubBinLocationIndices;
@@ -288,6 +295,15 @@ namespace vision {
          */
         inline void voteAtIndex(int index, unsigned int weight) {
             ASSERT(index >= 0, "index out of range");
+            if(mUseDenseVotes) {
+                ASSERT(index < (int)mDenseVotes.size(), "index out of range");
+                unsigned int& v = mDenseVotes[index];
+                if(v == 0) {
+                    mTouchedBins.push_back(index);
+                }
+                v += weight;
+                return;
+            }
             const hash_t::iterator it = mVotes.find(index);
             if(it == mVotes.end()) {
                 mVotes.insert(std::pair<unsigned int, unsigned int>(index, weight));
@@ -296,6 +312,17 @@ namespace vision {
             }
         }
         
+        /**
+         * Remove all votes.
+         */
+        void clearVotes();
+        
+        /**
+         * Choose the dense or hash accumulator for the current number of bins.
+         * Must be called with no votes cast.
+         */
+        void allocVotes();
+        
         /**
          * Set the number of bins for translation based on the correspondences.
          */
@@ -60,6 +60,13 @@ namespace vision {
     
     static const bool kUseFeatureIndex = true;
     
+    static const bool kUseGlobalIndex = true;
+    static const size_t kShortlistSize = 8;
+    static const int kMinShortlistVotes = 3;
+    
+    static const size_t kEarlyExitInliers = 0;
+    static const size_t kRecentHistorySize = 8;
+    
     template<typename FEATURE_EXTRACTOR, typename STORE, typename MATCHER>
     VisualDatabase<FEATURE_EXTRACTOR, STORE, MATCHER>::VisualDatabase() {
         mDetector.setLaplacianThreshold(kLaplacianThreshold);
@@ -70,6 +77,16 @@ namespace vision {
         mMinNumInliers = kMinNumInliers;
         
         mUseFeatureIndex = kUseFeatureIndex;
+        
+        mUseGlobalIndex = kUseGlobalIndex;
+        mShortlistSize = kShortlistSize;
+        mGlobalIndexDirty = true;
+        mNumGlobalIndexErased = 0;
+        
+        mEarlyExitInliers = kEarlyExitInliers;
+        mRecentHistorySize = kRecentHistorySize;
+        
+        setNumQueryThreads(0);
     }
     
     template<typename FEATURE_EXTRACTOR, typename STORE, typename MATCHER>
@@ -126,6 +143,7 @@ namespace vision {
         
         // Store the keyframe
         mKeyframeMap[id] = keyframe;
+        globalIndexAdded(id);
     }
     
     template<typename FEATURE_EXTRACTOR, typename STORE, typename MATCHER>
@@ -136,6 +154,7 @@ namespace vision {
         }
         
         mKeyframeMap[id] = keyframe;
+        globalIndexAdded(id);
     }
     
     template<typename FEATURE_EXTRACTOR, typename STORE, typename MATCHER>
@@ -181,157 +200,411 @@ namespace vision {
         mMatchedInliers.clear();
         mMatchedId = -1;
         
-        const std::vector<FeaturePoint>& query_points = query_keyframe->store().points();
+        // Snapshot the keyframes to match, so they can be indexed from the worker threads
+        selectQueryKeyframes(query_keyframe);
+        mQueryResults.resize(mQueryKeyframes.size());
         
-        // Loop over all the images in the database
-        typename keyframe_map_t::const_iterator it = mKeyframeMap.begin();
-        for(; it != mKeyframeMap.end(); it++) {
-            TIMED("Find Matches (1)") {
-                if(mUseFeatureIndex) {
-                    if(mMatcher.match(&query_keyframe->store(), &it->second->store(), it->second->index()) < mMinNumInliers) {
-                        continue;
-                    }
-                } else {
-                    if(mMatcher.match(&query_keyframe->store(), &it->second->store()) < mMinNumInliers) {
-                        continue;
+        size_t num_matched = mQueryKeyframes.size();
+        if(mEarlyExitInliers == 0) {
+            matchQueryKeyframes(query_keyframe, 0, mQueryKeyframes.size());
+        } else {
+            // Match one keyframe per thread at a time, in priority order, until one
+            // is good enough. Only the keyframes up to the first good one are
+            // considered, so the result does not depend on the number of threads.
+            size_t exit_inliers = max2(mEarlyExitInliers, mMinNumInliers);
+            size_t batch_size = (size_t)mQueryThreadPool.numThreads();
+            prioritizeQueryKeyframes();
+            num_matched = 0;
+            bool found = false;
+            for(size_t begin = 0; begin < mQueryKeyframes.size() && !found; begin += batch_size) {
+                size_t end = min2(mQueryKeyframes.size(), begin+batch_size);
+                matchQueryKeyframes(query_keyframe, begin, end);
+                
+                num_matched = end;
+                for(size_t i = begin; i < end && !found; i++) {
+                    if(mQueryResults[i].matched && mQueryResults[i].inliers.size() >= exit_inliers) {
+                        num_matched = i+1;
+                        found = true;
                     }
                 }
             }
-            
-            const std::vector<FeaturePoint>& ref_points = it->second->store().points();
-            //std::cout<<"ref_points-"<<ref_points.size()<<std::endl;
-            //std::cout<<"query_points-"<<query_points.size()<<std::endl;
-            
-            //
-            // Vote for a transformation based on the correspondences
-            //
-            
-            int max_hough_index = -1;
-            TIMED("Hough Voting (1)") {
-                max_hough_index = FindHoughSimilarity(mHoughSimilarityVoting,
-                                                      query_points,
-                                                      ref_points,
-                                                      mMatcher.matches(),
-                                                      query_keyframe->width(),
-                                                      query_keyframe->height(),
-                                                      it->second->width(),
-                                                      it->second->height());
-                if(max_hough_index < 0) {
-                    continue;
-                }
+        }
+        
+        // Select the best match in keyframe order, so the result does not depend on
+        // the number of threads
+        for(size_t i = 0; i < num_matched; i++) {
+            QueryResult& result = mQueryResults[i];
+            if(!result.matched) {
+                continue;
             }
-            
-            matches_t hough_matches;
-            TIMED("Find Hough Matches (1)") {
-                FindHoughMatches(hough_matches,
-                                 mHoughSimilarityVoting,
-                                 mMatcher.matches(),
-                                 max_hough_index,
-                                 kHoughBinDelta);
+            //std::cout<<"inliers-"<<result.inliers.size()<<std::endl;
+            if(result.inliers.size() >= mMinNumInliers && result.inliers.size() > mMatchedInliers.size()) {
+                CopyVector9(mMatchedGeometry, result.H);
+                mMatchedInliers.swap(result.inliers);
+                mMatchedId = mQueryKeyframes[i]->first;
             }
-            
-            //
-            // Estimate the transformation between the two images
-            //
-            
-            float H[9];
-            TIMED("Estimate Homography (1)") {
-                if(!EstimateHomography(H,
-                                       query_points,
-                                       ref_points,
-                                       hough_matches,
-                                       mRobustHomography,
-                                       it->second->width(),
-                                       it->second->height())) {
-                    continue;
+        }
+        
+        if(mMatchedId >= 0) {
+            updateRecentIds(mMatchedId);
+        }
+        
+        return mMatchedId >= 0;
+    }
+    
+    template<typename FEATURE_EXTRACTOR, typename STORE, typename MATCHER>
+    void VisualDatabase<FEATURE_EXTRACTOR, STORE, MATCHER>::selectQueryKeyframes(const keyframe_t* query_keyframe) {
+        mQueryKeyframes.clear();
+        
+        // There can be no more groups than keyframes, so only build the index
+        // when there might be enough groups to shortlist
+        bool match_all = !mUseGlobalIndex || mKeyframeMap.size() <= mShortlistSize;
+        if(!match_all) {
+            if(mGlobalIndexDirty) {
+                TIMED("Build Global Index") {
+                    rebuildGlobalIndex();
                 }
             }
-            
-            //
-            // Find the inliers
-            //
-            
-            matches_t inliers;
-            TIMED("Find Inliers (1)") {
-                FindInliers(inliers, H, query_points, ref_points, hough_matches, mHomographyInlierThreshold);
-                if(inliers.size() < mMinNumInliers) {
-                    continue;
-                }
+            match_all = mGlobalIndex.numGroups() <= mShortlistSize;
+        }
+        if(match_all) {
+            mQueryKeyframes.reserve(mKeyframeMap.size());
+            typename keyframe_map_t::const_iterator it = mKeyframeMap.begin();
+            for(; it != mKeyframeMap.end(); it++) {
+                mQueryKeyframes.push_back(it);
             }
-            
-            //
-            // Use the estimated homography to find more inliers
-            //
-            
-            TIMED("Find Matches (2)") {
-                if(mMatcher.match(&query_keyframe->store(),
-                                  &it->second->store(),
-                                  H,
-                                  10) < mMinNumInliers) {
-                    continue;
-                }
+            return;
+        }
+        
+        TIMED("Shortlist Keyframes") {
+            mGlobalIndex.vote(mVotes, query_keyframe->store(), mNumGlobalIndexErased > 0 ? &mGlobalIndexErased : NULL);
+            GlobalFeatureIndex<96>::Shortlist(mShortlist, mVotes, mShortlistSize, kMinShortlistVotes);
+        }
+        
+        // Every keyframe of a shortlisted group is verified. Positions are in map
+        // order, so the selected keyframes are too. Keyframes added since the index
+        // was built are not in it, so they always follow.
+        mShortlisted.assign(mGlobalIndex.numGroups(), 0);
+        for(size_t i = 0; i < mShortlist.size(); i++) {
+            mShortlisted[mShortlist[i]] = 1;
+        }
+        for(size_t i = 0; i < mGlobalIndexIds.size(); i++) {
+            if(!mGlobalIndexErased[i] && mShortlisted[mGlobalIndex.keyframeGroup(i)]) {
+                mQueryKeyframes.push_back(mKeyframeMap.find(mGlobalIndexIds[i]));
             }
-            
-            //
-            // Vote for a similarity with new matches
-            //
-            
-            TIMED("Hough Voting (2)") {
-                max_hough_index = FindHoughSimilarity(mHoughSimilarityVoting,
-                                                      query_points,
-                                                      ref_points,
-                                                      mMatcher.matches(),
-                                                      query_keyframe->width(),
-                                                      query_keyframe->height(),
-                                                      it->second->width(),
-                                                      it->second->height());
-                if(max_hough_index < 0) {
-                    continue;
-                }
+        }
+        for(size_t i = 0; i < mGlobalIndexPending.size(); i++) {
+            mQueryKeyframes.push_back(mKeyframeMap.find(mGlobalIndexPending[i]));
+        }
+    }
+    
+    template<typename FEATURE_EXTRACTOR, typename STORE, typename MATCHER>
+    void VisualDatabase<FEATURE_EXTRACTOR, STORE, MATCHER>::matchQueryKeyframes(const keyframe_t* query_keyframe, size_t begin, size_t end) {
+        if(end-begin == 1) {
+            // With a single keyframe there is nothing to spread over the threads,
+            // so use them to solve and score the homography hypotheses instead.
+            QueryContext& context = *mQueryContexts[0];
+            context.robustHomography.setThreadPool(&mQueryThreadPool);
+            matchKeyframe(mQueryResults[begin],
+                          context,
+                          query_keyframe,
+                          mQueryKeyframes[begin]->second.get());
+            context.robustHomography.setThreadPool(NULL);
+        } else {
+            // Each keyframe is only touched by one thread, and each thread has its
+            // own matching state.
+            mQueryThreadPool.parallelFor((int)(end-begin), [&](int i, int thread) {
+                matchKeyframe(mQueryResults[begin+i],
+                              *mQueryContexts[thread],
+                              query_keyframe,
+                              mQueryKeyframes[begin+i]->second.get());
+            });
+        }
+    }
+    
+    template<typename FEATURE_EXTRACTOR, typename STORE, typename MATCHER>
+    void VisualDatabase<FEATURE_EXTRACTOR, STORE, MATCHER>::prioritizeQueryKeyframes() {
+        if(mRecentIds.empty()) {
+            return;
+        }
+        
+        // Recent keyframes are tried even if they were not selected, as they are
+        // the most likely to be seen again
+        std::vector<typename keyframe_map_t::const_iterator> keyframes;
+        keyframes.reserve(mQueryKeyframes.size()+mRecentIds.size());
+        for(size_t i = 0; i < mRecentIds.size(); i++) {
+            typename keyframe_map_t::const_iterator it = mKeyframeMap.find(mRecentIds[i]);
+            if(it != mKeyframeMap.end()) {
+                keyframes.push_back(it);
             }
-            
-            TIMED("Find Hough Matches (2)") {
-                FindHoughMatches(hough_matches,
-                                 mHoughSimilarityVoting,
-                                 mMatcher.matches(),
-                                 max_hough_index,
-                                 kHoughBinDelta);
+        }
+        for(size_t i = 0; i < mQueryKeyframes.size(); i++) {
+            if(std::find(mRecentIds.begin(), mRecentIds.end(), mQueryKeyframes[i]->first) == mRecentIds.end()) {
+                keyframes.push_back(mQueryKeyframes[i]);
             }
-            
-            //
-            // Re-estimate the homography
-            //
-            
-            TIMED("Estimate Homography (2)") {
-                if(!EstimateHomography(H,
-                                       query_points,
-                                       ref_points,
-                                       hough_matches,
-                                       mRobustHomography,
-                                       it->second->width(),
-                                       it->second->height())) {
-                    continue;
+        }
+        mQueryKeyframes.swap(keyframes);
+        mQueryResults.resize(mQueryKeyframes.size());
+    }
+    
+    template<typename FEATURE_EXTRACTOR, typename STORE, typename MATCHER>
+    void VisualDatabase<FEATURE_EXTRACTOR, STORE, MATCHER>::updateRecentIds(id_t id) {
+        typename std::vector<id_t>::iterator it = std::find(mRecentIds.begin(), mRecentIds.end(), id);
+        if(it != mRecentIds.end()) {
+            mRecentIds.erase(it);
+        }
+        mRecentIds.insert(mRecentIds.begin(), id);
+        if(mRecentIds.size() > mRecentHistorySize) {
+            mRecentIds.resize(mRecentHistorySize);
+        }
+    }
+    
+    template<typename FEATURE_EXTRACTOR, typename STORE, typename MATCHER>
+    void VisualDatabase<FEATURE_EXTRACTOR, STORE, MATCHER>::setRecentHistorySize(size_t n) {
+        mRecentHistorySize = n;
+        if(mRecentIds.size() > n) {
+            mRecentIds.resize(n);
+        }
+    }
+    
+    template<typename FEATURE_EXTRACTOR, typename STORE, typename MATCHER>
+    void VisualDatabase<FEATURE_EXTRACTOR, STORE, MATCHER>::rebuildGlobalIndex() {
+        std::vector<const keyframe_t*> keyframes;
+        std::vector<int> groups;
+        keyframes.reserve(mKeyframeMap.size());
+        groups.reserve(mKeyframeMap.size());
+        mGlobalIndexIds.clear();
+        mGlobalIndexIds.reserve(mKeyframeMap.size());
+        typename keyframe_map_t::const_iterator it = mKeyframeMap.begin();
+        for(; it != mKeyframeMap.end(); it++) {
+            keyframes.push_back(it->second.get());
+            groups.push_back(keyframeGroup(it->first));
+            mGlobalIndexIds.push_back(it->first);
+        }
+        mGlobalIndex.build(keyframes, groups);
+        mGlobalIndexDirty = false;
+        
+        mGlobalIndexPending.clear();
+        mGlobalIndexErased.assign(mGlobalIndexIds.size(), 0);
+        mNumGlobalIndexErased = 0;
+    }
+    
+    template<typename FEATURE_EXTRACTOR, typename STORE, typename MATCHER>
+    void VisualDatabase<FEATURE_EXTRACTOR, STORE, MATCHER>::setKeyframeGroup(id_t id, int group) {
+        if(keyframeGroup(id) == group) {
+            return;
+        }
+        mKeyframeGroups[id] = group;
+        
+        // Pending keyframes take their group when they are folded into the index
+        if(!mGlobalIndexDirty && mKeyframeMap.find(id) != mKeyframeMap.end() &&
+           std::find(mGlobalIndexPending.begin(), mGlobalIndexPending.end(), id) == mGlobalIndexPending.end()) {
+            mGlobalIndexDirty = true;
+        }
+    }
+    
+    template<typename FEATURE_EXTRACTOR, typename STORE, typename MATCHER>
+    int VisualDatabase<FEATURE_EXTRACTOR, STORE, MATCHER>::keyframeGroup(id_t id) const {
+        typename std::unordered_map<id_t, int>::const_iterator it = mKeyframeGroups.find(id);
+        return it != mKeyframeGroups.end() ? it->second : (int)id;
+    }
+    
+    template<typename FEATURE_EXTRACTOR, typename STORE, typename MATCHER>
+    void VisualDatabase<FEATURE_EXTRACTOR, STORE, MATCHER>::globalIndexAdded(id_t id) {
+        if(mGlobalIndexDirty) {
+            return;
+        }
+        
+        // Every pending keyframe is verified on each query, so only allow as many
+        // as the shortlist before folding them into the index.
+        mGlobalIndexPending.push_back(id);
+        if(mGlobalIndexPending.size() > mShortlistSize) {
+            mGlobalIndexDirty = true;
+        }
+    }
+    
+    template<typename FEATURE_EXTRACTOR, typename STORE, typename MATCHER>
+    void VisualDatabase<FEATURE_EXTRACTOR, STORE, MATCHER>::globalIndexErased(id_t id) {
+        if(mGlobalIndexDirty) {
+            return;
+        }
+        
+        typename std::vector<id_t>::iterator pending = std::find(mGlobalIndexPending.begin(), mGlobalIndexPending.end(), id);
+        if(pending != mGlobalIndexPending.end()) {
+            mGlobalIndexPending.erase(pending);
+            return;
+        }
+        
+        // The ID may have been erased and added again, so skip erased positions
+        for(size_t i = 0; i < mGlobalIndexIds.size(); i++) {
+            if(mGlobalIndexIds[i] == id && !mGlobalIndexErased[i]) {
+                mGlobalIndexErased[i] = 1;
+                mNumGlobalIndexErased++;
+                break;
+            }
+        }
+        
+        // Rebuild once most of the index is dead weight
+        if(mNumGlobalIndexErased*2 > mGlobalIndexIds.size()) {
+            mGlobalIndexDirty = true;
+        }
+    }
+    
+    template<typename FEATURE_EXTRACTOR, typename STORE, typename MATCHER>
+    void VisualDatabase<FEATURE_EXTRACTOR, STORE, MATCHER>::matchKeyframe(QueryResult& result,
+                                                                          QueryContext& context,
+                                                                          const keyframe_t* query_keyframe,
+                                                                          const keyframe_t* ref_keyframe) {
+        result.matched = false;
+        result.inliers.clear();
+        
+        const std::vector<FeaturePoint>& query_points = query_keyframe->store().points();
+        
+        TIMED("Find Matches (1)") {
+            if(mUseFeatureIndex) {
+                if(context.matcher.match(&query_keyframe->store(), &ref_keyframe->store(), ref_keyframe->index()) < mMinNumInliers) {
+                    return;
                 }
+            } else {
+                if(context.matcher.match(&query_keyframe->store(), &ref_keyframe->store()) < mMinNumInliers) {
+                    return;
+                }
+            }
+        }
+        
+        const std::vector<FeaturePoint>& ref_points = ref_keyframe->store().points();
+        
+        //
+        // Vote for a transformation based on the correspondences
+        //
+        
+        int max_hough_index = -1;
+        TIMED("Hough Voting (1)") {
+            max_hough_index = FindHoughSimilarity(context.houghSimilarityVoting,
+                                                  query_points,
+                                                  ref_points,
+                                                  context.matcher.matches(),
+                                                  query_keyframe->width(),
+                                                  query_keyframe->height(),
+                                                  ref_keyframe->width(),
+                                                  ref_keyframe->height());
+            if(max_hough_index < 0) {
+                return;
             }
-            
-            //
-            // Check if this is the best match based on number of inliers
-            //
-            
-            inliers.clear();
-            TIMED("Find Inliers (2)") {
-                FindInliers(inliers, H, query_points, ref_points, hough_matches, mHomographyInlierThreshold);
+        }
+        
+        matches_t hough_matches;
+        TIMED("Find Hough Matches (1)") {
+            FindHoughMatches(hough_matches,
+                             context.houghSimilarityVoting,
+                             context.matcher.matches(),
+                             max_hough_index,
+                             kHoughBinDelta);
+        }
+        
+        //
+        // Estimate the transformation between the two images
+        //
+        
+        float* H = result.H;
+        TIMED("Estimate Homography (1)") {
+            if(!EstimateHomography(H,
+                                   query_points,
+                                   ref_points,
+                                   hough_matches,
+                                   context.robustHomography,
+                                   ref_keyframe->width(),
+                                   ref_keyframe->height())) {
+                return;
+            }
+        }
+        
+        //
+        // Find the inliers
+        //
+        
+        matches_t& inliers = result.inliers;
+        TIMED("Find Inliers (1)") {
+            FindInliers(inliers, H, query_points, ref_points, hough_matches, mHomographyInlierThreshold);
+            if(inliers.size() < mMinNumInliers) {
+                return;
             }
-            
-            //std::cout<<"inliers-"<<inliers.size()<<std::endl;
-            if(inliers.size() >= mMinNumInliers && inliers.size() > mMatchedInliers.size()) {
-                CopyVector9(mMatchedGeometry, H);
-                mMatchedInliers.swap(inliers);
-                mMatchedId = it->first;
+        }
+        
+        //
+        // Use the estimated homography to find more inliers
+        //
+        
+        TIMED("Find Matches (2)") {
+            if(context.matcher.match(&query_keyframe->store(),
+                                     &ref_keyframe->store(),
+                                     H,
+                                     10) < mMinNumInliers) {
+                return;
             }
         }
         
-        return mMatchedId >= 0;
+        //
+        // Vote for a similarity with new matches
+        //
+        
+        TIMED("Hough Voting (2)") {
+            max_hough_index = FindHoughSimilarity(context.houghSimilarityVoting,
+                                                  query_points,
+                                                  ref_points,
+                                                  context.matcher.matches(),
+                                                  query_keyframe->width(),
+                                                  query_keyframe->height(),
+                                                  ref_keyframe->width(),
+                                                  ref_keyframe->height());
+            if(max_hough_index < 0) {
+                return;
+            }
+        }
+        
+        TIMED("Find Hough Matches (2)") {
+            FindHoughMatches(hough_matches,
+                             context.houghSimilarityVoting,
+                             context.matcher.matches(),
+                             max_hough_index,
+                             kHoughBinDelta);
+        }
+        
+        //
+        // Re-estimate the homography
+        //
+        
+        TIMED("Estimate Homography (2)") {
+            if(!EstimateHomography(H,
+                                   query_points,
+                                   ref_points,
+                                   hough_matches,
+                                   context.robustHomography,
+                                   ref_keyframe->width(),
+                                   ref_keyframe->height())) {
+                return;
+            }
+        }
+        
+        //
+        // Check if this is the best match based on number of inliers
+        //
+        
+        inliers.clear();
+        TIMED("Find Inliers (2)") {
+            FindInliers(inliers, H, query_points, ref_points, hough_matches, mHomographyInlierThreshold);
+        }
+        
+        result.matched = true;
+    }
+    
+    template<typename FEATURE_EXTRACTOR, typename STORE, typename MATCHER>
+    void VisualDatabase<FEATURE_EXTRACTOR, STORE, MATCHER>::setNumQueryThreads(int n) {
+        mQueryThreadPool.setNumThreads(n);
+        while((int)mQueryContexts.size() < mQueryThreadPool.numThreads()) {
+            mQueryContexts.push_back(std::unique_ptr<QueryContext>(new QueryContext()));
+        }
+        mQueryContexts.resize(mQueryThreadPool.numThreads());
     }
     
     template<typename FEATURE_EXTRACTOR, typename STORE, typename MATCHER>
@@ -341,6 +614,13 @@ namespace vision {
             return false;
         }
         mKeyframeMap.erase(it);
+        mKeyframeGroups.erase(id);
+        globalIndexErased(id);
+        
+        typename std::vector<id_t>::iterator recent = std::find(mRecentIds.begin(), mRecentIds.end(), id);
+        if(recent != mRecentIds.end()) {
+            mRecentIds.erase(recent);
+        }
         return true;
     }
     
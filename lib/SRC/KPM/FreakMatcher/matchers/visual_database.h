@@ -37,8 +37,10 @@
 
 #include <framework/image.h>
 #include <framework/exception.h>
+#include <framework/thread_pool.h>
 #include <detectors/DoG_scale_invariant_detector.h>
 #include <matchers/keyframe.h>
+#include <matchers/global_feature_index.h>
 #include <matchers/feature_matcher-inline.h>
 #include <matchers/hough_similarity_voting.h>
 #include <homography_estimation/robust_homography.h>
@@ -48,6 +50,7 @@
 
 #include <vector>
 #include <memory>
+#include <algorithm>
 #include <unordered_map>
 
 #include "feature_point.h"
@@ -130,7 +133,7 @@ namespace vision {
         /**
          * @return Matcher
          */
-        const MATCHER& matcher() const { return mMatcher; }
+        const MATCHER& matcher() const { return mQueryContexts[0]->matcher; }
         
         /**
          * @return Feature extractor
@@ -164,8 +167,117 @@ namespace vision {
         inline void setMinNumInliers(size_t n) { mMinNumInliers = n; }
         inline size_t minNumInliers() const { return mMinNumInliers; }
         
+        /**
+         * Set/Get the number of threads used to match keyframes during a query.
+         * Values less than 1 select one thread per hardware core.
+         */
+        void setNumQueryThreads(int n);
+        inline int numQueryThreads() const { return mQueryThreadPool.numThreads(); }
+        
+        /**
+         * Enable/Disable the global feature index. When enabled and the database
+         * holds more keyframe groups than the shortlist size, a query first votes
+         * for groups through one index over all keyframes, and only the keyframes
+         * of the shortlisted groups are matched and verified.
+         */
+        inline void setUseGlobalIndex(bool b) { mUseGlobalIndex = b; }
+        inline bool useGlobalIndex() const { return mUseGlobalIndex; }
+        
+        /**
+         * Set/Get the group of a keyframe. Keyframes showing the same image, such
+         * as the scales of one page, should share a group, so that the global
+         * index does not treat them as competing for a match. A keyframe whose
+         * group was never set is in the group numbered by its own ID.
+         */
+        void setKeyframeGroup(id_t id, int group);
+        int keyframeGroup(id_t id) const;
+        
+        /**
+         * Set/Get the maximum number of keyframe groups verified per query when the
+         * global feature index is used.
+         */
+        inline void setShortlistSize(size_t n) { mShortlistSize = n; }
+        inline size_t shortlistSize() const { return mShortlistSize; }
+        
+        /**
+         * Set/Get the number of inliers at which a query stops early. When set,
+         * the recently matched keyframes are tried first and the query ends at the
+         * first keyframe verified with at least this many inliers (and at least
+         * the minimum number of inliers). Zero matches every keyframe.
+         */
+        inline void setEarlyExitInliers(size_t n) { mEarlyExitInliers = n; }
+        inline size_t earlyExitInliers() const { return mEarlyExitInliers; }
+        
+        /**
+         * Set/Get the number of recently matched keyframes that are tried first
+         * when stopping early.
+         */
+        void setRecentHistorySize(size_t n);
+        inline size_t recentHistorySize() const { return mRecentHistorySize; }
+        
     private:
         
+        /**
+         * Per-thread matching state, so that keyframes can be matched concurrently.
+         */
+        struct QueryContext {
+            MATCHER matcher;
+            HoughSimilarityVoting houghSimilarityVoting;
+            RobustHomography<float> robustHomography;
+        };
+        
+        /**
+         * Outcome of matching the query against a single keyframe.
+         */
+        struct QueryResult {
+            bool matched;
+            matches_t inliers;
+            float H[9];
+        };
+        
+        /**
+         * Select the keyframes to match against a query, into mQueryKeyframes.
+         */
+        void selectQueryKeyframes(const keyframe_t* query_keyframe);
+        
+        /**
+         * Move the recently matched keyframes to the front of mQueryKeyframes.
+         */
+        void prioritizeQueryKeyframes();
+        
+        /**
+         * Match the query against mQueryKeyframes[BEGIN, END), into mQueryResults.
+         */
+        void matchQueryKeyframes(const keyframe_t* query_keyframe, size_t begin, size_t end);
+        
+        /**
+         * Record ID as the most recently matched keyframe.
+         */
+        void updateRecentIds(id_t id);
+        
+        /**
+         * Rebuild the global feature index after keyframes were added or removed.
+         */
+        void rebuildGlobalIndex();
+        
+        /**
+         * Keep the global feature index in step with an added or erased keyframe.
+         * A few changes are absorbed without rebuilding the index: added keyframes
+         * are verified on every query until the next rebuild, and erased ones are
+         * left out of the shortlist.
+         */
+        void globalIndexAdded(id_t id);
+        void globalIndexErased(id_t id);
+        
+        /**
+         * Match the query against one keyframe. On success, RESULT holds the
+         * inliers and homography of the match.
+         */
+        void matchKeyframe(QueryResult& result,
+                           QueryContext& context,
+                           const keyframe_t* query_keyframe,
+                           const keyframe_t* ref_keyframe);
+        
         size_t mMinNumInliers;
         float mHomographyInlierThreshold;
         
@@ -190,14 +302,42 @@ namespace vision {
         // Feature Extractor (FREAK, etc).
         FEATURE_EXTRACTOR mFeatureExtractor;
         
-        // Feature matcher
-        MATCHER mMatcher;
-        
-        // Similarity voter
-        HoughSimilarityVoting mHoughSimilarityVoting;
-        
-        // Robust homography estimation
-        RobustHomography<float> mRobustHomography;
+        // Threads used to match keyframes, and their feature matcher, similarity
+        // voter and robust homography estimator
+        ThreadPool mQueryThreadPool;
+        std::vector<std::unique_ptr<QueryContext> > mQueryContexts;
+        
+        // Index over the features of all keyframes, and the keyframe ID of each
+        // of its keyframe positions (in map order)
+        bool mUseGlobalIndex;
+        size_t mShortlistSize;
+        bool mGlobalIndexDirty;
+        GlobalFeatureIndex<96> mGlobalIndex;
+        std::vector<id_t> mGlobalIndexIds;
+        
+        // Group of each keyframe whose group was set
+        std::unordered_map<id_t, int> mKeyframeGroups;
+        
+        // Keyframes added since the index was built, and the positions whose
+        // keyframe was erased since
+        std::vector<id_t> mGlobalIndexPending;
+        std::vector<unsigned char> mGlobalIndexErased;
+        size_t mNumGlobalIndexErased;
+        
+        std::vector<int> mVotes;
+        std::vector<int> mShortlist;
+        std::vector<unsigned char> mShortlisted;
+        
+        // Inliers at which a query stops early (0 to match every keyframe), and
+        // the recently matched keyframe IDs, most recent first
+        size_t mEarlyExitInliers;
+        size_t mRecentHistorySize;
+        std::vector<id_t> mRecentIds;
+        
+        // Keyframes and their results for the current query, in map order unless
+        // stopping early
+        std::vector<typename keyframe_map_t::const_iterator> mQueryKeyframes;
+        std::vector<QueryResult> mQueryResults;
         
     }; // VisualDatabase
     
@@ -35,6 +35,15 @@
 
 #pragma once
 
+#include <limits>
+#include <cstring>
+#include <cstddef>
+#include <framework/cpu_features.h>
+
+#if VISION_X86_DISPATCH
+#  include <immintrin.h>
+#endif
+
 namespace vision {
     
     /**
@@ -56,34 +65,201 @@ namespace vision {
         return (x * h01) >> 24;         // returns left 8 bits of x + (x<<8) + (x<<16) + (x<<24) + ...
     }
     
+    namespace detail {
+        
+        /**
+         * Hamming distance for 768 bits (96 bytes), portable version.
+         */
+        inline unsigned int HammingDistance768Scalar(const unsigned int a[24], const unsigned int b[24]) {
+            return  HammingDistance32(a[0],  b[0]) +
+                    HammingDistance32(a[1],  b[1]) +
+                    HammingDistance32(a[2],  b[2]) +
+                    HammingDistance32(a[3],  b[3]) +
+                    HammingDistance32(a[4],  b[4]) +
+                    HammingDistance32(a[5],  b[5]) +
+                    HammingDistance32(a[6],  b[6]) +
+                    HammingDistance32(a[7],  b[7]) +
+                    HammingDistance32(a[8],  b[8]) +
+                    HammingDistance32(a[9],  b[9]) +
+                    HammingDistance32(a[10], b[10]) +
+                    HammingDistance32(a[11], b[11]) +
+                    HammingDistance32(a[12], b[12]) +
+                    HammingDistance32(a[13], b[13]) +
+                    HammingDistance32(a[14], b[14]) +
+                    HammingDistance32(a[15], b[15]) +
+                    HammingDistance32(a[16], b[16]) +
+                    HammingDistance32(a[17], b[17]) +
+                    HammingDistance32(a[18], b[18]) +
+                    HammingDistance32(a[19], b[19]) +
+                    HammingDistance32(a[20], b[20]) +
+                    HammingDistance32(a[21], b[21]) +
+                    HammingDistance32(a[22], b[22]) +
+                    HammingDistance32(a[23], b[23]);
+        }
+        
+        inline unsigned int HammingDistance768Scalar(const unsigned char* a, const unsigned char* b) {
+            return HammingDistance768Scalar((const unsigned int*)a, (const unsigned int*)b);
+        }
+        
+#if VISION_X86_DISPATCH
+        
+        /**
+         * Hamming distance for 768 bits (96 bytes) with the POPCNT instruction.
+         */
+        VISION_TARGET("popcnt")
+        inline unsigned int HammingDistance768Popcnt(const unsigned char* a, const unsigned char* b) {
+            unsigned int d = 0;
+#if defined(__x86_64__) || defined(_M_X64)
+            for(int i = 0; i < 96; i += 8) {
+                unsigned long long x, y;
+                memcpy(&x, a+i, 8);
+                memcpy(&y, b+i, 8);
+                d += (unsigned int)_mm_popcnt_u64(x^y);
+            }
+#else
+            for(int i = 0; i < 96; i += 4) {
+                unsigned int x, y;
+                memcpy(&x, a+i, 4);
+                memcpy(&y, b+i, 4);
+                d += (unsigned int)_mm_popcnt_u32(x^y);
+            }
+#endif
+            return d;
+        }
+        
+        /**
+         * Per-byte bit counts of X, using a nibble lookup table.
+         */
+        VISION_TARGET("avx2")
+        inline __m256i PopcountBytesAVX2(__m256i x) {
+            const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                                    0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+            const __m256i low_mask = _mm256_set1_epi8(0x0f);
+            __m256i lo = _mm256_and_si256(x, low_mask);
+            __m256i hi = _mm256_and_si256(_mm256_srli_epi16(x, 4), low_mask);
+            return _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo), _mm256_shuffle_epi8(lookup, hi));
+        }
+        
+        /**
+         * Hamming distance for 768 bits (96 bytes) between a query already loaded
+         * into Q0..Q2 and B, with AVX2.
+         */
+        VISION_TARGET("avx2")
+        inline unsigned int HammingDistance768AVX2(__m256i q0, __m256i q1, __m256i q2, const unsigned char* b) {
+            __m256i c = PopcountBytesAVX2(_mm256_xor_si256(q0, _mm256_loadu_si256((const __m256i*)(b))));
+            c = _mm256_add_epi8(c, PopcountBytesAVX2(_mm256_xor_si256(q1, _mm256_loadu_si256((const __m256i*)(b+32)))));
+            c = _mm256_add_epi8(c, PopcountBytesAVX2(_mm256_xor_si256(q2, _mm256_loadu_si256((const __m256i*)(b+64)))));
+            // Each byte is at most 24, so the sums cannot overflow before SAD widens them
+            __m256i s = _mm256_sad_epu8(c, _mm256_setzero_si256());
+            __m128i t = _mm_add_epi64(_mm256_castsi256_si128(s), _mm256_extracti128_si256(s, 1));
+            t = _mm_add_epi64(t, _mm_unpackhi_epi64(t, t));
+            return (unsigned int)_mm_cvtsi128_si32(t);
+        }
+        
+        VISION_TARGET("popcnt")
+        inline void HammingDistance768BatchPopcnt(unsigned int* distances,
+                                                  const unsigned char* query,
+                                                  const unsigned char* features,
+                                                  const int* indices,
+                                                  int num) {
+            for(int i = 0; i < num; i++) {
+                const unsigned char* f = features + 96*(indices ? indices[i] : i);
+                distances[i] = HammingDistance768Popcnt(query, f);
+            }
+        }
+        
+        VISION_TARGET("avx2")
+        inline void HammingDistance768BatchAVX2(unsigned int* distances,
+                                                const unsigned char* query,
+                                                const unsigned char* features,
+                                                const int* indices,
+                                                int num) {
+            __m256i q0 = _mm256_loadu_si256((const __m256i*)(query));
+            __m256i q1 = _mm256_loadu_si256((const __m256i*)(query+32));
+            __m256i q2 = _mm256_loadu_si256((const __m256i*)(query+64));
+            for(int i = 0; i < num; i++) {
+                const unsigned char* f = features + 96*(indices ? indices[i] : i);
+                distances[i] = HammingDistance768AVX2(q0, q1, q2, f);
+            }
+        }
+        
+#endif // VISION_X86_DISPATCH
+        
+        inline void HammingDistance768BatchScalar(unsigned int* distances,
+                                                  const unsigned char* query,
+                                                  const unsigned char* features,
+                                                  const int* indices,
+                                                  int num) {
+            for(int i = 0; i < num; i++) {
+                const unsigned char* f = features + 96*(indices ? indices[i] : i);
+                distances[i] = HammingDistance768Scalar(query, f);
+            }
+        }
+        
+        typedef unsigned int (*HammingDistance768Fn)(const unsigned char*, const unsigned char*);
+        typedef void (*HammingDistance768BatchFn)(unsigned int*, const unsigned char*, const unsigned char*, const int*, int);
+        
+        /**
+         * Select the fastest single-pair kernel for this CPU. For one pair, POPCNT
+         * is as fast as the AVX2 kernel and has no setup cost.
+         */
+        inline HammingDistance768Fn SelectHammingDistance768() {
+#if VISION_X86_DISPATCH
+            if(GetCpuFeatures().popcnt) {
+                return &HammingDistance768Popcnt;
+            }
+#endif
+            return &HammingDistance768Scalar;
+        }
+        
+        /**
+         * Select the fastest one-vs-many kernel for this CPU.
+         */
+        inline HammingDistance768BatchFn SelectHammingDistance768Batch() {
+#if VISION_X86_DISPATCH
+            if(GetCpuFeatures().avx2) {
+                return &HammingDistance768BatchAVX2;
+            }
+            if(GetCpuFeatures().popcnt) {
+                return &HammingDistance768BatchPopcnt;
+            }
+#endif
+            return &HammingDistance768BatchScalar;
+        }
+        
+    } // detail
+    
     /**
      * Hamming distance for 768 bits (96 bytes)
      */
     inline unsigned int HammingDistance768(const unsigned int a[24], const unsigned int b[24]) {
-        return  HammingDistance32(a[0],  b[0]) +
-                HammingDistance32(a[1],  b[1]) +
-                HammingDistance32(a[2],  b[2]) +
-                HammingDistance32(a[3],  b[3]) +
-                HammingDistance32(a[4],  b[4]) +
-                HammingDistance32(a[5],  b[5]) +
-                HammingDistance32(a[6],  b[6]) +
-                HammingDistance32(a[7],  b[7]) +
-                HammingDistance32(a[8],  b[8]) +
-                HammingDistance32(a[9],  b[9]) +
-                HammingDistance32(a[10], b[10]) +
-                HammingDistance32(a[11], b[11]) +
-                HammingDistance32(a[12], b[12]) +
-                HammingDistance32(a[13], b[13]) +
-                HammingDistance32(a[14], b[14]) +
-                HammingDistance32(a[15], b[15]) +
-                HammingDistance32(a[16], b[16]) +
-                HammingDistance32(a[17], b[17]) +
-                HammingDistance32(a[18], b[18]) +
-                HammingDistance32(a[19], b[19]) +
-                HammingDistance32(a[20], b[20]) +
-                HammingDistance32(a[21], b[21]) +
-                HammingDistance32(a[22], b[22]) +
-                HammingDistance32(a[23], b[23]);
+        static const detail::HammingDistance768Fn fn = detail::SelectHammingDistance768();
+        return fn((const unsigned char*)a, (const unsigned char*)b);
+    }
+    
+    /**
+     * Hamming distances for 768 bits (96 bytes) from QUERY to each of NUM
+     * contiguous 96 byte FEATURES, written to DISTANCES.
+     */
+    inline void HammingDistance768Batch(unsigned int* distances,
+                                        const unsigned char* query,
+                                        const unsigned char* features,
+                                        int num) {
+        static const detail::HammingDistance768BatchFn fn = detail::SelectHammingDistance768Batch();
+        fn(distances, query, features, NULL, num);
+    }
+    
+    /**
+     * Hamming distances for 768 bits (96 bytes) from QUERY to the 96 byte
+     * FEATURES selected by the NUM entries of INDICES, written to DISTANCES.
+     */
+    inline void HammingDistance768Batch(unsigned int* distances,
+                                        const unsigned char* query,
+                                        const unsigned char* features,
+                                        const int* indices,
+                                        int num) {
+        static const detail::HammingDistance768BatchFn fn = detail::SelectHammingDistance768Batch();
+        fn(distances, query, features, indices, num);
     }
     
     template<int NUM_BYTES>
@@ -47,7 +47,9 @@ namespace vision {
      * http://software.intel.com/en-us/articles/fast-random-number-generator-on-the-intel-pentiumr-4-processor/
      */
     inline int FastRandom(int& seed) {
-        seed = (214013*seed+2531011);
+        // Unsigned, as signed overflow is undefined and lets the optimizer break
+        // the sequence
+        seed = (int)(214013u*(unsigned int)seed+2531011u);
         return (seed>>16)&0x7FFF;
     }
     
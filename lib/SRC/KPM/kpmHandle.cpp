@@ -111,6 +111,21 @@ static KpmHandle *kpmCreateHandleCore( ARParamLT *cparamLT, int xsize, int ysize
 
     kpmHandle->result                  = NULL;
     kpmHandle->resultNum               = 0;
+    for( int i = 0; i < DB_IMAGE_MAX; i++ ) kpmHandle->pageIDs[i] = -1;
+    pthread_mutex_init( &(kpmHandle->refDataSetLock), NULL );
+
+    kpmHandle->bwImage                 = NULL;
+    kpmHandle->bwImageSize             = 0;
+    kpmHandle->inDataSetMax            = 0;
+#if !BINARY_FEATURE
+    kpmHandle->featureVector.sf        = NULL;
+    kpmHandle->corspMap.mp             = NULL;
+    kpmHandle->inlierIndex             = NULL;
+    kpmHandle->annMatch2               = NULL;
+    kpmHandle->pageMatch               = NULL;
+    kpmHandle->pageMatchStart          = NULL;
+    kpmHandle->refPointPage            = NULL;
+#endif
 
 #if !BINARY_FEATURE
     switch (kpmHandle->procMode) {
@@ -227,9 +242,75 @@ int kpmGetDetectedFeatureMax( KpmHandle *kpmHandle, int *detectedMaxFeature )
 
 int kpmSetSurfThreadNum( KpmHandle *kpmHandle, int surfThreadNum )
 {
+    if( kpmHandle == NULL ) return -1;
 #if !BINARY_FEATURE
     kpmHandle->surfThreadNum = surfThreadNum;
     surfSubSetThreadNum(kpmHandle->surfHandle, kpmHandle->surfThreadNum);
+#else
+    kpmHandle->freakMatcher->setNumDetectorThreads(surfThreadNum);
+#endif
+    return 0;
+}
+
+int kpmSetMatchingThreadNum( KpmHandle *kpmHandle, int matchingThreadNum )
+{
+    if( kpmHandle == NULL ) return -1;
+#if BINARY_FEATURE
+    kpmHandle->freakMatcher->setNumQueryThreads(matchingThreadNum);
+#endif
+    return 0;
+}
+
+int kpmGetMatchingThreadNum( KpmHandle *kpmHandle, int *matchingThreadNum )
+{
+    if( kpmHandle == NULL || matchingThreadNum == NULL ) return -1;
+#if BINARY_FEATURE
+    *matchingThreadNum = kpmHandle->freakMatcher->numQueryThreads();
+#else
+    *matchingThreadNum = 1;
+#endif
+    return 0;
+}
+
+int kpmSetMatchingEarlyExit( KpmHandle *kpmHandle, int inlierNum )
+{
+    if( kpmHandle == NULL ) return -1;
+#if BINARY_FEATURE
+    kpmHandle->freakMatcher->setEarlyExitInliers(inlierNum);
+#endif
+    return 0;
+}
+
+int kpmGetMatchingEarlyExit( KpmHandle *kpmHandle, int *inlierNum )
+{
+    if( kpmHandle == NULL || inlierNum == NULL ) return -1;
+#if BINARY_FEATURE
+    *inlierNum = kpmHandle->freakMatcher->earlyExitInliers();
+#else
+    *inlierNum = 0;
+#endif
+    return 0;
+}
+
+int kpmSetGlobalIndex( KpmHandle *kpmHandle, int on, int shortlistSize )
+{
+    if( kpmHandle == NULL || shortlistSize < 1 ) return -1;
+#if BINARY_FEATURE
+    kpmHandle->freakMatcher->setUseGlobalIndex(on != 0);
+    kpmHandle->freakMatcher->setShortlistSize(shortlistSize);
+#endif
+    return 0;
+}
+
+int kpmGetGlobalIndex( KpmHandle *kpmHandle, int *on, int *shortlistSize )
+{
+    if( kpmHandle == NULL || on == NULL || shortlistSize == NULL ) return -1;
+#if BINARY_FEATURE
+    *on = (kpmHandle->freakMatcher->useGlobalIndex() ? 1 : 0);
+    *shortlistSize = kpmHandle->freakMatcher->shortlistSize();
+#else
+    *on = 0;
+    *shortlistSize = 0;
 #endif
     return 0;
 }
@@ -274,6 +355,17 @@ int kpmDeleteHandle( KpmHandle **kpmHandle )
     if( (*kpmHandle)->inDataSet.coord != NULL ) {
         free( (*kpmHandle)->inDataSet.coord );
     }
+    free( (*kpmHandle)->bwImage );
+#if !BINARY_FEATURE
+    free( (*kpmHandle)->featureVector.sf );
+    free( (*kpmHandle)->corspMap.mp );
+    free( (*kpmHandle)->inlierIndex );
+    free( (*kpmHandle)->annMatch2 );
+    free( (*kpmHandle)->pageMatch );
+    free( (*kpmHandle)->pageMatchStart );
+    free( (*kpmHandle)->refPointPage );
+#endif
+    pthread_mutex_destroy( &((*kpmHandle)->refDataSetLock) );
 
     free( *kpmHandle );
     *kpmHandle = NULL;
@@ -52,6 +52,10 @@ extern "C" {
 #  include "AnnMatch2.h"
 #endif
 
+#if !BINARY_FEATURE
+#define KPM_ANN_KNN 1   // Number of nearest neighbours looked up per input feature.
+#endif
+
 int kpmUtilGetPose_binary( ARParamLT *cparamLT, const vision::matches_t &matchData, const std::vector<vision::Point3d<float> > &refDataSet, const std::vector<vision::FeaturePoint> &inputDataSet, float  camPose[3][4], float  *error );
 
 template<typename T>
@@ -170,15 +174,118 @@ int kpmLoadImageDb(KpmHandle *kpmHandle, const char *filename)
     return 1;
 }
         
-int kpmSetRefDataSet( KpmHandle *kpmHandle, KpmRefDataSet *refDataSet )
+#if BINARY_FEATURE
+// Keyframe data of one reference image, gathered before the handle is locked.
+struct KpmPageImage {
+    std::vector<vision::FeaturePoint>       points;
+    std::vector<vision::Point3d<float> >    points_3d;
+    std::vector<unsigned char>              descriptors;
+    int                                     width, height;
+};
+
+static void kpmGatherPageImages( const KpmRefDataSet *refDataSet, const KpmPageInfo *pageInfo, std::vector<KpmPageImage> &images )
 {
-#if !BINARY_FEATURE
-    CAnnMatch2         *ann2;
-#endif
+    images.resize(pageInfo->imageNum);
+    for (int m = 0; m < pageInfo->imageNum; m++) {
+        KpmPageImage &image = images[m];
+        image.width = pageInfo->imageInfo[m].width;
+        image.height = pageInfo->imageInfo[m].height;
+        for (int i = 0; i < refDataSet->num; i++) {
+            const KpmRefData &refPoint = refDataSet->refPoint[i];
+            if (refPoint.refImageNo == pageInfo->imageInfo[m].imageNo && refPoint.pageNo == pageInfo->pageNo) {
+                image.points.push_back(vision::FeaturePoint(refPoint.coord2D.x,
+                                                            refPoint.coord2D.y,
+                                                            refPoint.featureVec.angle,
+                                                            refPoint.featureVec.scale,
+                                                            refPoint.featureVec.maxima));
+                image.points_3d.push_back(vision::Point3d<float>(refPoint.coord3D.x, refPoint.coord3D.y, 0));
+                for (int j = 0; j < FREAK_SUB_DIMENSION; j++)
+                    image.descriptors.push_back(refPoint.featureVec.v[j]);
+            }
+        }
+        ARLOGi("points-%d\n", image.points.size());
+    }
+}
+
+// Add the images of a page to the matcher, each under an unused database id.
+static int kpmAddPageImages( KpmHandle *kpmHandle, int pageNo, const std::vector<KpmPageImage> &images )
+{
+    int    db_id, freeNum;
     
+    freeNum = 0;
+    for (db_id = 0; db_id < DB_IMAGE_MAX; db_id++) {
+        if (kpmHandle->pageIDs[db_id] < 0) freeNum++;
+    }
+    if (freeNum < (int)images.size()) {
+        ARLOGe("Too many reference images (max %d).\n", DB_IMAGE_MAX);
+        return -1;
+    }
+    
+    db_id = 0;
+    for (size_t m = 0; m < images.size(); m++) {
+        while (kpmHandle->pageIDs[db_id] >= 0) db_id++;
+        kpmHandle->freakMatcher->addFreakFeaturesAndDescriptors(images[m].points, images[m].descriptors, images[m].points_3d, images[m].width, images[m].height, db_id);
+        kpmHandle->freakMatcher->setImageGroup(db_id, pageNo); // Scales of a page are shortlisted together.
+        kpmHandle->pageIDs[db_id] = pageNo;
+    }
+    return 0;
+}
+
+// Remove the images of a page (or of every page, if pageNo is -1) from the matcher.
+// Keyframes of other pages and their indexes are left as they are.
+static void kpmRemovePageImages( KpmHandle *kpmHandle, int pageNo )
+{
+    for (int db_id = 0; db_id < DB_IMAGE_MAX; db_id++) {
+        if (kpmHandle->pageIDs[db_id] < 0) continue;
+        if (pageNo >= 0 && kpmHandle->pageIDs[db_id] != pageNo) continue;
+        kpmHandle->freakMatcher->erase(db_id);
+        kpmHandle->pageIDs[db_id] = -1;
+    }
+}
+#else
+// The SURF matcher searches a single ANN index over all the refPoints, so it is
+// rebuilt whenever the reference points change.
+static void kpmBuildAnnIndex( KpmHandle *kpmHandle )
+{
+    CAnnMatch2         *ann2;
     FeatureVector       featureVector;
     int                 i, j;
     
+    if (kpmHandle->ann2) {
+        delete (CAnnMatch2 *)(kpmHandle->ann2);
+        kpmHandle->ann2 = NULL;
+    }
+    free( kpmHandle->refPointPage );
+    free( kpmHandle->pageMatchStart );
+    kpmHandle->refPointPage = NULL;
+    arMalloc( kpmHandle->pageMatchStart, int, kpmHandle->refDataSet.pageNum + 1 );
+    if (kpmHandle->refDataSet.num != 0) {
+        arMalloc( kpmHandle->refPointPage, int, kpmHandle->refDataSet.num );
+        for( i = 0; i < kpmHandle->refDataSet.num; i++ ) {
+            for( j = 0; j < kpmHandle->refDataSet.pageNum; j++ ) {
+                if( kpmHandle->refDataSet.refPoint[i].pageNo == kpmHandle->refDataSet.pageInfo[j].pageNo ) break;
+            }
+            kpmHandle->refPointPage[i] = (j < kpmHandle->refDataSet.pageNum) ? j : -1;
+        }
+    }
+    if (kpmHandle->refDataSet.num != 0) {
+        ann2 = new CAnnMatch2();
+        kpmHandle->ann2 = (void *)ann2;
+        arMalloc( featureVector.sf, SurfFeature, kpmHandle->refDataSet.num );
+        for( int l = 0; l < kpmHandle->refDataSet.num; l++ ) {
+            featureVector.sf[l] = kpmHandle->refDataSet.refPoint[l].featureVec;
+        }
+        featureVector.num = kpmHandle->refDataSet.num;
+        ann2->Construct(&featureVector);
+        free(featureVector.sf);
+    }
+}
+#endif
+
+int kpmSetRefDataSet( KpmHandle *kpmHandle, KpmRefDataSet *refDataSet )
+{
+    int                 i, j;
+    
     if (!kpmHandle || !refDataSet) {
         ARLOGe("kpmSetRefDataSet(): NULL kpmHandle/refDataSet.\n");
         return -1;
@@ -188,6 +295,8 @@ int kpmSetRefDataSet( KpmHandle *kpmHandle, KpmRefDataSet *refDataSet )
         return -1;
     }
     
+    pthread_mutex_lock( &(kpmHandle->refDataSetLock) );
+    
     // Copy the refPoints into the kpmHandle's dataset.
     if( kpmHandle->refDataSet.refPoint != NULL ) {
         // Discard any old points first.
@@ -226,7 +335,7 @@ int kpmSetRefDataSet( KpmHandle *kpmHandle, KpmRefDataSet *refDataSet )
                 }
             }
             else {
-                refDataSet->pageInfo[i].imageInfo = NULL;
+                kpmHandle->refDataSet.pageInfo[i].imageInfo = NULL;
             }
         }
     }
@@ -251,53 +360,176 @@ int kpmSetRefDataSet( KpmHandle *kpmHandle, KpmRefDataSet *refDataSet )
 
     // Create feature vectors.
 #if !BINARY_FEATURE
-    if (kpmHandle->ann2) {
-        delete (CAnnMatch2 *)(kpmHandle->ann2);
-        kpmHandle->ann2 = NULL;
+    kpmBuildAnnIndex( kpmHandle );
+#else
+    // Replace the keyframes of any previous dataset.
+    kpmRemovePageImages( kpmHandle, -1 );
+    for (int k = 0; k < kpmHandle->refDataSet.pageNum; k++) {
+        std::vector<KpmPageImage> images;
+        kpmGatherPageImages( &(kpmHandle->refDataSet), &(kpmHandle->refDataSet.pageInfo[k]), images );
+        if (kpmAddPageImages( kpmHandle, kpmHandle->refDataSet.pageInfo[k].pageNo, images ) < 0) {
+            pthread_mutex_unlock( &(kpmHandle->refDataSetLock) );
+            return -1;
+        }
     }
-    if (kpmHandle->refDataSet.num != 0) {
-        ann2 = new CAnnMatch2();
-        kpmHandle->ann2 = (void *)ann2;
-        arMalloc( featureVector.sf, SurfFeature, kpmHandle->refDataSet.num );
-        for( int l = 0; l < kpmHandle->refDataSet.num; l++ ) {
-            featureVector.sf[l] = kpmHandle->refDataSet.refPoint[l].featureVec;
+#endif
+    
+    pthread_mutex_unlock( &(kpmHandle->refDataSetLock) );
+    
+    return 0;
+}
+
+int kpmAddRefDataSetPage( KpmHandle *kpmHandle, KpmRefDataSet *refDataSet, int pageNo )
+{
+    const KpmPageInfo  *pageInfo;
+    KpmRefData         *refPoint;
+    KpmPageInfo        *newPageInfo;
+    KpmResult          *result;
+    int                 num, pageNum;
+    int                 i, j, k;
+    
+    if (!kpmHandle || !refDataSet) {
+        ARLOGe("kpmAddRefDataSetPage(): NULL kpmHandle/refDataSet.\n");
+        return -1;
+    }
+    for( k = 0; k < refDataSet->pageNum; k++ ) {
+        if( refDataSet->pageInfo[k].pageNo == pageNo ) break;
+    }
+    if( k == refDataSet->pageNum ) {
+        ARLOGe("kpmAddRefDataSetPage(): page %d is not in refDataSet.\n", pageNo);
+        return -1;
+    }
+    pageInfo = &(refDataSet->pageInfo[k]);
+    num = 0;
+    for( i = 0; i < refDataSet->num; i++ ) {
+        if( refDataSet->refPoint[i].pageNo == pageNo ) num++;
+    }
+    if( num == 0 ) {
+        ARLOGe("kpmAddRefDataSetPage(): page %d has no reference points.\n", pageNo);
+        return -1;
+    }
+    
+#if BINARY_FEATURE
+    // Gather the keyframe data while matching carries on.
+    std::vector<KpmPageImage> images;
+    kpmGatherPageImages( refDataSet, pageInfo, images );
+#endif
+    
+    pthread_mutex_lock( &(kpmHandle->refDataSetLock) );
+    
+    pageNum = kpmHandle->refDataSet.pageNum;
+    for( k = 0; k < pageNum; k++ ) {
+        if( kpmHandle->refDataSet.pageInfo[k].pageNo == pageNo ) {
+            pthread_mutex_unlock( &(kpmHandle->refDataSetLock) );
+            ARLOGe("kpmAddRefDataSetPage(): page %d is already loaded.\n", pageNo);
+            return -1;
         }
-        featureVector.num = kpmHandle->refDataSet.num;
-        ann2->Construct(&featureVector);
-        free(featureVector.sf);
     }
-#else
-    if (kpmHandle->refDataSet.num != 0) {
-        featureVector.num = kpmHandle->refDataSet.num;
-        
-        int db_id = 0;
-        for (int k = 0; k < kpmHandle->refDataSet.pageNum; k++) {
-            for (int m = 0; m < kpmHandle->refDataSet.pageInfo[k].imageNum; m++) {
-                std::vector<vision::FeaturePoint> points;
-                std::vector<vision::Point3d<float> > points_3d;
-                std::vector<unsigned char> descriptors;
-            
-                for (int i = 0; i < featureVector.num; i++) {
-                    if (kpmHandle->refDataSet.refPoint[i].refImageNo == kpmHandle->refDataSet.pageInfo[k].imageInfo[m].imageNo
-                    && kpmHandle->refDataSet.refPoint[i].pageNo == kpmHandle->refDataSet.pageInfo[k].pageNo) {
-                        points.push_back(vision::FeaturePoint(kpmHandle->refDataSet.refPoint[i].coord2D.x,
-                                                          kpmHandle->refDataSet.refPoint[i].coord2D.y,
-                                                          kpmHandle->refDataSet.refPoint[i].featureVec.angle,
-                                                          kpmHandle->refDataSet.refPoint[i].featureVec.scale,
-                                                          kpmHandle->refDataSet.refPoint[i].featureVec.maxima));
-                        points_3d.push_back(vision::Point3d<float>(kpmHandle->refDataSet.refPoint[i].coord3D.x,
-                                                                   kpmHandle->refDataSet.refPoint[i].coord3D.y,                                                                  0));
-                        for (int j = 0; j < FREAK_SUB_DIMENSION; j++)
-                            descriptors.push_back(kpmHandle->refDataSet.refPoint[i].featureVec.v[j]);
-                    }
-                }
-                ARLOGi("points-%d\n", points.size());
-               kpmHandle->pageIDs[db_id] = kpmHandle->refDataSet.pageInfo[k].pageNo; kpmHandle->freakMatcher->addFreakFeaturesAndDescriptors(points,descriptors,points_3d,kpmHandle->refDataSet.pageInfo[k].imageInfo[m].width,kpmHandle->refDataSet.pageInfo[k].imageInfo[m].height,db_id++);
-            }
+    
+#if BINARY_FEATURE
+    if( kpmAddPageImages( kpmHandle, pageNo, images ) < 0 ) {
+        pthread_mutex_unlock( &(kpmHandle->refDataSetLock) );
+        return -1;
+    }
+#endif
+    
+    // Append the page's refPoints.
+    arMalloc( refPoint, KpmRefData, kpmHandle->refDataSet.num + num );
+    for( i = 0; i < kpmHandle->refDataSet.num; i++ ) {
+        refPoint[i] = kpmHandle->refDataSet.refPoint[i];
+    }
+    for( j = 0; j < refDataSet->num; j++ ) {
+        if( refDataSet->refPoint[j].pageNo == pageNo ) refPoint[i++] = refDataSet->refPoint[j];
+    }
+    free( kpmHandle->refDataSet.refPoint );
+    kpmHandle->refDataSet.refPoint = refPoint;
+    kpmHandle->refDataSet.num = i;
+    
+    // Append the pageInfo and a result slot. Existing imageInfo is moved, not copied.
+    arMalloc( newPageInfo, KpmPageInfo, pageNum + 1 );
+    arMalloc( result, KpmResult, pageNum + 1 );
+    for( k = 0; k < pageNum; k++ ) {
+        newPageInfo[k] = kpmHandle->refDataSet.pageInfo[k];
+        result[k] = kpmHandle->result[k];
+    }
+    newPageInfo[pageNum].pageNo = pageNo;
+    newPageInfo[pageNum].imageNum = pageInfo->imageNum;
+    if( pageInfo->imageNum != 0 ) {
+        arMalloc( newPageInfo[pageNum].imageInfo, KpmImageInfo, pageInfo->imageNum );
+        for( j = 0; j < pageInfo->imageNum; j++ ) {
+            newPageInfo[pageNum].imageInfo[j] = pageInfo->imageInfo[j];
+        }
+    }
+    else {
+        newPageInfo[pageNum].imageInfo = NULL;
+    }
+    result[pageNum].pageNo = pageNo;
+    result[pageNum].camPoseF = -1;
+    result[pageNum].skipF = 0;
+    free( kpmHandle->refDataSet.pageInfo );
+    free( kpmHandle->result );
+    kpmHandle->refDataSet.pageInfo = newPageInfo;
+    kpmHandle->refDataSet.pageNum = pageNum + 1;
+    kpmHandle->result = result;
+    kpmHandle->resultNum = pageNum + 1;
+    
+#if !BINARY_FEATURE
+    kpmBuildAnnIndex( kpmHandle );
+#endif
+    
+    pthread_mutex_unlock( &(kpmHandle->refDataSetLock) );
+    
+    return 0;
+}
+
+int kpmRemoveRefDataSetPage( KpmHandle *kpmHandle, int pageNo )
+{
+    int                 i, j, k;
+    
+    if (!kpmHandle) {
+        ARLOGe("kpmRemoveRefDataSetPage(): NULL kpmHandle.\n");
+        return -1;
+    }
+    
+    pthread_mutex_lock( &(kpmHandle->refDataSetLock) );
+    
+    for( k = 0; k < kpmHandle->refDataSet.pageNum; k++ ) {
+        if( kpmHandle->refDataSet.pageInfo[k].pageNo == pageNo ) break;
+    }
+    if( k == kpmHandle->refDataSet.pageNum ) {
+        pthread_mutex_unlock( &(kpmHandle->refDataSetLock) );
+        ARLOGe("kpmRemoveRefDataSetPage(): page %d is not loaded.\n", pageNo);
+        return -1;
+    }
+    
+#if BINARY_FEATURE
+    kpmRemovePageImages( kpmHandle, pageNo );
+#endif
+    
+    // Drop the page's refPoints in place, keeping the order of the rest.
+    j = 0;
+    for( i = 0; i < kpmHandle->refDataSet.num; i++ ) {
+        if( kpmHandle->refDataSet.refPoint[i].pageNo != pageNo ) {
+            kpmHandle->refDataSet.refPoint[j++] = kpmHandle->refDataSet.refPoint[i];
         }
     }
+    kpmHandle->refDataSet.num = j;
+    
+    // Close up the pageInfo and results over the removed page.
+    free( kpmHandle->refDataSet.pageInfo[k].imageInfo );
+    for( i = k + 1; i < kpmHandle->refDataSet.pageNum; i++ ) {
+        kpmHandle->refDataSet.pageInfo[i-1] = kpmHandle->refDataSet.pageInfo[i];
+        kpmHandle->result[i-1] = kpmHandle->result[i];
+    }
+    kpmHandle->refDataSet.pageNum--;
+    kpmHandle->resultNum--;
+    
+#if !BINARY_FEATURE
+    kpmBuildAnnIndex( kpmHandle );
 #endif
     
+    pthread_mutex_unlock( &(kpmHandle->refDataSetLock) );
+    
     return 0;
 }
 
@@ -342,6 +574,7 @@ int kpmSetMatchingSkipPage( KpmHandle *kpmHandle, int skipPages[], int num )
     
     if( kpmHandle == NULL ) return -1;
     
+    pthread_mutex_lock( &(kpmHandle->refDataSetLock) );
     for( i = 0; i < num; i++ ) {
         for( j = 0; j < kpmHandle->refDataSet.pageNum; j++ ) {
             if( skipPages[i] == kpmHandle->refDataSet.pageInfo[j].pageNo ) {
@@ -350,10 +583,12 @@ int kpmSetMatchingSkipPage( KpmHandle *kpmHandle, int skipPages[], int num )
             }
         }
         if( j == kpmHandle->refDataSet.pageNum ) {
+            pthread_mutex_unlock( &(kpmHandle->refDataSetLock) );
             ARLOGe("Cannot find the page for skipping.\n");
             return -1;
         }
     }
+    pthread_mutex_unlock( &(kpmHandle->refDataSetLock) );
     
     return 0;
 }
@@ -380,17 +615,139 @@ int kpmSetMatchingSkipRegion( KpmHandle *kpmHandle, SurfSubRect *skipRegion, int
 }
 #endif
 
+static int kpmMatchingCore( KpmHandle *kpmHandle, ARUint8 *inImageBW, int xsize2, int ysize2 );
+static int kpmMatchingConvert( KpmHandle *kpmHandle, ARUint8 *inImage, AR_PIXEL_FORMAT pixFormat, int rowBytes );
+static int kpmAllocInDataSet( KpmHandle *kpmHandle, int num );
+#if !BINARY_FEATURE
+static void kpmBucketMatchesByPage( KpmHandle *kpmHandle, const int *annMatch, int num, int knn );
+#endif
+
 int kpmMatching( KpmHandle *kpmHandle, ARUint8 *inImage )
 {
-    int               xsize, ysize;
+    if (!kpmHandle || !inImage) {
+        ARLOGe("kpmMatching(): NULL kpmHandle/inImage.\n");
+        return -1;
+    }
+    
+    if (kpmHandle->procMode == KpmProcFullSize && (kpmHandle->pixFormat == AR_PIXEL_FORMAT_MONO || kpmHandle->pixFormat == AR_PIXEL_FORMAT_420v || kpmHandle->pixFormat == AR_PIXEL_FORMAT_420f || kpmHandle->pixFormat == AR_PIXEL_FORMAT_NV21)) {
+        return kpmMatchingCore( kpmHandle, inImage, kpmHandle->xsize, kpmHandle->ysize );
+    }
+    return kpmMatchingConvert( kpmHandle, inImage, kpmHandle->pixFormat, kpmHandle->xsize*arUtilGetPixelSize(kpmHandle->pixFormat) );
+}
+
+int kpmMatchingMono( KpmHandle *kpmHandle, ARUint8 *monoImage, int rowBytes )
+{
+    if (!kpmHandle || !monoImage) {
+        ARLOGe("kpmMatchingMono(): NULL kpmHandle/monoImage.\n");
+        return -1;
+    }
+    if (rowBytes <= 0) rowBytes = kpmHandle->xsize;
+    else if (rowBytes < kpmHandle->xsize) {
+        ARLOGe("kpmMatchingMono(): rowBytes %d is less than image width %d.\n", rowBytes, kpmHandle->xsize);
+        return -1;
+    }
+    
+    if (kpmHandle->procMode == KpmProcFullSize && rowBytes == kpmHandle->xsize) {
+        return kpmMatchingCore( kpmHandle, monoImage, kpmHandle->xsize, kpmHandle->ysize );
+    }
+    return kpmMatchingConvert( kpmHandle, monoImage, AR_PIXEL_FORMAT_MONO, rowBytes );
+}
+
+// Convert to an unpadded greyscale image at the processing size, in the buffer held by the handle.
+static int kpmMatchingConvert( KpmHandle *kpmHandle, ARUint8 *inImage, AR_PIXEL_FORMAT pixFormat, int rowBytes )
+{
     int               xsize2, ysize2;
-    int               procMode;
-    ARUint8          *inImageBW;
+    
+    if( kpmUtilGetBWImageSize( kpmHandle->xsize, kpmHandle->ysize, kpmHandle->procMode, &xsize2, &ysize2 ) < 0 ) return -1;
+    if( kpmHandle->bwImageSize < xsize2*ysize2 ) {
+        free( kpmHandle->bwImage );
+        kpmHandle->bwImageSize = xsize2*ysize2;
+        arMalloc( kpmHandle->bwImage, ARUint8, kpmHandle->bwImageSize );
+    }
+    if( kpmUtilGenBWImage2( inImage, pixFormat, kpmHandle->xsize, kpmHandle->ysize, rowBytes, kpmHandle->procMode, kpmHandle->bwImage ) < 0 ) return -1;
+    
+    return kpmMatchingCore( kpmHandle, kpmHandle->bwImage, xsize2, ysize2 );
+}
+
+// Make sure the per-feature arrays can hold 'num' features. They are only ever grown.
+static int kpmAllocInDataSet( KpmHandle *kpmHandle, int num )
+{
+    if( num <= kpmHandle->inDataSetMax ) return 0;
+    
+    free( kpmHandle->inDataSet.coord );
+#if !BINARY_FEATURE
+    free( kpmHandle->preRANSAC.match );
+    free( kpmHandle->aftRANSAC.match );
+    free( kpmHandle->featureVector.sf );
+    free( kpmHandle->corspMap.mp );
+    free( kpmHandle->inlierIndex );
+    free( kpmHandle->annMatch2 );
+    free( kpmHandle->pageMatch );
+#endif
+    kpmHandle->inDataSetMax = num;
+    arMalloc( kpmHandle->inDataSet.coord, KpmCoord2D,     num );
+#if !BINARY_FEATURE
+    arMalloc( kpmHandle->preRANSAC.match, KpmMatchData,   num );
+    arMalloc( kpmHandle->aftRANSAC.match, KpmMatchData,   num );
+    arMalloc( kpmHandle->featureVector.sf, SurfFeature,   num );
+    arMalloc( kpmHandle->corspMap.mp,     MatchPoint,     num );
+    arMalloc( kpmHandle->inlierIndex,     int,            num );
+    arMalloc( kpmHandle->annMatch2,       int,            num*KPM_ANN_KNN );
+    arMalloc( kpmHandle->pageMatch,       int,            num*KPM_ANN_KNN );
+#endif
+    
+    return 0;
+}
+
+#if !BINARY_FEATURE
+// Page index of the j'th neighbour of a feature, or -1 if there is no match or an earlier neighbour
+// of the same feature is already on that page.
+static int kpmGetMatchPage( KpmHandle *kpmHandle, const int *annMatch, int j )
+{
+    int    page, k;
+    
+    if( annMatch[j] < 0 ) return -1;
+    page = kpmHandle->refPointPage[annMatch[j]];
+    for( k = 0; k < j; k++ ) {
+        if( annMatch[k] >= 0 && kpmHandle->refPointPage[annMatch[k]] == page ) return -1;
+    }
+    return page;
+}
+
+// Group the ANN matches by page, keeping input order within a page. On return the matches of page p
+// are pageMatch[pageMatchStart[p]] to pageMatch[pageMatchStart[p+1]-1], as indices into annMatch.
+static void kpmBucketMatchesByPage( KpmHandle *kpmHandle, const int *annMatch, int num, int knn )
+{
+    int   *start = kpmHandle->pageMatchStart;
+    int    pageNum = kpmHandle->refDataSet.pageNum;
+    int    page, i, j;
+    
+    for( i = 0; i <= pageNum; i++ ) start[i] = 0;
+    for( i = 0; i < num; i++ ) {
+        for( j = 0; j < knn; j++ ) {
+            if( (page = kpmGetMatchPage( kpmHandle, &annMatch[i*knn], j )) >= 0 ) start[page+1]++;
+        }
+    }
+    for( i = 0; i < pageNum; i++ ) start[i+1] += start[i];
+    
+    // Fill, advancing start[p] to the end of page p, then shift back.
+    for( i = 0; i < num; i++ ) {
+        for( j = 0; j < knn; j++ ) {
+            if( (page = kpmGetMatchPage( kpmHandle, &annMatch[i*knn], j )) >= 0 ) kpmHandle->pageMatch[start[page]++] = i*knn + j;
+        }
+    }
+    for( i = pageNum; i > 0; i-- ) start[i] = start[i-1];
+    start[0] = 0;
+}
+#endif
+
+static int kpmMatchingCore( KpmHandle *kpmHandle, ARUint8 *inImageBW, int xsize2, int ysize2 )
+{
+    float             procScale;
     int               i;
 #if !BINARY_FEATURE
-    FeatureVector     featureVector;
-    int              *inlierIndex;
-    CorspMap          preRANSAC;
+    FeatureVector    *featureVector;
+    CorspMap         *preRANSAC;
     int               inlierNum;
     CAnnMatch2       *ann2;
     int              *annMatch2;
@@ -400,171 +757,67 @@ int kpmMatching( KpmHandle *kpmHandle, ARUint8 *inImage )
 #endif
     int               ret;
     
-    if (!kpmHandle || !inImage) {
-        ARLOGe("kpmMatching(): NULL kpmHandle/inImage.\n");
-        return -1;
-    }
-    
-    xsize           = kpmHandle->xsize;
-    ysize           = kpmHandle->ysize;
-    procMode        = kpmHandle->procMode;
-    
-    if (procMode == KpmProcFullSize && (kpmHandle->pixFormat == AR_PIXEL_FORMAT_MONO || kpmHandle->pixFormat == AR_PIXEL_FORMAT_420v || kpmHandle->pixFormat == AR_PIXEL_FORMAT_420f || kpmHandle->pixFormat == AR_PIXEL_FORMAT_NV21)) {
-        inImageBW = inImage;
-    } else {
-        inImageBW = kpmUtilGenBWImage( inImage, kpmHandle->pixFormat, xsize, ysize, procMode, &xsize2, &ysize2 );
-        if( inImageBW == NULL ) return -1;
+    // Scale from the processed image back to the input image.
+    switch (kpmHandle->procMode) {
+        case KpmProcFullSize:     procScale = 1.0f; break;
+        case KpmProcTwoThirdSize: procScale = 1.5f; break;
+        case KpmProcHalfSize:     procScale = 2.0f; break;
+        case KpmProcOneThirdSize: procScale = 3.0f; break;
+        default:                  procScale = 4.0f; break; // KpmProcQuatSize
     }
 
+    pthread_mutex_lock( &(kpmHandle->refDataSetLock) );
+    
 #if BINARY_FEATURE
-    kpmHandle->freakMatcher->query(inImageBW, xsize ,ysize);
+    kpmHandle->freakMatcher->query(inImageBW, xsize2, ysize2);
     kpmHandle->inDataSet.num = (int)kpmHandle->freakMatcher->getQueryFeaturePoints().size();
 #else
     surfSubExtractFeaturePoint( kpmHandle->surfHandle, inImageBW, kpmHandle->skipRegion.region, kpmHandle->skipRegion.regionNum );
     kpmHandle->skipRegion.regionNum = 0;
-    kpmHandle->inDataSet.num = featureVector.num = surfSubGetFeaturePointNum( kpmHandle->surfHandle );
+    kpmHandle->inDataSet.num = surfSubGetFeaturePointNum( kpmHandle->surfHandle );
 #endif
     
     if( kpmHandle->inDataSet.num != 0 ) {
-        if( kpmHandle->inDataSet.coord != NULL ) free(kpmHandle->inDataSet.coord);
-#if !BINARY_FEATURE
-        if( kpmHandle->preRANSAC.match != NULL ) free(kpmHandle->preRANSAC.match);
-        if( kpmHandle->aftRANSAC.match != NULL ) free(kpmHandle->aftRANSAC.match);
-#endif
-        arMalloc( kpmHandle->inDataSet.coord, KpmCoord2D,     kpmHandle->inDataSet.num );
+        kpmAllocInDataSet( kpmHandle, kpmHandle->inDataSet.num );
 #if !BINARY_FEATURE
-        arMalloc( kpmHandle->preRANSAC.match, KpmMatchData,   kpmHandle->inDataSet.num );
-        arMalloc( kpmHandle->aftRANSAC.match, KpmMatchData,   kpmHandle->inDataSet.num );
-#endif
-#if BINARY_FEATURE
-#else
-        arMalloc( featureVector.sf,           SurfFeature,    kpmHandle->inDataSet.num );
-        arMalloc( preRANSAC.mp,               MatchPoint,     kpmHandle->inDataSet.num );
-        arMalloc( inlierIndex,                int,            kpmHandle->inDataSet.num );
-
-        knn = 1;
-        arMalloc( annMatch2,                  int,            kpmHandle->inDataSet.num*knn);
+        featureVector = &(kpmHandle->featureVector);
+        featureVector->num = kpmHandle->inDataSet.num;
+        preRANSAC = &(kpmHandle->corspMap);
+        knn = KPM_ANN_KNN;
+        annMatch2 = kpmHandle->annMatch2;
 #endif
         
 #if BINARY_FEATURE
         const std::vector<vision::FeaturePoint>& points = kpmHandle->freakMatcher->getQueryFeaturePoints();
         //const std::vector<unsigned char>& descriptors = kpmHandle->freakMatcher->getQueryDescriptors();
 #endif
-        if( procMode == KpmProcFullSize ) {
-            for( i = 0 ; i < kpmHandle->inDataSet.num; i++ ) {
-
+        for( i = 0 ; i < kpmHandle->inDataSet.num; i++ ) {
 #if BINARY_FEATURE
-                float  x = points[i].x, y = points[i].y;
+            float  x = points[i].x, y = points[i].y;
 #else
-                float  x, y, *desc;
-                surfSubGetFeaturePosition( kpmHandle->surfHandle, i, &x, &y );
-                desc = surfSubGetFeatureDescPtr( kpmHandle->surfHandle, i );
-                for( j = 0; j < SURF_SUB_DIMENSION; j++ ) {
-                    featureVector.sf[i].v[j] = desc[j];
-                }
-                featureVector.sf[i].l = surfSubGetFeatureSign( kpmHandle->surfHandle, i );
-#endif
-                if( kpmHandle->cparamLT != NULL ) {
-                    arParamObserv2IdealLTf( &(kpmHandle->cparamLT->paramLTf), x, y, &(kpmHandle->inDataSet.coord[i].x), &(kpmHandle->inDataSet.coord[i].y) );
-                }
-                else {
-                    kpmHandle->inDataSet.coord[i].x = x;
-                    kpmHandle->inDataSet.coord[i].y = y;
-                }
-            }
-        }
-        else if( procMode == KpmProcTwoThirdSize ) {
-            for( i = 0 ; i < kpmHandle->inDataSet.num; i++ ) {
-#if BINARY_FEATURE
-                float  x = points[i].x, y = points[i].y;
-#else
-                float  x, y, *desc;
-                surfSubGetFeaturePosition( kpmHandle->surfHandle, i, &x, &y );
-                desc = surfSubGetFeatureDescPtr( kpmHandle->surfHandle, i );
-                for( j = 0; j < SURF_SUB_DIMENSION; j++ ) {
-                    featureVector.sf[i].v[j] = desc[j];
-                }
-                featureVector.sf[i].l = surfSubGetFeatureSign( kpmHandle->surfHandle, i );
-#endif
-                if( kpmHandle->cparamLT != NULL ) {
-                    arParamObserv2IdealLTf( &(kpmHandle->cparamLT->paramLTf), x*1.5f, y*1.5f, &(kpmHandle->inDataSet.coord[i].x), &(kpmHandle->inDataSet.coord[i].y) );
-                }
-                else {
-                    kpmHandle->inDataSet.coord[i].x = x*1.5f;
-                    kpmHandle->inDataSet.coord[i].y = y*1.5f;
-                }
-            }
-        }
-        else if( procMode == KpmProcHalfSize ) {
-            for( i = 0 ; i < kpmHandle->inDataSet.num; i++ ) {
-#if BINARY_FEATURE
-                float  x = points[i].x, y = points[i].y;
-#else
-                float  x, y, *desc;
-                surfSubGetFeaturePosition( kpmHandle->surfHandle, i, &x, &y );
-                desc = surfSubGetFeatureDescPtr( kpmHandle->surfHandle, i );
-                for( j = 0; j < SURF_SUB_DIMENSION; j++ ) {
-                    featureVector.sf[i].v[j] = desc[j];
-                }
-                featureVector.sf[i].l = surfSubGetFeatureSign( kpmHandle->surfHandle, i );
-#endif
-                if( kpmHandle->cparamLT != NULL ) {
-                    arParamObserv2IdealLTf( &(kpmHandle->cparamLT->paramLTf), x*2.0f, y*2.0f, &(kpmHandle->inDataSet.coord[i].x), &(kpmHandle->inDataSet.coord[i].y) );
-                }
-                else {
-                    kpmHandle->inDataSet.coord[i].x = x*2.0f;
-                    kpmHandle->inDataSet.coord[i].y = y*2.0f;
-                }
+            float  x, y, *desc;
+            surfSubGetFeaturePosition( kpmHandle->surfHandle, i, &x, &y );
+            desc = surfSubGetFeatureDescPtr( kpmHandle->surfHandle, i );
+            for( j = 0; j < SURF_SUB_DIMENSION; j++ ) {
+                featureVector->sf[i].v[j] = desc[j];
             }
-        }
-        else if( procMode == KpmProcOneThirdSize ) {
-            for( i = 0 ; i < kpmHandle->inDataSet.num; i++ ) {
-#if BINARY_FEATURE
-                float  x = points[i].x, y = points[i].y;
-#else
-                float  x, y, *desc;
-                surfSubGetFeaturePosition( kpmHandle->surfHandle, i, &x, &y );
-                desc = surfSubGetFeatureDescPtr( kpmHandle->surfHandle, i );
-                for( j = 0; j < SURF_SUB_DIMENSION; j++ ) {
-                    featureVector.sf[i].v[j] = desc[j];
-                }
-                featureVector.sf[i].l = surfSubGetFeatureSign( kpmHandle->surfHandle, i );
+            featureVector->sf[i].l = surfSubGetFeatureSign( kpmHandle->surfHandle, i );
 #endif
-                if( kpmHandle->cparamLT != NULL ) {
-                    arParamObserv2IdealLTf( &(kpmHandle->cparamLT->paramLTf), x*3.0f, y*3.0f, &(kpmHandle->inDataSet.coord[i].x), &(kpmHandle->inDataSet.coord[i].y) );
-                }
-                else {
-                    kpmHandle->inDataSet.coord[i].x = x*3.0f;
-                    kpmHandle->inDataSet.coord[i].y = y*3.0f;
-                }
+            x *= procScale;
+            y *= procScale;
+            if( kpmHandle->cparamLT != NULL ) {
+                arParamObserv2IdealLTf( &(kpmHandle->cparamLT->paramLTf), x, y, &(kpmHandle->inDataSet.coord[i].x), &(kpmHandle->inDataSet.coord[i].y) );
             }
-        }
-        else { // procMode == KpmProcQuatSize
-            for( i = 0 ; i < kpmHandle->inDataSet.num; i++ ) {
-#if BINARY_FEATURE
-                float  x = points[i].x, y = points[i].y;
-#else
-                float  x, y, *desc;
-                surfSubGetFeaturePosition( kpmHandle->surfHandle, i, &x, &y );
-                desc = surfSubGetFeatureDescPtr( kpmHandle->surfHandle, i );
-                for( j = 0; j < SURF_SUB_DIMENSION; j++ ) {
-                    featureVector.sf[i].v[j] = desc[j];
-                }
-                featureVector.sf[i].l = surfSubGetFeatureSign( kpmHandle->surfHandle, i );
-#endif
-                if( kpmHandle->cparamLT != NULL ) {
-                    arParamObserv2IdealLTf( &(kpmHandle->cparamLT->paramLTf), x*4.0f, y*4.0f, &(kpmHandle->inDataSet.coord[i].x), &(kpmHandle->inDataSet.coord[i].y) );
-                }
-                else {
-                    kpmHandle->inDataSet.coord[i].x = x*4.0f;
-                    kpmHandle->inDataSet.coord[i].y = y*4.0f;
-                }
+            else {
+                kpmHandle->inDataSet.coord[i].x = x;
+                kpmHandle->inDataSet.coord[i].y = y;
             }
         }
 
 #if !BINARY_FEATURE
         ann2 = (CAnnMatch2*)kpmHandle->ann2;
-        ann2->Match(&featureVector, knn, annMatch2);
+        ann2->Match(featureVector, knn, annMatch2);
+        kpmBucketMatchesByPage( kpmHandle, annMatch2, kpmHandle->inDataSet.num, knn );
         for(int pageLoop = 0; pageLoop < kpmHandle->resultNum; pageLoop++ ) {
             kpmHandle->preRANSAC.num = 0;
             kpmHandle->aftRANSAC.num = 0;
@@ -573,40 +826,34 @@ int kpmMatching( KpmHandle *kpmHandle, ARUint8 *inImage )
             kpmHandle->result[pageLoop].camPoseF = -1;
             if( kpmHandle->result[pageLoop].skipF ) continue;
 
-            int featureNum = 0;
-            int *annMatch2Ptr = annMatch2;
-            int pageNo = kpmHandle->refDataSet.pageInfo[pageLoop].pageNo;
-            for( i = 0; i < kpmHandle->inDataSet.num; i++ ) {
-                for( j = 0; j < knn; j++ ) {
-                    if( *annMatch2Ptr >= 0 && kpmHandle->refDataSet.refPoint[*annMatch2Ptr].pageNo == pageNo ) {
-                        kpmHandle->preRANSAC.match[featureNum].inIndex = i;
-                        kpmHandle->preRANSAC.match[featureNum].refIndex = *annMatch2Ptr;
-                        preRANSAC.mp[featureNum].x1 = kpmHandle->inDataSet.coord[i].x;
-                        preRANSAC.mp[featureNum].y1 = kpmHandle->inDataSet.coord[i].y;
-                        preRANSAC.mp[featureNum].x2 = kpmHandle->refDataSet.refPoint[*annMatch2Ptr].coord3D.x;
-                        preRANSAC.mp[featureNum].y2 = kpmHandle->refDataSet.refPoint[*annMatch2Ptr].coord3D.y;
-                        featureNum++;
-                        annMatch2Ptr += knn-j;
-                        break;
-                    }
-                    annMatch2Ptr++;
-                }
-            }
+            int featureNum = kpmHandle->pageMatchStart[pageLoop+1] - kpmHandle->pageMatchStart[pageLoop];
             //printf("Page[%d] %d\n", pageLoop, featureNum);
-            preRANSAC.num = featureNum;
             if( featureNum < 6 ) continue;
             
-            if( kpmRansacHomograhyEstimation(&preRANSAC, inlierIndex, &inlierNum, h) < 0 ) {
+            const int *pageMatch = &(kpmHandle->pageMatch[kpmHandle->pageMatchStart[pageLoop]]);
+            for( i = 0; i < featureNum; i++ ) {
+                int inIndex  = pageMatch[i] / knn;
+                int refIndex = annMatch2[pageMatch[i]];
+                kpmHandle->preRANSAC.match[i].inIndex = inIndex;
+                kpmHandle->preRANSAC.match[i].refIndex = refIndex;
+                preRANSAC->mp[i].x1 = kpmHandle->inDataSet.coord[inIndex].x;
+                preRANSAC->mp[i].y1 = kpmHandle->inDataSet.coord[inIndex].y;
+                preRANSAC->mp[i].x2 = kpmHandle->refDataSet.refPoint[refIndex].coord3D.x;
+                preRANSAC->mp[i].y2 = kpmHandle->refDataSet.refPoint[refIndex].coord3D.y;
+            }
+            preRANSAC->num = featureNum;
+            
+            if( kpmRansacHomograhyEstimation(preRANSAC, kpmHandle->inlierIndex, &inlierNum, h) < 0 ) {
                 inlierNum = 0;
             }
-            //printf(" --> page[%d] %d  pre:%3d, aft:%3d\n", pageLoop, kpmHandle->inDataSet.num, preRANSAC.num, inlierNum);
+            //printf(" --> page[%d] %d  pre:%3d, aft:%3d\n", pageLoop, kpmHandle->inDataSet.num, preRANSAC->num, inlierNum);
             if( inlierNum < 6 ) continue;
             
-            kpmHandle->preRANSAC.num = preRANSAC.num;
+            kpmHandle->preRANSAC.num = preRANSAC->num;
             kpmHandle->aftRANSAC.num = inlierNum;
             for( i = 0; i < inlierNum; i++ ) {
-                kpmHandle->aftRANSAC.match[i].inIndex = kpmHandle->preRANSAC.match[inlierIndex[i]].inIndex;
-                kpmHandle->aftRANSAC.match[i].refIndex = kpmHandle->preRANSAC.match[inlierIndex[i]].refIndex;
+                kpmHandle->aftRANSAC.match[i].inIndex = kpmHandle->preRANSAC.match[kpmHandle->inlierIndex[i]].inIndex;
+                kpmHandle->aftRANSAC.match[i].refIndex = kpmHandle->preRANSAC.match[kpmHandle->inlierIndex[i]].refIndex;
             }
             //printf(" ---> %d %d %d\n", kpmHandle->inDataSet.num, kpmHandle->preRANSAC.num, kpmHandle->aftRANSAC.num);
             if( kpmHandle->poseMode == KpmPose6DOF ) {
@@ -623,22 +870,26 @@ int kpmMatching( KpmHandle *kpmHandle, ARUint8 *inImage )
             if( ret == 0 ) {
                 kpmHandle->result[pageLoop].camPoseF = 0;
                 kpmHandle->result[pageLoop].inlierNum = inlierNum;
-                ARLOGi("Page[%d]  pre:%3d, aft:%3d, error = %f\n", pageLoop, preRANSAC.num, inlierNum, kpmHandle->result[pageLoop].error);
+                ARLOGi("Page[%d]  pre:%3d, aft:%3d, error = %f\n", pageLoop, preRANSAC->num, inlierNum, kpmHandle->result[pageLoop].error);
             }
         }
-        free(annMatch2);
 #else
         for (int pageLoop = 0; pageLoop < kpmHandle->resultNum; pageLoop++) {
-            
             kpmHandle->result[pageLoop].pageNo = kpmHandle->refDataSet.pageInfo[pageLoop].pageNo;
             kpmHandle->result[pageLoop].camPoseF = -1;
-            if( kpmHandle->result[pageLoop].skipF ) continue;
-            
-            
+        }
+        
+        // The query yields at most one matched image, so only its page needs a pose.
+        int matched_image_id = kpmHandle->freakMatcher->matchedId();
+        int pageLoop = -1;
+        if (matched_image_id >= 0) {
+            for (pageLoop = 0; pageLoop < kpmHandle->resultNum; pageLoop++) {
+                if (kpmHandle->result[pageLoop].pageNo == kpmHandle->pageIDs[matched_image_id]) break;
+            }
+        }
+        if (pageLoop >= 0 && pageLoop < kpmHandle->resultNum && !kpmHandle->result[pageLoop].skipF) {
             const vision::matches_t& matches = kpmHandle->freakMatcher->inliers();
-            int matched_image_id = kpmHandle->freakMatcher->matchedId();
-            if (matched_image_id < 0) continue;
-
+            
             ret = kpmUtilGetPose_binary(kpmHandle->cparamLT,
                                         matches ,
                                         kpmHandle->freakMatcher->get3DFeaturePoints(matched_image_id),
@@ -649,15 +900,9 @@ int kpmMatching( KpmHandle *kpmHandle, ARUint8 *inImage )
             if( ret == 0 ) {
                 kpmHandle->result[pageLoop].camPoseF = 0;
                 kpmHandle->result[pageLoop].inlierNum = (int)matches.size();
-                kpmHandle->result[pageLoop].pageNo = kpmHandle->pageIDs[matched_image_id];
                 ARLOGi("Page[%d]  pre:%3d, aft:%3d, error = %f\n", pageLoop, (int)matches.size(), (int)matches.size(), kpmHandle->result[pageLoop].error);
             }
         }
-#endif
-#if !BINARY_FEATURE
-        free(featureVector.sf);
-        free(preRANSAC.mp);
-        free(inlierIndex);
 #endif
     }
     else {
@@ -671,9 +916,9 @@ int kpmMatching( KpmHandle *kpmHandle, ARUint8 *inImage )
     }
     
     for( i = 0; i < kpmHandle->resultNum; i++ ) kpmHandle->result[i].skipF = 0;
-
-    if (inImageBW != inImage) free( inImageBW );
     
+    pthread_mutex_unlock( &(kpmHandle->refDataSetLock) );
+
     return 0;
 }
 
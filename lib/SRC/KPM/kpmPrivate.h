@@ -41,6 +41,8 @@
 #else
 #include <KPM/surfSub.h>
 #endif
+#include <pthread.h>
+
 #define DB_IMAGE_MAX 1024
 #if !BINARY_FEATURE
 typedef struct {
@@ -88,7 +90,24 @@ struct _KpmHandle {
     
     KpmResult                *result;
     int                       resultNum;
-    int                       pageIDs[DB_IMAGE_MAX];
+    int                       pageIDs[DB_IMAGE_MAX];   // Page number of each database image, or -1 if unused.
+    
+    // Held while matching, and while the reference data is replaced or pages are added or removed.
+    pthread_mutex_t           refDataSetLock;
+    
+    // Buffers reused from frame to frame by kpmMatching.
+    ARUint8                  *bwImage;
+    int                       bwImageSize;
+    int                       inDataSetMax;     // Capacity of the per-feature arrays.
+#if !BINARY_FEATURE
+    FeatureVector             featureVector;
+    CorspMap                  corspMap;
+    int                      *inlierIndex;
+    int                      *annMatch2;
+    int                      *pageMatch;        // ANN matches grouped by page.
+    int                      *pageMatchStart;   // refDataSet.pageNum+1 offsets into pageMatch.
+    int                      *refPointPage;     // Index into refDataSet.pageInfo of each refPoint.
+#endif
 };
 
 #endif // !__kpmPrivate_h__
@@ -37,6 +37,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <AR/ar.h>
 #include <AR/icp.h>
 #include <KPM/kpm.h>
@@ -48,11 +49,11 @@
 #include <KPM/surfSub.h>
 #endif
 
-static ARUint8 *genBWImageFull      ( ARUint8 *image, AR_PIXEL_FORMAT pixFormat, int xsize, int ysize, int *newXsize, int *newYsize );
-static ARUint8 *genBWImageHalf      ( ARUint8 *image, AR_PIXEL_FORMAT pixFormat, int xsize, int ysize, int *newXsize, int *newYsize );
-static ARUint8 *genBWImageOneThird  ( ARUint8 *image, AR_PIXEL_FORMAT pixFormat, int xsize, int ysize, int *newXsize, int *newYsize );
-static ARUint8 *genBWImageTwoThird  ( ARUint8 *image, AR_PIXEL_FORMAT pixFormat, int xsize, int ysize, int *newXsize, int *newYsize );
-static ARUint8 *genBWImageQuart     ( ARUint8 *image, AR_PIXEL_FORMAT pixFormat, int xsize, int ysize, int *newXsize, int *newYsize );
+static void     genBWImageFull      ( ARUint8 *image, AR_PIXEL_FORMAT pixFormat, int xsize, int ysize, int rowBytes, ARUint8 *newImage );
+static void     genBWImageHalf      ( ARUint8 *image, AR_PIXEL_FORMAT pixFormat, int xsize, int ysize, int rowBytes, ARUint8 *newImage );
+static void     genBWImageOneThird  ( ARUint8 *image, AR_PIXEL_FORMAT pixFormat, int xsize, int ysize, int rowBytes, ARUint8 *newImage );
+static void     genBWImageTwoThird  ( ARUint8 *image, AR_PIXEL_FORMAT pixFormat, int xsize, int ysize, int rowBytes, ARUint8 *newImage );
+static void     genBWImageQuart     ( ARUint8 *image, AR_PIXEL_FORMAT pixFormat, int xsize, int ysize, int rowBytes, ARUint8 *newImage );
 
 
 #if !BINARY_FEATURE
@@ -163,21 +164,65 @@ int kpmUtilGetCorner( ARUint8 *inImage, AR_PIXEL_FORMAT pixFormat, int xsize, in
 
 ARUint8 *kpmUtilGenBWImage( ARUint8 *image, AR_PIXEL_FORMAT pixFormat, int xsize, int ysize, int procMode, int *newXsize, int *newYsize )
 {
+    ARUint8  *newImage;
+    
+    if( kpmUtilGetBWImageSize( xsize, ysize, procMode, newXsize, newYsize ) < 0 ) return NULL;
+    arMalloc( newImage, ARUint8, (*newXsize)*(*newYsize) );
+    
+    kpmUtilGenBWImage2( image, pixFormat, xsize, ysize, xsize*arUtilGetPixelSize(pixFormat), procMode, newImage );
+    
+    return newImage;
+}
+
+int kpmUtilGetBWImageSize( int xsize, int ysize, int procMode, int *newXsize, int *newYsize )
+{
+    if( !newXsize || !newYsize ) return -1;
+    
+    if( procMode == KpmProcFullSize ) {
+        *newXsize = xsize;
+        *newYsize = ysize;
+    }
+    else if( procMode == KpmProcTwoThirdSize ) {
+        *newXsize = xsize/3*2;
+        *newYsize = ysize/3*2;
+    }
+    else if( procMode == KpmProcHalfSize ) {
+        *newXsize = xsize/2;
+        *newYsize = ysize/2;
+    }
+    else if( procMode == KpmProcOneThirdSize ) {
+        *newXsize = xsize/3;
+        *newYsize = ysize/3;
+    }
+    else {
+        *newXsize = xsize/4;
+        *newYsize = ysize/4;
+    }
+    
+    return 0;
+}
+
+int kpmUtilGenBWImage2( ARUint8 *image, AR_PIXEL_FORMAT pixFormat, int xsize, int ysize, int rowBytes, int procMode, ARUint8 *newImage )
+{
+    if( !image || !newImage ) return -1;
+    
     if( procMode == KpmProcFullSize ) {
-        return genBWImageFull( image, pixFormat, xsize, ysize, newXsize, newYsize );
+        genBWImageFull( image, pixFormat, xsize, ysize, rowBytes, newImage );
     }
     else if( procMode == KpmProcTwoThirdSize ) {
-        return genBWImageTwoThird( image, pixFormat, xsize, ysize, newXsize, newYsize );
+        genBWImageTwoThird( image, pixFormat, xsize, ysize, rowBytes, newImage );
     }
     else if( procMode == KpmProcHalfSize ) {
-        return genBWImageHalf( image, pixFormat, xsize, ysize, newXsize, newYsize );
+        genBWImageHalf( image, pixFormat, xsize, ysize, rowBytes, newImage );
     }
     else if( procMode == KpmProcOneThirdSize ) {
-        return genBWImageOneThird( image, pixFormat, xsize, ysize, newXsize, newYsize );
+        genBWImageOneThird( image, pixFormat, xsize, ysize, rowBytes, newImage );
     }
     else {
-        return genBWImageQuart( image, pixFormat, xsize, ysize, newXsize, newYsize );
+        genBWImageQuart( image, pixFormat, xsize, ysize, rowBytes, newImage );
     }
+    
+    return 0;
 }
 
 #if !BINARY_FEATURE
@@ -463,89 +508,88 @@ int kpmUtilGetPoseHomography( KpmMatchResult *matchData, KpmRefDataSet *refDataS
 }
 #endif
 
-static ARUint8 *genBWImageFull( ARUint8 *image, AR_PIXEL_FORMAT pixFormat, int xsize, int ysize, int *newXsize, int *newYsize )
+static void genBWImageFull( ARUint8 *image, AR_PIXEL_FORMAT pixFormat, int xsize, int ysize, int rowBytes, ARUint8 *newImage )
 {
-    ARUint8  *newImage, *p;
+    ARUint8  *p, *p1;
     int       xsize2, ysize2;
     int       i, j;
 
-    *newXsize = xsize2 = xsize;
-    *newYsize = ysize2 = ysize;
-    arMalloc( newImage, ARUint8, xsize*ysize );
+    xsize2 = xsize;
+    ysize2 = ysize;
     
     if( pixFormat == AR_PIXEL_FORMAT_RGB || pixFormat == AR_PIXEL_FORMAT_BGR ) {
         p = newImage;
         for( j = 0; j < ysize2; j++ ) {
+            p1 = image + rowBytes*j;
             for( i = 0; i < xsize2; i++ ) {
-                *(p++) = ( (int)*image + (int)*(image+1) + (int)*(image+2) ) / 3;
-                image+=3;
+                *(p++) = ( (int)*p1 + (int)*(p1+1) + (int)*(p1+2) ) / 3;
+                p1+=3;
             }
         }
     }
     else if( pixFormat == AR_PIXEL_FORMAT_RGBA || pixFormat == AR_PIXEL_FORMAT_BGRA ) {
         p = newImage;
         for( j = 0; j < ysize2; j++ ) {
+            p1 = image + rowBytes*j;
             for( i = 0; i < xsize2; i++ ) {
-                *(p++) = ( (int)*image + (int)*(image+1) + (int)*(image+2) ) / 3;
-                image+=4;
+                *(p++) = ( (int)*p1 + (int)*(p1+1) + (int)*(p1+2) ) / 3;
+                p1+=4;
             }
         }
     }
     else if( pixFormat == AR_PIXEL_FORMAT_ABGR || pixFormat == AR_PIXEL_FORMAT_ARGB) {
         p = newImage;
         for( j = 0; j < ysize2; j++ ) {
+            p1 = image + rowBytes*j;
             for( i = 0; i < xsize2; i++ ) {
-                *(p++) = ( (int)*(image+1) + (int)*(image+2) + (int)*(image+3) ) / 3;
-                image+=4;
+                *(p++) = ( (int)*(p1+1) + (int)*(p1+2) + (int)*(p1+3) ) / 3;
+                p1+=4;
             }
         }
     }
     else if( pixFormat == AR_PIXEL_FORMAT_MONO || pixFormat == AR_PIXEL_FORMAT_420f || pixFormat == AR_PIXEL_FORMAT_420v || pixFormat == AR_PIXEL_FORMAT_NV21 ) {
         p = newImage;
         for( j = 0; j < ysize2; j++ ) {
-            for( i = 0; i < xsize2; i++ ) {
-                *(p++) = *(image++);
-            }
+            memcpy( p, image + rowBytes*j, xsize2 );
+            p += xsize2;
         }
     }
     else if( pixFormat == AR_PIXEL_FORMAT_2vuy ) {
         p = newImage;
         for( j = 0; j < ysize2; j++ ) {
+            p1 = image + rowBytes*j;
             for( i = 0; i < xsize2; i++ ) {
-                *(p++) = *(image+1);
-                image+=2;
+                *(p++) = *(p1+1);
+                p1+=2;
             }
         }
     }
     else if( pixFormat == AR_PIXEL_FORMAT_yuvs ) {
         p = newImage;
         for( j = 0; j < ysize2; j++ ) {
+            p1 = image + rowBytes*j;
             for( i = 0; i < xsize2; i++ ) {
-                *(p++) = *image;
-                image+=2;
+                *(p++) = *p1;
+                p1+=2;
             }
         }
     }
-
-    return newImage;
 }
 
-static ARUint8 *genBWImageHalf( ARUint8 *image, AR_PIXEL_FORMAT pixFormat, int xsize, int ysize, int *newXsize, int *newYsize )
+static void genBWImageHalf( ARUint8 *image, AR_PIXEL_FORMAT pixFormat, int xsize, int ysize, int rowBytes, ARUint8 *newImage )
 {
-    ARUint8  *newImage;
     ARUint8  *p, *p1, *p2;
     int       xsize2, ysize2;
     int       i, j;
     
-    *newXsize = xsize2 = xsize/2;
-    *newYsize = ysize2 = ysize/2;
-    arMalloc( newImage, ARUint8, xsize2*ysize2 );
+    xsize2 = xsize/2;
+    ysize2 = ysize/2;
 
     if( pixFormat == AR_PIXEL_FORMAT_RGB || pixFormat == AR_PIXEL_FORMAT_BGR ) {
         p  = newImage;
         for( j = 0; j < ysize2; j++ ) {
-            p1 = image + xsize*3*(j*2+0);
-            p2 = image + xsize*3*(j*2+1);
+            p1 = image + rowBytes*(j*2+0);
+            p2 = image + rowBytes*(j*2+1);
             for( i = 0; i < xsize2; i++ ) {
                 *(p++) = ( (int)*(p1+0) + (int)*(p1+1) + (int)*(p1+2)
                          + (int)*(p1+3) + (int)*(p1+4) + (int)*(p1+5)
@@ -559,8 +603,8 @@ static ARUint8 *genBWImageHalf( ARUint8 *image, AR_PIXEL_FORMAT pixFormat, int x
     else if( pixFormat == AR_PIXEL_FORMAT_RGBA || pixFormat == AR_PIXEL_FORMAT_BGRA ) {
         p  = newImage;
         for( j = 0; j < ysize2; j++ ) {
-            p1 = image + xsize*4*(j*2+0);
-            p2 = image + xsize*4*(j*2+1);
+            p1 = image + rowBytes*(j*2+0);
+            p2 = image + rowBytes*(j*2+1);
             for( i = 0; i < xsize2; i++ ) {
                 *(p++) = ( (int)*(p1+0) + (int)*(p1+1) + (int)*(p1+2)
                          + (int)*(p1+4) + (int)*(p1+5) + (int)*(p1+6)
@@ -574,8 +618,8 @@ static ARUint8 *genBWImageHalf( ARUint8 *image, AR_PIXEL_FORMAT pixFormat, int x
     else if( pixFormat == AR_PIXEL_FORMAT_ABGR || pixFormat == AR_PIXEL_FORMAT_ARGB) {
         p  = newImage;
         for( j = 0; j < ysize2; j++ ) {
-            p1 = image + xsize*4*(j*2+0);
-            p2 = image + xsize*4*(j*2+1);
+            p1 = image + rowBytes*(j*2+0);
+            p2 = image + rowBytes*(j*2+1);
             for( i = 0; i < xsize2; i++ ) {
                 *(p++) = ( (int)*(p1+1) + (int)*(p1+2) + (int)*(p1+3)
                          + (int)*(p1+5) + (int)*(p1+6) + (int)*(p1+7)
@@ -589,8 +633,8 @@ static ARUint8 *genBWImageHalf( ARUint8 *image, AR_PIXEL_FORMAT pixFormat, int x
     else if( pixFormat == AR_PIXEL_FORMAT_MONO || pixFormat == AR_PIXEL_FORMAT_420f || pixFormat == AR_PIXEL_FORMAT_420v || pixFormat == AR_PIXEL_FORMAT_NV21) {
         p  = newImage;
         for( j = 0; j < ysize2; j++ ) {
-            p1 = image + xsize*(j*2+0);
-            p2 = image + xsize*(j*2+1);
+            p1 = image + rowBytes*(j*2+0);
+            p2 = image + rowBytes*(j*2+1);
             for( i = 0; i < xsize2; i++ ) {
                 *(p++) = ( (int)*(p1+0) + (int)*(p1+1)
                          + (int)*(p2+0) + (int)*(p2+1) ) / 4;
@@ -602,8 +646,8 @@ static ARUint8 *genBWImageHalf( ARUint8 *image, AR_PIXEL_FORMAT pixFormat, int x
     else if( pixFormat == AR_PIXEL_FORMAT_2vuy) {
         p  = newImage;
         for( j = 0; j < ysize2; j++ ) {
-            p1 = image + xsize*2*(j*2+0);
-            p2 = image + xsize*2*(j*2+1);
+            p1 = image + rowBytes*(j*2+0);
+            p2 = image + rowBytes*(j*2+1);
             for( i = 0; i < xsize2; i++ ) {
                 *(p++) = ( (int)*(p1+1) + (int)*(p1+3)
                          + (int)*(p2+1) + (int)*(p2+3) ) / 4;
@@ -615,8 +659,8 @@ static ARUint8 *genBWImageHalf( ARUint8 *image, AR_PIXEL_FORMAT pixFormat, int x
     else if( pixFormat == AR_PIXEL_FORMAT_yuvs) {
         p  = newImage;
         for( j = 0; j < ysize2; j++ ) {
-            p1 = image + xsize*2*(j*2+0);
-            p2 = image + xsize*2*(j*2+1);
+            p1 = image + rowBytes*(j*2+0);
+            p2 = image + rowBytes*(j*2+1);
             for( i = 0; i < xsize2; i++ ) {
                 *(p++) = ( (int)*(p1+0) + (int)*(p1+2)
                          + (int)*(p2+0) + (int)*(p2+2) ) / 4;
@@ -625,28 +669,24 @@ static ARUint8 *genBWImageHalf( ARUint8 *image, AR_PIXEL_FORMAT pixFormat, int x
             }
         }
     }
-
-    return newImage;
 }
 
-static ARUint8 *genBWImageQuart( ARUint8 *image, AR_PIXEL_FORMAT pixFormat, int xsize, int ysize, int *newXsize, int *newYsize )
+static void genBWImageQuart( ARUint8 *image, AR_PIXEL_FORMAT pixFormat, int xsize, int ysize, int rowBytes, ARUint8 *newImage )
 {
-    ARUint8  *newImage;
     ARUint8  *p, *p1, *p2, *p3, *p4;
     int       xsize2, ysize2;
     int       i, j;
     
-    *newXsize = xsize2 = xsize/4;
-    *newYsize = ysize2 = ysize/4;
-    arMalloc( newImage, ARUint8, xsize2*ysize2 );
+    xsize2 = xsize/4;
+    ysize2 = ysize/4;
     
     if( pixFormat == AR_PIXEL_FORMAT_RGB || pixFormat == AR_PIXEL_FORMAT_BGR ) {
         p  = newImage;
         for( j = 0; j < ysize2; j++ ) {
-            p1 = image + xsize*3*(j*4+0);
-            p2 = image + xsize*3*(j*4+1);
-            p3 = image + xsize*3*(j*4+2);
-            p4 = image + xsize*3*(j*4+3);
+            p1 = image + rowBytes*(j*4+0);
+            p2 = image + rowBytes*(j*4+1);
+            p3 = image + rowBytes*(j*4+2);
+            p4 = image + rowBytes*(j*4+3);
             for( i = 0; i < xsize2; i++ ) {
                 *(p++) = ( (int)*(p1+0) + (int)*(p1+1) + (int)*(p1+2)
                          + (int)*(p1+3) + (int)*(p1+4) + (int)*(p1+5)
@@ -674,10 +714,10 @@ static ARUint8 *genBWImageQuart( ARUint8 *image, AR_PIXEL_FORMAT pixFormat, int
     else if( pixFormat == AR_PIXEL_FORMAT_RGBA || pixFormat == AR_PIXEL_FORMAT_BGRA ) {
         p  = newImage;
         for( j = 0; j < ysize2; j++ ) {
-            p1 = image + xsize*4*(j*4+0);
-            p2 = image + xsize*4*(j*4+1);
-            p3 = image + xsize*4*(j*4+2);
-            p4 = image + xsize*4*(j*4+3);
+            p1 = image + rowBytes*(j*4+0);
+            p2 = image + rowBytes*(j*4+1);
+            p3 = image + rowBytes*(j*4+2);
+            p4 = image + rowBytes*(j*4+3);
             for( i = 0; i < xsize2; i++ ) {
                 *(p++) = ( (int)*(p1+0) + (int)*(p1+1) + (int)*(p1+2)
                          + (int)*(p1+4) + (int)*(p1+5) + (int)*(p1+6)
@@ -705,10 +745,10 @@ static ARUint8 *genBWImageQuart( ARUint8 *image, AR_PIXEL_FORMAT pixFormat, int
     else if( pixFormat == AR_PIXEL_FORMAT_ABGR || pixFormat == AR_PIXEL_FORMAT_ARGB) {
         p  = newImage;
         for( j = 0; j < ysize2; j++ ) {
-            p1 = image + xsize*4*(j*4+0);
-            p2 = image + xsize*4*(j*4+1);
-            p3 = image + xsize*4*(j*4+2);
-            p4 = image + xsize*4*(j*4+3);
+            p1 = image + rowBytes*(j*4+0);
+            p2 = image + rowBytes*(j*4+1);
+            p3 = image + rowBytes*(j*4+2);
+            p4 = image + rowBytes*(j*4+3);
             for( i = 0; i < xsize2; i++ ) {
                 *(p++) = ( (int)*(p1+1) + (int)*(p1+2) + (int)*(p1+3)
                          + (int)*(p1+5) + (int)*(p1+6) + (int)*(p1+7)
@@ -736,10 +776,10 @@ static ARUint8 *genBWImageQuart( ARUint8 *image, AR_PIXEL_FORMAT pixFormat, int
     else if( pixFormat == AR_PIXEL_FORMAT_MONO || pixFormat == AR_PIXEL_FORMAT_420f || pixFormat == AR_PIXEL_FORMAT_420v || pixFormat == AR_PIXEL_FORMAT_NV21 ) {
         p  = newImage;
         for( j = 0; j < ysize2; j++ ) {
-            p1 = image + xsize*(j*4+0);
-            p2 = image + xsize*(j*4+1);
-            p3 = image + xsize*(j*4+2);
-            p4 = image + xsize*(j*4+3);
+            p1 = image + rowBytes*(j*4+0);
+            p2 = image + rowBytes*(j*4+1);
+            p3 = image + rowBytes*(j*4+2);
+            p4 = image + rowBytes*(j*4+3);
             for( i = 0; i < xsize2; i++ ) {
                 *(p++) = ( (int)*(p1+0) + (int)*(p1+1) + (int)*(p1+2) + (int)*(p1+3)
                          + (int)*(p2+0) + (int)*(p2+1) + (int)*(p2+2) + (int)*(p2+3)
@@ -755,10 +795,10 @@ static ARUint8 *genBWImageQuart( ARUint8 *image, AR_PIXEL_FORMAT pixFormat, int
     else if( pixFormat == AR_PIXEL_FORMAT_2vuy ) {
         p  = newImage;
         for( j = 0; j < ysize2; j++ ) {
-            p1 = image + xsize*2*(j*4+0);
-            p2 = image + xsize*2*(j*4+1);
-            p3 = image + xsize*2*(j*4+2);
-            p4 = image + xsize*2*(j*4+3);
+            p1 = image + rowBytes*(j*4+0);
+            p2 = image + rowBytes*(j*4+1);
+            p3 = image + rowBytes*(j*4+2);
+            p4 = image + rowBytes*(j*4+3);
             for( i = 0; i < xsize2; i++ ) {
                 *(p++) = ( (int)*(p1+1) + (int)*(p1+3) + (int)*(p1+5) + (int)*(p1+7)
                          + (int)*(p2+1) + (int)*(p2+3) + (int)*(p2+5) + (int)*(p2+7)
@@ -774,10 +814,10 @@ static ARUint8 *genBWImageQuart( ARUint8 *image, AR_PIXEL_FORMAT pixFormat, int
     else if( pixFormat == AR_PIXEL_FORMAT_yuvs ) {
         p  = newImage;
         for( j = 0; j < ysize2; j++ ) {
-            p1 = image + xsize*2*(j*4+0);
-            p2 = image + xsize*2*(j*4+1);
-            p3 = image + xsize*2*(j*4+2);
-            p4 = image + xsize*2*(j*4+3);
+            p1 = image + rowBytes*(j*4+0);
+            p2 = image + rowBytes*(j*4+1);
+            p3 = image + rowBytes*(j*4+2);
+            p4 = image + rowBytes*(j*4+3);
             for( i = 0; i < xsize2; i++ ) {
                 *(p++) = ( (int)*(p1+0) + (int)*(p1+2) + (int)*(p1+4) + (int)*(p1+6)
                          + (int)*(p2+0) + (int)*(p2+2) + (int)*(p2+4) + (int)*(p2+6)
@@ -790,28 +830,24 @@ static ARUint8 *genBWImageQuart( ARUint8 *image, AR_PIXEL_FORMAT pixFormat, int
             }
         }
     }
-
-    return newImage;
 }
 
 
-static ARUint8 *genBWImageOneThird( ARUint8 *image, AR_PIXEL_FORMAT pixFormat, int xsize, int ysize, int *newXsize, int *newYsize )
+static void genBWImageOneThird( ARUint8 *image, AR_PIXEL_FORMAT pixFormat, int xsize, int ysize, int rowBytes, ARUint8 *newImage )
 {
-    ARUint8  *newImage;
     ARUint8  *p, *p1, *p2, *p3;
     int       xsize2, ysize2;
     int       i, j;
     
-    *newXsize = xsize2 = xsize/3;
-    *newYsize = ysize2 = ysize/3;
-    arMalloc( newImage, ARUint8, xsize2*ysize2 );
+    xsize2 = xsize/3;
+    ysize2 = ysize/3;
 
     if( pixFormat == AR_PIXEL_FORMAT_RGB || pixFormat == AR_PIXEL_FORMAT_BGR ) {
         p  = newImage;
         for( j = 0; j < ysize2; j++ ) {
-            p1 = image + xsize*3*(j*3+0);
-            p2 = image + xsize*3*(j*3+1);
-            p3 = image + xsize*3*(j*3+2);
+            p1 = image + rowBytes*(j*3+0);
+            p2 = image + rowBytes*(j*3+1);
+            p3 = image + rowBytes*(j*3+2);
             for( i = 0; i < xsize2; i++ ) {
                 *(p++) = ( (int)*(p1+0) + (int)*(p1+1) + (int)*(p1+2)
                          + (int)*(p1+3) + (int)*(p1+4) + (int)*(p1+5)
@@ -831,9 +867,9 @@ static ARUint8 *genBWImageOneThird( ARUint8 *image, AR_PIXEL_FORMAT pixFormat, i
     else if( pixFormat == AR_PIXEL_FORMAT_RGBA || pixFormat == AR_PIXEL_FORMAT_BGRA ) {
         p  = newImage;
         for( j = 0; j < ysize2; j++ ) {
-            p1 = image + xsize*4*(j*3+0);
-            p2 = image + xsize*4*(j*3+1);
-            p3 = image + xsize*4*(j*3+2);
+            p1 = image + rowBytes*(j*3+0);
+            p2 = image + rowBytes*(j*3+1);
+            p3 = image + rowBytes*(j*3+2);
             for( i = 0; i < xsize2; i++ ) {
                 *(p++) = ( (int)*(p1+0) + (int)*(p1+1) + (int)*(p1+2)
                          + (int)*(p1+4) + (int)*(p1+5) + (int)*(p1+6)
@@ -853,9 +889,9 @@ static ARUint8 *genBWImageOneThird( ARUint8 *image, AR_PIXEL_FORMAT pixFormat, i
     else if( pixFormat == AR_PIXEL_FORMAT_ABGR || pixFormat == AR_PIXEL_FORMAT_ARGB) {
         p  = newImage;
         for( j = 0; j < ysize2; j++ ) {
-            p1 = image + xsize*4*(j*3+0);
-            p2 = image + xsize*4*(j*3+1);
-            p3 = image + xsize*4*(j*3+2);
+            p1 = image + rowBytes*(j*3+0);
+            p2 = image + rowBytes*(j*3+1);
+            p3 = image + rowBytes*(j*3+2);
             for( i = 0; i < xsize2; i++ ) {
                 *(p++) = ( (int)*(p1+1) + (int)*(p1+2) + (int)*(p1+3)
                          + (int)*(p1+5) + (int)*(p1+6) + (int)*(p1+7)
@@ -875,9 +911,9 @@ static ARUint8 *genBWImageOneThird( ARUint8 *image, AR_PIXEL_FORMAT pixFormat, i
     else if( pixFormat == AR_PIXEL_FORMAT_MONO || pixFormat == AR_PIXEL_FORMAT_420f || pixFormat == AR_PIXEL_FORMAT_420v || pixFormat == AR_PIXEL_FORMAT_NV21 ) {
         p  = newImage;
         for( j = 0; j < ysize2; j++ ) {
-            p1 = image + xsize*(j*3+0);
-            p2 = image + xsize*(j*3+1);
-            p3 = image + xsize*(j*3+2);
+            p1 = image + rowBytes*(j*3+0);
+            p2 = image + rowBytes*(j*3+1);
+            p3 = image + rowBytes*(j*3+2);
             for( i = 0; i < xsize2; i++ ) {
                 *(p++) = ( (int)*(p1+0) + (int)*(p1+1) + (int)*(p1+2)
                          + (int)*(p2+0) + (int)*(p2+1) + (int)*(p2+2)
@@ -891,9 +927,9 @@ static ARUint8 *genBWImageOneThird( ARUint8 *image, AR_PIXEL_FORMAT pixFormat, i
     else if( pixFormat == AR_PIXEL_FORMAT_2vuy ) {
         p  = newImage;
         for( j = 0; j < ysize2; j++ ) {
-            p1 = image + xsize*2*(j*3+0);
-            p2 = image + xsize*2*(j*3+1);
-            p3 = image + xsize*2*(j*3+2);
+            p1 = image + rowBytes*(j*3+0);
+            p2 = image + rowBytes*(j*3+1);
+            p3 = image + rowBytes*(j*3+2);
             for( i = 0; i < xsize2; i++ ) {
                 *(p++) = ( (int)*(p1+1) + (int)*(p1+3) + (int)*(p1+5)
                          + (int)*(p2+1) + (int)*(p2+3) + (int)*(p2+5)
@@ -907,9 +943,9 @@ static ARUint8 *genBWImageOneThird( ARUint8 *image, AR_PIXEL_FORMAT pixFormat, i
     else if( pixFormat == AR_PIXEL_FORMAT_yuvs ) {
         p  = newImage;
         for( j = 0; j < ysize2; j++ ) {
-            p1 = image + xsize*2*(j*3+0);
-            p2 = image + xsize*2*(j*3+1);
-            p3 = image + xsize*2*(j*3+2);
+            p1 = image + rowBytes*(j*3+0);
+            p2 = image + rowBytes*(j*3+1);
+            p3 = image + rowBytes*(j*3+2);
             for( i = 0; i < xsize2; i++ ) {
                 *(p++) = ( (int)*(p1+0) + (int)*(p1+2) + (int)*(p1+4)
                          + (int)*(p2+0) + (int)*(p2+2) + (int)*(p2+4)
@@ -920,28 +956,24 @@ static ARUint8 *genBWImageOneThird( ARUint8 *image, AR_PIXEL_FORMAT pixFormat, i
             }
         }
     }
-
-    return newImage;
 }
 
-static ARUint8 *genBWImageTwoThird  ( ARUint8 *image, AR_PIXEL_FORMAT pixFormat, int xsize, int ysize, int *newXsize, int *newYsize )
+static void genBWImageTwoThird  ( ARUint8 *image, AR_PIXEL_FORMAT pixFormat, int xsize, int ysize, int rowBytes, ARUint8 *newImage )
 {
-    ARUint8  *newImage;
     ARUint8  *q1, *q2, *p1, *p2, *p3;
     int       xsize2, ysize2;
     int       i, j;
     
-    *newXsize = xsize2 = xsize/3*2;
-    *newYsize = ysize2 = ysize/3*2;
-    arMalloc( newImage, ARUint8, xsize2*ysize2 );
+    xsize2 = xsize/3*2;
+    ysize2 = ysize/3*2;
 
     if( pixFormat == AR_PIXEL_FORMAT_RGB || pixFormat == AR_PIXEL_FORMAT_BGR ) {
         q1  = newImage;
         q2  = newImage + xsize2;
         for( j = 0; j < ysize2/2; j++ ) {
-            p1 = image + xsize*3*(j*3+0);
-            p2 = image + xsize*3*(j*3+1);
-            p3 = image + xsize*3*(j*3+2);
+            p1 = image + rowBytes*(j*3+0);
+            p2 = image + rowBytes*(j*3+1);
+            p3 = image + rowBytes*(j*3+2);
             for( i = 0; i < xsize2/2; i++ ) {
                 *(q1++) = ( ((int)*(p1+0) + (int)*(p1+1) + (int)*(p1+2))
                           + ((int)*(p1+3) + (int)*(p1+4) + (int)*(p1+5))/2
@@ -975,9 +1007,9 @@ static ARUint8 *genBWImageTwoThird  ( ARUint8 *image, AR_PIXEL_FORMAT pixFormat,
         q1  = newImage;
         q2  = newImage + xsize2;
         for( j = 0; j < ysize2/2; j++ ) {
-            p1 = image + xsize*4*(j*3+0);
-            p2 = image + xsize*4*(j*3+1);
-            p3 = image + xsize*4*(j*3+2);
+            p1 = image + rowBytes*(j*3+0);
+            p2 = image + rowBytes*(j*3+1);
+            p3 = image + rowBytes*(j*3+2);
             for( i = 0; i < xsize2/2; i++ ) {
                 *(q1++) = ( ((int)*(p1+0) + (int)*(p1+1) + (int)*(p1+2))
                           + ((int)*(p1+4) + (int)*(p1+5) + (int)*(p1+6))/2
@@ -1011,9 +1043,9 @@ static ARUint8 *genBWImageTwoThird  ( ARUint8 *image, AR_PIXEL_FORMAT pixFormat,
         q1  = newImage;
         q2  = newImage + xsize2;
         for( j = 0; j < ysize2/2; j++ ) {
-            p1 = image + xsize*4*(j*3+0);
-            p2 = image + xsize*4*(j*3+1);
-            p3 = image + xsize*4*(j*3+2);
+            p1 = image + rowBytes*(j*3+0);
+            p2 = image + rowBytes*(j*3+1);
+            p3 = image + rowBytes*(j*3+2);
             for( i = 0; i < xsize2/2; i++ ) {
                 *(q1++) = ( ((int)*(p1+1) + (int)*(p1+2) + (int)*(p1+3))
                           + ((int)*(p1+5) + (int)*(p1+6) + (int)*(p1+7))/2
@@ -1047,9 +1079,9 @@ static ARUint8 *genBWImageTwoThird  ( ARUint8 *image, AR_PIXEL_FORMAT pixFormat,
         q1  = newImage;
         q2  = newImage + xsize2;
         for( j = 0; j < ysize2/2; j++ ) {
-            p1 = image + xsize*(j*3+0);
-            p2 = image + xsize*(j*3+1);
-            p3 = image + xsize*(j*3+2);
+            p1 = image + rowBytes*(j*3+0);
+            p2 = image + rowBytes*(j*3+1);
+            p3 = image + rowBytes*(j*3+2);
             for( i = 0; i < xsize2/2; i++ ) {
                 *(q1++) = ( (int)*(p1+0)   + (int)*(p1+1)/2
                           + (int)*(p2+0)/2 + (int)*(p2+1)/4 ) *4/9;
@@ -1074,9 +1106,9 @@ static ARUint8 *genBWImageTwoThird  ( ARUint8 *image, AR_PIXEL_FORMAT pixFormat,
         q1  = newImage;
         q2  = newImage + xsize2;
         for( j = 0; j < ysize2/2; j++ ) {
-            p1 = image + xsize*2*(j*3+0);
-            p2 = image + xsize*2*(j*3+1);
-            p3 = image + xsize*2*(j*3+2);
+            p1 = image + rowBytes*(j*3+0);
+            p2 = image + rowBytes*(j*3+1);
+            p3 = image + rowBytes*(j*3+2);
             for( i = 0; i < xsize2/2; i++ ) {
                 *(q1++) = ( (int)*(p1+1)   + (int)*(p1+3)/2
                           + (int)*(p2+1)/2 + (int)*(p2+3)/4 ) *4/9;
@@ -1101,9 +1133,9 @@ static ARUint8 *genBWImageTwoThird  ( ARUint8 *image, AR_PIXEL_FORMAT pixFormat,
         q1  = newImage;
         q2  = newImage + xsize2;
         for( j = 0; j < ysize2/2; j++ ) {
-            p1 = image + xsize*2*(j*3+0);
-            p2 = image + xsize*2*(j*3+1);
-            p3 = image + xsize*2*(j*3+2);
+            p1 = image + rowBytes*(j*3+0);
+            p2 = image + rowBytes*(j*3+1);
+            p3 = image + rowBytes*(j*3+2);
             for( i = 0; i < xsize2/2; i++ ) {
                 *(q1++) = ( (int)*(p1+0)   + (int)*(p1+2)/2
                           + (int)*(p2+0)/2 + (int)*(p2+2)/4 ) *4/9;
@@ -1124,8 +1156,6 @@ static ARUint8 *genBWImageTwoThird  ( ARUint8 *image, AR_PIXEL_FORMAT pixFormat,
             q2 += xsize2;
         }
     }
-
-    return newImage;
 }
 
 #if !BINARY_FEATURE
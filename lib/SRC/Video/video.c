@@ -72,6 +72,8 @@ int arVideoGetDefaultDevice( void )
     return AR_VIDEO_DEVICE_QUICKTIME7;
 #elif defined(AR_DEFAULT_INPUT_IMAGE)
     return AR_VIDEO_DEVICE_IMAGE;
+#elif defined(AR_DEFAULT_INPUT_RAW)
+    return AR_VIDEO_DEVICE_RAW;
 #elif defined(AR_DEFAULT_INPUT_ANDROID)
     return AR_VIDEO_DEVICE_ANDROID;
 #elif defined(AR_DEFAULT_INPUT_WINDOWS_MEDIA_FOUNDATION)
@@ -134,6 +134,9 @@ static int ar2VideoGetDeviceWithConfig(const char *config, const char **configSt
             else if( strcmp( b, "-device=Image" ) == 0 )    {
                 device = AR_VIDEO_DEVICE_IMAGE;
             }
+            else if( strcmp( b, "-device=Raw" ) == 0 )    {
+                device = AR_VIDEO_DEVICE_RAW;
+            }
             else if( strcmp( b, "-device=Android" ) == 0 )    {
                 device = AR_VIDEO_DEVICE_ANDROID;
             }
@@ -233,6 +236,11 @@ ARVideoSourceInfoListT *ar2VideoCreateSourceInfoList(const char *config_in)
         return (NULL);
     }
 #endif
+#ifdef AR_INPUT_RAW
+    if (device == AR_VIDEO_DEVICE_RAW) {
+        return (NULL);
+    }
+#endif
 #ifdef AR_INPUT_ANDROID
     if (device == AR_VIDEO_DEVICE_ANDROID) {
         return (NULL);
@@ -375,6 +383,13 @@ AR2VideoParamT *ar2VideoOpen( const char *config_in )
         if( (vid->device.image = ar2VideoOpenImage(config)) != NULL ) return vid;
 #else
         ARLOGe("ar2VideoOpen: Error: device \"Image\" not supported on this build/architecture/system.\n");
+#endif
+    }
+    if( vid->deviceType == AR_VIDEO_DEVICE_RAW ) {
+#ifdef AR_INPUT_RAW
+        if( (vid->device.raw = ar2VideoOpenRaw(config)) != NULL ) return vid;
+#else
+        ARLOGe("ar2VideoOpen: Error: device \"Raw\" not supported on this build/architecture/system.\n");
 #endif
     }
     if( vid->deviceType == AR_VIDEO_DEVICE_ANDROID ) {
@@ -506,6 +521,11 @@ int ar2VideoClose( AR2VideoParamT *vid )
         ret = ar2VideoCloseImage( vid->device.image );
     }
 #endif
+#ifdef AR_INPUT_RAW
+    if( vid->deviceType == AR_VIDEO_DEVICE_RAW ) {
+        ret = ar2VideoCloseRaw( vid->device.raw );
+    }
+#endif
 #ifdef AR_INPUT_ANDROID
     if( vid->deviceType == AR_VIDEO_DEVICE_ANDROID ) {
         ret = ar2VideoCloseAndroid( vid->device.android );
@@ -598,6 +618,11 @@ int ar2VideoDispOption( AR2VideoParamT *vid )
         return ar2VideoDispOptionImage();
     }
 #endif
+#ifdef AR_INPUT_RAW
+    if( vid->deviceType == AR_VIDEO_DEVICE_RAW ) {
+        return ar2VideoDispOptionRaw();
+    }
+#endif
 #ifdef AR_INPUT_ANDROID
     if( vid->deviceType == AR_VIDEO_DEVICE_ANDROID ) {
         return ar2VideoDispOptionAndroid();
@@ -695,6 +720,11 @@ int ar2VideoGetId( AR2VideoParamT *vid, ARUint32 *id0, ARUint32 *id1 )
         return ar2VideoGetIdImage( vid->device.image, id0, id1 );
     }
 #endif
+#ifdef AR_INPUT_RAW
+    if( vid->deviceType == AR_VIDEO_DEVICE_RAW ) {
+        return ar2VideoGetIdRaw( vid->device.raw, id0, id1 );
+    }
+#endif
 #ifdef AR_INPUT_ANDROID
     if( vid->deviceType == AR_VIDEO_DEVICE_ANDROID ) {
         return ar2VideoGetIdAndroid( vid->device.android, id0, id1 );
@@ -786,6 +816,11 @@ int ar2VideoGetSize(AR2VideoParamT *vid, int *x,int *y)
         return ar2VideoGetSizeImage( vid->device.image, x, y );
     }
 #endif
+#ifdef AR_INPUT_RAW
+    if( vid->deviceType == AR_VIDEO_DEVICE_RAW ) {
+        return ar2VideoGetSizeRaw( vid->device.raw, x, y );
+    }
+#endif
 #ifdef AR_INPUT_ANDROID
     if( vid->deviceType == AR_VIDEO_DEVICE_ANDROID ) {
         return ar2VideoGetSizeAndroid( vid->device.android, x, y );
@@ -882,6 +917,11 @@ AR_PIXEL_FORMAT ar2VideoGetPixelFormat( AR2VideoParamT *vid )
         return ar2VideoGetPixelFormatImage( vid->device.image );
     }
 #endif
+#ifdef AR_INPUT_RAW
+    if( vid->deviceType == AR_VIDEO_DEVICE_RAW ) {
+        return ar2VideoGetPixelFormatRaw( vid->device.raw );
+    }
+#endif
 #ifdef AR_INPUT_ANDROID
     if( vid->deviceType == AR_VIDEO_DEVICE_ANDROID ) {
         return ar2VideoGetPixelFormatAndroid( vid->device.android );
@@ -973,6 +1013,11 @@ AR2VideoBufferT *ar2VideoGetImage( AR2VideoParamT *vid )
         return ar2VideoGetImageImage( vid->device.image );
     }
 #endif
+#ifdef AR_INPUT_RAW
+    if( vid->deviceType == AR_VIDEO_DEVICE_RAW ) {
+        return ar2VideoGetImageRaw( vid->device.raw );
+    }
+#endif
 #ifdef AR_INPUT_ANDROID
     if( vid->deviceType == AR_VIDEO_DEVICE_ANDROID ) {
 #  if AR_VIDEO_ANDROID_ENABLE_NATIVE_CAMERA
@@ -1068,6 +1113,11 @@ int ar2VideoCapStart( AR2VideoParamT *vid )
         return ar2VideoCapStartImage( vid->device.image );
     }
 #endif
+#ifdef AR_INPUT_RAW
+    if( vid->deviceType == AR_VIDEO_DEVICE_RAW ) {
+        return ar2VideoCapStartRaw( vid->device.raw );
+    }
+#endif
 #ifdef AR_INPUT_ANDROID
     if( vid->deviceType == AR_VIDEO_DEVICE_ANDROID ) {
 #  if AR_VIDEO_ANDROID_ENABLE_NATIVE_CAMERA
@@ -1093,6 +1143,11 @@ int ar2VideoCapStart( AR2VideoParamT *vid )
 int ar2VideoCapStartAsync (AR2VideoParamT *vid, AR_VIDEO_FRAME_READY_CALLBACK callback, void *userdata)
 {
     if (!vid) return -1;
+#ifdef AR_INPUT_V4L2
+    if( vid->deviceType == AR_VIDEO_DEVICE_V4L2 ) {
+        return ar2VideoCapStartAsyncV4L2( vid->device.v4l2, callback, userdata );
+    }
+#endif
 #ifdef AR_INPUT_ANDROID
     if( vid->deviceType == AR_VIDEO_DEVICE_ANDROID ) {
 #  if AR_VIDEO_ANDROID_ENABLE_NATIVE_CAMERA
@@ -1178,6 +1233,11 @@ int ar2VideoCapStop( AR2VideoParamT *vid )
         return ar2VideoCapStopImage( vid->device.image );
     }
 #endif
+#ifdef AR_INPUT_RAW
+    if( vid->deviceType == AR_VIDEO_DEVICE_RAW ) {
+        return ar2VideoCapStopRaw( vid->device.raw );
+    }
+#endif
 #ifdef AR_INPUT_ANDROID
     if( vid->deviceType == AR_VIDEO_DEVICE_ANDROID ) {
 #  if AR_VIDEO_ANDROID_ENABLE_NATIVE_CAMERA
@@ -1288,6 +1348,11 @@ int ar2VideoGetParami( AR2VideoParamT *vid, int paramName, int *value )
         return ar2VideoGetParamiImage( vid->device.image, paramName, value );
     }
 #endif
+#ifdef AR_INPUT_RAW
+    if( vid->deviceType == AR_VIDEO_DEVICE_RAW ) {
+        return ar2VideoGetParamiRaw( vid->device.raw, paramName, value );
+    }
+#endif
 #ifdef AR_INPUT_ANDROID
     if( vid->deviceType == AR_VIDEO_DEVICE_ANDROID ) {
         return ar2VideoGetParamiAndroid( vid->device.android, paramName, value );
@@ -1379,6 +1444,11 @@ int ar2VideoSetParami( AR2VideoParamT *vid, int paramName, int  value )
         return ar2VideoSetParamiImage( vid->device.image, paramName, value );
     }
 #endif
+#ifdef AR_INPUT_RAW
+    if( vid->deviceType == AR_VIDEO_DEVICE_RAW ) {
+        return ar2VideoSetParamiRaw( vid->device.raw, paramName, value );
+    }
+#endif
 #ifdef AR_INPUT_ANDROID
     if( vid->deviceType == AR_VIDEO_DEVICE_ANDROID ) {
         return ar2VideoSetParamiAndroid( vid->device.android, paramName, value );
@@ -1470,6 +1540,11 @@ int ar2VideoGetParamd( AR2VideoParamT *vid, int paramName, double *value )
         return ar2VideoGetParamdImage( vid->device.image, paramName, value );
     }
 #endif
+#ifdef AR_INPUT_RAW
+    if( vid->deviceType == AR_VIDEO_DEVICE_RAW ) {
+        return ar2VideoGetParamdRaw( vid->device.raw, paramName, value );
+    }
+#endif
 #ifdef AR_INPUT_ANDROID
     if( vid->deviceType == AR_VIDEO_DEVICE_ANDROID ) {
         return ar2VideoGetParamdAndroid( vid->device.android, paramName, value );
@@ -1561,6 +1636,11 @@ int ar2VideoSetParamd( AR2VideoParamT *vid, int paramName, double  value )
         return ar2VideoSetParamdImage( vid->device.image, paramName, value );
     }
 #endif
+#ifdef AR_INPUT_RAW
+    if( vid->deviceType == AR_VIDEO_DEVICE_RAW ) {
+        return ar2VideoSetParamdRaw( vid->device.raw, paramName, value );
+    }
+#endif
 #ifdef AR_INPUT_ANDROID
     if( vid->deviceType == AR_VIDEO_DEVICE_ANDROID ) {
         return ar2VideoSetParamdAndroid( vid->device.android, paramName, value );
@@ -1603,6 +1683,11 @@ int ar2VideoGetParams( AR2VideoParamT *vid, const int paramName, char **value )
         return ar2VideoGetParamsImage( vid->device.image, paramName, value );
     }
 #endif
+#ifdef AR_INPUT_RAW
+    if( vid->deviceType == AR_VIDEO_DEVICE_RAW ) {
+        return ar2VideoGetParamsRaw( vid->device.raw, paramName, value );
+    }
+#endif
 #ifdef AR_INPUT_ANDROID
     if( vid->deviceType == AR_VIDEO_DEVICE_ANDROID ) {
         return ar2VideoGetParamsAndroid( vid->device.android, paramName, value );
@@ -1644,6 +1729,11 @@ int ar2VideoSetParams( AR2VideoParamT *vid, const int paramName, const char  *va
         return ar2VideoSetParamsImage( vid->device.image, paramName, value );
     }
 #endif
+#ifdef AR_INPUT_RAW
+    if( vid->deviceType == AR_VIDEO_DEVICE_RAW ) {
+        return ar2VideoSetParamsRaw( vid->device.raw, paramName, value );
+    }
+#endif
 #ifdef AR_INPUT_ANDROID
     if( vid->deviceType == AR_VIDEO_DEVICE_ANDROID ) {
         return ar2VideoSetParamsAndroid( vid->device.android, paramName, value );
@@ -1706,6 +1796,11 @@ int ar2VideoSetBufferSize(AR2VideoParamT *vid, const int width, const int height
     if( vid->deviceType == AR_VIDEO_DEVICE_IMAGE ) {
         return ar2VideoSetBufferSizeImage( vid->device.image, width, height );
     }
+#endif
+#ifdef AR_INPUT_RAW
+    if( vid->deviceType == AR_VIDEO_DEVICE_RAW ) {
+        return ar2VideoSetBufferSizeRaw( vid->device.raw, width, height );
+    }
 #endif
     return (-1);
 }
@@ -1732,6 +1827,11 @@ int ar2VideoGetBufferSize(AR2VideoParamT *vid, int *width, int *height)
     if( vid->deviceType == AR_VIDEO_DEVICE_IMAGE ) {
         return ar2VideoGetBufferSizeImage( vid->device.image, width, height );
     }
+#endif
+#ifdef AR_INPUT_RAW
+    if( vid->deviceType == AR_VIDEO_DEVICE_RAW ) {
+        return ar2VideoGetBufferSizeRaw( vid->device.raw, width, height );
+    }
 #endif
     return (-1);
 }
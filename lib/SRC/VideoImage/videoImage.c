@@ -42,13 +42,19 @@
 #ifdef AR_INPUT_IMAGE
 
 #include <string.h> // memset()
+#include <pthread.h>
 #include "jpeglib.h"
 
 #define AR_VIDEO_IMAGE_XSIZE_DEFAULT   640
 #define AR_VIDEO_IMAGE_YSIZE_DEFAULT   480
+#define AR_VIDEO_IMAGE_PREFETCH_DEFAULT 2   // Number of images decoded ahead of the caller. 0 = decode synchronously.
+#define AR_VIDEO_IMAGE_DECODERS_DEFAULT 1
 #ifndef MIN
 #define MIN(x,y) (x < y ? x : y)
 #endif
+#ifndef MAX
+#define MAX(x,y) (x > y ? x : y)
+#endif
 
 typedef struct _AR2VideoImageRef AR2VideoImageRef;
 
@@ -57,6 +63,17 @@ struct _AR2VideoImageRef {
     char *pathname;
 };
 
+#define AR_VIDEO_IMAGE_SLOT_FREE     0
+#define AR_VIDEO_IMAGE_SLOT_DECODING 1
+#define AR_VIDEO_IMAGE_SLOT_READY    2
+#define AR_VIDEO_IMAGE_SLOT_IN_USE   3
+
+typedef struct {
+    AR2VideoBufferT    buffer;
+    unsigned long      seq;         // Position of this image in the sequence handed to the decoders.
+    int                state;       // One of AR_VIDEO_IMAGE_SLOT_*.
+} AR2VideoImageSlotT;
+
 struct _AR2VideoParamImageT {
     AR2VideoBufferT    buffer;
     int                width;
@@ -68,6 +85,20 @@ struct _AR2VideoParamImageT {
     AR2VideoImageRef  *nextImage;
     unsigned long      imageCount;
     int                loop;
+    // Prefetch. While running, decoder threads fill up to prefetchDepth slots ahead of the caller,
+    // plus one more slot holding the buffer most recently returned from ar2VideoGetImageImage().
+    int                prefetchDepth;
+    int                prefetchDecoderCount;
+    int                prefetchRunning;
+    int                prefetchQuit;
+    pthread_t         *prefetchThreads;
+    pthread_mutex_t    prefetchMutex;
+    pthread_cond_t     prefetchCond;
+    AR2VideoImageSlotT *prefetchSlots;
+    AR2VideoImageRef  *prefetchNextImage; // Next image to be handed to a decoder.
+    unsigned long      prefetchSeqNext;   // Sequence number of the next image to be handed to a decoder.
+    unsigned long      prefetchSeqRead;   // Sequence number of the next image to be returned to the caller.
+    int                prefetchInUse;     // Index of the slot last returned to the caller, or -1.
 };
 
 #ifdef HAVE_LIBJPEG
@@ -239,6 +270,134 @@ static int jpegRead(FILE *fp, unsigned char *buf, int bufWidth, int bufHeight, A
 }
 #endif // HAVE_LIBJPEG
 
+static AR2VideoImageRef *ar2VideoImageNextRef(AR2VideoParamImageT *vid, AR2VideoImageRef *ref)
+{
+    ref = ref->next; // Next item in linked list.
+    if (!ref && vid->loop) ref = vid->imageList; // If we've hit the end of the list and looping requested, go back to head of linked list.
+    return (ref);
+}
+
+static int ar2VideoImageDecode(AR2VideoParamImageT *vid, AR2VideoImageRef *ref, AR2VideoBufferT *buffer)
+{
+    FILE *infile;
+    int ok;
+    
+    if ((infile = fopen(ref->pathname, "rb")) == NULL) {
+        ARLOGe("Can't open JPEG file '%s'\n", ref->pathname);
+        ARLOGperror(NULL);
+        return (FALSE);
+    }
+    ok = jpegRead(infile, buffer->buff, vid->bufWidth, vid->bufHeight, vid->format);
+    fclose(infile);
+    buffer->fillFlag  = 1;
+    buffer->time_sec  = 0;
+    buffer->time_usec = 0;
+    return (ok);
+}
+
+// Each decoder thread repeatedly claims the next image in the sequence and a free slot, and
+// decodes into the slot with the mutex released. Slots may complete out of order when there
+// is more than one decoder; ar2VideoGetImageImage() returns them by sequence number.
+static void *ar2VideoImagePrefetchThread(void *arg)
+{
+    AR2VideoParamImageT *vid = (AR2VideoParamImageT *)arg;
+    AR2VideoImageSlotT *slot;
+    AR2VideoImageRef *ref;
+    int i;
+    
+    pthread_mutex_lock(&(vid->prefetchMutex));
+    for (;;) {
+        slot = NULL;
+        if (!vid->prefetchQuit && vid->prefetchNextImage && vid->prefetchSeqNext - vid->prefetchSeqRead < (unsigned long)vid->prefetchDepth) {
+            for (i = 0; i <= vid->prefetchDepth; i++) {
+                if (vid->prefetchSlots[i].state == AR_VIDEO_IMAGE_SLOT_FREE) {
+                    slot = &(vid->prefetchSlots[i]);
+                    break;
+                }
+            }
+        }
+        if (!slot) {
+            if (vid->prefetchQuit) break;
+            pthread_cond_wait(&(vid->prefetchCond), &(vid->prefetchMutex));
+            continue;
+        }
+        
+        ref = vid->prefetchNextImage;
+        vid->prefetchNextImage = ar2VideoImageNextRef(vid, ref);
+        slot->seq = vid->prefetchSeqNext++;
+        slot->state = AR_VIDEO_IMAGE_SLOT_DECODING;
+        pthread_mutex_unlock(&(vid->prefetchMutex));
+        
+        slot->buffer.fillFlag = 0;
+        ar2VideoImageDecode(vid, ref, &(slot->buffer));
+        
+        pthread_mutex_lock(&(vid->prefetchMutex));
+        slot->state = AR_VIDEO_IMAGE_SLOT_READY;
+        pthread_cond_broadcast(&(vid->prefetchCond));
+    }
+    pthread_mutex_unlock(&(vid->prefetchMutex));
+    
+    return (NULL);
+}
+
+static void ar2VideoImagePrefetchStop(AR2VideoParamImageT *vid)
+{
+    int i;
+    
+    if (!vid->prefetchRunning) return;
+    
+    pthread_mutex_lock(&(vid->prefetchMutex));
+    vid->prefetchQuit = TRUE;
+    pthread_cond_broadcast(&(vid->prefetchCond));
+    pthread_mutex_unlock(&(vid->prefetchMutex));
+    for (i = 0; i < vid->prefetchDecoderCount; i++) pthread_join(vid->prefetchThreads[i], NULL);
+    free(vid->prefetchThreads);
+    vid->prefetchThreads = NULL;
+    pthread_cond_destroy(&(vid->prefetchCond));
+    pthread_mutex_destroy(&(vid->prefetchMutex));
+    
+    // Images decoded ahead but not yet returned are discarded. vid->nextImage still
+    // points to the next image the caller should see, so synchronous reads carry on from there.
+    for (i = 0; i <= vid->prefetchDepth; i++) free(vid->prefetchSlots[i].buffer.buff);
+    free(vid->prefetchSlots);
+    vid->prefetchSlots = NULL;
+    vid->prefetchRunning = FALSE;
+}
+
+static int ar2VideoImagePrefetchStart(AR2VideoParamImageT *vid)
+{
+    int i, rowBytes, err_i;
+    
+    if (vid->prefetchRunning || vid->prefetchDepth <= 0 || !vid->nextImage || !vid->bufWidth || !vid->bufHeight) return (0);
+    
+    rowBytes = vid->bufWidth * arVideoUtilGetPixelSize(vid->format);
+    arMallocClear(vid->prefetchSlots, AR2VideoImageSlotT, vid->prefetchDepth + 1);
+    for (i = 0; i <= vid->prefetchDepth; i++) {
+        arMalloc(vid->prefetchSlots[i].buffer.buff, ARUint8, vid->bufHeight * rowBytes);
+        vid->prefetchSlots[i].state = AR_VIDEO_IMAGE_SLOT_FREE;
+    }
+    arMalloc(vid->prefetchThreads, pthread_t, vid->prefetchDecoderCount);
+    pthread_mutex_init(&(vid->prefetchMutex), NULL);
+    pthread_cond_init(&(vid->prefetchCond), NULL);
+    vid->prefetchNextImage = vid->nextImage;
+    vid->prefetchSeqNext = vid->prefetchSeqRead = 0ul;
+    vid->prefetchInUse = -1;
+    vid->prefetchQuit = FALSE;
+    
+    for (i = 0; i < vid->prefetchDecoderCount; i++) {
+        if ((err_i = pthread_create(&(vid->prefetchThreads[i]), NULL, ar2VideoImagePrefetchThread, (void *)vid)) != 0) {
+            ARLOGe("Error %d creating image prefetch thread. Images will be decoded synchronously.\n", err_i);
+            vid->prefetchDecoderCount = i; // Only join the threads that were started.
+            vid->prefetchRunning = TRUE;
+            ar2VideoImagePrefetchStop(vid);
+            return (-1);
+        }
+    }
+    vid->prefetchRunning = TRUE;
+    
+    return (0);
+}
+
 int ar2VideoDispOptionImage( void )
 {
     ARLOG(" -device=Image\n");
@@ -255,6 +414,11 @@ int ar2VideoDispOptionImage( void )
     ARLOG("    After reading last image, next read will return first image.\n");
     ARLOG(" -noloop\n");
     ARLOG("    After reading last image, no further images will be returned.\n");
+    ARLOG(" -prefetch=N\n");
+    ARLOG("    Once capture is started, decode up to N images ahead in the background (default %d).\n", AR_VIDEO_IMAGE_PREFETCH_DEFAULT);
+    ARLOG("    N=0 decodes each image synchronously inside the get-image call.\n");
+    ARLOG(" -decoders=N\n");
+    ARLOG("    Number of background decoder threads used for prefetching (default %d).\n", AR_VIDEO_IMAGE_DECODERS_DEFAULT);
     ARLOG("\n");
 
     return 0;
@@ -284,6 +448,11 @@ AR2VideoParamImageT *ar2VideoOpenImage( const char *config )
     vid->imageList = NULL;
     vid->imageCount = 0ul;
     vid->loop = FALSE;
+    vid->prefetchDepth = AR_VIDEO_IMAGE_PREFETCH_DEFAULT;
+    vid->prefetchDecoderCount = AR_VIDEO_IMAGE_DECODERS_DEFAULT;
+    vid->prefetchRunning = FALSE;
+    vid->prefetchThreads = NULL;
+    vid->prefetchSlots = NULL;
 
     a = config;
     if( a != NULL) {
@@ -344,6 +513,14 @@ AR2VideoParamImageT *ar2VideoOpenImage( const char *config )
                 vid->loop = TRUE;
             } else if (strncmp(a, "-noloop", 7) == 0) {
                 vid->loop = FALSE;
+            } else if (strncmp(line, "-prefetch=", 10) == 0) {
+                if (sscanf(&line[10], "%d", &vid->prefetchDepth) == 0 || vid->prefetchDepth < 0) {
+                    err_i = 1;
+                }
+            } else if (strncmp(line, "-decoders=", 10) == 0) {
+                if (sscanf(&line[10], "%d", &vid->prefetchDecoderCount) == 0 || vid->prefetchDecoderCount < 1) {
+                    err_i = 1;
+                }
             } else if( strcmp( line, "-device=Image" ) == 0 )    {
             } else {
                 err_i = 1;
@@ -403,6 +580,9 @@ AR2VideoParamImageT *ar2VideoOpenImage( const char *config )
     
     // Point to head of image list.
     vid->nextImage = vid->imageList;
+    
+    // More decoders than images in flight would just sit idle.
+    if (vid->prefetchDecoderCount > vid->prefetchDepth) vid->prefetchDecoderCount = MAX(vid->prefetchDepth, 1);
 
     ARLOG("Image video size %dx%d@%dBpp.\n", vid->width, vid->height, arVideoUtilGetPixelSize(vid->format));
 
@@ -417,6 +597,7 @@ int ar2VideoCloseImage( AR2VideoParamImageT *vid )
     AR2VideoImageRef *imageRefToFree;
     
     if (!vid) return (-1); // Sanity check.
+    ar2VideoImagePrefetchStop(vid);
     while (vid->imageList) {
         imageRefToFree = vid->imageList;
         vid->imageList = vid->imageList->next;
@@ -432,35 +613,61 @@ int ar2VideoCloseImage( AR2VideoParamImageT *vid )
 
 int ar2VideoCapStartImage( AR2VideoParamImageT *vid )
 {
+    if (!vid) return (-1); // Sanity check.
+    ar2VideoImagePrefetchStart(vid); // On failure, falls back to synchronous decoding.
     return 0;
 }
 
 int ar2VideoCapStopImage( AR2VideoParamImageT *vid )
 {
+    if (!vid) return (-1); // Sanity check.
+    ar2VideoImagePrefetchStop(vid);
     return 0;
 }
 
 AR2VideoBufferT *ar2VideoGetImageImage( AR2VideoParamImageT *vid )
 {
-    FILE *infile;
-    int ok;
+    AR2VideoImageSlotT *slot;
+    int i;
 
     if (!vid) return (NULL); // Sanity check.
     
-    if (vid->nextImage) {
-        if ((infile = fopen(vid->nextImage->pathname, "rb")) == NULL) {
-            ARLOGe("Can't open JPEG file '%s'\n", vid->nextImage->pathname);
-            ARLOGperror(NULL);
-        } else {
-            ok = jpegRead(infile, vid->buffer.buff, vid->bufWidth, vid->bufHeight, vid->format);
-            fclose(infile);
-            vid->buffer.fillFlag  = 1;
-            vid->buffer.time_sec  = 0;
-            vid->buffer.time_usec = 0;
+    if (vid->prefetchRunning) {
+        pthread_mutex_lock(&(vid->prefetchMutex));
+        // The buffer returned last time is no longer in use by the caller.
+        if (vid->prefetchInUse >= 0) {
+            vid->prefetchSlots[vid->prefetchInUse].state = AR_VIDEO_IMAGE_SLOT_FREE;
+            vid->prefetchInUse = -1;
+            pthread_cond_broadcast(&(vid->prefetchCond));
         }
+        for (;;) {
+            slot = NULL;
+            for (i = 0; i <= vid->prefetchDepth; i++) {
+                if (vid->prefetchSlots[i].state == AR_VIDEO_IMAGE_SLOT_READY && vid->prefetchSlots[i].seq == vid->prefetchSeqRead) {
+                    slot = &(vid->prefetchSlots[i]);
+                    break;
+                }
+            }
+            if (slot) break;
+            if (vid->prefetchSeqRead == vid->prefetchSeqNext && !vid->prefetchNextImage) { // End of list and nothing in flight.
+                pthread_mutex_unlock(&(vid->prefetchMutex));
+                return (NULL);
+            }
+            pthread_cond_wait(&(vid->prefetchCond), &(vid->prefetchMutex));
+        }
+        slot->state = AR_VIDEO_IMAGE_SLOT_IN_USE;
+        vid->prefetchInUse = i;
+        vid->prefetchSeqRead++;
+        vid->nextImage = ar2VideoImageNextRef(vid, vid->nextImage);
+        pthread_cond_broadcast(&(vid->prefetchCond)); // A decoder may now start on another image.
+        pthread_mutex_unlock(&(vid->prefetchMutex));
         
-        vid->nextImage = vid->nextImage->next; // Next item in linked list.
-        if (!vid->nextImage && vid->loop) vid->nextImage = vid->imageList; // If we've hit the end of the list and looping requested, go back to head of linked list.
+        return &(slot->buffer);
+    }
+    
+    if (vid->nextImage) {
+        ar2VideoImageDecode(vid, vid->nextImage, &(vid->buffer));
+        vid->nextImage = ar2VideoImageNextRef(vid, vid->nextImage);
 
         return &(vid->buffer);
     } else {
@@ -486,9 +693,14 @@ AR_PIXEL_FORMAT ar2VideoGetPixelFormatImage( AR2VideoParamImageT *vid )
 int ar2VideoSetBufferSizeImage(AR2VideoParamImageT *vid, const int width, const int height)
 {
     int rowBytes;
+    int prefetchWasRunning;
 
     if (!vid) return (-1);
     
+    // Prefetch slots are sized to the buffer, so restart prefetching around the change.
+    prefetchWasRunning = vid->prefetchRunning;
+    ar2VideoImagePrefetchStop(vid);
+    
     if (vid->buffer.buff) {
         free (vid->buffer.buff);
         vid->buffer.buff = NULL;
@@ -510,6 +722,8 @@ int ar2VideoSetBufferSizeImage(AR2VideoParamImageT *vid, const int width, const
     vid->bufWidth = width;
     vid->bufHeight = height;
     
+    if (prefetchWasRunning) ar2VideoImagePrefetchStart(vid);
+    
     return (0);
 }
 
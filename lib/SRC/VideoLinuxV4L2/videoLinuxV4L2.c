@@ -0,0 +1,703 @@
+/*
+ *  videoLinuxV4L2.c
+ *  ARToolKit5
+ *
+ *  Video capture module using Video4Linux2 memory-mapped streaming I/O.
+ *
+ *  This file is part of ARToolKit.
+ *
+ *  ARToolKit is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ARToolKit is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ARToolKit.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  As a special exception, the copyright holders of this library give you
+ *  permission to link this library with independent modules to produce an
+ *  executable, regardless of the license terms of these independent modules, and to
+ *  copy and distribute the resulting executable under terms of your choice,
+ *  provided that you also meet, for each linked independent module, the terms and
+ *  conditions of the license of that module. An independent module is a module
+ *  which is neither derived from nor based on this library. If you modify this
+ *  library, you may extend this exception to your version of the library, but you
+ *  are not obligated to do so. If you do not wish to do so, delete this exception
+ *  statement from your version.
+ *
+ *  Copyright 2015 Daqri, LLC.
+ *  Copyright 2004-2015 ARToolworks, Inc.
+ *
+ *  Author(s): Hirokazu Kato, Philip Lamb
+ *
+ */
+
+#include <AR/video.h>
+
+#ifdef AR_INPUT_V4L2
+
+#include <stdio.h>
+#include <string.h> // memset()
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+
+#define AR_VIDEO_V4L2_DEFAULT_DEVICE    "/dev/video0"
+#define AR_VIDEO_V4L2_DEFAULT_WIDTH     640
+#define AR_VIDEO_V4L2_DEFAULT_HEIGHT    480
+#define AR_VIDEO_V4L2_DEFAULT_PALETTE   V4L2_PIX_FMT_YUYV
+#define AR_VIDEO_V4L2_DEFAULT_BUFFERS   4
+#define AR_VIDEO_V4L2_MIN_BUFFERS       3   // One held by the caller, and at least two for the driver to fill.
+#define AR_VIDEO_V4L2_POLL_TIMEOUT_MS   100 // How often the async thread checks for a stop request.
+
+static int xioctl(int fd, unsigned long request, void *arg)
+{
+    int r;
+
+    do {
+        r = ioctl(fd, request, arg);
+    } while (r == -1 && errno == EINTR);
+    return (r);
+}
+
+static AR_PIXEL_FORMAT ar2VideoV4L2PaletteToFormat(__u32 palette, __u32 quantization)
+{
+    switch (palette) {
+        case V4L2_PIX_FMT_GREY:   return (AR_PIXEL_FORMAT_MONO);
+        case V4L2_PIX_FMT_RGB24:  return (AR_PIXEL_FORMAT_RGB);
+        case V4L2_PIX_FMT_BGR24:  return (AR_PIXEL_FORMAT_BGR);
+#ifdef V4L2_PIX_FMT_ABGR32
+        case V4L2_PIX_FMT_ABGR32: // Bytes in memory are B, G, R, A.
+        case V4L2_PIX_FMT_XBGR32:
+#endif
+        case V4L2_PIX_FMT_BGR32:  return (AR_PIXEL_FORMAT_BGRA);
+#ifdef V4L2_PIX_FMT_ARGB32
+        case V4L2_PIX_FMT_ARGB32: // Bytes in memory are A, R, G, B.
+        case V4L2_PIX_FMT_XRGB32:
+#endif
+        case V4L2_PIX_FMT_RGB32:  return (AR_PIXEL_FORMAT_ARGB);
+        case V4L2_PIX_FMT_UYVY:   return (AR_PIXEL_FORMAT_2vuy);
+        case V4L2_PIX_FMT_YUYV:   return (AR_PIXEL_FORMAT_yuvs);
+        case V4L2_PIX_FMT_NV12:   return (quantization == V4L2_QUANTIZATION_FULL_RANGE ? AR_PIXEL_FORMAT_420f : AR_PIXEL_FORMAT_420v);
+        case V4L2_PIX_FMT_NV21:   return (AR_PIXEL_FORMAT_NV21);
+        default:                  return (AR_PIXEL_FORMAT_INVALID);
+    }
+}
+
+static int ar2VideoV4L2IsBiPlanar(AR_PIXEL_FORMAT format)
+{
+    return (format == AR_PIXEL_FORMAT_420v || format == AR_PIXEL_FORMAT_420f || format == AR_PIXEL_FORMAT_NV21);
+}
+
+static void ar2VideoV4L2SetControl(AR2VideoParamV4L2T *vid, __u32 id, int value, const char *name)
+{
+    struct v4l2_control control;
+
+    if (value == -1) return; // Leave at driver default.
+    memset(&control, 0, sizeof(control));
+    control.id = id;
+    control.value = value;
+    if (xioctl(vid->fd, VIDIOC_S_CTRL, &control) == -1) {
+        ARLOGw("Unable to set V4L2 control %s to %d.\n", name, value);
+    }
+}
+
+// Points each buffer's AR2VideoBufferT at its mapping, or sets up the repacking buffer if the driver pads rows.
+static int ar2VideoV4L2SetupOutBuffers(AR2VideoParamV4L2T *vid)
+{
+    int i, pixelSize, packedRowBytes, size;
+
+    pixelSize = arVideoUtilGetPixelSize(vid->format);
+    packedRowBytes = vid->width * pixelSize;
+    size = packedRowBytes * vid->height;
+    if (ar2VideoV4L2IsBiPlanar(vid->format)) size += packedRowBytes * vid->height / 2;
+
+    for (i = 0; i < vid->n_buffers; i++) {
+        vid->buffers[i].out.buff = vid->buffers[i].start;
+        vid->buffers[i].out.bufPlanes = NULL;
+        vid->buffers[i].out.bufPlaneCount = 0;
+        if (ar2VideoV4L2IsBiPlanar(vid->format)) {
+            vid->buffers[i].outPlanes[0] = vid->buffers[i].start;
+            vid->buffers[i].outPlanes[1] = vid->buffers[i].start + vid->bytesPerLine * vid->height;
+            vid->buffers[i].out.bufPlanes = vid->buffers[i].outPlanes;
+            vid->buffers[i].out.bufPlaneCount = 2;
+        }
+    }
+
+    if (vid->bytesPerLine != packedRowBytes) {
+        ARLOGw("V4L2 driver pads rows to %d bytes (%d needed). Frames will be repacked.\n", vid->bytesPerLine, packedRowBytes);
+        arMalloc(vid->copyBuffer, ARUint8, size);
+        vid->copyOut.buff = vid->copyBuffer;
+        if (ar2VideoV4L2IsBiPlanar(vid->format)) {
+            vid->copyOutPlanes[0] = vid->copyBuffer;
+            vid->copyOutPlanes[1] = vid->copyBuffer + packedRowBytes * vid->height;
+            vid->copyOut.bufPlanes = vid->copyOutPlanes;
+            vid->copyOut.bufPlaneCount = 2;
+        }
+    }
+    return (0);
+}
+
+static void ar2VideoV4L2Repack(AR2VideoParamV4L2T *vid, const ARUint8 *src)
+{
+    int row, rows, packedRowBytes;
+    ARUint8 *dst = vid->copyBuffer;
+
+    packedRowBytes = vid->width * arVideoUtilGetPixelSize(vid->format);
+    rows = vid->height;
+    if (ar2VideoV4L2IsBiPlanar(vid->format)) rows += vid->height / 2;
+    for (row = 0; row < rows; row++) {
+        memcpy(dst, src, packedRowBytes);
+        dst += packedRowBytes;
+        src += vid->bytesPerLine;
+    }
+}
+
+static int ar2VideoV4L2QueueBuffer(AR2VideoParamV4L2T *vid, int index)
+{
+    struct v4l2_buffer buf;
+
+    memset(&buf, 0, sizeof(buf));
+    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = V4L2_MEMORY_MMAP;
+    buf.index = index;
+    if (xioctl(vid->fd, VIDIOC_QBUF, &buf) == -1) {
+        ARLOGe("Error queueing V4L2 buffer %d.\n", index);
+        ARLOGperror(NULL);
+        return (-1);
+    }
+    return (0);
+}
+
+static void ar2VideoV4L2UnmapBuffers(AR2VideoParamV4L2T *vid)
+{
+    struct v4l2_requestbuffers req;
+    int i;
+
+    if (vid->buffers) {
+        for (i = 0; i < vid->n_buffers; i++) {
+            if (vid->buffers[i].start && vid->buffers[i].start != MAP_FAILED) munmap(vid->buffers[i].start, vid->buffers[i].length);
+        }
+        free(vid->buffers);
+        vid->buffers = NULL;
+    }
+    vid->n_buffers = 0;
+
+    memset(&req, 0, sizeof(req));
+    req.count = 0;
+    req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    req.memory = V4L2_MEMORY_MMAP;
+    xioctl(vid->fd, VIDIOC_REQBUFS, &req); // Release driver buffers. Failure is harmless.
+
+    free(vid->copyBuffer);
+    vid->copyBuffer = NULL;
+}
+
+static int ar2VideoV4L2MapBuffers(AR2VideoParamV4L2T *vid, int count)
+{
+    struct v4l2_requestbuffers req;
+    struct v4l2_buffer buf;
+    int i;
+
+    memset(&req, 0, sizeof(req));
+    req.count = count;
+    req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    req.memory = V4L2_MEMORY_MMAP;
+    if (xioctl(vid->fd, VIDIOC_REQBUFS, &req) == -1) {
+        if (errno == EINVAL) ARLOGe("Device '%s' does not support memory-mapped streaming.\n", vid->dev);
+        else ARLOGperror("VIDIOC_REQBUFS");
+        return (-1);
+    }
+    if (req.count < AR_VIDEO_V4L2_MIN_BUFFERS) {
+        ARLOGe("Insufficient buffer memory on '%s' (got %u buffers, need %d).\n", vid->dev, req.count, AR_VIDEO_V4L2_MIN_BUFFERS);
+        return (-1);
+    }
+
+    arMallocClear(vid->buffers, AR2VideoBufferV4L2T, req.count);
+    vid->n_buffers = req.count;
+    for (i = 0; i < vid->n_buffers; i++) {
+        memset(&buf, 0, sizeof(buf));
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = V4L2_MEMORY_MMAP;
+        buf.index = i;
+        if (xioctl(vid->fd, VIDIOC_QUERYBUF, &buf) == -1) {
+            ARLOGperror("VIDIOC_QUERYBUF");
+            return (-1);
+        }
+        vid->buffers[i].length = buf.length;
+        vid->buffers[i].start = (ARUint8 *)mmap(NULL, buf.length, PROT_READ | PROT_WRITE, MAP_SHARED, vid->fd, buf.m.offset);
+        if (vid->buffers[i].start == MAP_FAILED) {
+            vid->buffers[i].start = NULL;
+            ARLOGperror("mmap");
+            return (-1);
+        }
+    }
+    return (0);
+}
+
+int ar2VideoDispOptionV4L2( void )
+{
+    ARLOG(" -device=LinuxV4L2\n");
+    ARLOG("\n");
+    ARLOG(" -dev=filepath\n");
+    ARLOG("    specifies device file (default %s).\n", AR_VIDEO_V4L2_DEFAULT_DEVICE);
+    ARLOG(" -channel=N\n");
+    ARLOG("    specifies source channel (input).\n");
+    ARLOG(" -width=N\n");
+    ARLOG("    specifies expected width of image.\n");
+    ARLOG(" -height=N\n");
+    ARLOG("    specifies expected height of image.\n");
+    ARLOG(" -fps=N\n");
+    ARLOG("    requests a frame rate from the device.\n");
+    ARLOG(" -format=X\n");
+    ARLOG("    requests format of image pixels. The driver may substitute another.\n");
+    ARLOG("    Acceptable values for X are:\n");
+    ARLOG("    yuvs (YUYV, the default), 2vuy (UYVY), 420v (NV12), NV21, MONO,\n");
+    ARLOG("    RGB, BGR, BGRA, ARGB.\n");
+    ARLOG(" -buffers=N\n");
+    ARLOG("    number of memory-mapped capture buffers (default %d, minimum %d).\n", AR_VIDEO_V4L2_DEFAULT_BUFFERS, AR_VIDEO_V4L2_MIN_BUFFERS);
+    ARLOG(" -brightness=N\n");
+    ARLOG(" -contrast=N\n");
+    ARLOG(" -saturation=N\n");
+    ARLOG(" -hue=N\n");
+    ARLOG(" -gain=N\n");
+    ARLOG(" -gamma=N\n");
+    ARLOG(" -exposure=N\n");
+    ARLOG("    set the corresponding device control, in device units.\n");
+    ARLOG(" -debug\n");
+    ARLOG("    print the format negotiated with the device.\n");
+    ARLOG("\n");
+
+    return 0;
+}
+
+AR2VideoParamV4L2T *ar2VideoOpenV4L2( const char *config )
+{
+    AR2VideoParamV4L2T       *vid;
+    const char               *a;
+    char                      line[256];
+    int                       bufferCount = AR_VIDEO_V4L2_DEFAULT_BUFFERS;
+    int                       err_i = 0;
+    struct v4l2_capability    cap;
+    struct v4l2_format        fmt;
+    struct v4l2_streamparm    parm;
+    __u32                     caps;
+
+    arMallocClear( vid, AR2VideoParamV4L2T, 1 );
+    strcpy(vid->dev, AR_VIDEO_V4L2_DEFAULT_DEVICE);
+    vid->width      = AR_VIDEO_V4L2_DEFAULT_WIDTH;
+    vid->height     = AR_VIDEO_V4L2_DEFAULT_HEIGHT;
+    vid->channel    = -1;
+    vid->palette    = AR_VIDEO_V4L2_DEFAULT_PALETTE;
+    vid->format     = AR_PIXEL_FORMAT_INVALID;
+    vid->brightness = -1;
+    vid->contrast   = -1;
+    vid->saturation = -1;
+    vid->hue        = -1;
+    vid->gain       = -1;
+    vid->gamma      = -1;
+    vid->exposure   = -1;
+    vid->fd         = -1;
+    vid->status     = AR2VIDEO_V4L2_STATUS_IDLE;
+    vid->bufferInUse = -1;
+
+    a = config;
+    if( a != NULL) {
+        for(;;) {
+            while( *a == ' ' || *a == '\t' ) a++;
+            if( *a == '\0' ) break;
+
+            if( sscanf(a, "%s", line) == 0 ) break;
+            if( strncmp( line, "-dev=", 5 ) == 0 ) {
+                if( sscanf( &line[5], "%255s", vid->dev ) == 0 ) err_i = 1;
+            } else if( strncmp( line, "-channel=", 9 ) == 0 ) {
+                if( sscanf( &line[9], "%d", &vid->channel ) == 0 ) err_i = 1;
+            } else if( strncmp( line, "-width=", 7 ) == 0 ) {
+                if( sscanf( &line[7], "%d", &vid->width ) == 0 ) err_i = 1;
+            } else if( strncmp( line, "-height=", 8 ) == 0 ) {
+                if( sscanf( &line[8], "%d", &vid->height ) == 0 ) err_i = 1;
+            } else if( strncmp( line, "-fps=", 5 ) == 0 ) {
+                if( sscanf( &line[5], "%d", &vid->fps ) == 0 ) err_i = 1;
+            } else if( strncmp( line, "-buffers=", 9 ) == 0 ) {
+                if( sscanf( &line[9], "%d", &bufferCount ) == 0 || bufferCount < AR_VIDEO_V4L2_MIN_BUFFERS ) err_i = 1;
+            } else if( strncmp( line, "-brightness=", 12 ) == 0 ) {
+                if( sscanf( &line[12], "%d", &vid->brightness ) == 0 ) err_i = 1;
+            } else if( strncmp( line, "-contrast=", 10 ) == 0 ) {
+                if( sscanf( &line[10], "%d", &vid->contrast ) == 0 ) err_i = 1;
+            } else if( strncmp( line, "-saturation=", 12 ) == 0 ) {
+                if( sscanf( &line[12], "%d", &vid->saturation ) == 0 ) err_i = 1;
+            } else if( strncmp( line, "-hue=", 5 ) == 0 ) {
+                if( sscanf( &line[5], "%d", &vid->hue ) == 0 ) err_i = 1;
+            } else if( strncmp( line, "-gain=", 6 ) == 0 ) {
+                if( sscanf( &line[6], "%d", &vid->gain ) == 0 ) err_i = 1;
+            } else if( strncmp( line, "-gamma=", 7 ) == 0 ) {
+                if( sscanf( &line[7], "%d", &vid->gamma ) == 0 ) err_i = 1;
+            } else if( strncmp( line, "-exposure=", 10 ) == 0 ) {
+                if( sscanf( &line[10], "%d", &vid->exposure ) == 0 ) err_i = 1;
+            } else if( strncmp( line, "-format=", 8 ) == 0 ) {
+                if (strcmp(line+8, "yuvs") == 0 || strcmp(line+8, "YUYV") == 0) vid->palette = V4L2_PIX_FMT_YUYV;
+                else if (strcmp(line+8, "2vuy") == 0 || strcmp(line+8, "UYVY") == 0) vid->palette = V4L2_PIX_FMT_UYVY;
+                else if (strcmp(line+8, "420v") == 0 || strcmp(line+8, "420f") == 0 || strcmp(line+8, "NV12") == 0) vid->palette = V4L2_PIX_FMT_NV12;
+                else if (strcmp(line+8, "NV21") == 0) vid->palette = V4L2_PIX_FMT_NV21;
+                else if (strcmp(line+8, "MONO") == 0) vid->palette = V4L2_PIX_FMT_GREY;
+                else if (strcmp(line+8, "RGB") == 0) vid->palette = V4L2_PIX_FMT_RGB24;
+                else if (strcmp(line+8, "BGR") == 0) vid->palette = V4L2_PIX_FMT_BGR24;
+#ifdef V4L2_PIX_FMT_ABGR32
+                else if (strcmp(line+8, "BGRA") == 0) vid->palette = V4L2_PIX_FMT_ABGR32;
+                else if (strcmp(line+8, "ARGB") == 0) vid->palette = V4L2_PIX_FMT_ARGB32;
+#else
+                else if (strcmp(line+8, "BGRA") == 0) vid->palette = V4L2_PIX_FMT_BGR32;
+                else if (strcmp(line+8, "ARGB") == 0) vid->palette = V4L2_PIX_FMT_RGB32;
+#endif
+                else {
+                    ARLOGe("Unsupported V4L2 pixel format '%s'.\n", line+8);
+                    err_i = 1;
+                }
+            } else if( strcmp( line, "-debug" ) == 0 ) {
+                vid->debug = 1;
+            } else if( strcmp( line, "-device=LinuxV4L2" ) == 0 ) {
+            } else {
+                err_i = 1;
+            }
+
+            if (err_i) {
+                ARLOGe("Error with configuration option.\n");
+                ar2VideoDispOptionV4L2();
+                goto bail;
+            }
+
+            while( *a != ' ' && *a != '\t' && *a != '\0') a++;
+        }
+    }
+
+    // Non-blocking, so that ar2VideoGetImageV4L2() returns immediately when no new frame is ready.
+    if ((vid->fd = open(vid->dev, O_RDWR | O_NONBLOCK, 0)) == -1) {
+        ARLOGe("Unable to open video device '%s'.\n", vid->dev);
+        ARLOGperror(NULL);
+        goto bail;
+    }
+
+    if (xioctl(vid->fd, VIDIOC_QUERYCAP, &cap) == -1) {
+        if (errno == EINVAL) ARLOGe("'%s' is not a V4L2 device.\n", vid->dev);
+        else ARLOGperror("VIDIOC_QUERYCAP");
+        goto bail1;
+    }
+    caps = ((cap.capabilities & V4L2_CAP_DEVICE_CAPS) ? cap.device_caps : cap.capabilities);
+    if (!(caps & V4L2_CAP_VIDEO_CAPTURE)) {
+        ARLOGe("'%s' is not a video capture device.\n", vid->dev);
+        goto bail1;
+    }
+    if (!(caps & V4L2_CAP_STREAMING)) {
+        ARLOGe("'%s' does not support streaming I/O.\n", vid->dev);
+        goto bail1;
+    }
+
+    if (vid->channel >= 0) {
+        if (xioctl(vid->fd, VIDIOC_S_INPUT, &vid->channel) == -1) {
+            ARLOGe("Unable to select input %d on '%s'.\n", vid->channel, vid->dev);
+            goto bail1;
+        }
+    }
+
+    memset(&fmt, 0, sizeof(fmt));
+    fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    fmt.fmt.pix.width       = vid->width;
+    fmt.fmt.pix.height      = vid->height;
+    fmt.fmt.pix.pixelformat = vid->palette;
+    fmt.fmt.pix.field       = V4L2_FIELD_NONE;
+    if (xioctl(vid->fd, VIDIOC_S_FMT, &fmt) == -1) {
+        ARLOGperror("VIDIOC_S_FMT");
+        goto bail1;
+    }
+    // The driver may have adjusted any of these.
+    vid->width = fmt.fmt.pix.width;
+    vid->height = fmt.fmt.pix.height;
+    vid->palette = fmt.fmt.pix.pixelformat;
+    vid->bytesPerLine = fmt.fmt.pix.bytesperline;
+    vid->format = ar2VideoV4L2PaletteToFormat(vid->palette, fmt.fmt.pix.quantization);
+    if (vid->format == AR_PIXEL_FORMAT_INVALID) {
+        ARLOGe("V4L2 device '%s' offered unsupported pixel format '%c%c%c%c'.\n", vid->dev,
+               vid->palette & 0xff, (vid->palette >> 8) & 0xff, (vid->palette >> 16) & 0xff, (vid->palette >> 24) & 0xff);
+        goto bail1;
+    }
+    if (!vid->bytesPerLine) vid->bytesPerLine = vid->width * arVideoUtilGetPixelSize(vid->format);
+    if (vid->debug) {
+        ARLOGi("V4L2 format '%c%c%c%c' %dx%d, %d bytes per line, %u bytes per image.\n",
+               vid->palette & 0xff, (vid->palette >> 8) & 0xff, (vid->palette >> 16) & 0xff, (vid->palette >> 24) & 0xff,
+               vid->width, vid->height, vid->bytesPerLine, fmt.fmt.pix.sizeimage);
+    }
+
+    if (vid->fps > 0) {
+        memset(&parm, 0, sizeof(parm));
+        parm.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        parm.parm.capture.timeperframe.numerator = 1;
+        parm.parm.capture.timeperframe.denominator = vid->fps;
+        if (xioctl(vid->fd, VIDIOC_S_PARM, &parm) == -1) ARLOGw("Unable to set frame rate on '%s'.\n", vid->dev);
+    }
+
+    ar2VideoV4L2SetControl(vid, V4L2_CID_BRIGHTNESS, vid->brightness, "brightness");
+    ar2VideoV4L2SetControl(vid, V4L2_CID_CONTRAST, vid->contrast, "contrast");
+    ar2VideoV4L2SetControl(vid, V4L2_CID_SATURATION, vid->saturation, "saturation");
+    ar2VideoV4L2SetControl(vid, V4L2_CID_HUE, vid->hue, "hue");
+    ar2VideoV4L2SetControl(vid, V4L2_CID_GAIN, vid->gain, "gain");
+    ar2VideoV4L2SetControl(vid, V4L2_CID_GAMMA, vid->gamma, "gamma");
+    ar2VideoV4L2SetControl(vid, V4L2_CID_EXPOSURE_ABSOLUTE, vid->exposure, "exposure");
+
+    if (ar2VideoV4L2MapBuffers(vid, bufferCount) != 0) goto bail2;
+    if (ar2VideoV4L2SetupOutBuffers(vid) != 0) goto bail2;
+
+    pthread_mutex_init(&(vid->asyncMutex), NULL);
+    pthread_cond_init(&(vid->asyncCond), NULL);
+
+    ARLOGi("V4L2 video size %dx%d@%dBpp, %d buffers.\n", vid->width, vid->height, arVideoUtilGetPixelSize(vid->format), vid->n_buffers);
+
+    return vid;
+
+bail2:
+    ar2VideoV4L2UnmapBuffers(vid);
+bail1:
+    close(vid->fd);
+bail:
+    free(vid);
+    return (NULL);
+}
+
+int ar2VideoCloseV4L2( AR2VideoParamV4L2T *vid )
+{
+    if (!vid) return (-1); // Sanity check.
+
+    if (vid->status == AR2VIDEO_V4L2_STATUS_RUN) ar2VideoCapStopV4L2(vid);
+    ar2VideoV4L2UnmapBuffers(vid);
+    close(vid->fd);
+    pthread_cond_destroy(&(vid->asyncCond));
+    pthread_mutex_destroy(&(vid->asyncMutex));
+    free(vid);
+
+    return 0;
+}
+
+int ar2VideoGetIdV4L2( AR2VideoParamV4L2T *vid, ARUint32 *id0, ARUint32 *id1 )
+{
+    return -1;
+}
+
+int ar2VideoCapStartV4L2( AR2VideoParamV4L2T *vid )
+{
+    enum v4l2_buf_type type;
+    int i;
+
+    if (!vid) return (-1); // Sanity check.
+    if (vid->status == AR2VIDEO_V4L2_STATUS_RUN) {
+        ARLOGe("ar2VideoCapStartV4L2: Error, capture already started.\n");
+        return (-1);
+    }
+
+    // STREAMOFF returned every buffer to the application, so all are queued again here.
+    for (i = 0; i < vid->n_buffers; i++) {
+        if (ar2VideoV4L2QueueBuffer(vid, i) != 0) return (-1);
+    }
+    vid->bufferInUse = -1;
+
+    type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if (xioctl(vid->fd, VIDIOC_STREAMON, &type) == -1) {
+        ARLOGperror("VIDIOC_STREAMON");
+        return (-1);
+    }
+    vid->status = AR2VIDEO_V4L2_STATUS_RUN;
+
+    return 0;
+}
+
+// Waits for the driver to fill a buffer, then calls the user's callback. No further callback is made until the
+// frame has been collected with ar2VideoGetImageV4L2(), so a slow consumer is never called back repeatedly.
+static void *ar2VideoV4L2AsyncThread(void *arg)
+{
+    AR2VideoParamV4L2T *vid = (AR2VideoParamV4L2T *)arg;
+    struct pollfd pfd;
+    int ret;
+
+    pfd.fd = vid->fd;
+    pfd.events = POLLIN;
+
+    pthread_mutex_lock(&(vid->asyncMutex));
+    while (!vid->asyncQuit) {
+        if (vid->asyncFramePending) {
+            pthread_cond_wait(&(vid->asyncCond), &(vid->asyncMutex));
+            continue;
+        }
+        pthread_mutex_unlock(&(vid->asyncMutex));
+        pfd.revents = 0;
+        ret = poll(&pfd, 1, AR_VIDEO_V4L2_POLL_TIMEOUT_MS);
+        pthread_mutex_lock(&(vid->asyncMutex));
+        if (ret == -1 && errno != EINTR) {
+            ARLOGe("Error waiting for V4L2 frame.\n");
+            ARLOGperror(NULL);
+            break;
+        }
+        if (ret > 0 && (pfd.revents & POLLIN) && !vid->asyncQuit) {
+            vid->asyncFramePending = TRUE;
+            pthread_mutex_unlock(&(vid->asyncMutex));
+            (*vid->callback)(vid->userdata);
+            pthread_mutex_lock(&(vid->asyncMutex));
+        }
+    }
+    pthread_mutex_unlock(&(vid->asyncMutex));
+
+    return (NULL);
+}
+
+int ar2VideoCapStartAsyncV4L2( AR2VideoParamV4L2T *vid, AR_VIDEO_FRAME_READY_CALLBACK callback, void *userdata )
+{
+    int err_i;
+
+    if (!vid || !callback) return (-1); // Sanity check.
+
+    if (ar2VideoCapStartV4L2(vid) != 0) return (-1);
+
+    vid->callback = callback;
+    vid->userdata = userdata;
+    vid->asyncQuit = FALSE;
+    vid->asyncFramePending = FALSE;
+    if ((err_i = pthread_create(&(vid->asyncThread), NULL, ar2VideoV4L2AsyncThread, (void *)vid)) != 0) {
+        ARLOGe("Error %d creating V4L2 frame-ready thread.\n", err_i);
+        ar2VideoCapStopV4L2(vid);
+        return (-1);
+    }
+    vid->asyncRunning = TRUE;
+
+    return 0;
+}
+
+int ar2VideoCapStopV4L2( AR2VideoParamV4L2T *vid )
+{
+    enum v4l2_buf_type type;
+
+    if (!vid) return (-1); // Sanity check.
+    if (vid->status != AR2VIDEO_V4L2_STATUS_RUN) return (-1);
+
+    if (vid->asyncRunning) {
+        pthread_mutex_lock(&(vid->asyncMutex));
+        vid->asyncQuit = TRUE;
+        pthread_cond_signal(&(vid->asyncCond));
+        pthread_mutex_unlock(&(vid->asyncMutex));
+        pthread_join(vid->asyncThread, NULL);
+        vid->asyncRunning = FALSE;
+    }
+
+    type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if (xioctl(vid->fd, VIDIOC_STREAMOFF, &type) == -1) {
+        ARLOGperror("VIDIOC_STREAMOFF");
+    }
+    // The buffer last returned stays mapped, so it remains valid for the caller until close.
+    vid->bufferInUse = -1;
+    vid->status = AR2VIDEO_V4L2_STATUS_STOP;
+
+    return 0;
+}
+
+AR2VideoBufferT *ar2VideoGetImageV4L2( AR2VideoParamV4L2T *vid )
+{
+    struct v4l2_buffer buf;
+    int latest = -1;
+    AR2VideoBufferT *out;
+
+    if (!vid) return (NULL); // Sanity check.
+    if (vid->status != AR2VIDEO_V4L2_STATUS_RUN) return (NULL);
+
+    // The caller has finished with the frame returned last time, so give it back to the driver.
+    if (vid->bufferInUse >= 0) {
+        ar2VideoV4L2QueueBuffer(vid, vid->bufferInUse);
+        vid->bufferInUse = -1;
+    }
+
+    // Dequeue everything the driver has filled, keeping only the newest frame. Older frames are
+    // requeued immediately, so latency doesn't build up when the caller runs slower than the camera.
+    for (;;) {
+        memset(&buf, 0, sizeof(buf));
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = V4L2_MEMORY_MMAP;
+        if (xioctl(vid->fd, VIDIOC_DQBUF, &buf) == -1) {
+            if (errno != EAGAIN) {
+                ARLOGe("Error dequeueing V4L2 buffer.\n");
+                ARLOGperror(NULL);
+            }
+            break;
+        }
+        if (buf.index >= (__u32)vid->n_buffers) continue; // Shouldn't happen.
+        if (buf.flags & V4L2_BUF_FLAG_ERROR) { // Corrupt frame; recycle it.
+            ar2VideoV4L2QueueBuffer(vid, buf.index);
+            continue;
+        }
+        if (latest >= 0) ar2VideoV4L2QueueBuffer(vid, latest);
+        latest = buf.index;
+        vid->buffers[latest].out.time_sec  = (ARUint32)buf.timestamp.tv_sec;
+        vid->buffers[latest].out.time_usec = (ARUint32)buf.timestamp.tv_usec;
+    }
+
+    if (vid->asyncRunning) {
+        pthread_mutex_lock(&(vid->asyncMutex));
+        vid->asyncFramePending = FALSE;
+        pthread_cond_signal(&(vid->asyncCond));
+        pthread_mutex_unlock(&(vid->asyncMutex));
+    }
+
+    if (latest < 0) return (NULL);
+
+    vid->bufferInUse = latest;
+    out = &(vid->buffers[latest].out);
+    out->fillFlag = 1;
+    if (vid->copyBuffer) {
+        ar2VideoV4L2Repack(vid, vid->buffers[latest].start);
+        vid->copyOut.fillFlag  = 1;
+        vid->copyOut.time_sec  = out->time_sec;
+        vid->copyOut.time_usec = out->time_usec;
+        out = &(vid->copyOut);
+    }
+
+    return (out);
+}
+
+int ar2VideoGetSizeV4L2(AR2VideoParamV4L2T *vid, int *x,int *y)
+{
+    if (!vid) return (-1); // Sanity check.
+    *x = vid->width;
+    *y = vid->height;
+
+    return 0;
+}
+
+AR_PIXEL_FORMAT ar2VideoGetPixelFormatV4L2( AR2VideoParamV4L2T *vid )
+{
+    if (!vid) return (AR_PIXEL_FORMAT_INVALID);
+    return (vid->format);
+}
+
+int ar2VideoGetParamiV4L2( AR2VideoParamV4L2T *vid, int paramName, int *value )
+{
+    return -1;
+}
+
+int ar2VideoSetParamiV4L2( AR2VideoParamV4L2T *vid, int paramName, int  value )
+{
+    return -1;
+}
+
+int ar2VideoGetParamdV4L2( AR2VideoParamV4L2T *vid, int paramName, double *value )
+{
+    return -1;
+}
+
+int ar2VideoSetParamdV4L2( AR2VideoParamV4L2T *vid, int paramName, double  value )
+{
+    return -1;
+}
+
+#endif // AR_INPUT_V4L2
@@ -0,0 +1,659 @@
+/*
+ *	videoRaw.c
+ *  ARToolKit5
+ *
+ *  Video capture module which replays uncompressed frames from a raw or
+ *  YUV4MPEG2 (Y4M) file or from standard input.
+ *
+ *  This file is part of ARToolKit.
+ *
+ *  ARToolKit is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ARToolKit is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ARToolKit.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  As a special exception, the copyright holders of this library give you
+ *  permission to link this library with independent modules to produce an
+ *  executable, regardless of the license terms of these independent modules, and to
+ *  copy and distribute the resulting executable under terms of your choice,
+ *  provided that you also meet, for each linked independent module, the terms and
+ *  conditions of the license of that module. An independent module is a module
+ *  which is neither derived from nor based on this library. If you modify this
+ *  library, you may extend this exception to your version of the library, but you
+ *  are not obligated to do so. If you do not wish to do so, delete this exception
+ *  statement from your version.
+ *
+ *  Copyright 2015 Daqri, LLC.
+ *
+ *  Author(s): Philip Lamb
+ *
+ */
+
+#include <AR/video.h>
+
+#ifdef AR_INPUT_RAW
+
+#include <stdio.h>
+#include <string.h> // memset(), strncmp()
+#ifdef _WIN32
+#  include <io.h>     // _setmode(), _fileno()
+#  include <fcntl.h>  // _O_BINARY
+#  include <sys/timeb.h>
+#else
+#  include <sys/time.h>
+#endif
+
+#define AR_VIDEO_RAW_FPS_DEFAULT       30
+#define AR_VIDEO_RAW_Y4M_HEADER_MAX    1024
+#ifndef MIN
+#define MIN(x,y) (x < y ? x : y)
+#endif
+
+struct _AR2VideoParamRawT {
+    AR2VideoBufferT    buffer;
+    int                width;
+    int                height;
+    AR_PIXEL_FORMAT    format;
+    int                bufWidth;
+    int                bufHeight;
+    FILE              *fp;
+    int                fpIsStdin;
+    char               pending[10]; // Bytes read while checking for a Y4M signature, still to be delivered.
+    int                pendingCount;
+    int                y4m;
+    int                planar420;   // Frames are stored as three planes (Y, Cb, Cr), and chroma is interleaved on read.
+    ARUint8           *chromaBuf;   // Holds the Cb and Cr planes of a planar420 frame.
+    long               dataOffset;  // File offset of the first frame, or -1 if the stream is not seekable.
+    int                loop;
+    int                paced;
+    int                fpsNum;
+    int                fpsDen;
+    unsigned long      frameIndex;  // Index of the next frame to be read, counting across loops.
+    double             startTime;   // Wall time corresponding to frame 0 when paced, or < 0 if not yet started.
+    int                eos;
+};
+
+static double ar2VideoRawTime(void)
+{
+#ifdef _WIN32
+    struct _timeb sys_time;
+
+    _ftime(&sys_time);
+    return ((double)sys_time.time + (double)sys_time.millitm / 1000.0);
+#else
+    struct timeval time;
+
+    gettimeofday(&time, NULL);
+    return ((double)time.tv_sec + (double)time.tv_usec / 1000000.0);
+#endif
+}
+
+// Stream time of frame 'index', in seconds.
+static double ar2VideoRawFrameTime(AR2VideoParamRawT *vid, unsigned long index)
+{
+    return ((double)index * (double)vid->fpsDen / (double)vid->fpsNum);
+}
+
+// Parses the remainder of a "YUV4MPEG2 " stream header.
+static int ar2VideoRawReadY4MHeader(AR2VideoParamRawT *vid)
+{
+    char header[AR_VIDEO_RAW_Y4M_HEADER_MAX];
+    char *tok;
+    int colourspace420 = TRUE, mono = FALSE, fullRange = FALSE;
+
+    if (!fgets(header, sizeof(header), vid->fp) || !strchr(header, '\n')) {
+        ARLOGe("Error reading Y4M stream header.\n");
+        return (-1);
+    }
+    for (tok = strtok(header, " \n"); tok; tok = strtok(NULL, " \n")) {
+        switch (tok[0]) {
+            case 'W':
+                vid->width = atoi(tok + 1);
+                break;
+            case 'H':
+                vid->height = atoi(tok + 1);
+                break;
+            case 'F':
+                if (sscanf(tok + 1, "%d:%d", &vid->fpsNum, &vid->fpsDen) != 2 || vid->fpsNum <= 0 || vid->fpsDen <= 0) {
+                    ARLOGe("Y4M stream has invalid frame rate '%s'.\n", tok + 1);
+                    return (-1);
+                }
+                break;
+            case 'C':
+                if (strcmp(tok + 1, "mono") == 0) {
+                    mono = TRUE;
+                    colourspace420 = FALSE;
+                } else if (strncmp(tok + 1, "420", 3) == 0) { // 420, 420jpeg, 420paldv, 420mpeg2 differ only in chroma siting.
+                    colourspace420 = TRUE;
+                } else {
+                    ARLOGe("Y4M stream has unsupported colourspace '%s'. Only 4:2:0 and mono are supported.\n", tok + 1);
+                    return (-1);
+                }
+                break;
+            case 'I':
+                if (tok[1] != 'p' && tok[1] != '?') ARLOGw("Y4M stream is interlaced. Fields will be treated as a progressive frame.\n");
+                break;
+            case 'X':
+                if (strcmp(tok + 1, "COLORRANGE=FULL") == 0) fullRange = TRUE;
+                break;
+            default: // A (aspect ratio) and unrecognised parameters are ignored.
+                break;
+        }
+    }
+    if (vid->width <= 0 || vid->height <= 0) {
+        ARLOGe("Y4M stream header does not specify frame size.\n");
+        return (-1);
+    }
+    if (mono) {
+        vid->format = AR_PIXEL_FORMAT_MONO;
+    } else if (colourspace420) {
+        if ((vid->width & 1) || (vid->height & 1)) {
+            ARLOGe("Y4M 4:2:0 streams with odd frame dimensions (%dx%d) are not supported.\n", vid->width, vid->height);
+            return (-1);
+        }
+        vid->format = (fullRange ? AR_PIXEL_FORMAT_420f : AR_PIXEL_FORMAT_420v);
+        vid->planar420 = TRUE;
+    }
+    return (0);
+}
+
+// Consumes a Y4M "FRAME" header. Returns 1 if a header was read, 0 at end of stream, -1 on error.
+static int ar2VideoRawReadY4MFrameHeader(AR2VideoParamRawT *vid)
+{
+    char tag[6];
+    int c;
+
+    if (fread(tag, 1, 5, vid->fp) != 5) return (0);
+    if (strncmp(tag, "FRAME", 5) != 0) {
+        ARLOGe("Y4M stream is corrupt (expected FRAME header).\n");
+        return (-1);
+    }
+    do { // Skip frame parameters.
+        c = getc(vid->fp);
+    } while (c != '\n' && c != EOF);
+    return (c == '\n' ? 1 : 0);
+}
+
+static int ar2VideoRawRead(AR2VideoParamRawT *vid, ARUint8 *dst, size_t size)
+{
+    size_t n = 0;
+
+    if (vid->pendingCount) {
+        n = MIN((size_t)vid->pendingCount, size);
+        memcpy(dst, vid->pending, n);
+        vid->pendingCount -= (int)n;
+        memmove(vid->pending, vid->pending + n, vid->pendingCount);
+        if (n == size) return (TRUE);
+    }
+    return (fread(dst + n, 1, size - n, vid->fp) == size - n);
+}
+
+static int ar2VideoRawReadPlane(AR2VideoParamRawT *vid, ARUint8 *dst, int rowBytes, int rows, int dstRowBytes)
+{
+    int row;
+
+    if (rowBytes == dstRowBytes) {
+        return (ar2VideoRawRead(vid, dst, (size_t)rowBytes * rows));
+    }
+    for (row = 0; row < rows; row++) {
+        if (!ar2VideoRawRead(vid, dst + row*dstRowBytes, rowBytes)) return (FALSE);
+    }
+    return (TRUE);
+}
+
+// Reads the next frame into vid->buffer. Returns 1 on success, 0 at end of stream, -1 on error.
+static int ar2VideoRawReadFrame(AR2VideoParamRawT *vid)
+{
+    int ret;
+    int i, j, pixelSize, chromaPlaneBytes;
+    ARUint8 *cb, *cr, *p1;
+
+    if (vid->y4m) {
+        if ((ret = ar2VideoRawReadY4MFrameHeader(vid)) != 1) return (ret);
+    } else if (!vid->pendingCount) {
+        // Detect end of stream before the frame so that a clean end isn't reported as truncation.
+        if ((i = getc(vid->fp)) == EOF) return (0);
+        ungetc(i, vid->fp);
+    }
+
+    pixelSize = arVideoUtilGetPixelSize(vid->format);
+    if (!ar2VideoRawReadPlane(vid, vid->buffer.buff, vid->width*pixelSize, vid->height, vid->bufWidth*pixelSize)) goto truncated;
+
+    if (vid->format == AR_PIXEL_FORMAT_420v || vid->format == AR_PIXEL_FORMAT_420f || vid->format == AR_PIXEL_FORMAT_NV21) {
+        if (!vid->planar420) {
+            // Interleaved chroma plane is stored as-is.
+            if (!ar2VideoRawReadPlane(vid, vid->buffer.bufPlanes[1], vid->width, vid->height/2, vid->bufWidth)) goto truncated;
+        } else {
+            chromaPlaneBytes = (vid->width/2) * (vid->height/2);
+            if (!ar2VideoRawRead(vid, vid->chromaBuf, chromaPlaneBytes*2)) goto truncated;
+            cb = vid->chromaBuf;
+            cr = vid->chromaBuf + chromaPlaneBytes;
+            for (j = 0; j < vid->height/2; j++) {
+                p1 = vid->buffer.bufPlanes[1] + j*vid->bufWidth;
+                for (i = 0; i < vid->width/2; i++) {
+                    p1[0] = *cb++;
+                    p1[1] = *cr++;
+                    p1 += 2;
+                }
+            }
+        }
+    }
+
+    return (1);
+
+truncated:
+    ARLOGw("Raw video stream ended part-way through frame %lu.\n", vid->frameIndex);
+    return (0);
+}
+
+// Reads the next frame, rewinding to the first frame at end of stream if looping.
+static int ar2VideoRawReadNextFrame(AR2VideoParamRawT *vid)
+{
+    int ret;
+
+    ret = ar2VideoRawReadFrame(vid);
+    if (ret == 0 && vid->loop && vid->dataOffset >= 0) {
+        if (fseek(vid->fp, vid->dataOffset, SEEK_SET) == 0) ret = ar2VideoRawReadFrame(vid);
+    }
+    return (ret);
+}
+
+int ar2VideoDispOptionRaw( void )
+{
+    ARLOG(" -device=Raw\n");
+    ARLOG("\n");
+    ARLOG(" -file=pathname\n");
+    ARLOG(" -file=\"pathname\"\n");
+    ARLOG("    specifies file to read frames from. Use -file=- to read from standard input.\n");
+    ARLOG("    Files beginning with a YUV4MPEG2 header are read as Y4M (4:2:0 or mono),\n");
+    ARLOG("    and the size, format and frame rate options below are then ignored.\n");
+    ARLOG(" -width=N\n");
+    ARLOG("    specifies width of raw frames.\n");
+    ARLOG(" -height=N\n");
+    ARLOG("    specifies height of raw frames.\n");
+    ARLOG(" -format=X\n");
+    ARLOG("    specifies format of raw frame pixels.\n");
+    ARLOG("    Acceptable values for X are:\n");
+    ARLOG("    RGB, BGR, RGBA, BGRA, ARGB, ABGR, MONO, 2vuy, yuvs,\n");
+    ARLOG("    420v, 420f, NV21 (Y plane followed by interleaved chroma plane),\n");
+    ARLOG("    I420 (Y, Cb and Cr planes; returned as 420v).\n");
+    ARLOG(" -fps=N\n");
+    ARLOG("    specifies frame rate of raw frames, for timestamps and pacing (default %d).\n", AR_VIDEO_RAW_FPS_DEFAULT);
+    ARLOG(" -free\n");
+    ARLOG("    Return the next frame every time one is requested (default).\n");
+    ARLOG(" -paced\n");
+    ARLOG("    Return frames at their recorded times, measured from capture start.\n");
+    ARLOG("    No frame is returned until the next one is due, and late frames are dropped.\n");
+    ARLOG(" -loop\n");
+    ARLOG("    After reading last frame, next read will return first frame. Not available for standard input.\n");
+    ARLOG(" -noloop\n");
+    ARLOG("    After reading last frame, no further frames will be returned.\n");
+    ARLOG("\n");
+
+    return 0;
+}
+
+AR2VideoParamRawT *ar2VideoOpenRaw( const char *config )
+{
+    AR2VideoParamRawT        *vid;
+    const char               *a;
+    char                      line[1024];
+    char                      pathname[1024] = "";
+    int                       i;
+    int                       err_i = 0;
+
+    arMallocClear( vid, AR2VideoParamRawT, 1 );
+    vid->format = AR_PIXEL_FORMAT_INVALID;
+    vid->fpsNum = AR_VIDEO_RAW_FPS_DEFAULT;
+    vid->fpsDen = 1;
+    vid->dataOffset = -1L;
+    vid->startTime = -1.0;
+
+    a = config;
+    if( a != NULL) {
+        for(;;) {
+            while( *a == ' ' || *a == '\t' ) a++;
+            if( *a == '\0' ) break;
+
+            if (sscanf(a, "%s", line) == 0) break;
+            if (strncmp( line, "-width=", 7) == 0) {
+                if (sscanf(&line[7], "%d", &vid->width) == 0) {
+                    err_i = 1;
+                }
+            } else if (strncmp( line, "-height=", 8) == 0) {
+                if (sscanf( &line[8], "%d", &vid->height) == 0) {
+                    err_i = 1;
+                }
+            } else if (strncmp( line, "-fps=", 5) == 0) {
+                if (sscanf( &line[5], "%d", &vid->fpsNum) == 0 || vid->fpsNum <= 0) {
+                    err_i = 1;
+                }
+            } else if (strncmp(a, "-file=", 6) == 0) {
+                // Attempt to read in pathname, allowing for quoting of whitespace.
+                a += 6; // Skip "-file=" characters.
+                if (*a == '"') {
+                    a++;
+                    // Read all characters up to next '"'.
+                    i = 0;
+                    while (i < (sizeof(pathname) - 1) && *a != '\0') {
+                        pathname[i] = *a;
+                        a++;
+                        if (pathname[i] == '"') break;
+                        i++;
+                    }
+                    pathname[i] = '\0';
+                } else {
+                    sscanf(a, "%s", pathname);
+                }
+                if (!strlen(pathname)) err_i = 1;
+            } else if( strncmp( line, "-format=", 8 ) == 0 ) {
+                if (strcmp(line+8, "RGB") == 0) {
+                    vid->format = AR_PIXEL_FORMAT_RGB;
+                } else if (strcmp(line+8, "BGR") == 0) {
+                    vid->format = AR_PIXEL_FORMAT_BGR;
+                } else if (strcmp(line+8, "RGBA") == 0) {
+                    vid->format = AR_PIXEL_FORMAT_RGBA;
+                } else if (strcmp(line+8, "BGRA") == 0) {
+                    vid->format = AR_PIXEL_FORMAT_BGRA;
+                } else if (strcmp(line+8, "ARGB") == 0) {
+                    vid->format = AR_PIXEL_FORMAT_ARGB;
+                } else if (strcmp(line+8, "ABGR") == 0) {
+                    vid->format = AR_PIXEL_FORMAT_ABGR;
+                } else if (strcmp(line+8, "MONO") == 0) {
+                    vid->format = AR_PIXEL_FORMAT_MONO;
+                } else if (strcmp(line+8, "2vuy") == 0 || strcmp(line+8, "UYVY") == 0) {
+                    vid->format = AR_PIXEL_FORMAT_2vuy;
+                } else if (strcmp(line+8, "yuvs") == 0 || strcmp(line+8, "YUY2") == 0) {
+                    vid->format = AR_PIXEL_FORMAT_yuvs;
+                } else if (strcmp(line+8, "420v") == 0) {
+                    vid->format = AR_PIXEL_FORMAT_420v;
+                } else if (strcmp(line+8, "420f") == 0) {
+                    vid->format = AR_PIXEL_FORMAT_420f;
+                } else if (strcmp(line+8, "NV21") == 0) {
+                    vid->format = AR_PIXEL_FORMAT_NV21;
+                } else if (strcmp(line+8, "I420") == 0) {
+                    vid->format = AR_PIXEL_FORMAT_420v;
+                    vid->planar420 = TRUE;
+                } else {
+                    ARLOGe("Unsupported raw pixel format '%s'.\n", line+8);
+                    err_i = 1;
+                }
+            } else if (strcmp(line, "-free") == 0) {
+                vid->paced = FALSE;
+            } else if (strcmp(line, "-paced") == 0) {
+                vid->paced = TRUE;
+            } else if (strcmp(line, "-loop") == 0) {
+                vid->loop = TRUE;
+            } else if (strcmp(line, "-noloop") == 0) {
+                vid->loop = FALSE;
+            } else if( strcmp( line, "-device=Raw" ) == 0 )    {
+            } else {
+                err_i = 1;
+            }
+
+            if (err_i) {
+                ARLOGe("Error with configuration option.\n");
+                ar2VideoDispOptionRaw();
+                goto bail;
+            }
+
+            while( *a != ' ' && *a != '\t' && *a != '\0') a++;
+        }
+    }
+
+    if (!pathname[0]) {
+        ARLOGe("No file specified.\n");
+        goto bail;
+    }
+    if (strcmp(pathname, "-") == 0) {
+        vid->fp = stdin;
+        vid->fpIsStdin = TRUE;
+#ifdef _WIN32
+        _setmode(_fileno(stdin), _O_BINARY);
+#endif
+    } else if ((vid->fp = fopen(pathname, "rb")) == NULL) {
+        ARLOGe("Can't open raw video file '%s'\n", pathname);
+        ARLOGperror(NULL);
+        goto bail;
+    }
+
+    // Y4M streams identify themselves with a "YUV4MPEG2 " signature. Otherwise, what we read is the start of
+    // the first raw frame, and is held until then, as standard input can't be rewound.
+    vid->pendingCount = (int)fread(vid->pending, 1, sizeof(vid->pending), vid->fp);
+    if (vid->pendingCount == sizeof(vid->pending) && strncmp(vid->pending, "YUV4MPEG2 ", sizeof(vid->pending)) == 0) {
+        vid->pendingCount = 0;
+        vid->y4m = TRUE;
+        vid->planar420 = FALSE;
+        vid->width = vid->height = 0;
+        vid->fpsNum = AR_VIDEO_RAW_FPS_DEFAULT;
+        vid->fpsDen = 1;
+        vid->format = AR_PIXEL_FORMAT_INVALID;
+        if (ar2VideoRawReadY4MHeader(vid) != 0) goto bail1;
+        vid->dataOffset = (vid->fpIsStdin ? -1L : ftell(vid->fp));
+    } else {
+        vid->dataOffset = (vid->fpIsStdin ? -1L : 0L);
+        if (vid->width <= 0 || vid->height <= 0 || vid->format == AR_PIXEL_FORMAT_INVALID) {
+            ARLOGe("Raw video requires -width, -height and -format options.\n");
+            goto bail1;
+        }
+        if ((vid->format == AR_PIXEL_FORMAT_420v || vid->format == AR_PIXEL_FORMAT_420f || vid->format == AR_PIXEL_FORMAT_NV21) && ((vid->width & 1) || (vid->height & 1))) {
+            ARLOGe("4:2:0 raw frames must have even dimensions.\n");
+            goto bail1;
+        }
+    }
+
+    if (vid->loop && vid->dataOffset < 0) {
+        ARLOGw("Raw video input is not seekable. Ignoring -loop.\n");
+        vid->loop = FALSE;
+    }
+
+    if (vid->planar420) arMalloc(vid->chromaBuf, ARUint8, (vid->width/2) * (vid->height/2) * 2);
+    if (ar2VideoSetBufferSizeRaw(vid, vid->width, vid->height) != 0) {
+        goto bail1;
+    }
+
+    ARLOGi("Raw video size %dx%d@%dBpp, %.3f fps, %s%s.\n", vid->width, vid->height, arVideoUtilGetPixelSize(vid->format),
+           (double)vid->fpsNum / (double)vid->fpsDen, (vid->y4m ? "Y4M" : "raw"), (vid->paced ? ", paced" : ""));
+
+    return vid;
+
+bail1:
+    free(vid->chromaBuf);
+    if (!vid->fpIsStdin) fclose(vid->fp);
+bail:
+    free(vid);
+    return (NULL);
+}
+
+int ar2VideoCloseRaw( AR2VideoParamRawT *vid )
+{
+    if (!vid) return (-1); // Sanity check.
+
+    ar2VideoSetBufferSizeRaw(vid, 0, 0);
+    free(vid->chromaBuf);
+    if (!vid->fpIsStdin) fclose(vid->fp);
+    free( vid );
+
+    return 0;
+}
+
+int ar2VideoCapStartRaw( AR2VideoParamRawT *vid )
+{
+    if (!vid) return (-1); // Sanity check.
+
+    // Pace from the current position, so that stopping and restarting doesn't cause a burst of dropped frames.
+    vid->startTime = ar2VideoRawTime() - ar2VideoRawFrameTime(vid, vid->frameIndex);
+
+    return 0;
+}
+
+int ar2VideoCapStopRaw( AR2VideoParamRawT *vid )
+{
+    if (!vid) return (-1); // Sanity check.
+
+    vid->startTime = -1.0;
+
+    return 0;
+}
+
+AR2VideoBufferT *ar2VideoGetImageRaw( AR2VideoParamRawT *vid )
+{
+    unsigned long dueIndex;
+    double elapsed, t;
+    int ret;
+
+    if (!vid) return (NULL); // Sanity check.
+    if (vid->eos) return (NULL);
+
+    if (vid->paced) {
+        if (vid->startTime < 0.0) ar2VideoCapStartRaw(vid);
+        elapsed = ar2VideoRawTime() - vid->startTime;
+        if (elapsed < 0.0) return (NULL); // Clock stepped backwards.
+        dueIndex = (unsigned long)(elapsed * (double)vid->fpsNum / (double)vid->fpsDen);
+        if (vid->frameIndex > dueIndex) return (NULL); // Next frame not yet due.
+        // As a live camera would, drop frames which are already late.
+        while (vid->frameIndex < dueIndex) {
+            if ((ret = ar2VideoRawReadNextFrame(vid)) != 1) goto done;
+            vid->frameIndex++;
+        }
+    }
+
+    if ((ret = ar2VideoRawReadNextFrame(vid)) != 1) goto done;
+
+    t = ar2VideoRawFrameTime(vid, vid->frameIndex);
+    vid->buffer.fillFlag  = 1;
+    vid->buffer.time_sec  = (ARUint32)t;
+    vid->buffer.time_usec = (ARUint32)((t - (double)vid->buffer.time_sec) * 1000000.0);
+    vid->frameIndex++;
+
+    return &(vid->buffer);
+
+done:
+    if (ret == 0) ARLOGi("Raw video reached end of stream after %lu frames.\n", vid->frameIndex);
+    vid->eos = TRUE;
+    return (NULL);
+}
+
+int ar2VideoGetSizeRaw(AR2VideoParamRawT *vid, int *x,int *y)
+{
+    if (!vid) return (-1); // Sanity check.
+    *x = vid->width;
+    *y = vid->height;
+
+    return 0;
+}
+
+AR_PIXEL_FORMAT ar2VideoGetPixelFormatRaw( AR2VideoParamRawT *vid )
+{
+    if (!vid) return (AR_PIXEL_FORMAT_INVALID);
+    return (vid->format);
+}
+
+int ar2VideoSetBufferSizeRaw(AR2VideoParamRawT *vid, const int width, const int height)
+{
+    int rowBytes;
+
+    if (!vid) return (-1);
+
+    if (vid->buffer.bufPlaneCount) {
+        free(vid->buffer.bufPlanes[0]);
+        free(vid->buffer.bufPlanes[1]);
+        free(vid->buffer.bufPlanes);
+        vid->buffer.bufPlanes = NULL;
+        vid->buffer.bufPlaneCount = 0;
+        vid->buffer.buff = NULL;
+    } else {
+        if (vid->buffer.buff) {
+            free (vid->buffer.buff);
+            vid->buffer.buff = NULL;
+        }
+    }
+
+    if (width && height) {
+        if (width < vid->width || height < vid->height) {
+            ARLOGe("Error: Requested buffer size smaller than video size.\n");
+            return (-1);
+        }
+
+        if (vid->format == AR_PIXEL_FORMAT_420v || vid->format == AR_PIXEL_FORMAT_420f || vid->format == AR_PIXEL_FORMAT_NV21) {
+            arMallocClear(vid->buffer.bufPlanes, ARUint8 *, 2);
+            arMalloc(vid->buffer.bufPlanes[0], ARUint8, width*height);
+            arMalloc(vid->buffer.bufPlanes[1], ARUint8, width*height/2);
+            vid->buffer.bufPlaneCount = 2;
+            vid->buffer.buff = vid->buffer.bufPlanes[0];
+        } else {
+            rowBytes = width * arVideoUtilGetPixelSize(vid->format);
+            arMalloc(vid->buffer.buff, ARUint8, height * rowBytes);
+        }
+    }
+
+    vid->bufWidth = width;
+    vid->bufHeight = height;
+
+    return (0);
+}
+
+int ar2VideoGetBufferSizeRaw(AR2VideoParamRawT *vid, int *width, int *height)
+{
+    if (!vid) return (-1);
+    if (width) *width = vid->bufWidth;
+    if (height) *height = vid->bufHeight;
+    return (0);
+}
+
+int ar2VideoGetIdRaw( AR2VideoParamRawT *vid, ARUint32 *id0, ARUint32 *id1 )
+{
+    return -1;
+}
+
+int ar2VideoGetParamiRaw( AR2VideoParamRawT *vid, int paramName, int *value )
+{
+    return -1;
+}
+
+int ar2VideoSetParamiRaw( AR2VideoParamRawT *vid, int paramName, int  value )
+{
+    return -1;
+}
+
+int ar2VideoGetParamdRaw( AR2VideoParamRawT *vid, int paramName, double *value )
+{
+    return -1;
+}
+
+int ar2VideoSetParamdRaw( AR2VideoParamRawT *vid, int paramName, double  value )
+{
+    return -1;
+}
+
+int ar2VideoGetParamsRaw( AR2VideoParamRawT *vid, const int paramName, char **value )
+{
+    if (!vid || !value) return (-1);
+
+    switch (paramName) {
+        default:
+            return (-1);
+    }
+    return (0);
+}
+
+int ar2VideoSetParamsRaw( AR2VideoParamRawT *vid, const int paramName, const char  *value )
+{
+    if (!vid) return (-1);
+
+    switch (paramName) {
+        default:
+            return (-1);
+    }
+    return (0);
+}
+
+#endif //  AR_INPUT_RAW